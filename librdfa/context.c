@@ -113,6 +113,9 @@ void rdfa_init_context(rdfacontext* context)
    context->local_list_mappings =
       rdfa_create_mapping(MAX_LOCAL_LIST_MAPPINGS);
 
+   /* CURIEs resolved with the current mappings */
+   context->curie_cache = rdfa_create_curie_cache();
+
    /* the default vocabulary is set to null
     * (or a IRI defined in the initial context of the Host Language). */
    context->default_vocabulary = NULL;
@@ -164,7 +167,7 @@ do {                                                                    \
     } while(0)
 #else
 #define DECLARE_URI_MAPPING(context, prefix, value)                     \
-  rdfa_update_mapping(context->uri_mappings, prefix, value,             \
+  rdfa_update_mapping(&context->uri_mappings, prefix, value,            \
                       (update_mapping_value_fp)rdfa_replace_string)
 #endif
 
@@ -174,7 +177,7 @@ void rdfa_setup_initial_context(rdfacontext* context)
 #else
    char* key = NULL;
    void* value = NULL;
-   void** mptr = context->uri_mappings;
+   size_t position = 0;
 #endif
 
    /* Setup the base RDFa 1.1 prefix and term mappings */
@@ -239,13 +242,13 @@ void rdfa_setup_initial_context(rdfacontext* context)
          "schema", "http://schema.org/");
 
       /* Setup the base RDFa 1.1 term mappings */
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "describedby", "http://www.w3.org/2007/05/powder-s#describedby",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "license", "http://www.w3.org/1999/xhtml/vocab#license",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "role", "http://www.w3.org/1999/xhtml/vocab#role",
          (update_mapping_value_fp)rdfa_replace_string);
    }
@@ -253,84 +256,84 @@ void rdfa_setup_initial_context(rdfacontext* context)
    /* Setup the term mappings for XHTML1 */
    if(context->host_language == HOST_LANGUAGE_XHTML1)
    {
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "alternate", "http://www.w3.org/1999/xhtml/vocab#alternate",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "appendix", "http://www.w3.org/1999/xhtml/vocab#appendix",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "cite", "http://www.w3.org/1999/xhtml/vocab#cite",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "bookmark", "http://www.w3.org/1999/xhtml/vocab#bookmark",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "contents", "http://www.w3.org/1999/xhtml/vocab#contents",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "chapter", "http://www.w3.org/1999/xhtml/vocab#chapter",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "copyright", "http://www.w3.org/1999/xhtml/vocab#copyright",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "first", "http://www.w3.org/1999/xhtml/vocab#first",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "glossary", "http://www.w3.org/1999/xhtml/vocab#glossary",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "help", "http://www.w3.org/1999/xhtml/vocab#help",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "icon", "http://www.w3.org/1999/xhtml/vocab#icon",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "index", "http://www.w3.org/1999/xhtml/vocab#index",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "last", "http://www.w3.org/1999/xhtml/vocab#last",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "license", "http://www.w3.org/1999/xhtml/vocab#license",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "meta", "http://www.w3.org/1999/xhtml/vocab#meta",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "next", "http://www.w3.org/1999/xhtml/vocab#next",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "prev", "http://www.w3.org/1999/xhtml/vocab#prev",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "previous", "http://www.w3.org/1999/xhtml/vocab#previous",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "section", "http://www.w3.org/1999/xhtml/vocab#section",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "start", "http://www.w3.org/1999/xhtml/vocab#start",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "stylesheet", "http://www.w3.org/1999/xhtml/vocab#stylesheet",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "subsection", "http://www.w3.org/1999/xhtml/vocab#subsection",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "top", "http://www.w3.org/1999/xhtml/vocab#top",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "up", "http://www.w3.org/1999/xhtml/vocab#up",
          (update_mapping_value_fp)rdfa_replace_string);
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "p3pv1", "http://www.w3.org/1999/xhtml/vocab#p3pv1",
          (update_mapping_value_fp)rdfa_replace_string);
 
       /* From the role attribute module */
-      rdfa_update_mapping(context->term_mappings,
+      rdfa_update_mapping(&context->term_mappings,
          "role", "http://www.w3.org/1999/xhtml/vocab#role",
          (update_mapping_value_fp)rdfa_replace_string);
    }
@@ -345,10 +348,8 @@ void rdfa_setup_initial_context(rdfacontext* context)
    /* Raptor does this elsewhere */
 #else
    /* Generate namespace triples for all values in the uri_mapping */
-   while(*mptr != NULL)
+   while(rdfa_next_mapping(context->uri_mappings, &position, &key, &value))
    {
-      rdfa_next_mapping(mptr++, &key, &value);
-      mptr++;
       rdfa_generate_namespace_triple(context, key, value);
    }
 #endif
@@ -393,19 +394,23 @@ rdfacontext* rdfa_create_new_element_context(rdfalist* context_stack)
    /* Raptor does this automatically for URIs */
 #else
    rval->uri_mappings =
-      rdfa_copy_mapping((void**)parent_context->uri_mappings,
+      rdfa_copy_mapping(parent_context->uri_mappings,
          (copy_mapping_value_fp)rdfa_replace_string);
 #endif
    rval->term_mappings =
-      rdfa_copy_mapping((void**)parent_context->term_mappings,
+      rdfa_copy_mapping(parent_context->term_mappings,
          (copy_mapping_value_fp)rdfa_replace_string);
    rval->list_mappings =
-      rdfa_copy_mapping((void**)parent_context->local_list_mappings,
+      rdfa_copy_mapping(parent_context->local_list_mappings,
          (copy_mapping_value_fp)rdfa_replace_list);
    rval->local_list_mappings =
-      rdfa_copy_mapping((void**)parent_context->local_list_mappings,
+      rdfa_copy_mapping(parent_context->local_list_mappings,
          (copy_mapping_value_fp)rdfa_replace_list);
 
+   /* share the parent's CURIE cache until the mappings change */
+   rdfa_free_curie_cache(rval->curie_cache);
+   rval->curie_cache = rdfa_copy_curie_cache(parent_context->curie_cache);
+
    /* inherit the parent context's host language and RDFa processor mode */
    rval->host_language = parent_context->host_language;
    rval->rdfa_version = parent_context->rdfa_version;
@@ -567,6 +572,7 @@ void rdfa_free_context(rdfacontext* context)
       (free_mapping_value_fp)rdfa_free_list);
    rdfa_free_mapping(context->local_list_mappings,
       (free_mapping_value_fp)rdfa_free_list);
+   rdfa_free_curie_cache(context->curie_cache);
    free(context->language);
    free(context->underscore_colon_bnode_name);
    free(context->new_subject);
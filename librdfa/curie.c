@@ -344,8 +344,59 @@ char* rdfa_resolve_uri(rdfacontext* context, const char* uri)
    return rval;
 }
 
-char* rdfa_resolve_curie(
-   rdfacontext* context, const char* uri, curieparse_t mode)
+rdfacuriecache* rdfa_create_curie_cache(void)
+{
+   rdfacuriecache* rval = (rdfacuriecache*)malloc(sizeof(rdfacuriecache));
+
+   if(rval != NULL)
+   {
+      rval->usage = 1;
+      rval->resolved = rdfa_create_mapping(MAX_CURIE_CACHE_ENTRIES);
+      if(rval->resolved == NULL)
+      {
+         free(rval);
+         rval = NULL;
+      }
+   }
+
+   return rval;
+}
+
+rdfacuriecache* rdfa_copy_curie_cache(rdfacuriecache* cache)
+{
+   if(cache != NULL)
+   {
+      cache->usage++;
+   }
+
+   return cache;
+}
+
+void rdfa_free_curie_cache(rdfacuriecache* cache)
+{
+   if(cache != NULL && --cache->usage == 0)
+   {
+      rdfa_free_mapping(cache->resolved, (free_mapping_value_fp)free);
+      free(cache);
+   }
+}
+
+void rdfa_reset_curie_cache(rdfacontext* context)
+{
+   rdfa_free_curie_cache(context->curie_cache);
+   context->curie_cache = rdfa_create_curie_cache();
+}
+
+/**
+ * Resolves a CURIE without using the CURIE cache, see
+ * rdfa_resolve_curie().
+ *
+ * @param cacheable set to 0 if the result depends on more than the
+ *                  prefix mappings, default vocabulary and base or if
+ *                  resolving it reported a warning.
+ */
+static char* rdfa_resolve_curie_uncached(
+   rdfacontext* context, const char* uri, curieparse_t mode, int* cacheable)
 {
    char* rval = NULL;
    curie_t ctype = rdfa_get_curie_type(uri);
@@ -393,6 +444,7 @@ char* rdfa_resolve_curie(
 
          rdfa_processor_triples(context, RDFA_PROCESSOR_WARNING, msg);
 #endif
+         *cacheable = 0;
       }
    }
 
@@ -499,6 +551,7 @@ char* rdfa_resolve_curie(
 
                rdfa_processor_triples(context, RDFA_PROCESSOR_WARNING, msg);
 #endif
+              *cacheable = 0;
             }
 #endif
          }
@@ -535,6 +588,7 @@ char* rdfa_resolve_curie(
        * unnamed bnode specified by _: */
       if((strcmp(uri, "[_:]") == 0) || (strcmp(uri, "_:") == 0))
       {
+         *cacheable = 0;
          if(context->underscore_colon_bnode_name == NULL)
          {
             context->underscore_colon_bnode_name = rdfa_create_bnode(context);
@@ -570,6 +624,44 @@ char* rdfa_resolve_curie(
    return rval;
 }
 
+char* rdfa_resolve_curie(
+   rdfacontext* context, const char* uri, curieparse_t mode)
+{
+   char key[MAX_CURIE_CACHE_KEY_LENGTH];
+   size_t uri_length;
+   rdfamapping* resolved;
+   const char* cached;
+   char* rval;
+   int cacheable = 1;
+
+   if(!uri || !context->curie_cache)
+      return rdfa_resolve_curie_uncached(context, uri, mode, &cacheable);
+
+   /* the key is the parse mode followed by the CURIE */
+   uri_length = strlen(uri);
+   if(uri_length + 2 > sizeof(key))
+      return rdfa_resolve_curie_uncached(context, uri, mode, &cacheable);
+
+   key[0] = (char)('0' + mode);
+   memcpy(key + 1, uri, uri_length + 1);
+
+   resolved = context->curie_cache->resolved;
+   cached = (const char*)rdfa_get_mapping(resolved, key);
+   if(cached != NULL)
+      return strdup(cached);
+
+   rval = rdfa_resolve_curie_uncached(context, uri, mode, &cacheable);
+
+   if(rval != NULL && cacheable &&
+      resolved->num_entries < MAX_CURIE_CACHE_ENTRIES)
+   {
+      rdfa_update_mapping(&context->curie_cache->resolved, key, rval,
+         (update_mapping_value_fp)rdfa_replace_string);
+   }
+
+   return rval;
+}
+
 /**
  * Resolves a given uri depending on whether or not it is a fully
  * qualified IRI, a CURIE, or a short-form XHTML reserved word for
@@ -43,13 +43,13 @@ void rdfa_establish_new_inlist_triples(rdfacontext* context,
       rdftriple* triple;
       /* ensure the list mapping exists */
       rdfa_create_list_mapping(
-         context, context->local_list_mappings,
+         context, &context->local_list_mappings,
          context->new_subject, resolved_predicate);
 
       /* add an incomplete triple for each list mapping */
       triple = rdfa_create_triple(context->new_subject, resolved_predicate,
          object, object_type, context->datatype, context->language);
-      rdfa_append_to_list_mapping(context->local_list_mappings,
+      rdfa_append_to_list_mapping(&context->local_list_mappings,
          context->new_subject, resolved_predicate, triple);
 
       free(resolved_predicate);
@@ -73,7 +73,7 @@ void rdfa_save_incomplete_list_triples(
 
       /* ensure the list mapping exists */
       rdfa_create_list_mapping(
-         context, context->local_list_mappings,
+         context, &context->local_list_mappings,
          context->new_subject, resolved_curie);
 
       /* get the list name */
@@ -98,9 +98,8 @@ void rdfa_complete_list_triples(rdfacontext* context)
    int i;
    rdfalist* list;
    rdftriple* triple;
-   void** mptr = context->local_list_mappings;
+   size_t position = 0;
    char* key = NULL;
-   void** kptr = NULL;
    void* value = NULL;
    unsigned int list_depth = 0;
 
@@ -110,13 +109,11 @@ void rdfa_complete_list_triples(rdfacontext* context)
          (print_mapping_value_fp)rdfa_print_triple_list);
 #endif
 
-   while(*mptr != NULL)
+   while(rdfa_next_mapping(
+      context->local_list_mappings, &position, &key, &value))
    {
-      kptr = mptr;
-      rdfa_next_mapping(mptr++, &key, &value);
       list = (rdfalist*)value;
       list_depth = list->user_data;
-      mptr++;
 #if defined(DEBUG) && DEBUG > 0
       printf("LIST TRIPLES for key (%u/%u): KEY(%s)\n",
              context->depth, list_depth, key);
@@ -124,10 +121,16 @@ void rdfa_complete_list_triples(rdfacontext* context)
 
       if((context->depth < (int)list_depth) &&
          (rdfa_get_list_mapping(
-            context->list_mappings, context->new_subject, key) == NULL) &&
-         (strcmp(key, RDFA_MAPPING_DELETED_KEY) != 0))
+            context->list_mappings, context->new_subject, key) == NULL))
       {
          char* predicate = strstr(key, " ") + 1;
+
+         /* the list is emptied below so it must not be shared; a copy
+          * keeps the order of the keys so the walk can go on */
+         if(rdfa_unshare_mapping(&context->local_list_mappings) == NULL)
+            break;
+         list = (rdfalist*)rdfa_get_mapping(context->local_list_mappings, key);
+
          triple = (rdftriple*)list->items[0]->data;
          if(list->num_items == 1)
          {
@@ -237,7 +240,8 @@ void rdfa_complete_list_triples(rdfacontext* context)
          list->num_items = 0;
 
          /* clear the entry from the mapping */
-         *kptr = rdfa_replace_string((char*)*kptr, RDFA_MAPPING_DELETED_KEY);
+         rdfa_delete_mapping(&context->local_list_mappings, key,
+            (free_mapping_value_fp)rdfa_free_list);
       }
    }
 }
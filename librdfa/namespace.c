@@ -58,6 +58,9 @@ void rdfa_update_uri_mappings(
     * follow best practice for using namespaces, which includes not
     * using relative paths. */
 
+   /* CURIEs may now resolve differently */
+   rdfa_reset_curie_cache(context);
+
    if(attr == NULL)
    {
 #ifdef LIBRDFA_IN_RAPTOR
@@ -67,7 +70,7 @@ void rdfa_update_uri_mappings(
                                              0);
 #else
       rdfa_update_mapping(
-         context->uri_mappings, XMLNS_DEFAULT_MAPPING, value,
+         &context->uri_mappings, XMLNS_DEFAULT_MAPPING, value,
          (update_mapping_value_fp)rdfa_replace_string);
 #endif
    }
@@ -98,7 +101,7 @@ void rdfa_update_uri_mappings(
                                             0);
 #else
       rdfa_generate_namespace_triple(context, attr, value);
-      rdfa_update_mapping(context->uri_mappings, attr, value,
+      rdfa_update_mapping(&context->uri_mappings, attr, value,
          (update_mapping_value_fp)rdfa_replace_string);
 #endif
    }
@@ -176,6 +176,7 @@ static size_t rdfa_init_base(
 	       /* clean up the base context */
                context->base =
                   rdfa_replace_string(context->base, cleaned_base);
+               rdfa_reset_curie_cache(context);
                free(cleaned_base);
                free(temp_uri);
             }
@@ -187,6 +188,22 @@ static size_t rdfa_init_base(
 }
 
 #ifdef LIBRDFA_IN_RAPTOR
+/**
+ * Resets the CURIE cache of every context on the stack. Raptor keeps
+ * namespaces declared by @prefix past the end of the element, so these
+ * change how CURIEs resolve everywhere.
+ */
+static void
+raptor_rdfa_reset_curie_caches(rdfalist* context_stack)
+{
+   size_t i;
+
+   for(i = 0; i < context_stack->num_items; i++)
+   {
+      rdfa_reset_curie_cache((rdfacontext*)context_stack->items[i]->data);
+   }
+}
+
 static int
 raptor_nspace_compare(const void *a, const void *b)
 {
@@ -311,7 +328,7 @@ static void start_element(void *parser_context, const char* name,
       raptor_namespace** ns_list = NULL;
       size_t ns_size;
 #else
-      void** umap = context->uri_mappings;
+      size_t umap_position = 0;
 #endif
       const char* umap_key = NULL;
       void* umap_value = NULL;
@@ -327,7 +344,8 @@ static void start_element(void *parser_context, const char* name,
 
       while(ns_size > 0)
 #else
-      while(*umap != NULL)
+      while(rdfa_next_mapping(context->uri_mappings, &umap_position,
+                              (char**)&umap_key, &umap_value))
 #endif
       {
          unsigned char insert_xmlns_definition = 1;
@@ -341,9 +359,6 @@ static void start_element(void *parser_context, const char* name,
          if(!umap_key)
            umap_key=(const char*)XMLNS_DEFAULT_MAPPING;
          umap_value = (char*)raptor_uri_as_string(raptor_namespace_get_uri(ns));
-#else
-         rdfa_next_mapping(umap++, &umap_key, &umap_value);
-         umap++;
 #endif
 
          /* check to make sure that the namespace isn't already
@@ -405,6 +420,11 @@ static void start_element(void *parser_context, const char* name,
 
 #ifdef LIBRDFA_IN_RAPTOR
    /* Raptor namespace code does this already */
+   if(nb_namespaces > 0)
+   {
+      /* CURIEs may now resolve differently */
+      rdfa_reset_curie_cache(context);
+   }
 #else
    /* 3. For backward compatibility, RDFa Processors should also permit the
     * definition of mappings via @xmlns. In this case, the value to be mapped
@@ -472,10 +492,12 @@ static void start_element(void *parser_context, const char* name,
             if(strstr(value, "RDFa 1.0") != NULL)
             {
                context->rdfa_version = RDFA_VERSION_1_0;
+               rdfa_reset_curie_cache(context);
             }
             else if(strstr(value, "RDFa 1.1") != NULL)
             {
                context->rdfa_version = RDFA_VERSION_1_1;
+               rdfa_reset_curie_cache(context);
             }
 
             free(value);
@@ -518,6 +540,8 @@ static void start_element(void *parser_context, const char* name,
              * default vocabulary via @vocab. */
             if(strcmp(attr, "vocab") == 0)
             {
+               rdfa_reset_curie_cache(context);
+
                if(strlen(value) < 1)
                {
                   /* If the value is empty, then the local default vocabulary
@@ -590,6 +614,9 @@ static void start_element(void *parser_context, const char* name,
                }
 
                free(working_string);
+#ifdef LIBRDFA_IN_RAPTOR
+               raptor_rdfa_reset_curie_caches(context_stack);
+#endif
             }
             else if(strcmp(attr, "inlist") == 0)
             {
@@ -1179,7 +1206,7 @@ static void end_element(void* parser_context, const char* name,
          rdfa_free_mapping(parent_context->local_list_mappings,
             (free_mapping_value_fp)rdfa_free_list);
          parent_context->local_list_mappings = rdfa_copy_mapping(
-            (void**)context->local_list_mappings,
+            context->local_list_mappings,
             (copy_mapping_value_fp)rdfa_replace_list);
 
 #if defined(DEBUG) && DEBUG > 0
@@ -1254,12 +1281,14 @@ static void rdfa_report_error(void* parser_context, char* msg, ...)
 static void raptor_rdfa_start_element(void *user_data,
                                       raptor_xml_element *xml_element)
 {
+  rdfacontext* root_context = (rdfacontext*)user_data;
   raptor_qname* qname = raptor_xml_element_get_name(xml_element);
   int nb_attributes = raptor_xml_element_get_attributes_count(xml_element);
   raptor_qname** attrs = raptor_xml_element_get_attributes(xml_element);
   unsigned char* localname = raptor_qname_to_counted_name(qname, NULL);
   const raptor_namespace* qname_ns = raptor_qname_get_namespace(qname);
-  int nb_namespaces = 0;
+  /* counted by raptor_rdfa_namespace_handler(); the names are not passed */
+  int nb_namespaces = root_context->nb_namespaces;
   const char** namespaces = NULL;
   int nb_defaulted = 0;
   char** attr = NULL;
@@ -1304,6 +1333,8 @@ static void raptor_rdfa_start_element(void *user_data,
     ns_uri = (const char*)raptor_uri_as_string(qname_ns->uri);
   }
 
+  root_context->nb_namespaces = 0;
+
   start_element(user_data, (const char*)localname,
                 ns_name,
                 ns_uri,
@@ -1346,6 +1377,9 @@ static void raptor_rdfa_namespace_handler(void *user_data,
 {
   rdfacontext* context = (rdfacontext*)user_data;
 
+  /* declared on the element about to be started */
+  context->nb_namespaces++;
+
   if(context->namespace_handler)
     (*context->namespace_handler)(context->namespace_handler_user_data,
                                   nspace);
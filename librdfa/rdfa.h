@@ -112,6 +112,8 @@ extern "C"
 #define MAX_TERM_MAPPINGS 64
 #define MAX_URI_MAPPINGS 128
 #define MAX_INCOMPLETE_TRIPLES 128
+#define MAX_CURIE_CACHE_ENTRIES 1024
+#define MAX_CURIE_CACHE_KEY_LENGTH 256
 
 /* host language definitions */
 #define HOST_LANGUAGE_NONE 0
@@ -191,6 +193,16 @@ typedef struct rdfalist
    unsigned int user_data;
 } rdfalist;
 
+/**
+ * A mapping of keys to values, see rdfa_utils.h.
+ */
+typedef struct rdfamapping rdfamapping;
+
+/**
+ * A cache of resolved CURIEs, see rdfa_utils.h.
+ */
+typedef struct rdfacuriecache rdfacuriecache;
+
 /**
  * The RDFa Parser structure is responsible for keeping track of the state of
  * the current RDFa parser. Things such as the default namespace,
@@ -204,11 +216,12 @@ typedef struct rdfacontext
    char* parent_object;
    char* default_vocabulary;
 #ifndef LIBRDFA_IN_RAPTOR
-   void** uri_mappings;
+   rdfamapping* uri_mappings;
 #endif
-   void** term_mappings;
-   void** list_mappings;
-   void** local_list_mappings;
+   rdfamapping* term_mappings;
+   rdfamapping* list_mappings;
+   rdfamapping* local_list_mappings;
+   rdfacuriecache* curie_cache;
    rdfalist* incomplete_triples;
    rdfalist* local_incomplete_triples;
    char* language;
@@ -258,6 +271,8 @@ typedef struct rdfacontext
    raptor_sax2* sax2;
    raptor_namespace_handler namespace_handler;
    void* namespace_handler_user_data;
+   /* namespaces declared on the element being started */
+   int nb_namespaces;
    int raptor_rdfa_version; /* 10 or 11 or otherwise default */
 #else
    xmlParserCtxtPtr parser;
@@ -309,22 +309,164 @@ void rdfa_add_item(rdfalist* list, void* data, liflag_t flags)
    ++list->num_items;
 }
 
-void** rdfa_create_mapping(size_t elements)
+/* hash a mapping key (FNV-1a) */
+static unsigned int rdfa_hash_key(const char* key)
 {
-   size_t mapping_size = sizeof(void*) * MAX_URI_MAPPINGS * 2;
-   void** mapping = (void**)malloc(mapping_size);
+   unsigned int hash = 2166136261U;
 
-   /* only initialize the mapping if it is not null. */
+   while(*key)
+   {
+      hash ^= (unsigned char)*key++;
+      hash *= 16777619U;
+   }
+
+   return hash;
+}
+
+/* find the bucket holding the given key or the empty bucket ending
+ * its probe sequence */
+static size_t rdfa_mapping_find_bucket(
+   const rdfamapping* mapping, const char* key, unsigned int hash)
+{
+   size_t mask = mapping->num_buckets - 1;
+   size_t b = hash & mask;
+
+   while(mapping->buckets[b])
+   {
+      const rdfamappingentry* entry =
+         &mapping->entries[mapping->buckets[b] - 1];
+
+      if(entry->hash == hash && entry->key && strcmp(entry->key, key) == 0)
+         break;
+
+      b = (b + 1) & mask;
+   }
+
+   return b;
+}
+
+/* rebuild the buckets so that the table can hold the entries and one
+ * more; deleted entries keep their slot in the entries array */
+static int rdfa_mapping_grow(rdfamapping* mapping)
+{
+   size_t num_buckets;
+   size_t i;
+
+   if(mapping->num_entries == mapping->max_entries)
+   {
+      size_t max_entries = mapping->max_entries ? mapping->max_entries * 2 : 8;
+      rdfamappingentry* entries = (rdfamappingentry*)realloc(
+         mapping->entries, sizeof(rdfamappingentry) * max_entries);
+
+      if(entries == NULL)
+         return 1;
+
+      mapping->entries = entries;
+      mapping->max_entries = max_entries;
+   }
+
+   /* keep the table at most 3/4 full */
+   if((mapping->num_entries + 1) * 4 <= mapping->num_buckets * 3)
+      return 0;
+
+   num_buckets = mapping->num_buckets ? mapping->num_buckets * 2 : 16;
+   while((mapping->num_entries + 1) * 4 > num_buckets * 3)
+      num_buckets *= 2;
+
+   free(mapping->buckets);
+   mapping->buckets = (size_t*)calloc(num_buckets, sizeof(size_t));
+   if(mapping->buckets == NULL)
+   {
+      mapping->num_buckets = 0;
+      return 1;
+   }
+   mapping->num_buckets = num_buckets;
+
+   for(i = 0; i < mapping->num_entries; i++)
+   {
+      const rdfamappingentry* entry = &mapping->entries[i];
+
+      if(entry->key)
+         mapping->buckets[rdfa_mapping_find_bucket(
+            mapping, entry->key, entry->hash)] = i + 1;
+   }
+
+   return 0;
+}
+
+rdfamapping* rdfa_unshare_mapping(rdfamapping** mapping)
+{
+   rdfamapping* shared = *mapping;
+   rdfamapping* rval;
+   size_t i;
+
+   if(shared->usage == 1)
+      return shared;
+
+   rval = (rdfamapping*)calloc(1, sizeof(rdfamapping));
+   if(rval == NULL)
+      return NULL;
+
+   rval->usage = 1;
+   rval->copy_value = shared->copy_value;
+   rval->max_entries = shared->num_entries;
+
+   if(shared->num_entries)
+   {
+      rval->entries = (rdfamappingentry*)malloc(
+         sizeof(rdfamappingentry) * shared->num_entries);
+      rval->buckets = (size_t*)malloc(sizeof(size_t) * shared->num_buckets);
+      if(rval->entries == NULL || rval->buckets == NULL)
+      {
+         free(rval->entries);
+         free(rval->buckets);
+         free(rval);
+         return NULL;
+      }
+
+      /* same layout so positions held by iterating callers stay valid */
+      memcpy(rval->buckets, shared->buckets,
+         sizeof(size_t) * shared->num_buckets);
+      rval->num_buckets = shared->num_buckets;
+
+      for(i = 0; i < shared->num_entries; i++)
+      {
+         const rdfamappingentry* entry = &shared->entries[i];
+
+         rval->entries[i].hash = entry->hash;
+         rval->entries[i].key = NULL;
+         rval->entries[i].value = NULL;
+         if(entry->key)
+         {
+            rval->entries[i].key = strdup(entry->key);
+            rval->entries[i].value =
+               shared->copy_value(NULL, entry->value);
+         }
+      }
+      rval->num_entries = shared->num_entries;
+   }
+
+   shared->usage--;
+   *mapping = rval;
+
+   return rval;
+}
+
+rdfamapping* rdfa_create_mapping(size_t elements)
+{
+   rdfamapping* mapping = (rdfamapping*)calloc(1, sizeof(rdfamapping));
+
+   /* the entries are allocated on first use */
    if(mapping != NULL)
    {
-      memset(mapping, 0, mapping_size);
+      mapping->usage = 1;
    }
 
    return mapping;
 }
 
 void rdfa_create_list_mapping(
-   rdfacontext* context, void** mapping,
+   rdfacontext* context, rdfamapping** mapping,
    const char* subject, const char* key)
 {
    char* realkey = NULL;
@@ -334,7 +476,7 @@ void rdfa_create_list_mapping(
    rdftriple* triple;
 
    /* Attempt to find the list mapping */
-   value = (rdfalist*)rdfa_get_list_mapping(mapping, subject, key);
+   value = (rdfalist*)rdfa_get_list_mapping(*mapping, subject, key);
 
    if(value == NULL)
    {
@@ -362,93 +504,72 @@ void rdfa_create_list_mapping(
 }
 
 void rdfa_append_to_list_mapping(
-   void** mapping, const char* subject, const char* key, void* value)
+   rdfamapping** mapping, const char* subject, const char* key, void* value)
 {
-   rdfalist* list = (rdfalist*)rdfa_get_list_mapping(mapping, subject, key);
+   rdfalist* list;
+
+   /* the list is changed in place so it must not be shared */
+   if(rdfa_unshare_mapping(mapping) == NULL)
+      return;
+
+   list = (rdfalist*)rdfa_get_list_mapping(*mapping, subject, key);
    rdfa_add_item(list, value, RDFALIST_FLAG_TRIPLE);
 }
 
-void** rdfa_copy_mapping(
-   void** mapping, copy_mapping_value_fp copy_mapping_value)
+rdfamapping* rdfa_copy_mapping(
+   rdfamapping* mapping, copy_mapping_value_fp copy_mapping_value)
 {
-   void** rval = (void**)calloc(MAX_URI_MAPPINGS * 2, sizeof(void*));
-   void** mptr = mapping;
-   void** rptr = rval;
+   /* share the mapping; it is copied when either owner changes it */
+   mapping->usage++;
+   mapping->copy_value = copy_mapping_value;
 
-   /* copy each element of the old mapping to the new mapping. */
-   while(*mptr != NULL)
-   {
-      /* copy the key */
-      *rptr = rdfa_replace_string((char*)*rptr, (const char*)*mptr);
-      rptr++;
-      mptr++;
-
-      /* copy the value */
-      *rptr = copy_mapping_value(*rptr, *mptr);
-      rptr++;
-      mptr++;
-   }
-
-   return rval;
+   return mapping;
 }
 
-void rdfa_update_mapping(void** mapping, const char* key, const void* value,
-   update_mapping_value_fp update_mapping_value)
+void rdfa_update_mapping(rdfamapping** mapping, const char* key,
+   const void* value, update_mapping_value_fp update_mapping_value)
 {
-   int found = 0;
-   void** mptr = mapping;
+   rdfamapping* m = rdfa_unshare_mapping(mapping);
+   unsigned int hash = rdfa_hash_key(key);
+   size_t b;
+
+   if(m == NULL || rdfa_mapping_grow(m))
+      return;
 
    /* search the current mapping to see if the key exists in the mapping */
-   while(!found && (*mptr != NULL))
+   b = rdfa_mapping_find_bucket(m, key, hash);
+   if(m->buckets[b])
    {
-      if(strcmp((char*)*mptr, key) == 0)
-      {
-         mptr++;
-         *mptr = update_mapping_value(*mptr, value);
-         found = 1;
-      }
-      else
-      {
-         mptr++;
-      }
-      mptr++;
+      rdfamappingentry* entry = &m->entries[m->buckets[b] - 1];
+      entry->value = update_mapping_value(entry->value, value);
    }
-
-   /* if we made it through the entire URI mapping and the key was not
-    * found, create a new key-value pair. */
-   if(!found)
+   else
    {
-     *mptr = rdfa_replace_string((char*)*mptr, key);
-      mptr++;
-      *mptr = update_mapping_value(*mptr, value);
+      /* the key was not found, create a new key-value pair. */
+      rdfamappingentry* entry = &m->entries[m->num_entries];
+      entry->key = strdup(key);
+      entry->value = update_mapping_value(NULL, value);
+      entry->hash = hash;
+      m->buckets[b] = ++m->num_entries;
    }
 }
 
-const void* rdfa_get_mapping(void** mapping, const char* key)
+const void* rdfa_get_mapping(rdfamapping* mapping, const char* key)
 {
-   const void* rval = NULL;
-   char** mptr = (char**)mapping;
+   size_t b;
 
-   /* search the current mapping to see if the key exists in the mapping. */
-   while(*mptr != NULL)
-   {
-      if(strcmp(*mptr, key) == 0)
-      {
-         mptr++;
-         rval = *mptr;
-      }
-      else
-      {
-         mptr++;
-      }
-      mptr++;
-   }
+   if(mapping->num_buckets == 0)
+      return NULL;
 
-   return rval;
+   b = rdfa_mapping_find_bucket(mapping, key, rdfa_hash_key(key));
+   if(!mapping->buckets[b])
+      return NULL;
+
+   return mapping->entries[mapping->buckets[b] - 1].value;
 }
 
 const void* rdfa_get_list_mapping(
-   void** mapping, const char* subject, const char* key)
+   rdfamapping* mapping, const char* subject, const char* key)
 {
    void* rval;
    char* realkey = NULL;
@@ -464,40 +585,73 @@ const void* rdfa_get_list_mapping(
    return (const void*)rval;
 }
 
-void rdfa_next_mapping(void** mapping, char** key, void** value)
+void rdfa_delete_mapping(rdfamapping** mapping, const char* key,
+   free_mapping_value_fp free_value)
+{
+   rdfamapping* m;
+   rdfamappingentry* entry;
+   size_t b;
+
+   if(rdfa_get_mapping(*mapping, key) == NULL)
+      return;
+
+   m = rdfa_unshare_mapping(mapping);
+   if(m == NULL)
+      return;
+
+   /* the bucket stays in use so that probing continues past it */
+   b = rdfa_mapping_find_bucket(m, key, rdfa_hash_key(key));
+   entry = &m->entries[m->buckets[b] - 1];
+   free(entry->key);
+   free_value(entry->value);
+   entry->key = NULL;
+   entry->value = NULL;
+}
+
+int rdfa_next_mapping(
+   rdfamapping* mapping, size_t* position, char** key, void** value)
 {
    *key = NULL;
    *value = NULL;
 
-   if(*mapping != NULL)
+   while(*position < mapping->num_entries)
    {
-      *key = *(char**)mapping++;
-      *value = *mapping++;
+      const rdfamappingentry* entry = &mapping->entries[(*position)++];
+
+      if(entry->key != NULL)
+      {
+         *key = entry->key;
+         *value = entry->value;
+         return 1;
+      }
    }
+
+   return 0;
 }
 
-void rdfa_print_mapping(void** mapping, print_mapping_value_fp print_value)
+void rdfa_print_mapping(rdfamapping* mapping,
+   print_mapping_value_fp print_value)
 {
-   void** mptr = mapping;
+   size_t position = 0;
+   char* key;
+   void* value;
+   int first = 1;
+
    printf("{\n");
-   while(*mptr != NULL)
+   while(rdfa_next_mapping(mapping, &position, &key, &value))
    {
-      char* key;
-      void* value;
-      key = (char*)*mptr++;
-      value = *mptr++;
-
-      printf("   %s : ", key);
-      print_value(value);
-
-      if(*mptr != NULL)
+      if(!first)
       {
          printf(",\n");
       }
-      else
-      {
-         printf("\n");
-      }
+      first = 0;
+
+      printf("   %s : ", key);
+      print_value(value);
+   }
+   if(!first)
+   {
+      printf("\n");
    }
    printf("}\n");
 }
@@ -507,22 +661,28 @@ void rdfa_print_string(const char* str)
    printf("%s", str);
 }
 
-void rdfa_free_mapping(void** mapping, free_mapping_value_fp free_value)
+void rdfa_free_mapping(rdfamapping* mapping, free_mapping_value_fp free_value)
 {
-   void** mptr = mapping;
-
    if(mapping != NULL)
    {
+      size_t i;
+
+      /* another context still shares it */
+      if(--mapping->usage > 0)
+         return;
+
       /* free all of the memory in the mapping */
-      while(*mptr != NULL)
+      for(i = 0; i < mapping->num_entries; i++)
       {
-         free(*mptr);
-         mptr++;
-         free_value(*mptr);
-         mptr++;
+         if(mapping->entries[i].key != NULL)
+         {
+            free(mapping->entries[i].key);
+            free_value(mapping->entries[i].value);
+         }
       }
 
+      free(mapping->entries);
+      free(mapping->buckets);
       free(mapping);
    }
 }
-
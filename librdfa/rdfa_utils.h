@@ -79,9 +79,6 @@ typedef enum
 #define RDFA_PROCESSOR_WARNING "http://www.w3.org/ns/rdfa#Warning"
 #define RDFA_PROCESSOR_ERROR "http://www.w3.org/ns/rdfa#Error"
 
-/* key establishing a deleted mapping entry */
-#define RDFA_MAPPING_DELETED_KEY "<DELETED-KEY>"
-
 /**
  * A function pointer that will be used to copy mapping values.
  */
@@ -102,6 +99,45 @@ typedef void (*print_mapping_value_fp)(void*);
  */
 typedef void (*free_mapping_value_fp)(void*);
 
+/**
+ * A mapping entry holds a key, its value and the hash of the key. The
+ * key of a deleted entry is NULL.
+ */
+typedef struct rdfamappingentry
+{
+   char* key;
+   void* value;
+   unsigned int hash;
+} rdfamappingentry;
+
+/**
+ * A mapping is a hash table of keys to values that keeps the order in
+ * which keys were added. Copying a mapping shares it between the
+ * owners; it is copied for real when one of them changes it.
+ */
+struct rdfamapping
+{
+   unsigned int usage;
+   copy_mapping_value_fp copy_value;
+   rdfamappingentry* entries;
+   size_t num_entries;
+   size_t max_entries;
+   size_t* buckets;
+   size_t num_buckets;
+};
+
+/**
+ * A CURIE cache maps the parse mode and CURIE to the resolved IRI. It is
+ * shared by the context of an element and the contexts of its children
+ * until one of them changes how CURIEs resolve, see
+ * rdfa_reset_curie_cache().
+ */
+struct rdfacuriecache
+{
+   unsigned int usage;
+   rdfamapping* resolved;
+};
+
 /**
  * Initializes a mapping given the number of elements the mapping is
  * expected to hold.
@@ -109,9 +145,9 @@ typedef void (*free_mapping_value_fp)(void*);
  * @param elements the maximum number of elements the mapping is
  *                 supposed to hold.
  *
- * @return an initialized void**, with all of the elements set to NULL.
+ * @return an initialized, empty mapping.
  */
-void** rdfa_create_mapping(size_t elements);
+rdfamapping* rdfa_create_mapping(size_t elements);
 
 /**
  * Adds a list to a mapping given a key to create. The result will be a
@@ -124,7 +160,8 @@ void** rdfa_create_mapping(size_t elements);
  * @param user_data the user-defined data to store with the list information.
  */
 void rdfa_create_list_mapping(
-   rdfacontext* context, void** mapping, const char* subject, const char* key);
+   rdfacontext* context, rdfamapping** mapping,
+   const char* subject, const char* key);
 
 /**
  * Adds an item to the end of the list that is associated with the given
@@ -136,7 +173,7 @@ void rdfa_create_list_mapping(
  * @param value the value to append to the end of the list.
  */
 void rdfa_append_to_list_mapping(
-   void** mapping, const char* subject, const char* key, void* value);
+   rdfamapping** mapping, const char* subject, const char* key, void* value);
 
 /**
  * Gets the value for a given list mapping when presented with a subject
@@ -150,20 +187,31 @@ void rdfa_append_to_list_mapping(
  * @return value the value in the mapping for the given key.
  */
 const void* rdfa_get_list_mapping(
-   void** mapping, const char* subject, const char* key);
+   rdfamapping* mapping, const char* subject, const char* key);
 
 /**
- * Copies the entire contents of a mapping verbatim and returns a
- * pointer to the copied mapping.
+ * Copies a mapping and returns a pointer to the copied mapping. The
+ * copy shares the memory of the original until either is changed.
  *
  * @param mapping the mapping to copy
+ * @param copy_mapping_value the function used to copy values once the
+ *                           mapping is changed.
  *
- * @return the copied mapping, with all of the memory newly
- *         allocated. You MUST free the returned mapping when you are
- *         done with it.
+ * @return the copied mapping. You MUST free the returned mapping when
+ *         you are done with it.
  */
-void** rdfa_copy_mapping(
-   void** mapping, copy_mapping_value_fp copy_mapping_value);
+rdfamapping* rdfa_copy_mapping(
+   rdfamapping* mapping, copy_mapping_value_fp copy_mapping_value);
+
+/**
+ * Makes sure a mapping is not shared with a copy before its values are
+ * changed in place. A shared mapping is replaced by a copy of its own.
+ *
+ * @param mapping the mapping to unshare.
+ *
+ * @return the unshared mapping, NULL on failure.
+ */
+rdfamapping* rdfa_unshare_mapping(rdfamapping** mapping);
 
 /**
  * Updates the given mapping when presented with a key and a value. If
@@ -175,8 +223,8 @@ void** rdfa_copy_mapping(
  * @param replace_mapping_value a pointer to a function that will replace the
  *    old
  */
-void rdfa_update_mapping(void** mapping, const char* key, const void* value,
-   update_mapping_value_fp update_mapping_value);
+void rdfa_update_mapping(rdfamapping** mapping, const char* key,
+   const void* value, update_mapping_value_fp update_mapping_value);
 
 /**
  * Gets the value for a given mapping when presented with a key. If
@@ -187,19 +235,33 @@ void rdfa_update_mapping(void** mapping, const char* key, const void* value,
  *
  * @return value the value in the mapping for the given key.
  */
-const void* rdfa_get_mapping(void** mapping, const char* key);
+const void* rdfa_get_mapping(rdfamapping* mapping, const char* key);
+
+/**
+ * Removes a key and its value from the given mapping, if present.
+ *
+ * @param mapping the mapping to modify.
+ * @param key the key.
+ * @param free_value the function to free the value.
+ */
+void rdfa_delete_mapping(rdfamapping** mapping, const char* key,
+   free_mapping_value_fp free_value);
 
 /**
- * Gets the current mapping for the given mapping and increments the
- * mapping to the next value in the chain. 
+ * Gets the next key and value of a mapping in the order the keys were
+ * added.
+ *
+ * @param mapping the mapping to walk.
+ * @param position the walk position, 0 to start at the first key.
+ * @param key the key that will be retrieved, NULL if you are at the end
+ *            of the mapping.
+ * @param value the value that is associated with the key. NULL if you
+ *              are at the end of the mapping.
  *
- * @param mapping the mapping to use and increment.
- * @param key the key that will be retrieved, NULL if the mapping is
- *            blank or you are at the end of the mapping.
- * @param value the value that is associated with the key. NULL if the
- *              mapping is blank or you are at the end of the mapping.
+ * @return 1 if a key was retrieved, 0 at the end of the mapping.
  */
-void rdfa_next_mapping(void** mapping, char** key, void** value);
+int rdfa_next_mapping(
+   rdfamapping* mapping, size_t* position, char** key, void** value);
 
 /**
  * Prints the mapping to the screen in a human-readable way.
@@ -207,15 +269,17 @@ void rdfa_next_mapping(void** mapping, char** key, void** value);
  * @param mapping the mapping to print to the screen.
  * @param print_value the function pointer to use to print the mapping values.
  */
-void rdfa_print_mapping(void** mapping, print_mapping_value_fp print_value);
+void rdfa_print_mapping(rdfamapping* mapping,
+   print_mapping_value_fp print_value);
 
 /**
- * Frees all memory associated with a mapping.
+ * Frees a mapping. The memory is released once no copy shares it.
  *
  * @param mapping the mapping to free.
  * @param free_value the function to free mapping values.
  */
-void rdfa_free_mapping(void** mapping, free_mapping_value_fp free_value);
+void rdfa_free_mapping(rdfamapping* mapping,
+   free_mapping_value_fp free_value);
 
 /**
  * Creates a list and initializes it to the given size.
@@ -415,6 +479,38 @@ char* rdfa_resolve_uri(rdfacontext* context, const char* uri);
 char* rdfa_resolve_curie(
    rdfacontext* context, const char* uri, curieparse_t mode);
 
+/**
+ * Creates an empty CURIE cache.
+ *
+ * @return the CURIE cache, or NULL if memory allocation failed.
+ */
+rdfacuriecache* rdfa_create_curie_cache(void);
+
+/**
+ * Shares a CURIE cache with another context.
+ *
+ * @param cache the CURIE cache to share.
+ *
+ * @return the shared cache. You MUST free it when you are done with it.
+ */
+rdfacuriecache* rdfa_copy_curie_cache(rdfacuriecache* cache);
+
+/**
+ * Frees a CURIE cache once no context shares it.
+ *
+ * @param cache the CURIE cache to free.
+ */
+void rdfa_free_curie_cache(rdfacuriecache* cache);
+
+/**
+ * Gives a context a new, empty CURIE cache. This must be done whenever
+ * the prefix mappings, default vocabulary, base or RDFa version of the
+ * context change.
+ *
+ * @param context the current processing context.
+ */
+void rdfa_reset_curie_cache(rdfacontext* context);
+
 /**
  * Resolves one or more CURIEs into fully qualified IRIs.
  *
@@ -86,6 +86,9 @@ raptor_new_abbrev_node(raptor_world* world, raptor_term *term)
  * @node: raptor abbrev node
  *
  * INTERNAL - Destructor for raptor_abbrev_node
+ *
+ * Nodes allocated by a #raptor_abbrev_nodes table are only released
+ * when the table is freed.
  */
 void
 raptor_free_abbrev_node(raptor_abbrev_node* node)
@@ -95,6 +98,9 @@ raptor_free_abbrev_node(raptor_abbrev_node* node)
   if(--node->ref_count)
     return;
 
+  if(node->in_arena)
+    return;
+
   if(node->term)
     raptor_free_term(node->term);
 
@@ -141,94 +147,258 @@ raptor_abbrev_node_equals(raptor_abbrev_node* node1, raptor_abbrev_node* node2)
 }
 
 
+/*
+ * raptor_abbrev_nodes implementation
+ *
+ * A table of unique nodes indexed by an open addressing hash of their
+ * terms.  The nodes themselves are carved out of fixed size blocks
+ * that are all released together when the table is freed.
+ *
+ */
+
+#define RAPTOR_ABBREV_NODES_BLOCK_SIZE 256
+#define RAPTOR_ABBREV_NODES_INITIAL_SIZE 64
+
+typedef struct raptor_abbrev_nodes_block_s {
+  struct raptor_abbrev_nodes_block_s* next;
+  int used;
+  raptor_abbrev_node nodes[RAPTOR_ABBREV_NODES_BLOCK_SIZE];
+} raptor_abbrev_nodes_block;
+
+typedef struct {
+  unsigned int hash;
+  raptor_abbrev_node* node;
+} raptor_abbrev_nodes_entry;
+
+struct raptor_abbrev_nodes_s {
+  raptor_world* world;
+
+  /* hash table with a power of 2 size; NULL node marks an empty slot */
+  raptor_abbrev_nodes_entry* entries;
+  size_t size;
+  size_t count;
+
+  /* node storage, most recently allocated block first */
+  raptor_abbrev_nodes_block* blocks;
+};
+
+
 /**
- * raptor_abbrev_node_lookup:
- * @nodes: Tree of nodes to search
- * @node: Node value to search for
+ * raptor_new_abbrev_nodes:
+ * @world: raptor world
  *
- * INTERNAL - Look in an avltree of nodes for a node described by parameters
- *   and if present create it, add it and return it
+ * INTERNAL - Constructor for a table of unique #raptor_abbrev_node
  *
- * Return value: the node found/created or NULL on failure
+ * Return value: new node table or NULL on failure
  */
-raptor_abbrev_node* 
-raptor_abbrev_node_lookup(raptor_avltree* nodes, raptor_term* term)
+raptor_abbrev_nodes*
+raptor_new_abbrev_nodes(raptor_world* world)
 {
-  raptor_abbrev_node *lookup_node;
-  raptor_abbrev_node *rv_node;
+  raptor_abbrev_nodes* nodes;
 
-  /* Create a temporary node for search comparison. */
-  lookup_node = raptor_new_abbrev_node(term->world, term);
-  
-  if(!lookup_node)
+  nodes = RAPTOR_CALLOC(raptor_abbrev_nodes*, 1, sizeof(*nodes));
+  if(!nodes)
     return NULL;
 
-  rv_node = (raptor_abbrev_node*)raptor_avltree_search(nodes, lookup_node);
-  
-  /* If not found, insert/return a new one */
-  if(!rv_node) {
-    
-    if(raptor_avltree_add(nodes, lookup_node))
-      return NULL;
-    else
-      return lookup_node;
+  nodes->world = world;
+  nodes->size = RAPTOR_ABBREV_NODES_INITIAL_SIZE;
+  nodes->entries = RAPTOR_CALLOC(raptor_abbrev_nodes_entry*, nodes->size,
+                                 sizeof(*nodes->entries));
+  if(!nodes->entries) {
+    RAPTOR_FREE(raptor_abbrev_nodes, nodes);
+    return NULL;
+  }
+
+  return nodes;
+}
+
+
+/**
+ * raptor_free_abbrev_nodes:
+ * @nodes: node table
+ *
+ * INTERNAL - Destructor for a table of #raptor_abbrev_node
+ *
+ * All the nodes allocated by the table are freed whatever their
+ * reference count so any subjects using them must be freed first.
+ */
+void
+raptor_free_abbrev_nodes(raptor_abbrev_nodes* nodes)
+{
+  raptor_abbrev_nodes_block* block;
 
-  /* Found */
-  } else {
-    raptor_free_abbrev_node(lookup_node);
-    return rv_node;
+  RAPTOR_ASSERT_OBJECT_POINTER_RETURN(nodes, raptor_abbrev_nodes);
+
+  for(block = nodes->blocks; block; ) {
+    raptor_abbrev_nodes_block* next = block->next;
+    int i;
+
+    for(i = 0; i < block->used; i++) {
+      if(block->nodes[i].term)
+        raptor_free_term(block->nodes[i].term);
+    }
+    RAPTOR_FREE(raptor_abbrev_nodes_block, block);
+    block = next;
   }
+
+  RAPTOR_FREE(raptor_abbrev_nodes_entry, nodes->entries);
+  RAPTOR_FREE(raptor_abbrev_nodes, nodes);
 }
 
 
-static raptor_abbrev_node**
-raptor_new_abbrev_po(raptor_abbrev_node* predicate, raptor_abbrev_node* object)
+static raptor_abbrev_nodes_entry*
+raptor_abbrev_nodes_find_entry(raptor_abbrev_nodes* nodes, raptor_term* term,
+                               unsigned int hash)
 {
-  raptor_abbrev_node** nodes = NULL;
-  nodes = RAPTOR_CALLOC(raptor_abbrev_node**, 2, sizeof(raptor_abbrev_node*));
-  if(!nodes)
-    return NULL;
-  
-  nodes[0] = predicate;
-  nodes[1] = object;
-  
-  return nodes;
+  size_t mask = nodes->size - 1;
+  size_t i;
+
+  for(i = hash & mask; nodes->entries[i].node; i = (i + 1) & mask) {
+    raptor_abbrev_nodes_entry* entry = &nodes->entries[i];
+
+    if(entry->hash == hash && raptor_term_equals(entry->node->term, term))
+      return entry;
+  }
+
+  /* empty slot */
+  return &nodes->entries[i];
 }
 
 
-static void
-raptor_free_abbrev_po(raptor_abbrev_node** nodes)
+static int
+raptor_abbrev_nodes_grow(raptor_abbrev_nodes* nodes)
 {
-  RAPTOR_ASSERT_OBJECT_POINTER_RETURN(nodes, raptor_abbrev_node_pair);
-  
-  if(nodes[0])
-    raptor_free_abbrev_node(nodes[0]);
-  if(nodes[1])
-    raptor_free_abbrev_node(nodes[1]);
+  raptor_abbrev_nodes_entry* old_entries = nodes->entries;
+  size_t old_size = nodes->size;
+  size_t new_size = old_size << 1;
+  size_t mask = new_size - 1;
+  size_t i;
+
+  nodes->entries = RAPTOR_CALLOC(raptor_abbrev_nodes_entry*, new_size,
+                                 sizeof(*nodes->entries));
+  if(!nodes->entries) {
+    nodes->entries = old_entries;
+    return 1;
+  }
+  nodes->size = new_size;
 
-  RAPTOR_FREE(raptor_abbrev_nodes, nodes);
+  for(i = 0; i < old_size; i++) {
+    size_t j;
+
+    if(!old_entries[i].node)
+      continue;
+
+    for(j = old_entries[i].hash & mask; nodes->entries[j].node;
+        j = (j + 1) & mask)
+      ;
+    nodes->entries[j] = old_entries[i];
+  }
+
+  RAPTOR_FREE(raptor_abbrev_nodes_entry, old_entries);
+  return 0;
+}
+
+
+/**
+ * raptor_abbrev_node_find:
+ * @nodes: node table to search
+ * @term: term to search for
+ *
+ * INTERNAL - Find the node for a term in a node table
+ *
+ * Return value: the node or NULL if not present
+ */
+raptor_abbrev_node*
+raptor_abbrev_node_find(raptor_abbrev_nodes* nodes, raptor_term* term)
+{
+  return raptor_abbrev_nodes_find_entry(nodes, term,
+                                        raptor_term_hash(term))->node;
+}
+
+
+/**
+ * raptor_abbrev_node_lookup:
+ * @nodes: node table to search
+ * @term: term to search for
+ *
+ * INTERNAL - Look in a node table for a node described by @term and
+ * if not present create it, add it and return it
+ *
+ * Return value: the node found/created or NULL on failure
+ */
+raptor_abbrev_node* 
+raptor_abbrev_node_lookup(raptor_abbrev_nodes* nodes, raptor_term* term)
+{
+  raptor_abbrev_nodes_entry* entry;
+  raptor_abbrev_nodes_block* block;
+  raptor_abbrev_node* node;
+  unsigned int hash;
+
+  if(term->type == RAPTOR_TERM_TYPE_UNKNOWN)
+    return NULL;
+
+  hash = raptor_term_hash(term);
+  entry = raptor_abbrev_nodes_find_entry(nodes, term, hash);
+  if(entry->node)
+    return entry->node;
+
+  /* keep the table at most half full */
+  if((nodes->count + 1) * 2 > nodes->size) {
+    if(raptor_abbrev_nodes_grow(nodes))
+      return NULL;
+    entry = raptor_abbrev_nodes_find_entry(nodes, term, hash);
+  }
+
+  block = nodes->blocks;
+  if(!block || block->used == RAPTOR_ABBREV_NODES_BLOCK_SIZE) {
+    block = RAPTOR_MALLOC(raptor_abbrev_nodes_block*, sizeof(*block));
+    if(!block)
+      return NULL;
+    block->used = 0;
+    block->next = nodes->blocks;
+    nodes->blocks = block;
+  }
+
+  node = &block->nodes[block->used];
+  memset(node, 0, sizeof(*node));
+  node->term = raptor_term_copy(term);
+  if(!node->term)
+    return NULL;
+  node->world = nodes->world;
+  node->ref_count = 1;
+  node->in_arena = 1;
+  block->used++;
+
+  entry->hash = hash;
+  entry->node = node;
+  nodes->count++;
+
+  return node;
 }
 
 
 static int
-raptor_compare_abbrev_po(raptor_abbrev_node** nodes1,
-                         raptor_abbrev_node** nodes2)
+raptor_compare_abbrev_po(const void* data1, const void* data2,
+                         void* user_data)
 {
+  const raptor_abbrev_po* po1 = (const raptor_abbrev_po*)data1;
+  const raptor_abbrev_po* po2 = (const raptor_abbrev_po*)data2;
   int d;
-  d = raptor_abbrev_node_compare(nodes1[0], nodes2[0]);
+
+  d = raptor_abbrev_node_compare(po1->predicate, po2->predicate);
   if(!d)
-    d = raptor_abbrev_node_compare(nodes1[1], nodes2[1]);
+    d = raptor_abbrev_node_compare(po1->object, po2->object);
 
   return d;
 }
 
 
-#ifdef RAPTOR_DEBUG
+#ifdef ABBREV_DEBUG
 static void
-raptor_print_abbrev_po(raptor_abbrev_node** nodes, FILE* handle)
+raptor_print_abbrev_po(raptor_abbrev_po* po, FILE* handle)
 {
-  raptor_abbrev_node* p = nodes[0];
-  raptor_abbrev_node* o = nodes[1];
+  raptor_abbrev_node* p = po->predicate;
+  raptor_abbrev_node* o = po->object;
   
   if(p && o) {
     fputc('[', handle);
@@ -273,20 +443,16 @@ raptor_new_abbrev_subject(raptor_abbrev_node* node)
 
     subject->valid = 1;
 
-    subject->properties =
-      raptor_new_avltree((raptor_data_compare_handler)raptor_compare_abbrev_po,
-                         (raptor_data_free_handler)raptor_free_abbrev_po,
-                         0);
-#ifdef RAPTOR_DEBUG
-    if(subject->properties)
-      raptor_avltree_set_print_handler(subject->properties,
-                                       (raptor_data_print_handler)raptor_print_abbrev_po);
-#endif
+    /* properties vector is allocated on the first add */
+    subject->properties = NULL;
+    subject->properties_count = 0;
+    subject->properties_size = 0;
+    subject->properties_sorted = 1;
 
     subject->list_items =
       raptor_new_sequence((raptor_data_free_handler)raptor_free_abbrev_node, NULL);
 
-    if(!subject->properties || !subject->list_items) {
+    if(!subject->list_items) {
       raptor_free_abbrev_subject(subject);
       subject = NULL;
     }
@@ -308,8 +474,15 @@ raptor_free_abbrev_subject(raptor_abbrev_subject* subject)
   if(subject->node_type)
     raptor_free_abbrev_node(subject->node_type);
   
-  if(subject->properties)
-    raptor_free_avltree(subject->properties);
+  if(subject->properties) {
+    int i;
+
+    for(i = 0; i < subject->properties_count; i++) {
+      raptor_free_abbrev_node(subject->properties[i].predicate);
+      raptor_free_abbrev_node(subject->properties[i].object);
+    }
+    RAPTOR_FREE(raptor_abbrev_po, subject->properties);
+  }
   
   if(subject->list_items)
     raptor_free_sequence(subject->list_items);
@@ -343,53 +516,90 @@ raptor_abbrev_subject_invalidate(raptor_abbrev_subject *subject)
  *
  * INTERNAL - Add predicate/object pair into properties array of a subject node.
  *
- * The subject node takes ownership of the predicate/object nodes.
- * On error, predicate/object are freed immediately.
+ * The pair is appended to the properties vector and takes a
+ * reference to the predicate/object nodes.  Duplicate pairs are
+ * removed when the properties are sorted by
+ * raptor_abbrev_subject_sort_properties().
  * 
- * Return value: <0 on failure, >0 if pair is a duplicate and it was not added
+ * Return value: <0 on failure
  **/
 int
 raptor_abbrev_subject_add_property(raptor_abbrev_subject* subject,
                                    raptor_abbrev_node* predicate,
                                    raptor_abbrev_node* object) 
 {
-  int err;
-  raptor_abbrev_node** nodes;
-  
-  nodes = raptor_new_abbrev_po(predicate, object);
-  if(!nodes)
-    return -1;
+  raptor_abbrev_po* po;
+
+  if(subject->properties_count == subject->properties_size) {
+    int new_size = subject->properties_size ? subject->properties_size << 1 : 4;
+    raptor_abbrev_po* new_properties;
+
+    new_properties = RAPTOR_REALLOC(raptor_abbrev_po*, subject->properties,
+                                    new_size * sizeof(*new_properties));
+    if(!new_properties)
+      return -1;
+    subject->properties = new_properties;
+    subject->properties_size = new_size;
+  }
 
+  po = &subject->properties[subject->properties_count++];
+  po->predicate = predicate;
+  po->object = object;
   predicate->ref_count++;
   object->ref_count++;
 
-  if(raptor_avltree_search(subject->properties, nodes)) {
-    /* Already present - do not add a duplicate triple (s->[p o]) */
-    raptor_free_abbrev_po(nodes);
-    return 1;
-  }
-  
-#if 0
-  fprintf(stderr, "Adding P,O ");
-  raptor_print_abbrev_po(stderr, nodes);
+  if(subject->properties_count > 1 &&
+     raptor_compare_abbrev_po(&po[-1], po, NULL) >= 0)
+    subject->properties_sorted = 0;
 
-  raptor_avltree_dump(subject->properties, stderr);
-#endif
-  err = raptor_avltree_add(subject->properties, nodes);
-  if(err)
-    return -1;
-#if 0
-  fprintf(stderr, "Result ");
-  raptor_avltree_print(subject->properties, stderr);
-  
-  raptor_avltree_dump(subject->properties, stderr);
+  return 0;
+}
 
-  raptor_avltree_check(subject->properties);
 
-  fprintf(stderr, "\n\n");
-#endif
+/**
+ * raptor_abbrev_subject_sort_properties:
+ * @subject: subject node
+ *
+ * INTERNAL - Sort the properties of a subject node and remove duplicates
+ *
+ * This is called by the serializers before walking
+ * @subject->properties and does nothing if no properties were added
+ * since the last call.
+ *
+ * Return value: number of properties
+ **/
+int
+raptor_abbrev_subject_sort_properties(raptor_abbrev_subject* subject)
+{
+  int i;
+  int count;
 
-  return 0;
+  if(subject->properties_sorted)
+    return subject->properties_count;
+
+  raptor_sort_r(subject->properties, subject->properties_count,
+                sizeof(*subject->properties), raptor_compare_abbrev_po, NULL);
+
+  /* Do not keep duplicate triples (s->[p o]) */
+  count = 1;
+  for(i = 1; i < subject->properties_count; i++) {
+    raptor_abbrev_po* po = &subject->properties[i];
+
+    if(!raptor_compare_abbrev_po(&subject->properties[count - 1], po, NULL)) {
+      raptor_free_abbrev_node(po->predicate);
+      raptor_free_abbrev_node(po->object);
+      continue;
+    }
+
+    if(i != count)
+      subject->properties[count] = *po;
+    count++;
+  }
+
+  subject->properties_count = count;
+  subject->properties_sorted = 1;
+
+  return count;
 }
 
 
@@ -413,34 +623,26 @@ raptor_abbrev_subject_compare(raptor_abbrev_subject* subject1,
 raptor_abbrev_subject*
 raptor_abbrev_subject_find(raptor_avltree *subjects, raptor_term* node)
 {
-  raptor_abbrev_subject* rv_subject = NULL;
-  raptor_abbrev_node* lookup_node = NULL;
-  raptor_abbrev_subject* lookup = NULL;
-
-  /* datatype and language are both NULL for a subject node */
-  
-  lookup_node = raptor_new_abbrev_node(node->world, node);
-  if(!lookup_node)
-    return NULL;
-  
-  lookup = raptor_new_abbrev_subject(lookup_node);
-  if(!lookup) {
-    raptor_free_abbrev_node(lookup_node);
-    return NULL;
-  }
+  raptor_abbrev_node lookup_node;
+  raptor_abbrev_subject lookup;
 
-  rv_subject = (raptor_abbrev_subject*) raptor_avltree_search(subjects, lookup);
+  /* The tree compare only looks at the subject node term so search
+   * with a borrowed term rather than copying it.
+   */
+  memset(&lookup_node, 0, sizeof(lookup_node));
+  lookup_node.world = node->world;
+  lookup_node.term = node;
 
-  raptor_free_abbrev_subject(lookup);
-  raptor_free_abbrev_node(lookup_node);
+  memset(&lookup, 0, sizeof(lookup));
+  lookup.node = &lookup_node;
 
-  return rv_subject;
+  return (raptor_abbrev_subject*)raptor_avltree_search(subjects, &lookup);
 }
 
 
 /**
  * raptor_abbrev_subject_lookup:
- * @nodes: AVL-Tree of subject nodes
+ * @nodes: table of nodes
  * @subjects: AVL-Tree of URI-subject nodes
  * @blanks: AVL-Tree of blank-subject nodes
  * @term: node to find
@@ -450,7 +652,7 @@ raptor_abbrev_subject_find(raptor_avltree *subjects, raptor_term* node)
  * Return value: node or NULL on failure
  */
 raptor_abbrev_subject* 
-raptor_abbrev_subject_lookup(raptor_avltree* nodes,
+raptor_abbrev_subject_lookup(raptor_abbrev_nodes* nodes,
                              raptor_avltree* subjects, raptor_avltree* blanks,
                              raptor_term* term)
 {
@@ -486,7 +688,6 @@ raptor_print_subject(raptor_abbrev_subject* subject)
   unsigned char *subj;
   unsigned char *pred;
   unsigned char *obj;
-  raptor_avltree_iterator* iter = NULL;
 
   /* Note: The raptor_abbrev_node field passed as the first argument for
    * raptor_term_to_string() is somewhat arbitrary, since as
@@ -514,19 +715,9 @@ raptor_print_subject(raptor_abbrev_subject* subject)
   }
 
 
-  iter = raptor_new_avltree_iterator(subject->properties, NULL, NULL, 1);
-  while(iter) {
-    raptor_abbrev_node** nodes;
-    nodes = (raptor_abbrev_node**)raptor_avltree_iterator_get(iter);
-    if(!nodes)
-      break;
-    raptor_print_abbrev_po(stderr, nodes);
-
-    if(raptor_avltree_iterator_next(iter))
-      break;
-  }
-  if(iter)
-    raptor_free_avltree_iterator(iter);
+  raptor_abbrev_subject_sort_properties(subject);
+  for(i = 0; i < subject->properties_count; i++)
+    raptor_print_abbrev_po(&subject->properties[i], stderr);
   
   RAPTOR_FREE(char*, subj);
   
@@ -553,16 +744,13 @@ raptor_new_qname_from_resource(raptor_sequence* namespaces,
                                int* namespace_count,
                                raptor_abbrev_node* node)
 {
-  unsigned char* name = NULL;  /* where to split predicate name */
-  size_t name_len = 1;
+  unsigned char* name;  /* where to split predicate name */
   unsigned char *uri_string;
   size_t uri_len;
-  unsigned char *p;
+  size_t ns_uri_len;
   raptor_uri *ns_uri;
   raptor_namespace *ns;
   raptor_qname *qname;
-  unsigned char *ns_uri_string;
-  size_t ns_uri_string_len;
   
   if(node->term->type != RAPTOR_TERM_TYPE_URI) {
 #ifdef RAPTOR_DEBUG
@@ -577,30 +765,14 @@ raptor_new_qname_from_resource(raptor_sequence* namespaces,
   
   uri_string = raptor_uri_as_counted_string(node->term->value.uri, &uri_len);
 
-  p= uri_string;
-  name_len = uri_len;
-  while(name_len >0) {
-    if(raptor_xml_name_check(p, name_len, 10)) {
-      name = p;
-      break;
-    }
-    p++; name_len--;
-  }
-      
-  if(!name || (name == uri_string))
+  /* split before the longest legal XML name at the end of the URI */
+  ns_uri_len = raptor_xml_name_suffix_start(uri_string, uri_len, 10);
+  if(!ns_uri_len || ns_uri_len == uri_len)
     return NULL;
+  name = uri_string + ns_uri_len;
 
-  ns_uri_string_len = uri_len - name_len;
-  ns_uri_string = RAPTOR_MALLOC(unsigned char*, ns_uri_string_len + 1);
-  if(!ns_uri_string)
-    return NULL;
-  memcpy(ns_uri_string, (const char*)uri_string, ns_uri_string_len);
-  ns_uri_string[ns_uri_string_len] = '\0';
-  
-  ns_uri = raptor_new_uri_from_counted_string(node->world, ns_uri_string,
-                                              ns_uri_string_len);
-  RAPTOR_FREE(char*, ns_uri_string);
-  
+  ns_uri = raptor_new_uri_from_counted_string(node->world, uri_string,
+                                              ns_uri_len);
   if(!ns_uri)
     return NULL;
 
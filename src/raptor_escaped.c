@@ -59,11 +59,36 @@ raptor_string_escaped_write(const unsigned char *string,
   unsigned char c;
   int unichar_len;
   raptor_unichar unichar;
+  char specials[3];
+  int scan_plain;
 
   if(!string)
     return 1;
+
+  /* Runs of printable ASCII other than backslash and the delimiter
+   * are always written as-is so they are found by a fast scan and
+   * written in one call.  SPARQL URI escaping also escapes printable
+   * characters, so uses the byte at a time loop.
+   */
+  scan_plain = !(flags & RAPTOR_ESCAPED_WRITE_BITFLAG_SPARQL_URI_ESCAPES);
+  specials[0] = '\\';
+  specials[1] = (delim != '\\') ? delim : '\0';
+  specials[2] = '\0';
   
   for(; (c=*string); string++, len--) {
+    if(scan_plain) {
+      size_t plain_len = raptor_memspn_ascii(string, len, specials);
+
+      if(plain_len) {
+        raptor_iostream_counted_string_write(string, plain_len, iostr);
+        string += plain_len;
+        len -= plain_len;
+        c = *string;
+        if(!c)
+          break;
+      }
+    }
+
     if((delim && c == delim && (delim == '\'' || delim == '"')) ||
        c == '\\') {
       raptor_iostream_write_byte('\\', iostr);
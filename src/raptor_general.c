@@ -145,6 +145,8 @@ raptor_new_world_internal(unsigned int version_decimal)
     /* set: URI Interning */
     world->uri_interning = 1;
 
+    world->iostream_write_buffer_size = RAPTOR_IOSTREAM_WRITE_BUFFER_SIZE;
+
     world->internal_ignore_errors = 0;
   }
   
@@ -476,6 +478,13 @@ raptor_world_set_flag(raptor_world *world, raptor_world_flag flag, int value)
     case RAPTOR_WORLD_FLAG_WWW_SKIP_INIT_FINISH:
       world->www_skip_www_init_finish = value;
       break;
+
+    case RAPTOR_WORLD_FLAG_IOSTREAM_WRITE_BUFFER_SIZE:
+      if(value < 0)
+        rc = -2;
+      else
+        world->iostream_write_buffer_size = value;
+      break;
   }
 
   return rc;
@@ -557,6 +566,64 @@ raptor_check_ordinal(const unsigned char *name)
 }
 
 
+/**
+ * raptor_hash_bytes:
+ * @h1_p: FNV-1a hash (in/out)
+ * @h2_p: Jenkins one-at-a-time hash (in/out) or NULL
+ * @p: bytes
+ * @len: length of @p
+ *
+ * INTERNAL - Add bytes to a pair of independent hashes
+ *
+ * Start *@h1_p at 2166136261 and *@h2_p at 0.  The two values
+ * together make a 64 bit fingerprint once *@h2_p is passed through
+ * raptor_hash_bytes_finish().
+ */
+void
+raptor_hash_bytes(unsigned int* h1_p, unsigned int* h2_p,
+                  const unsigned char* p, size_t len)
+{
+  unsigned int h1 = *h1_p;
+
+  if(h2_p) {
+    unsigned int h2 = *h2_p;
+    size_t i;
+
+    for(i = 0; i < len; i++) {
+      h2 += p[i];
+      h2 += (h2 << 10);
+      h2 ^= (h2 >> 6);
+    }
+    *h2_p = h2;
+  }
+
+  while(len--) {
+    h1 ^= *p++;
+    h1 *= 16777619U;
+  }
+  *h1_p = h1;
+}
+
+
+/**
+ * raptor_hash_bytes_finish:
+ * @h2: Jenkins one-at-a-time hash from raptor_hash_bytes()
+ *
+ * INTERNAL - Final mix of the second hash of raptor_hash_bytes()
+ *
+ * Return value: final hash value
+ */
+unsigned int
+raptor_hash_bytes_finish(unsigned int h2)
+{
+  h2 += (h2 << 3);
+  h2 ^= (h2 >> 11);
+  h2 += (h2 << 15);
+
+  return h2;
+}
+
+
 static const char* const raptor_domain_labels[RAPTOR_DOMAIN_LAST + 1] = {
   "none",
   "I/O Stream",
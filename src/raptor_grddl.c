@@ -61,6 +61,10 @@
 #include <libxslt/xsltutils.h>
 #include <libxslt/security.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 
 /*
  * libxslt API notes
@@ -93,6 +97,33 @@ typedef struct
 } grddl_xml_context;
   
 
+/*
+ * One GRDDL transformation of the document: a compiled XSLT sheet
+ * applied to it and the result serialized ready for a child parser.
+ */
+typedef struct
+{
+  grddl_xml_context* xml_context;
+  xsltStylesheetPtr sheet;
+
+  /* serialized result document, its length and media type */
+  xmlChar* doc_txt;
+  int doc_txt_len;
+  const char* media_type;
+
+  /* non-0 if the stylesheet failed to apply */
+  int failed;
+
+#ifdef HAVE_PTHREAD
+  /* libxslt messages when run on a worker; reported by the parser */
+  raptor_sequence* messages;
+
+  /* non-0 when the transformation has been run */
+  int done;
+#endif
+} raptor_grddl_transform;
+
+
 /*
  * XSLT parser object
  */
@@ -247,6 +278,307 @@ grddl_free_xml_context(void *context, void* userdata)
 }
 
 
+/*
+ * GRDDL cache
+ *
+ * Compiled XSLT sheets and the profile and namespace documents fetched
+ * while looking for transformations are kept per world, so that
+ * documents pointing at the same few transformations do not fetch and
+ * compile them again.  Both tables are small and evict the least
+ * recently used entry.  A cached entry is only used if the URI could
+ * be fetched now under the parser's options and URI filter.
+ */
+
+/* Maximum number of compiled XSLT sheets kept */
+#define RAPTOR_GRDDL_STYLESHEET_CACHE_SIZE 16
+
+/* Maximum number of profile and namespace documents kept */
+#define RAPTOR_GRDDL_DOCUMENT_CACHE_SIZE 16
+
+/* Largest profile or namespace document kept */
+#define RAPTOR_GRDDL_DOCUMENT_CACHE_MAX_LENGTH (1024 * 1024)
+
+typedef struct {
+  /* XSLT sheet URI or NULL if the entry is unused */
+  raptor_uri* uri;
+  /* non-0 if the sheet was parsed with XML_PARSE_NONET */
+  int no_net;
+  xsltStylesheetPtr sheet;
+  unsigned long last_used;
+} raptor_grddl_stylesheet_cache_entry;
+
+typedef struct {
+  /* document URI or NULL if the entry is unused */
+  raptor_uri* uri;
+  /* base URI the document was parsed with */
+  raptor_uri* base_uri;
+  char* content_type;
+  raptor_stringbuffer* content;
+  unsigned long last_used;
+} raptor_grddl_document_cache_entry;
+
+typedef struct {
+  raptor_grddl_stylesheet_cache_entry stylesheets[RAPTOR_GRDDL_STYLESHEET_CACHE_SIZE];
+  raptor_grddl_document_cache_entry documents[RAPTOR_GRDDL_DOCUMENT_CACHE_SIZE];
+  /* incremented on every use to order entries by last use */
+  unsigned long clock;
+} raptor_grddl_cache;
+
+
+static void
+raptor_grddl_clear_stylesheet_cache_entry(raptor_grddl_stylesheet_cache_entry* entry)
+{
+  if(entry->uri)
+    raptor_free_uri(entry->uri);
+  if(entry->sheet)
+    xsltFreeStylesheet(entry->sheet);
+  memset(entry, 0, sizeof(*entry));
+}
+
+
+static void
+raptor_grddl_clear_document_cache_entry(raptor_grddl_document_cache_entry* entry)
+{
+  if(entry->uri)
+    raptor_free_uri(entry->uri);
+  if(entry->base_uri)
+    raptor_free_uri(entry->base_uri);
+  if(entry->content_type)
+    RAPTOR_FREE(char*, entry->content_type);
+  if(entry->content)
+    raptor_free_stringbuffer(entry->content);
+  memset(entry, 0, sizeof(*entry));
+}
+
+
+static void
+raptor_free_grddl_cache(raptor_grddl_cache* cache)
+{
+  int i;
+
+  for(i = 0; i < RAPTOR_GRDDL_STYLESHEET_CACHE_SIZE; i++)
+    raptor_grddl_clear_stylesheet_cache_entry(&cache->stylesheets[i]);
+
+  for(i = 0; i < RAPTOR_GRDDL_DOCUMENT_CACHE_SIZE; i++)
+    raptor_grddl_clear_document_cache_entry(&cache->documents[i]);
+
+  RAPTOR_FREE(raptor_grddl_cache, cache);
+}
+
+
+/* Check @uri could be fetched now, as raptor_grddl_fetch_uri() would,
+ * before using anything cached from it */
+static int
+raptor_grddl_cache_uri_allowed(raptor_parser* rdf_parser, raptor_uri* uri)
+{
+  if(!rdf_parser->world->grddl_cache)
+    return 0;
+
+  if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_NO_NET)) {
+    if(!raptor_uri_uri_string_is_file_uri(raptor_uri_as_string(uri)))
+      return 0;
+  }
+
+  if(rdf_parser->uri_filter &&
+     rdf_parser->uri_filter(rdf_parser->uri_filter_user_data, uri))
+    return 0;
+
+  return 1;
+}
+
+
+/*
+ * raptor_grddl_cache_get_stylesheet:
+ * @rdf_parser: parser
+ * @uri: XSLT sheet URI
+ *
+ * INTERNAL - Take a compiled XSLT sheet out of the cache
+ *
+ * The caller owns the returned sheet until it is given back with
+ * raptor_grddl_cache_add_stylesheet().
+ *
+ * Return value: sheet or NULL if none is cached
+ */
+static xsltStylesheetPtr
+raptor_grddl_cache_get_stylesheet(raptor_parser* rdf_parser, raptor_uri* uri)
+{
+  raptor_grddl_cache* cache;
+  int no_net;
+  int i;
+
+  if(!raptor_grddl_cache_uri_allowed(rdf_parser, uri))
+    return NULL;
+
+  cache = (raptor_grddl_cache*)rdf_parser->world->grddl_cache;
+  no_net = RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_NO_NET) != 0;
+
+  for(i = 0; i < RAPTOR_GRDDL_STYLESHEET_CACHE_SIZE; i++) {
+    raptor_grddl_stylesheet_cache_entry* entry = &cache->stylesheets[i];
+    xsltStylesheetPtr sheet;
+
+    if(!entry->uri || entry->no_net != no_net ||
+       !raptor_uri_equals(entry->uri, uri))
+      continue;
+
+    sheet = entry->sheet;
+    entry->sheet = NULL;
+    raptor_grddl_clear_stylesheet_cache_entry(entry);
+
+    RAPTOR_DEBUG2("Using cached XSLT sheet for URI '%s'\n",
+                  raptor_uri_as_string(uri));
+    return sheet;
+  }
+
+  return NULL;
+}
+
+
+/*
+ * raptor_grddl_cache_add_stylesheet:
+ * @rdf_parser: parser
+ * @uri: XSLT sheet URI
+ * @sheet: compiled sheet (becomes owned by the cache)
+ *
+ * INTERNAL - Put a compiled XSLT sheet into the cache
+ *
+ * Replaces the least recently used entry if the cache is full.
+ */
+static void
+raptor_grddl_cache_add_stylesheet(raptor_parser* rdf_parser, raptor_uri* uri,
+                                  xsltStylesheetPtr sheet)
+{
+  raptor_grddl_cache* cache;
+  raptor_grddl_stylesheet_cache_entry* entry = NULL;
+  int no_net;
+  int i;
+
+  cache = (raptor_grddl_cache*)rdf_parser->world->grddl_cache;
+  if(!cache) {
+    xsltFreeStylesheet(sheet);
+    return;
+  }
+
+  no_net = RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_NO_NET) != 0;
+
+  for(i = 0; i < RAPTOR_GRDDL_STYLESHEET_CACHE_SIZE; i++) {
+    raptor_grddl_stylesheet_cache_entry* e = &cache->stylesheets[i];
+
+    if(e->uri && e->no_net == no_net && raptor_uri_equals(e->uri, uri)) {
+      /* already cached from another parse */
+      xsltFreeStylesheet(sheet);
+      e->last_used = ++cache->clock;
+      return;
+    }
+
+    if(!entry || !e->uri ||
+       (entry->uri && e->last_used < entry->last_used))
+      entry = e;
+  }
+
+  raptor_grddl_clear_stylesheet_cache_entry(entry);
+  entry->uri = raptor_uri_copy(uri);
+  entry->no_net = no_net;
+  entry->sheet = sheet;
+  entry->last_used = ++cache->clock;
+}
+
+
+/*
+ * raptor_grddl_cache_get_document:
+ * @rdf_parser: parser
+ * @uri: document URI
+ *
+ * INTERNAL - Find a cached profile or namespace document
+ *
+ * Return value: shared entry or NULL if none is cached
+ */
+static raptor_grddl_document_cache_entry*
+raptor_grddl_cache_get_document(raptor_parser* rdf_parser, raptor_uri* uri)
+{
+  raptor_grddl_cache* cache;
+  int i;
+
+  if(!raptor_grddl_cache_uri_allowed(rdf_parser, uri))
+    return NULL;
+
+  cache = (raptor_grddl_cache*)rdf_parser->world->grddl_cache;
+
+  for(i = 0; i < RAPTOR_GRDDL_DOCUMENT_CACHE_SIZE; i++) {
+    raptor_grddl_document_cache_entry* entry = &cache->documents[i];
+
+    if(entry->uri && raptor_uri_equals(entry->uri, uri)) {
+      entry->last_used = ++cache->clock;
+
+      RAPTOR_DEBUG2("Using cached document for URI '%s'\n",
+                    raptor_uri_as_string(uri));
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+
+/*
+ * raptor_grddl_cache_add_document:
+ * @rdf_parser: parser
+ * @uri: document URI
+ * @base_uri: base URI the document was parsed with
+ * @content_type: Content-Type of the document or NULL
+ * @content: content (becomes owned by the cache)
+ *
+ * INTERNAL - Put a profile or namespace document into the cache
+ *
+ * Replaces the least recently used entry if the cache is full.
+ */
+static void
+raptor_grddl_cache_add_document(raptor_parser* rdf_parser, raptor_uri* uri,
+                                raptor_uri* base_uri, const char* content_type,
+                                raptor_stringbuffer* content)
+{
+  raptor_grddl_cache* cache;
+  raptor_grddl_document_cache_entry* entry = NULL;
+  int i;
+
+  cache = (raptor_grddl_cache*)rdf_parser->world->grddl_cache;
+  if(!cache) {
+    raptor_free_stringbuffer(content);
+    return;
+  }
+
+  for(i = 0; i < RAPTOR_GRDDL_DOCUMENT_CACHE_SIZE; i++) {
+    raptor_grddl_document_cache_entry* e = &cache->documents[i];
+
+    if(e->uri && raptor_uri_equals(e->uri, uri)) {
+      entry = e;
+      break;
+    }
+
+    if(!entry || !e->uri ||
+       (entry->uri && e->last_used < entry->last_used))
+      entry = e;
+  }
+
+  raptor_grddl_clear_document_cache_entry(entry);
+
+  if(content_type) {
+    size_t len = strlen(content_type);
+
+    entry->content_type = RAPTOR_MALLOC(char*, len + 1);
+    if(!entry->content_type) {
+      raptor_free_stringbuffer(content);
+      return;
+    }
+    memcpy(entry->content_type, content_type, len + 1);
+  }
+
+  entry->uri = raptor_uri_copy(uri);
+  entry->base_uri = raptor_uri_copy(base_uri);
+  entry->content = content;
+  entry->last_used = ++cache->clock;
+}
+
+
 static int
 raptor_grddl_parse_init_common(raptor_parser* rdf_parser, const char *name)
 {
@@ -654,55 +986,42 @@ raptor_grddl_ensure_internal_parser(raptor_parser* rdf_parser,
 }
 
 
-/* Run a GRDDL transform using a pre-parsed XSLT stylesheet already
- * formed into a libxml document (with URI)
+/* Apply the compiled XSLT stylesheet of @transform to @doc and
+ * serialize the result
+ *
+ * This only uses libxslt and the transform so that it can be run on
+ * a worker thread.  The sheet is not modified so that it can be
+ * cached and reused.  Messages go to @error_handler.
  */
-static int
-raptor_grddl_run_grddl_transform_doc(raptor_parser* rdf_parser,
-                                     grddl_xml_context* xml_context,
-                                     xmlDocPtr xslt_doc,
-                                     xmlDocPtr doc)
+static void
+raptor_grddl_apply_transform(raptor_world* world,
+                             raptor_grddl_transform* transform,
+                             xmlDocPtr doc,
+                             void* error_data,
+                             xmlGenericErrorFunc error_handler)
 {
-  raptor_world* world = rdf_parser->world;
-  raptor_grddl_parser_context* grddl_parser;
-  int ret = 0;
-  xsltStylesheetPtr sheet = NULL;
+  xsltStylesheetPtr sheet = transform->sheet;
+  grddl_xml_context* xml_context = transform->xml_context;
   xmlDocPtr res = NULL;
-  xmlChar *doc_txt = NULL;
-  int doc_txt_len = 0;
-  const char* parser_name;
   const char* params[7];
   const unsigned char* base_uri_string;
   size_t base_uri_len;
-  raptor_uri* xslt_uri;
   raptor_uri* base_uri;
   char *quoted_base_uri = NULL;
   xsltTransformContextPtr userCtxt = NULL;
+  const char* method;
+  const char* media_type;
 
-  grddl_parser = (raptor_grddl_parser_context*)rdf_parser->context;
-
-  xslt_uri = xml_context->uri;
   base_uri = xml_context->base_uri ? xml_context->base_uri : xml_context->uri;
 
   base_uri_string = raptor_uri_as_counted_string(base_uri, &base_uri_len);
 
-  RAPTOR_DEBUG3("Running GRDDL transform with XSLT URI '%s' with doc base URI '%s'\n",
-                raptor_uri_as_string(xslt_uri),
-                base_uri_string);
-  
-  raptor_libxslt_set_global_state(rdf_parser);
-
-  /* This calls xsltGetDefaultSecurityPrefs() */
-  sheet = xsltParseStylesheetDoc(xslt_doc);
-  if(!sheet) {
-    raptor_parser_error(rdf_parser, "Failed to parse stylesheet in '%s'",
-                        raptor_uri_as_string(xslt_uri));
-    ret = 1;
-    goto cleanup_xslt;
-  }
-
   /* This calls xsltGetDefaultSecurityPrefs() */
   userCtxt = xsltNewTransformContext(sheet, doc);
+  if(!userCtxt) {
+    transform->failed = 1;
+    return;
+  }
 
   /* set per-transform security preferences */
   if(world->xslt_security_preferences)
@@ -710,8 +1029,7 @@ raptor_grddl_run_grddl_transform_doc(raptor_parser* rdf_parser,
                              userCtxt);
 
   /* set per-transform generic error handler */
-  xsltSetTransformErrorFunc(userCtxt, rdf_parser,
-                            raptor_grddl_xsltGenericError_handler);
+  xsltSetTransformErrorFunc(userCtxt, error_data, error_handler);
 
 
   /*
@@ -724,6 +1042,10 @@ raptor_grddl_run_grddl_transform_doc(raptor_parser* rdf_parser,
    *   http://www.w3.org/2001/sw/grddl-wg/td/RDFa2RDFXML.xsl
    */
   quoted_base_uri = RAPTOR_MALLOC(char*, base_uri_len + 3);
+  if(!quoted_base_uri) {
+    transform->failed = 1;
+    goto cleanup_xslt;
+  }
   quoted_base_uri[0] = '\'';
   memcpy(quoted_base_uri + 1, (const char*)base_uri_string, base_uri_len);
   quoted_base_uri[base_uri_len + 1] = '\'';
@@ -740,280 +1062,754 @@ raptor_grddl_run_grddl_transform_doc(raptor_parser* rdf_parser,
   res = xsltApplyStylesheetUser(sheet, doc, params, NULL, NULL, userCtxt);
 
   if(!res) {
-    raptor_parser_error(rdf_parser, "Failed to apply stylesheet in '%s'",
-                        raptor_uri_as_string(xslt_uri));
-    ret = 1;
+    transform->failed = 1;
     goto cleanup_xslt;
   }
 
+  /* write the resulting XML to a string, as HTML if that was made */
+  method = (const char*)sheet->method;
   if(res->type == XML_HTML_DOCUMENT_NODE) {
-    if(sheet->method != NULL)
-      xmlFree(sheet->method);
-    sheet->method = (xmlChar*)xmlMalloc(5);
-    memcpy(sheet->method, "html", 5);
-  }
+    xmlChar* saved_method = sheet->method;
 
-  /* write the resulting XML to a string */
-  xsltSaveResultToString(&doc_txt, &doc_txt_len, res, sheet);
+    method = "html";
+    sheet->method = (xmlChar*)method;
+    xsltSaveResultToString(&transform->doc_txt, &transform->doc_txt_len,
+                           res, sheet);
+    sheet->method = saved_method;
+  } else
+    xsltSaveResultToString(&transform->doc_txt, &transform->doc_txt_len,
+                           res, sheet);
   
-  if(!doc_txt || !doc_txt_len) {
-    raptor_parser_warning(rdf_parser, "XSLT returned an empty document");
-    goto cleanup_xslt;
+  /* Set mime types for XSLT <xsl:output method> content */
+  media_type = (const char*)sheet->mediaType;
+  if(!media_type && method) {
+    if(!strcmp(method, "text"))
+      media_type = "text/plain";
+    else if(!strcmp(method, "xml"))
+      media_type = "application/xml";
+    else if(!strcmp(method, "html"))
+      media_type = "text/html";
   }
 
   RAPTOR_DEBUG4("XSLT returned %d bytes document method %s media type %s\n",
-                doc_txt_len,
-                (sheet->method ? (const char*)sheet->method : "NULL"),
-                (sheet->mediaType ? (const char*)sheet->mediaType : "NULL"));
-
-  /* Set mime types for XSLT <xsl:output method> content */
-  if(sheet->mediaType == NULL && sheet->method) {
-    if(!(strcmp((const char*)sheet->method, "text"))) {
-      sheet->mediaType = (xmlChar*)xmlMalloc(11);
-      memcpy(sheet->mediaType, "text/plain",11);
-    } else if(!(strcmp((const char*)sheet->method, "xml"))) {
-      sheet->mediaType = (xmlChar*)xmlMalloc(16);
-      memcpy(sheet->mediaType, "application/xml",16);
-    } else if(!(strcmp((const char*)sheet->method, "html"))) {
-      sheet->mediaType = (xmlChar*)xmlMalloc(10);
-      memcpy(sheet->mediaType, "text/html",10);
-    }
-  }
+                transform->doc_txt_len,
+                (method ? method : "NULL"),
+                (media_type ? media_type : "NULL"));
 
   /* Assume all that all media XML is RDF/XML and also that
    * with no information at all we have RDF/XML
    */
-  if(!sheet->mediaType ||
-     (sheet->mediaType &&
-      !strcmp((const char*)sheet->mediaType, "application/xml"))) {
-    if(sheet->mediaType)
-      xmlFree(sheet->mediaType);
-    sheet->mediaType = (xmlChar*)xmlMalloc(20);
-    memcpy(sheet->mediaType, "application/rdf+xml",20);
-  }
+  if(!media_type || !strcmp(media_type, "application/xml"))
+    media_type = "application/rdf+xml";
+
+  transform->media_type = media_type;
+
+  cleanup_xslt:
+
+  xsltFreeTransformContext(userCtxt);
+  
+  if(quoted_base_uri)
+    RAPTOR_FREE(char*, quoted_base_uri);
   
+  if(res)
+    xmlFreeDoc(res);
+}
+
+
+/* Parse the result of an applied GRDDL transform with a child parser */
+static int
+raptor_grddl_parse_transform_result(raptor_parser* rdf_parser,
+                                    raptor_grddl_transform* transform)
+{
+  raptor_grddl_parser_context* grddl_parser;
+  grddl_xml_context* xml_context = transform->xml_context;
+  raptor_uri* base_uri;
+  const char* parser_name;
+  int ret = 0;
+
+  grddl_parser = (raptor_grddl_parser_context*)rdf_parser->context;
+
+  base_uri = xml_context->base_uri ? xml_context->base_uri : xml_context->uri;
+
+  if(transform->failed) {
+    raptor_parser_error(rdf_parser, "Failed to apply stylesheet in '%s'",
+                        raptor_uri_as_string(xml_context->uri));
+    return 1;
+  }
+
+  if(!transform->doc_txt || !transform->doc_txt_len) {
+    raptor_parser_warning(rdf_parser, "XSLT returned an empty document");
+    return 0;
+  }
+
   parser_name = raptor_world_guess_parser_name(rdf_parser->world, NULL,
-                                               (const char*)sheet->mediaType,
-                                               doc_txt, doc_txt_len, NULL);
+                                               transform->media_type,
+                                               transform->doc_txt,
+                                               transform->doc_txt_len, NULL);
   if(!parser_name) {
     RAPTOR_DEBUG3("Parser %p: Guessed no parser from mime type '%s' and content - ending",
-                  rdf_parser, sheet->mediaType);
-    goto cleanup_xslt;
+                  rdf_parser, transform->media_type);
+    return 0;
   }
   
   RAPTOR_DEBUG4("Parser %p: Guessed parser %s from mime type '%s' and content\n",
-                rdf_parser, parser_name, sheet->mediaType);
+                rdf_parser, parser_name, transform->media_type);
 
   if(!strcmp((const char*)parser_name, "grddl")) {
     RAPTOR_DEBUG2("Parser %p: Ignoring guess to run grddl parser - ending",
                   rdf_parser);
-    goto cleanup_xslt;
+    return 0;
   }
 
   ret = raptor_grddl_ensure_internal_parser(rdf_parser, parser_name, 0);
   if(ret)
-    goto cleanup_xslt;
+    return ret;
   
   if(grddl_parser->internal_parser) {
     /* generate the triples */
     ret = raptor_parser_parse_start(grddl_parser->internal_parser, base_uri);
     if(!ret)
       ret = raptor_parser_parse_chunk(grddl_parser->internal_parser,
-                                      doc_txt, doc_txt_len, 1);
+                                      transform->doc_txt,
+                                      transform->doc_txt_len, 1);
+  }
+
+  return ret;
+}
+
+
+/* Free the result of an applied GRDDL transform */
+static void
+raptor_grddl_clear_transform_result(raptor_grddl_transform* transform)
+{
+  if(transform->doc_txt) {
+    xmlFree(transform->doc_txt);
+    transform->doc_txt = NULL;
   }
+  transform->doc_txt_len = 0;
+  transform->media_type = NULL;
+  transform->failed = 0;
+
+#ifdef HAVE_PTHREAD
+  if(transform->messages) {
+    raptor_free_sequence(transform->messages);
+    transform->messages = NULL;
+  }
+#endif
+}
+
+
+/* Run a GRDDL transform using a compiled XSLT stylesheet */
+static int
+raptor_grddl_run_grddl_transform_doc(raptor_parser* rdf_parser,
+                                     grddl_xml_context* xml_context,
+                                     xsltStylesheetPtr sheet,
+                                     xmlDocPtr doc)
+{
+  raptor_grddl_transform transform;
+  int ret;
+
+  RAPTOR_DEBUG3("Running GRDDL transform with XSLT URI '%s' with doc base URI '%s'\n",
+                raptor_uri_as_string(xml_context->uri),
+                raptor_uri_as_string(xml_context->base_uri ?
+                                     xml_context->base_uri : xml_context->uri));
   
-  cleanup_xslt:
+  memset(&transform, '\0', sizeof(transform));
+  transform.xml_context = xml_context;
+  transform.sheet = sheet;
+
+  raptor_libxslt_set_global_state(rdf_parser);
+
+  raptor_grddl_apply_transform(rdf_parser->world, &transform, doc,
+                               rdf_parser,
+                               raptor_grddl_xsltGenericError_handler);
+
+  ret = raptor_grddl_parse_transform_result(rdf_parser, &transform);
+
+  raptor_grddl_clear_transform_result(&transform);
+
+  raptor_libxslt_reset_global_state(rdf_parser);
+
+  return ret;
+}
+
+
+typedef struct 
+{
+  raptor_parser* rdf_parser;
+  xmlParserCtxtPtr xc;
+  raptor_uri* base_uri;
+} raptor_grddl_xml_parse_bytes_context;
+  
+
+static void
+raptor_grddl_uri_xml_parse_bytes(raptor_www* www,
+                                 void *userdata,
+                                 const void *ptr, size_t size, size_t nmemb)
+{
+  raptor_grddl_xml_parse_bytes_context* xpbc;
+  size_t len = size * nmemb;
+  int rc = 0;
+  
+  xpbc = (raptor_grddl_xml_parse_bytes_context*)userdata;
+
+  if(!xpbc->xc) {
+    xmlParserCtxtPtr xc;
+    
+    xc = xmlCreatePushParserCtxt(NULL, NULL,
+                                 (const char*)ptr, RAPTOR_BAD_CAST(int, len),
+                                 (const char*)raptor_uri_as_string(xpbc->base_uri));
+    if(!xc)
+      rc = 1;
+    else {
+      int libxml_options = 0;
+
+#ifdef RAPTOR_LIBXML_XML_PARSE_NONET
+      if(RAPTOR_OPTIONS_GET_NUMERIC(xpbc->rdf_parser, RAPTOR_OPTION_NO_NET))
+        libxml_options |= XML_PARSE_NONET;
+#endif
+#ifdef HAVE_XMLCTXTUSEOPTIONS
+      xmlCtxtUseOptions(xc, libxml_options);
+#endif
+
+      xc->replaceEntities = 1;
+      xc->loadsubset = 1;
+    }
+    xpbc->xc = xc;
+  } else
+    rc = xmlParseChunk(xpbc->xc, (const char*)ptr, RAPTOR_BAD_CAST(int, len), 0);
+
+  if(rc)
+    raptor_parser_error(xpbc->rdf_parser, "XML Parsing failed");
+}
+
+
+#define FETCH_IGNORE_ERRORS 1
+#define FETCH_ACCEPT_XSLT   2
+
+static int
+raptor_grddl_fetch_uri(raptor_parser* rdf_parser, 
+                       raptor_uri* uri,
+                       raptor_www_write_bytes_handler write_bytes_handler,
+                       void* write_bytes_user_data,
+                       raptor_www_content_type_handler content_type_handler,
+                       void* content_type_user_data,
+                       int flags)
+{
+  raptor_www *www;
+  const char *accept_h;
+  int ret = 0;
+  int ignore_errors = (flags & FETCH_IGNORE_ERRORS);
+  
+  if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_NO_NET)) {
+    if(!raptor_uri_uri_string_is_file_uri(raptor_uri_as_string(uri)))
+      return 1;
+  }
+  
+  www = raptor_new_www(rdf_parser->world);
+  if(!www)
+    return 1;
+  
+  raptor_www_set_user_agent(www, "grddl/0.1");
+  
+  if(flags & FETCH_ACCEPT_XSLT) {
+    raptor_www_set_http_accept(www, "application/xml");
+  } else {
+    accept_h = raptor_parser_get_accept_header(rdf_parser);
+    if(accept_h) {
+      raptor_www_set_http_accept(www, accept_h);
+      RAPTOR_FREE(char*, accept_h);
+    }
+  }
+  if(rdf_parser->uri_filter)
+    raptor_www_set_uri_filter(www, rdf_parser->uri_filter,
+                              rdf_parser->uri_filter_user_data);
+  if(ignore_errors)
+    raptor_world_internal_set_ignore_errors(rdf_parser->world, 1);
+
+  raptor_www_set_write_bytes_handler(www, write_bytes_handler,
+                                     write_bytes_user_data);
+  raptor_www_set_content_type_handler(www, content_type_handler,
+                                      content_type_user_data);
+
+  if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_WWW_TIMEOUT) > 0)
+    raptor_www_set_connection_timeout(www, 
+                                      RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_WWW_TIMEOUT));
+
+  ret = raptor_www_fetch(www, uri);
+  
+  raptor_free_www(www);
+
+  if(ignore_errors)
+    raptor_world_internal_set_ignore_errors(rdf_parser->world, 0);
+
+  return ret;
+}
+
+
+/* Get the compiled XSLT stylesheet for a GRDDL transform
+ *
+ * The sheet is taken from the cache or fetched and compiled; it is
+ * given back with raptor_grddl_cache_add_stylesheet().
+ *
+ * Return value: non-0 on failure.  *sheet_p is NULL if the sheet
+ * could not be fetched which is only a warning.
+ */
+static int
+raptor_grddl_get_stylesheet(raptor_parser* rdf_parser,
+                            raptor_uri* xslt_uri,
+                            xsltStylesheetPtr* sheet_p)
+{
+  xmlParserCtxtPtr xslt_ctxt = NULL;
+  raptor_grddl_xml_parse_bytes_context xpbc;
+  int ret = 0;
+  raptor_uri* old_locator_uri;
+  raptor_locator *locator = &rdf_parser->locator;
+  xsltStylesheetPtr sheet;
+
+  *sheet_p = NULL;
+
+  sheet = raptor_grddl_cache_get_stylesheet(rdf_parser, xslt_uri);
+  if(sheet) {
+    *sheet_p = sheet;
+    return 0;
+  }
+
+  old_locator_uri = locator->uri;
+  locator->uri = xslt_uri;
+
+  /* make an xmlDoc via the raptor_grddl_uri_xml_parse_bytes callback
+   * as bytes are returned.  The sheet is parsed with its own URI as
+   * base so that it can be shared by documents with any base URI.
+   */
+  xpbc.xc = NULL;
+  xpbc.rdf_parser = rdf_parser;
+  xpbc.base_uri = xslt_uri;
+
+  ret = raptor_grddl_fetch_uri(rdf_parser,
+                               xslt_uri,
+                               raptor_grddl_uri_xml_parse_bytes, &xpbc,
+                               NULL, NULL,
+                               FETCH_ACCEPT_XSLT);
+  xslt_ctxt = xpbc.xc;
+  if(ret) {
+    locator->uri = old_locator_uri;
+    raptor_parser_warning(rdf_parser, "Fetching XSLT document URI '%s' failed",
+                          raptor_uri_as_string(xslt_uri));
+    ret = 0;
+    goto tidy;
+  }
+
+  xmlParseChunk(xpbc.xc, NULL, 0, 1);
+
+  raptor_libxslt_set_global_state(rdf_parser);
+  /* This calls xsltGetDefaultSecurityPrefs() */
+  sheet = xsltParseStylesheetDoc(xslt_ctxt->myDoc);
+  raptor_libxslt_reset_global_state(rdf_parser);
+
+  if(!sheet) {
+    raptor_parser_error(rdf_parser, "Failed to parse stylesheet in '%s'",
+                        raptor_uri_as_string(xslt_uri));
+    /* the document is only owned by a sheet that was made */
+    xmlFreeDoc(xslt_ctxt->myDoc);
+    xslt_ctxt->myDoc = NULL;
+    ret = 1;
+  }
+  locator->uri = old_locator_uri;
+
+  *sheet_p = sheet;
+
+  tidy:
+  if(xslt_ctxt)
+    xmlFreeParserCtxt(xslt_ctxt); 
+  
+  return ret;
+}
+
+
+/* Run a GRDDL transform using a XSLT stylesheet at a given URI */
+static int
+raptor_grddl_run_grddl_transform_uri(raptor_parser* rdf_parser,
+                                     grddl_xml_context* xml_context, 
+                                     xmlDocPtr doc)
+{
+  int ret = 0;
+  raptor_uri* xslt_uri;
+  raptor_uri* old_locator_uri;
+  raptor_locator *locator = &rdf_parser->locator;
+  xsltStylesheetPtr sheet;
+
+  xslt_uri = xml_context->uri;
+
+  RAPTOR_DEBUG3("Running GRDDL transform with XSLT URI %s and base URI %s\n",
+                raptor_uri_as_string(xslt_uri),
+                raptor_uri_as_string(xml_context->base_uri ?
+                                     xml_context->base_uri : xslt_uri));
+  
+  ret = raptor_grddl_get_stylesheet(rdf_parser, xslt_uri, &sheet);
+  if(ret || !sheet)
+    return ret;
+
+  old_locator_uri = locator->uri;
+  locator->uri = xslt_uri;
+
+  ret = raptor_grddl_run_grddl_transform_doc(rdf_parser, xml_context,
+                                             sheet, doc);
+  locator->uri = old_locator_uri;
+
+  raptor_grddl_cache_add_stylesheet(rdf_parser, xslt_uri, sheet);
+
+  return ret;
+}
+
+
+#ifdef HAVE_PTHREAD
+/*
+ * Worker pool applying the transformations of a document in parallel
+ *
+ * The sheets are got on the parser thread in document order, ahead
+ * of the transforms before them being run.  The workers take the transformations in turn, apply each to a private
+ * copy of the document and serialize the result.  The parser thread
+ * parses the results with the child parser in document order as they
+ * are done so the statements are the same, and in the same order, as
+ * when the transformations are run one by one.  The workers only use
+ * libxml and libxslt; raptor parsers, handlers and the world are only
+ * used by the parser thread.
+ */
+
+typedef struct {
+  raptor_world* world;
+  /* source document; only read while the pool runs */
+  xmlDocPtr doc;
+
+  raptor_grddl_transform* transforms;
+  int transforms_count;
+
+  /* transform being run by the current thread */
+  pthread_key_t current_key;
+
+  /* fields below are protected by lock */
+  pthread_mutex_t lock;
+  pthread_cond_t done_cond;
+  /* index of the next transform to run */
+  int next;
+} raptor_grddl_pool;
+
+
+static void raptor_grddl_transform_error_handler(void *user_data, const char *msg, ...) RAPTOR_PRINTF_FORMAT(2, 0);
+static void raptor_grddl_pool_error_handler(void *user_data, const char *msg, ...) RAPTOR_PRINTF_FORMAT(2, 0);
+
+
+static void
+raptor_grddl_transform_add_message(raptor_grddl_transform* transform,
+                                   const char *msg, va_list arguments)
+{
+  char *nmsg = NULL;
+  int length;
+
+  if(!msg || *msg == '\n')
+    return;
+
+  if(!transform->messages) {
+    transform->messages = raptor_new_sequence((raptor_data_free_handler)raptor_free_memory, NULL);
+    if(!transform->messages)
+      return;
+  }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+  length = raptor_vasprintf(&nmsg, msg, arguments);
+#pragma GCC diagnostic pop
+  if(length < 0 || !nmsg)
+    return;
+
+  if(length >= 1 && nmsg[length - 1] == '\n')
+    nmsg[length - 1] = '\0';
+
+  raptor_sequence_push(transform->messages, nmsg);
+}
+
+
+/* libxslt transform context error handler for a transform on the pool */
+static void
+raptor_grddl_transform_error_handler(void *user_data, const char *msg, ...)
+{
+  va_list arguments;
+
+  va_start(arguments, msg);
+  raptor_grddl_transform_add_message((raptor_grddl_transform*)user_data,
+                                     msg, arguments);
+  va_end(arguments);
+}
+
+
+/* libxslt global error handler while the pool runs */
+static void
+raptor_grddl_pool_error_handler(void *user_data, const char *msg, ...)
+{
+  raptor_grddl_pool* pool = (raptor_grddl_pool*)user_data;
+  raptor_grddl_transform* transform;
+  va_list arguments;
+
+  transform = (raptor_grddl_transform*)pthread_getspecific(pool->current_key);
+  if(!transform)
+    return;
+
+  va_start(arguments, msg);
+  raptor_grddl_transform_add_message(transform, msg, arguments);
+  va_end(arguments);
+}
+
+
+/* Run a transform of the pool on the current thread */
+static void
+raptor_grddl_pool_run_transform(raptor_grddl_pool* pool,
+                                raptor_grddl_transform* transform)
+{
+  xmlDocPtr doc;
 
-  if(userCtxt)
-    xsltFreeTransformContext(userCtxt);
-  
-  if(quoted_base_uri)
-    RAPTOR_FREE(char*, quoted_base_uri);
-  
-  if(doc_txt)    
-    xmlFree(doc_txt);
-  
-  if(res)
-    xmlFreeDoc(res);
-  
-  if(sheet)
-    xsltFreeStylesheet(sheet);
-  
-  raptor_libxslt_reset_global_state(rdf_parser);
+  /* libxslt may change the source document, such as when stripping
+   * space, so each transform gets its own copy */
+  doc = xmlCopyDoc(pool->doc, 1);
+  if(!doc)
+    transform->failed = 1;
+  else {
+    pthread_setspecific(pool->current_key, transform);
+    raptor_grddl_apply_transform(pool->world, transform, doc,
+                                 transform,
+                                 raptor_grddl_transform_error_handler);
+    pthread_setspecific(pool->current_key, NULL);
+
+    xmlFreeDoc(doc);
+  }
 
-  return ret;
+  pthread_mutex_lock(&pool->lock);
+  transform->done = 1;
+  pthread_cond_broadcast(&pool->done_cond);
+  pthread_mutex_unlock(&pool->lock);
 }
 
 
-typedef struct 
+static void*
+raptor_grddl_worker_run(void* arg)
 {
-  raptor_parser* rdf_parser;
-  xmlParserCtxtPtr xc;
-  raptor_uri* base_uri;
-} raptor_grddl_xml_parse_bytes_context;
-  
+  raptor_grddl_pool* pool = (raptor_grddl_pool*)arg;
+
+  pthread_mutex_lock(&pool->lock);
+  while(pool->next < pool->transforms_count) {
+    raptor_grddl_transform* transform = &pool->transforms[pool->next++];
+
+    pthread_mutex_unlock(&pool->lock);
+    raptor_grddl_pool_run_transform(pool, transform);
+    pthread_mutex_lock(&pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
 
+/* log handler counting messages while sheets are got ahead of turn */
 static void
-raptor_grddl_uri_xml_parse_bytes(raptor_www* www,
-                                 void *userdata,
-                                 const void *ptr, size_t size, size_t nmemb)
+raptor_grddl_count_log_handler(void *user_data, raptor_log_message *message)
 {
-  raptor_grddl_xml_parse_bytes_context* xpbc;
-  size_t len = size * nmemb;
-  int rc = 0;
-  
-  xpbc = (raptor_grddl_xml_parse_bytes_context*)userdata;
+  int* count_p = (int*)user_data;
 
-  if(!xpbc->xc) {
-    xmlParserCtxtPtr xc;
-    
-    xc = xmlCreatePushParserCtxt(NULL, NULL,
-                                 (const char*)ptr, RAPTOR_BAD_CAST(int, len),
-                                 (const char*)raptor_uri_as_string(xpbc->base_uri));
-    if(!xc)
-      rc = 1;
-    else {
-      int libxml_options = 0;
+  (*count_p)++;
+}
 
-#ifdef RAPTOR_LIBXML_XML_PARSE_NONET
-      if(RAPTOR_OPTIONS_GET_NUMERIC(xpbc->rdf_parser, RAPTOR_OPTION_NO_NET))
-        libxml_options |= XML_PARSE_NONET;
-#endif
-#ifdef HAVE_XMLCTXTUSEOPTIONS
-      xmlCtxtUseOptions(xc, libxml_options);
-#endif
 
-      xc->replaceEntities = 1;
-      xc->loadsubset = 1;
-    }
-    xpbc->xc = xc;
-  } else
-    rc = xmlParseChunk(xpbc->xc, (const char*)ptr, RAPTOR_BAD_CAST(int, len), 0);
+/*
+ * raptor_grddl_get_stylesheet_ahead:
+ * @rdf_parser: GRDDL parser
+ * @xslt_uri: XSLT sheet URI
+ *
+ * INTERNAL - Get a sheet before the transforms ahead of it have run
+ *
+ * Return value: sheet or NULL if getting it failed or logged any
+ * message.  The sheet is then got again in turn so that the messages
+ * are reported in the same order as when the transforms are run one
+ * by one.
+ */
+static xsltStylesheetPtr
+raptor_grddl_get_stylesheet_ahead(raptor_parser* rdf_parser,
+                                  raptor_uri* xslt_uri)
+{
+  raptor_world* world = rdf_parser->world;
+  void* saved_user_data = world->message_handler_user_data;
+  raptor_log_handler saved_handler = world->message_handler;
+  xsltStylesheetPtr sheet = NULL;
+  int messages_count = 0;
+  int ret;
 
-  if(rc)
-    raptor_parser_error(xpbc->rdf_parser, "XML Parsing failed");
-}
+  world->message_handler_user_data = &messages_count;
+  world->message_handler = raptor_grddl_count_log_handler;
 
+  ret = raptor_grddl_get_stylesheet(rdf_parser, xslt_uri, &sheet);
 
-#define FETCH_IGNORE_ERRORS 1
-#define FETCH_ACCEPT_XSLT   2
+  world->message_handler_user_data = saved_user_data;
+  world->message_handler = saved_handler;
 
+  if(sheet && (ret || messages_count)) {
+    xsltFreeStylesheet(sheet);
+    sheet = NULL;
+  }
+
+  return sheet;
+}
+
+
+/*
+ * raptor_grddl_run_transforms_pool:
+ * @rdf_parser: GRDDL parser
+ * @doc: document to transform
+ * @threads: maximum number of worker threads
+ *
+ * INTERNAL - Run transformation URIs seen for @doc on a worker pool
+ *
+ * Runs the transformations from the start of the list until one
+ * whose sheet cannot be got ahead of turn, which is left at the
+ * start of the list.
+ *
+ * Return value: non-0 on failure
+ */
 static int
-raptor_grddl_fetch_uri(raptor_parser* rdf_parser, 
-                       raptor_uri* uri,
-                       raptor_www_write_bytes_handler write_bytes_handler,
-                       void* write_bytes_user_data,
-                       raptor_www_content_type_handler content_type_handler,
-                       void* content_type_user_data,
-                       int flags)
+raptor_grddl_run_transforms_pool(raptor_parser* rdf_parser, xmlDocPtr doc,
+                                 int threads)
 {
-  raptor_www *www;
-  const char *accept_h;
+  raptor_grddl_parser_context* grddl_parser;
+  raptor_grddl_pool pool;
+  pthread_t* workers;
+  int workers_count = 0;
+  int size;
   int ret = 0;
-  int ignore_errors = (flags & FETCH_IGNORE_ERRORS);
-  
-  if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_NO_NET)) {
-    if(!raptor_uri_uri_string_is_file_uri(raptor_uri_as_string(uri)))
-      return 1;
-  }
-  
-  www = raptor_new_www(rdf_parser->world);
-  if(!www)
+  int i;
+
+  grddl_parser = (raptor_grddl_parser_context*)rdf_parser->context;
+
+  size = raptor_sequence_size(grddl_parser->doc_transform_uris);
+
+  memset(&pool, '\0', sizeof(pool));
+  pool.world = rdf_parser->world;
+  pool.doc = doc;
+  pool.transforms = RAPTOR_CALLOC(raptor_grddl_transform*, size,
+                                  sizeof(raptor_grddl_transform));
+  if(!pool.transforms)
     return 1;
-  
-  raptor_www_set_user_agent(www, "grddl/0.1");
-  
-  if(flags & FETCH_ACCEPT_XSLT) {
-    raptor_www_set_http_accept(www, "application/xml");
-  } else {
-    accept_h = raptor_parser_get_accept_header(rdf_parser);
-    if(accept_h) {
-      raptor_www_set_http_accept(www, accept_h);
-      RAPTOR_FREE(char*, accept_h);
-    }
+
+  for(i = 0; i < size; i++) {
+    grddl_xml_context* xml_context;
+    xsltStylesheetPtr sheet;
+
+    xml_context = (grddl_xml_context*)raptor_sequence_get_at(grddl_parser->doc_transform_uris, i);
+    sheet = raptor_grddl_get_stylesheet_ahead(rdf_parser, xml_context->uri);
+    if(!sheet)
+      break;
+
+    pool.transforms[i].sheet = sheet;
   }
-  if(rdf_parser->uri_filter)
-    raptor_www_set_uri_filter(www, rdf_parser->uri_filter,
-                              rdf_parser->uri_filter_user_data);
-  if(ignore_errors)
-    raptor_world_internal_set_ignore_errors(rdf_parser->world, 1);
+  pool.transforms_count = i;
 
-  raptor_www_set_write_bytes_handler(www, write_bytes_handler,
-                                     write_bytes_user_data);
-  raptor_www_set_content_type_handler(www, content_type_handler,
-                                      content_type_user_data);
+  if(!pool.transforms_count) {
+    RAPTOR_FREE(raptor_grddl_transform*, pool.transforms);
+    return 0;
+  }
 
-  if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_WWW_TIMEOUT) > 0)
-    raptor_www_set_connection_timeout(www, 
-                                      RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_WWW_TIMEOUT));
+  for(i = 0; i < pool.transforms_count; i++)
+    pool.transforms[i].xml_context = (grddl_xml_context*)raptor_sequence_unshift(grddl_parser->doc_transform_uris);
 
-  ret = raptor_www_fetch(www, uri);
-  
-  raptor_free_www(www);
+  workers = RAPTOR_CALLOC(pthread_t*, threads, sizeof(pthread_t));
 
-  if(ignore_errors)
-    raptor_world_internal_set_ignore_errors(rdf_parser->world, 0);
+  pthread_key_create(&pool.current_key, NULL);
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.done_cond, NULL);
 
-  return ret;
-}
+  raptor_libxslt_set_global_state(rdf_parser);
+  /* libxslt messages without a transform context are kept with the
+   * transform being run by the thread */
+  xsltSetGenericErrorFunc(&pool, raptor_grddl_pool_error_handler);
+
+  /* if no workers can be started the transforms are run below */
+  if(workers) {
+    for(i = 0; i < threads && i < pool.transforms_count; i++) {
+      if(pthread_create(&workers[i], NULL, raptor_grddl_worker_run, &pool))
+        break;
+    }
+    workers_count = i;
+  }
 
+  for(i = 0; i < pool.transforms_count; i++) {
+    raptor_grddl_transform* transform = &pool.transforms[i];
+    raptor_locator *locator = &rdf_parser->locator;
+    raptor_uri* old_locator_uri;
+    int j;
+
+    pthread_mutex_lock(&pool.lock);
+    if(pool.next == i) {
+      /* not taken by a worker yet so run it here */
+      pool.next++;
+      pthread_mutex_unlock(&pool.lock);
+      raptor_grddl_pool_run_transform(&pool, transform);
+      pthread_mutex_lock(&pool.lock);
+    }
+    while(!transform->done)
+      pthread_cond_wait(&pool.done_cond, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
 
-/* Run a GRDDL transform using a XSLT stylesheet at a given URI */
-static int
-raptor_grddl_run_grddl_transform_uri(raptor_parser* rdf_parser,
-                                     grddl_xml_context* xml_context, 
-                                     xmlDocPtr doc)
-{
-  xmlParserCtxtPtr xslt_ctxt = NULL;
-  raptor_grddl_xml_parse_bytes_context xpbc;
-  int ret = 0;
-  raptor_uri* xslt_uri;
-  raptor_uri* base_uri;
-  raptor_uri* old_locator_uri;
-  raptor_locator *locator = &rdf_parser->locator;
+    old_locator_uri = locator->uri;
+    locator->uri = transform->xml_context->uri;
 
-  xslt_uri = xml_context->uri;
-  base_uri = xml_context->base_uri ? xml_context->base_uri : xml_context->uri;
+    if(transform->messages) {
+      for(j = 0; j < raptor_sequence_size(transform->messages); j++) {
+        const char* msg;
 
-  RAPTOR_DEBUG3("Running GRDDL transform with XSLT URI %s and base URI %s\n",
-                raptor_uri_as_string(xslt_uri),
-                raptor_uri_as_string(base_uri));
-  
-  /* make an xsltStylesheetPtr via the raptor_grddl_uri_xml_parse_bytes 
-   * callback as bytes are returned
-   */
-  xpbc.xc = NULL;
-  xpbc.rdf_parser = rdf_parser;
-  xpbc.base_uri = base_uri;
+        msg = (const char*)raptor_sequence_get_at(transform->messages, j);
+        raptor_parser_error(rdf_parser, "libxslt error: %s", msg);
+      }
+    }
 
-  old_locator_uri = locator->uri;
-  locator->uri = xslt_uri;
-  ret = raptor_grddl_fetch_uri(rdf_parser,
-                             xslt_uri,
-                             raptor_grddl_uri_xml_parse_bytes, &xpbc,
-                             NULL, NULL,
-                             FETCH_ACCEPT_XSLT);
-  xslt_ctxt = xpbc.xc;
-  if(ret) {
-    locator->uri = old_locator_uri;
-    raptor_parser_warning(rdf_parser, "Fetching XSLT document URI '%s' failed",
-                          raptor_uri_as_string(xslt_uri));
-    ret = 0;
-  } else {
-    xmlParseChunk(xpbc.xc, NULL, 0, 1);
-  
-    ret = raptor_grddl_run_grddl_transform_doc(rdf_parser,
-                                               xml_context,
-                                               xslt_ctxt->myDoc,
-                                               doc);
+    ret = raptor_grddl_parse_transform_result(rdf_parser, transform);
     locator->uri = old_locator_uri;
+
+    raptor_grddl_clear_transform_result(transform);
+
+    if(ret)
+      break;
   }
 
-  if(xslt_ctxt)
-    xmlFreeParserCtxt(xslt_ctxt); 
-  
+  if(ret) {
+    /* stop workers taking any more transforms */
+    pthread_mutex_lock(&pool.lock);
+    pool.next = pool.transforms_count;
+    pthread_mutex_unlock(&pool.lock);
+  }
+
+  for(i = 0; i < workers_count; i++)
+    pthread_join(workers[i], NULL);
+
+  raptor_libxslt_reset_global_state(rdf_parser);
+
+  pthread_cond_destroy(&pool.done_cond);
+  pthread_mutex_destroy(&pool.lock);
+  pthread_key_delete(pool.current_key);
+
+  if(workers)
+    RAPTOR_FREE(pthread_t*, workers);
+
+  for(i = 0; i < pool.transforms_count; i++) {
+    raptor_grddl_transform* transform = &pool.transforms[i];
+
+    raptor_grddl_clear_transform_result(transform);
+    raptor_grddl_cache_add_stylesheet(rdf_parser,
+                                      transform->xml_context->uri,
+                                      transform->sheet);
+    grddl_free_xml_context(rdf_parser->world, transform->xml_context);
+  }
+  RAPTOR_FREE(raptor_grddl_transform*, pool.transforms);
+
   return ret;
 }
+#endif
 
 
 static int
@@ -1182,6 +1978,7 @@ raptor_grddl_run_xpath_match(raptor_parser* rdf_parser,
 
         xml_context = raptor_new_xml_context(rdf_parser->world, uri, base_uri);
         raptor_sequence_push(seq, xml_context);
+        raptor_free_uri(uri);
       }
       RAPTOR_FREE(char*, buffer);
     } else if(flags & MATCH_IS_HARDCODED) {
@@ -1249,6 +2046,75 @@ raptor_grddl_check_recursive_content_type_handler(raptor_www* www,
 
 }
 
+/* Records the content of a profile or namespace document while it is
+ * fetched and parsed, for raptor_grddl_cache_add_document() */
+typedef struct
+{
+  raptor_parse_bytes_context* rpbc;
+  raptor_www_content_type_handler content_type_handler;
+  void* content_type_user_data;
+  /* base URI the document was parsed with */
+  raptor_uri* base_uri;
+  char* content_type;
+  /* content so far or NULL if it is too large to cache */
+  raptor_stringbuffer* content;
+} raptor_grddl_document_recorder;
+
+
+static void
+raptor_grddl_record_write_bytes(raptor_www* www,
+                                void *userdata,
+                                const void *ptr, size_t size, size_t nmemb)
+{
+  raptor_grddl_document_recorder* rec;
+  size_t len = size * nmemb;
+
+  rec = (raptor_grddl_document_recorder*)userdata;
+
+  if(rec->content) {
+    if(raptor_stringbuffer_length(rec->content) + len >
+         RAPTOR_GRDDL_DOCUMENT_CACHE_MAX_LENGTH ||
+       raptor_stringbuffer_append_counted_string(rec->content,
+                                                 (const unsigned char*)ptr,
+                                                 len, 1)) {
+      raptor_free_stringbuffer(rec->content);
+      rec->content = NULL;
+    }
+  }
+
+  raptor_parser_parse_uri_write_bytes(www, rec->rpbc, ptr, size, nmemb);
+
+  if(!rec->base_uri) {
+    raptor_uri* base_uri = rec->rpbc->final_uri;
+    rec->base_uri = raptor_uri_copy(base_uri ? base_uri : www->uri);
+  }
+}
+
+
+static void
+raptor_grddl_record_content_type(raptor_www* www,
+                                 void* userdata,
+                                 const char* content_type)
+{
+  raptor_grddl_document_recorder* rec;
+
+  rec = (raptor_grddl_document_recorder*)userdata;
+
+  if(content_type) {
+    size_t len = strlen(content_type);
+
+    if(rec->content_type)
+      RAPTOR_FREE(char*, rec->content_type);
+    rec->content_type = RAPTOR_MALLOC(char*, len + 1);
+    if(rec->content_type)
+      memcpy(rec->content_type, content_type, len + 1);
+  }
+
+  if(rec->content_type_handler)
+    rec->content_type_handler(www, rec->content_type_user_data, content_type);
+}
+
+
 #define RECURSIVE_FLAGS_IGNORE_ERRORS 1
 #define RECURSIVE_FLAGS_FILTER        2
 
@@ -1266,6 +2132,8 @@ raptor_grddl_run_recursive(raptor_parser* rdf_parser, raptor_uri* uri,
   int filter = (flags & RECURSIVE_FLAGS_FILTER) > 0;
   int fetch_uri_flags = 0;
   int is_grddl=!strcmp(parser_name, "grddl");
+  raptor_grddl_document_cache_entry* cached = NULL;
+  raptor_grddl_document_recorder rec;
   
   grddl_parser = (raptor_grddl_parser_context*)rdf_parser->context;
 
@@ -1291,18 +2159,70 @@ raptor_grddl_run_recursive(raptor_parser* rdf_parser, raptor_uri* uri,
   
   if(ignore_errors)
     fetch_uri_flags |=FETCH_IGNORE_ERRORS;
-  
-  if(raptor_grddl_fetch_uri(grddl_parser->internal_parser,
-                            uri,
-                            raptor_parser_parse_uri_write_bytes, &rpbc,
-                            content_type_handler, grddl_parser->internal_parser,
-                            fetch_uri_flags)) {
-    if(!ignore_errors)
-      raptor_parser_warning(rdf_parser,
-                            "Fetching GRDDL document URI '%s' failed\n",
-                            raptor_uri_as_string(uri));
-    ret = 0;
-    goto tidy;
+
+  /* Profile and namespace documents (filtered for transformations)
+   * are cached */
+  memset(&rec, 0, sizeof(rec));
+  if(filter)
+    cached = raptor_grddl_cache_get_document(grddl_parser->internal_parser,
+                                             uri);
+
+  if(cached) {
+    size_t len = raptor_stringbuffer_length(cached->content);
+
+    if(content_type_handler && cached->content_type)
+      content_type_handler(NULL, grddl_parser->internal_parser,
+                           cached->content_type);
+
+    if(len &&
+       !raptor_parser_parse_start(grddl_parser->internal_parser,
+                                  cached->base_uri))
+      raptor_parser_parse_chunk(grddl_parser->internal_parser,
+                                raptor_stringbuffer_as_string(cached->content),
+                                len, 0);
+  } else {
+    raptor_www_write_bytes_handler write_bytes_handler;
+    void* write_bytes_user_data;
+    raptor_www_content_type_handler fetch_content_type_handler;
+    void* content_type_user_data;
+
+    write_bytes_handler = raptor_parser_parse_uri_write_bytes;
+    write_bytes_user_data = &rpbc;
+    fetch_content_type_handler = content_type_handler;
+    content_type_user_data = grddl_parser->internal_parser;
+
+    if(filter) {
+      rec.rpbc = &rpbc;
+      rec.content_type_handler = content_type_handler;
+      rec.content_type_user_data = grddl_parser->internal_parser;
+      rec.content = raptor_new_stringbuffer();
+
+      write_bytes_handler = raptor_grddl_record_write_bytes;
+      write_bytes_user_data = &rec;
+      fetch_content_type_handler = raptor_grddl_record_content_type;
+      content_type_user_data = &rec;
+    }
+
+    if(raptor_grddl_fetch_uri(grddl_parser->internal_parser,
+                              uri,
+                              write_bytes_handler, write_bytes_user_data,
+                              fetch_content_type_handler,
+                              content_type_user_data,
+                              fetch_uri_flags)) {
+      if(!ignore_errors)
+        raptor_parser_warning(rdf_parser,
+                              "Fetching GRDDL document URI '%s' failed\n",
+                              raptor_uri_as_string(uri));
+      ret = 0;
+      goto tidy;
+    }
+
+    if(rec.content && rec.base_uri) {
+      raptor_grddl_cache_add_document(grddl_parser->internal_parser, uri,
+                                      rec.base_uri, rec.content_type,
+                                      rec.content);
+      rec.content = NULL;
+    }
   }
 
   if(ignore_errors)
@@ -1343,6 +2263,12 @@ raptor_grddl_run_recursive(raptor_parser* rdf_parser, raptor_uri* uri,
   }
 
  tidy:
+  if(rec.base_uri)
+    raptor_free_uri(rec.base_uri);
+  if(rec.content_type)
+    RAPTOR_FREE(char*, rec.content_type);
+  if(rec.content)
+    raptor_free_stringbuffer(rec.content);
 
   return ret;
 }
@@ -1372,6 +2298,9 @@ raptor_grddl_parse_chunk(raptor_parser* rdf_parser,
   size_t buffer_len = 0;
   int buffer_is_libxml = 0;
   int loop;
+#ifdef HAVE_PTHREAD
+  int threads;
+#endif
 
   if(!is_end && !rdf_parser->emitted_default_graph) {
     /* Cannot tell if we have a statement yet but must ensure that
@@ -1407,11 +2336,7 @@ raptor_grddl_parse_chunk(raptor_parser* rdf_parser,
   if(!is_end)
     return 0;
 
-  buffer_len = raptor_stringbuffer_length(grddl_parser->sb);
-  buffer = RAPTOR_MALLOC(unsigned char*, buffer_len + 1);
-  if(buffer)
-    raptor_stringbuffer_copy_to_string(grddl_parser->sb, 
-                                       buffer, buffer_len);
+  buffer = raptor_stringbuffer_as_string_steal(grddl_parser->sb, &buffer_len);
   
 
   uri_string = raptor_uri_as_string(rdf_parser->base_uri);
@@ -1856,9 +2781,22 @@ raptor_grddl_parse_chunk(raptor_parser* rdf_parser,
   
   /* Apply all transformation URIs seen */
   transform:
+#ifdef HAVE_PTHREAD
+  threads = RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_GRDDL_THREADS);
+#endif
   while(raptor_sequence_size(grddl_parser->doc_transform_uris)) {
     grddl_xml_context* xml_context;
 
+#ifdef HAVE_PTHREAD
+    if(threads > 1 &&
+       raptor_sequence_size(grddl_parser->doc_transform_uris) > 1) {
+      /* this stops at a transform that must be run in turn below */
+      ret = raptor_grddl_run_transforms_pool(rdf_parser, doc, threads);
+      if(ret || !raptor_sequence_size(grddl_parser->doc_transform_uris))
+        break;
+    }
+#endif
+
     xml_context = (grddl_xml_context*)raptor_sequence_unshift(grddl_parser->doc_transform_uris);
     ret = raptor_grddl_run_grddl_transform_uri(rdf_parser, xml_context, doc);
     grddl_free_xml_context(rdf_parser->world, xml_context);
@@ -2026,6 +2964,11 @@ raptor_init_parser_grddl_common(raptor_world* world)
     
     world->xslt_security_preferences = (void*)raptor_xslt_sec;
   }
+
+  /* Failing to allocate this only disables caching */
+  if(!world->grddl_cache)
+    world->grddl_cache = RAPTOR_CALLOC(raptor_grddl_cache*, 1,
+                                       sizeof(raptor_grddl_cache));
   
   return 0;
 }
@@ -2050,6 +2993,11 @@ raptor_terminate_parser_grddl_common(raptor_world *world)
     world->xslt_security_preferences = NULL;
   }
 
+  if(world->grddl_cache) {
+    raptor_free_grddl_cache((raptor_grddl_cache*)world->grddl_cache);
+    world->grddl_cache = NULL;
+  }
+
   xsltCleanupGlobals();
 }
 
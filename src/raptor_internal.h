@@ -409,6 +409,7 @@ void raptor_concepts_finish(raptor_world* world);
 
 /* raptor_iostream.c */
 raptor_world* raptor_iostream_get_world(raptor_iostream *iostr);
+const unsigned char* raptor_iostream_read_string_remaining(raptor_iostream *iostr, size_t max_length, size_t *length_p);
 
 
 /* Raptor Namespace Stack node */
@@ -416,8 +417,13 @@ struct raptor_namespace_stack_s {
   raptor_world* world;
   int size;
 
+  /* namespaces by prefix; power of 2 size, grown as namespaces are added */
   int table_size;
   raptor_namespace** table;
+  /* namespaces by URI, chained through uri_next; same size as table */
+  raptor_namespace** uri_table;
+  /* byte trie of namespace URIs for finding qnames; built on demand */
+  struct raptor_namespace_trie_s* trie;
   raptor_namespace* def_namespace;
 
   raptor_uri *rdf_ms_uri;
@@ -433,6 +439,8 @@ struct raptor_namespace_stack_s {
 struct raptor_namespace_s {
   /* next down the stack, NULL at bottom */
   struct raptor_namespace_s* next;
+  /* next in the stack's URI index bucket */
+  struct raptor_namespace_s* uri_next;
 
   raptor_namespace_stack *nstack;
 
@@ -468,6 +476,14 @@ raptor_namespace** raptor_namespace_stack_to_array(raptor_namespace_stack *nstac
 #define RAPTOR_READ_BUFFER_SIZE 4096
 #endif
 
+/* Default maximum size of buffer used when writing to a file or file
+ * handle iostream; see RAPTOR_WORLD_FLAG_IOSTREAM_WRITE_BUFFER_SIZE.
+ * 0 disables write buffering.
+ */
+#ifndef RAPTOR_IOSTREAM_WRITE_BUFFER_SIZE
+#define RAPTOR_IOSTREAM_WRITE_BUFFER_SIZE 32768
+#endif
+
 
 /*
  * Raptor parser object
@@ -592,6 +608,10 @@ struct raptor_parser_factory_s {
 
   /* get the locator (OPTIONAL) */
   raptor_locator* (*get_locator)(raptor_parser* rdf_parser);
+
+  /* non-0 if chunk() can be given a whole document at once that is
+   * not NUL terminated, such as a mapped file (OPTIONAL) */
+  int whole_document_chunk;
 };
 
 
@@ -665,6 +685,10 @@ struct raptor_serializer_factory_s {
 
   /* flush current serialization state */
   int (*serialize_flush)(raptor_serializer* serializer);
+
+  /* serialize an array of statements (optional; otherwise
+   * serialize_statement is called for each one) */
+  int (*serialize_statements)(raptor_serializer* serializer, raptor_statement *statements, int count);
 };
 
 
@@ -696,6 +720,8 @@ void raptor_stats_print(raptor_parser *rdf_parser, FILE *stream);
 #endif
 RAPTOR_INTERNAL_API const char* raptor_basename(const char *name);
 int raptor_term_print_as_ntriples(const raptor_term *term, FILE* stream);
+unsigned int raptor_term_hash(const raptor_term* term);
+void raptor_term_fingerprint(const raptor_term* term, unsigned int* h1_p, unsigned int* h2_p);
 
 /* raptor_ntriples.c */
 size_t raptor_ntriples_parse_term(raptor_world* world, raptor_locator* locator, unsigned char *string, size_t *len_p, raptor_term** term_p, int allow_turtle);
@@ -741,6 +767,8 @@ int raptor_parser_copy_user_state(raptor_parser *to_parser, raptor_parser *from_
 /* raptor_general.c */
 extern int raptor_valid_xml_ID(raptor_parser *rdf_parser, const unsigned char *string);
 int raptor_check_ordinal(const unsigned char *name);
+void raptor_hash_bytes(unsigned int* h1_p, unsigned int* h2_p, const unsigned char* p, size_t len);
+unsigned int raptor_hash_bytes_finish(unsigned int h2);
 
 /* raptor_locator.c */
 
@@ -777,6 +805,8 @@ void raptor_parser_start_namespace(raptor_parser* rdf_parser, raptor_namespace*
  */
 struct raptor_qname_s {
   raptor_world* world;
+  /* reference count */
+  int usage;
   /* Name - always present */
   const unsigned char *local_name;
   int local_name_length;
@@ -792,6 +822,7 @@ struct raptor_qname_s {
 
 
 /* raptor_qname.c */
+raptor_qname* raptor_qname_copy_with_value(raptor_qname* qname, const unsigned char* value);
 #ifdef RAPTOR_DEBUG
 void raptor_qname_print(FILE *stream, raptor_qname* name);
 #endif
@@ -1039,9 +1070,10 @@ void raptor_www_libfetch_free(raptor_www *www);
 int raptor_www_libfetch_fetch(raptor_www *www);
 
 /* raptor_set.c */
-RAPTOR_INTERNAL_API raptor_id_set* raptor_new_id_set(raptor_world* world);
+RAPTOR_INTERNAL_API raptor_id_set* raptor_new_id_set(raptor_world* world, int exact, size_t max_size);
 RAPTOR_INTERNAL_API void raptor_free_id_set(raptor_id_set* set);
 RAPTOR_INTERNAL_API int raptor_id_set_add(raptor_id_set* set, raptor_uri* base_uri, const unsigned char *item, size_t item_len);
+RAPTOR_INTERNAL_API int raptor_id_set_reached_limit(raptor_id_set* set, size_t* count_p);
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
 void raptor_id_set_stats_print(raptor_id_set* set, FILE *stream);
 #endif
@@ -1056,6 +1088,8 @@ struct raptor_xml_element_s {
   raptor_qname *name;
   raptor_qname **attributes;
   unsigned int attribute_count;
+  /* allocated size of attributes array */
+  unsigned int attributes_size;
 
   /* value of xml:lang attribute on this element or NULL */
   const unsigned char *xml_language;
@@ -1142,6 +1176,19 @@ struct raptor_sax2_s {
 
   void* uri_filter_user_data;
   raptor_uri_filter_func uri_filter;
+
+  /* free list of ended elements linked by parent for reuse */
+  raptor_xml_element *element_pool;
+
+  /* element and attribute names resolved with the current namespaces */
+  struct raptor_sax2_qname_cache_entry_s *qname_cache;
+  int qname_cache_count;
+  /* deepest namespace used by a cached name */
+  int qname_cache_depth;
+
+  /* copy of the attribute pointers passed to a start element */
+  const unsigned char **atts_copy;
+  size_t atts_copy_size;
 };
 
 int raptor_sax2_init(raptor_world* world);
@@ -1237,6 +1284,14 @@ typedef void (*raptor_simple_message_handler)(void *user_data, const char *messa
 RAPTOR_INTERNAL_API int raptor_stringbuffer_append_turtle_string(raptor_stringbuffer* stringbuffer, const unsigned char *text, size_t len, int delim, raptor_simple_message_handler error_handler, void *error_data, int is_uri);
 
 
+/* raptor_stringbuffer.c */
+void raptor_stringbuffer_clear(raptor_stringbuffer* stringbuffer);
+
+
+/* raptor_xml.c */
+RAPTOR_INTERNAL_API size_t raptor_xml_name_suffix_start(const unsigned char *string, size_t length, int xml_version);
+
+
 /* raptor_abbrev.c */
 
 typedef struct {
@@ -1246,8 +1301,19 @@ typedef struct {
   int count_as_object;   /* count of this blank/resource node as object */
   
   raptor_term* term;
+
+  int in_arena;          /* non-0 if owned by a raptor_abbrev_nodes table */
 } raptor_abbrev_node;
 
+/* table of unique nodes */
+typedef struct raptor_abbrev_nodes_s raptor_abbrev_nodes;
+
+/* predicate/object pair of a subject */
+typedef struct {
+  raptor_abbrev_node* predicate;
+  raptor_abbrev_node* object;
+} raptor_abbrev_po;
+
 #ifdef RAPTOR_DEBUG
 #define RAPTOR_DEBUG_ABBREV_NODE(label, node) \
   do {                                                       \
@@ -1266,9 +1332,14 @@ typedef struct {
   raptor_abbrev_node* node;      /* node representing the subject of
                                   * this resource */
   raptor_abbrev_node* node_type; /* the rdf:type of this resource */
-  raptor_avltree *properties;    /* list of properties
+  raptor_abbrev_po *properties;  /* vector of properties
                                   * (predicate/object pair) of this
-                                  * subject */
+                                  * subject; call
+                                  * raptor_abbrev_subject_sort_properties()
+                                  * before walking it */
+  int properties_count;
+  int properties_size;
+  int properties_sorted;         /* non-0 if sorted with no duplicates */
   raptor_sequence *list_items;   /* list of container elements if
                                   * is rdf container */
   int valid;                     /* set 0 for blank nodes that do not
@@ -1280,13 +1351,17 @@ raptor_abbrev_node* raptor_new_abbrev_node(raptor_world* world, raptor_term* ter
 void raptor_free_abbrev_node(raptor_abbrev_node* node);
 int raptor_abbrev_node_compare(raptor_abbrev_node* node1, raptor_abbrev_node* node2);
 int raptor_abbrev_node_equals(raptor_abbrev_node* node1, raptor_abbrev_node* node2);
-raptor_abbrev_node* raptor_abbrev_node_lookup(raptor_avltree* nodes, raptor_term* term);
+raptor_abbrev_nodes* raptor_new_abbrev_nodes(raptor_world* world);
+void raptor_free_abbrev_nodes(raptor_abbrev_nodes* nodes);
+raptor_abbrev_node* raptor_abbrev_node_find(raptor_abbrev_nodes* nodes, raptor_term* term);
+raptor_abbrev_node* raptor_abbrev_node_lookup(raptor_abbrev_nodes* nodes, raptor_term* term);
 
 void raptor_free_abbrev_subject(raptor_abbrev_subject* subject);
 int raptor_abbrev_subject_add_property(raptor_abbrev_subject* subject, raptor_abbrev_node* predicate, raptor_abbrev_node* object);
+int raptor_abbrev_subject_sort_properties(raptor_abbrev_subject* subject);
 int raptor_abbrev_subject_compare(raptor_abbrev_subject* subject1, raptor_abbrev_subject* subject2);
 raptor_abbrev_subject* raptor_abbrev_subject_find(raptor_avltree *subjects, raptor_term* node);
-raptor_abbrev_subject* raptor_abbrev_subject_lookup(raptor_avltree* nodes, raptor_avltree* subjects, raptor_avltree* blanks, raptor_term* term);
+raptor_abbrev_subject* raptor_abbrev_subject_lookup(raptor_abbrev_nodes* nodes, raptor_avltree* subjects, raptor_avltree* blanks, raptor_term* term);
 int raptor_abbrev_subject_valid(raptor_abbrev_subject *subject);
 int raptor_abbrev_subject_invalidate(raptor_abbrev_subject *subject);
 
@@ -1370,6 +1445,7 @@ int raptor_json_writer_key_uri_value(raptor_json_writer* json_writer, const char
 
 /* raptor_memstr.c */
 const char* raptor_memstr(const char *haystack, size_t haystack_len, const char *needle);
+size_t raptor_memspn_ascii(const unsigned char *string, size_t len, const char *specials);
 
 /* raptor_serialize_rdfxmla.c special functions for embedding rdf/xml */
 int raptor_rdfxmla_serialize_set_write_rdf_RDF(raptor_serializer* serializer, int value);
@@ -1377,6 +1453,16 @@ int raptor_rdfxmla_serialize_set_xml_writer(raptor_serializer* serializer, rapto
 int raptor_rdfxmla_serialize_set_single_node(raptor_serializer* serializer, raptor_uri* uri);
 int raptor_rdfxmla_serialize_set_write_typed_nodes(raptor_serializer* serializer, int value);
 
+/* raptor_spool.c */
+typedef struct raptor_spool_s raptor_spool;
+
+RAPTOR_INTERNAL_API raptor_spool* raptor_new_spool(raptor_world* world, size_t memory_limit);
+RAPTOR_INTERNAL_API void raptor_free_spool(raptor_spool* spool);
+RAPTOR_INTERNAL_API int raptor_spool_add(raptor_spool* spool, const unsigned char* record, size_t length);
+RAPTOR_INTERNAL_API int raptor_spool_finish(raptor_spool* spool);
+RAPTOR_INTERNAL_API int raptor_spool_rewind(raptor_spool* spool);
+RAPTOR_INTERNAL_API const unsigned char* raptor_spool_next(raptor_spool* spool, size_t* length_p);
+
 /* snprintf.c */
 size_t raptor_format_integer(char* buffer, size_t bufsize, int integer, unsigned int base, int width, char padding);
 
@@ -1439,6 +1525,10 @@ struct raptor_world_s {
    */
   int xslt_security_preferences_policy;
 
+  /* GRDDL parser cache of compiled XSLT sheets and fetched profile
+   * documents shared by all parsers of this world */
+  void* grddl_cache;
+
   /* Flags for libxml set by raptor_world_set_libxml_flags().
    * See #raptor_libxml_flags for meanings 
    */
@@ -1464,6 +1554,9 @@ struct raptor_world_s {
   /* should */
   int uri_interning;
 
+  /* size of iostream write buffers in bytes; 0 for none */
+  int iostream_write_buffer_size;
+
   /* generate blank node ID policy */
   void *generate_bnodeid_handler_user_data;
   raptor_generate_bnodeid_handler generate_bnodeid_handler;
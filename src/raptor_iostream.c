@@ -53,13 +53,100 @@ struct raptor_iostream_s
   size_t offset;
   unsigned int mode;
   int flags;
+
+  /* write buffer - only for the built-in file sinks; allocated on
+   * first use and grown up to buffer_size */
+  unsigned char *buffer;
+  size_t buffer_size;
+  size_t buffer_alloc;
+  size_t buffer_len;
 };
 
 
+/* Initial allocation for a write buffer */
+#define RAPTOR_IOSTREAM_WRITE_BUFFER_MIN_SIZE 256
+
+
 
 /* prototypes for local functions */
 
 
+/*
+ * raptor_iostream_init_write_buffer:
+ * @iostr: iostream
+ *
+ * INTERNAL - Enable the write buffer for a built-in file write iostream
+ *
+ * Nothing is allocated until the first write so that short-lived
+ * iostreams writing a few bytes stay cheap.
+ */
+static void
+raptor_iostream_init_write_buffer(raptor_iostream *iostr)
+{
+  iostr->buffer_size = RAPTOR_BAD_CAST(size_t, iostr->world->iostream_write_buffer_size);
+}
+
+
+/*
+ * raptor_iostream_grow_write_buffer:
+ * @iostr: iostream
+ * @len: number of bytes needed in the buffer
+ *
+ * INTERNAL - Grow the write buffer geometrically to hold @len bytes
+ *
+ * @len must not be more than the buffer_size limit.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_iostream_grow_write_buffer(raptor_iostream *iostr, size_t len)
+{
+  size_t new_alloc;
+  unsigned char *new_buffer;
+
+  if(len <= iostr->buffer_alloc)
+    return 0;
+
+  new_alloc = iostr->buffer_alloc ? iostr->buffer_alloc : RAPTOR_IOSTREAM_WRITE_BUFFER_MIN_SIZE;
+  while(new_alloc < len)
+    new_alloc <<= 1;
+  if(new_alloc > iostr->buffer_size)
+    new_alloc = iostr->buffer_size;
+
+  new_buffer = RAPTOR_REALLOC(unsigned char*, iostr->buffer, new_alloc);
+  if(!new_buffer)
+    return 1;
+
+  iostr->buffer = new_buffer;
+  iostr->buffer_alloc = new_alloc;
+
+  return 0;
+}
+
+
+/*
+ * raptor_iostream_flush_write_buffer:
+ * @iostr: iostream
+ *
+ * INTERNAL - Pass any buffered bytes to the handler write_bytes method
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_iostream_flush_write_buffer(raptor_iostream *iostr)
+{
+  size_t len = iostr->buffer_len;
+  int nobj;
+
+  if(!len)
+    return 0;
+
+  iostr->buffer_len = 0;
+  nobj = iostr->handler->write_bytes(iostr->user_data, iostr->buffer, 1, len);
+  return (RAPTOR_BAD_CAST(size_t, nobj) != len);
+}
+
+
 static int
 raptor_iostream_calculate_modes(const raptor_iostream_handler * const handler)
 {
@@ -305,6 +392,8 @@ raptor_new_iostream_to_filename(raptor_world *world, const char *filename)
   iostr->user_data = (void*)handle;
   iostr->mode = mode;
 
+  raptor_iostream_init_write_buffer(iostr);
+
   if(iostr->handler->init && 
      iostr->handler->init(iostr->user_data)) {
     raptor_free_iostream(iostr);
@@ -336,6 +425,9 @@ static const raptor_iostream_handler raptor_iostream_write_file_handler = {
  * The @handle must already be open for writing.
  * NOTE: This does not fclose the @handle when it is finished.
  *
+ * Writes are buffered and only reach @handle when the buffer fills,
+ * on raptor_iostream_write_end() or when the iostream is freed.
+ *
  * Return value: new #raptor_iostream object or NULL on failure
  **/
 raptor_iostream*
@@ -365,8 +457,10 @@ raptor_new_iostream_to_file_handle(raptor_world *world, FILE *handle)
   iostr->user_data = (void*)handle;
   iostr->mode = mode;
 
+  raptor_iostream_init_write_buffer(iostr);
+
   if(iostr->handler->init && iostr->handler->init(iostr->user_data)) {
-    RAPTOR_FREE(raptor_iostream, iostr);
+    raptor_free_iostream(iostr);
     return NULL;
   }
   return iostr;
@@ -375,13 +469,22 @@ raptor_new_iostream_to_file_handle(raptor_world *world, FILE *handle)
 
 
 struct raptor_write_string_iostream_context {
-  raptor_stringbuffer *sb;
+  /* contiguous output buffer; always has room for a final NUL */
+  unsigned char *string;
+  /* bytes written */
+  size_t length;
+  /* bytes allocated */
+  size_t size;
   void *(*malloc_handler)(size_t size);
   void **string_p;
   size_t *length_p;
 };
 
 
+/* Initial allocation for a string iostream output buffer */
+#define RAPTOR_WRITE_STRING_IOSTREAM_MIN_SIZE 1024
+
+
 /* Local handlers for writing to a string */
 
 static void
@@ -389,40 +492,93 @@ raptor_write_string_iostream_finish(void *user_data)
 {
   struct raptor_write_string_iostream_context* con;
   size_t len;
-  void *str = NULL;
+  unsigned char *str = NULL;
 
   con = (struct raptor_write_string_iostream_context*)user_data;
-  len = raptor_stringbuffer_length(con->sb);
+  len = con->length;
 
   *con->string_p = NULL;
   if(con->length_p)
     *con->length_p = len;
-  
-  str = (void*)con->malloc_handler(len+1);
+
+  if(con->malloc_handler == raptor_alloc_memory && con->string) {
+    /* Same allocator: hand over the buffer, giving back any slack */
+    str = con->string;
+    con->string = NULL;
+    if(con->size > len + 1) {
+      unsigned char *shrunk = RAPTOR_REALLOC(unsigned char*, str, len + 1);
+      if(shrunk)
+        str = shrunk;
+    }
+  } else {
+    str = (unsigned char*)con->malloc_handler(len + 1);
+    if(str && len)
+      memcpy(str, con->string, len);
+  }
+
   if(str) {
-    if(len)
-      raptor_stringbuffer_copy_to_string(con->sb, (unsigned char*)str, len+1);
-    else
-      *(char*)str='\0';
+    str[len] = '\0';
     *con->string_p = str;
   }
 
   if(!str && con->length_p)
     *con->length_p = 0;
   
-  raptor_free_stringbuffer(con->sb);
+  if(con->string)
+    RAPTOR_FREE(char*, con->string);
   RAPTOR_FREE(raptor_write_string_iostream_context, con);
   return;
 }
 
+
+/*
+ * raptor_write_string_iostream_ensure:
+ * @con: string iostream context
+ * @len: number of bytes about to be appended
+ *
+ * INTERNAL - Grow the string buffer geometrically to fit @len more bytes
+ * plus a final NUL
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_write_string_iostream_ensure(struct raptor_write_string_iostream_context* con,
+                                    size_t len)
+{
+  size_t new_size;
+  unsigned char *new_string;
+
+  if(con->length + len < con->size)
+    return 0;
+
+  new_size = con->size ? con->size : RAPTOR_WRITE_STRING_IOSTREAM_MIN_SIZE;
+  while(new_size <= con->length + len) {
+    if(new_size > ((size_t)-1) / 2)
+      return 1;
+    new_size <<= 1;
+  }
+
+  new_string = RAPTOR_REALLOC(unsigned char*, con->string, new_size);
+  if(!new_string)
+    return 1;
+
+  con->string = new_string;
+  con->size = new_size;
+  return 0;
+}
+
+
 static int
 raptor_write_string_iostream_write_byte(void *user_data, const int byte)
 {
   struct raptor_write_string_iostream_context* con;
-  unsigned char buf = (unsigned char)byte;
 
   con = (struct raptor_write_string_iostream_context*)user_data;
-  return raptor_stringbuffer_append_counted_string(con->sb, &buf, 1, 1);
+  if(raptor_write_string_iostream_ensure(con, 1))
+    return 1;
+
+  con->string[con->length++] = RAPTOR_GOOD_CAST(unsigned char, byte);
+  return 0;
 }
 
 
@@ -431,12 +587,15 @@ raptor_write_string_iostream_write_bytes(void *user_data, const void *ptr,
                                          size_t size, size_t nmemb)
 {
   struct raptor_write_string_iostream_context* con;
+  size_t len = size * nmemb;
 
   con = (struct raptor_write_string_iostream_context*)user_data;
-  if(raptor_stringbuffer_append_counted_string(con->sb,
-                                               (const unsigned char*)ptr, size * nmemb, 1))
+  if(raptor_write_string_iostream_ensure(con, len))
     return 0; /* failure */
-  return RAPTOR_BAD_CAST(int, size * nmemb); /* success */
+
+  memcpy(con->string + con->length, ptr, len);
+  con->length += len;
+  return RAPTOR_BAD_CAST(int, nmemb); /* success */
 }
 
 static const raptor_iostream_handler raptor_iostream_write_string_handler = {
@@ -499,13 +658,6 @@ raptor_new_iostream_to_string(raptor_world *world,
     return NULL;
   }
 
-  con->sb = raptor_new_stringbuffer();
-  if(!con->sb) {
-    RAPTOR_FREE(raptor_iostream, iostr);
-    RAPTOR_FREE(raptor_write_string_iostream_context, con);
-    return NULL;
-  }
-
   con->string_p = string_p;
   *string_p = NULL;
 
@@ -694,12 +846,18 @@ raptor_free_iostream(raptor_iostream *iostr)
   if(iostr->flags & RAPTOR_IOSTREAM_FLAGS_EOF)
     raptor_iostream_write_end(iostr);
 
+  if(iostr->buffer && !(iostr->flags & RAPTOR_IOSTREAM_FLAGS_EOF))
+    raptor_iostream_flush_write_buffer(iostr);
+
   if(iostr->handler->finish)
     iostr->handler->finish(iostr->user_data);
 
   if((iostr->flags & RAPTOR_IOSTREAM_FLAGS_FREE_HANDLER))
     RAPTOR_FREE(raptor_iostream_handler, iostr->handler);
 
+  if(iostr->buffer)
+    RAPTOR_FREE(char*, iostr->buffer);
+
   RAPTOR_FREE(raptor_iostream, iostr);
 }
 
@@ -721,6 +879,17 @@ raptor_iostream_write_byte(const int byte, raptor_iostream *iostr)
 
   if(iostr->flags & RAPTOR_IOSTREAM_FLAGS_EOF)
     return 1;
+
+  if(iostr->buffer_size) {
+    if(iostr->buffer_len == iostr->buffer_size &&
+       raptor_iostream_flush_write_buffer(iostr))
+      return 1;
+    if(raptor_iostream_grow_write_buffer(iostr, iostr->buffer_len + 1))
+      return 1;
+    iostr->buffer[iostr->buffer_len++] = RAPTOR_GOOD_CAST(unsigned char, byte);
+    return 0;
+  }
+
   if(!iostr->handler->write_byte)
     return 1;
   if(!(iostr->mode & RAPTOR_IOSTREAM_MODE_WRITE))
@@ -753,6 +922,34 @@ raptor_iostream_write_bytes(const void *ptr, size_t size, size_t nmemb,
   if(!(iostr->mode & RAPTOR_IOSTREAM_MODE_WRITE))
     return -1;
 
+  if(iostr->buffer_size) {
+    size_t len = size * nmemb;
+
+    if(len <= iostr->buffer_size - iostr->buffer_len) {
+      if(raptor_iostream_grow_write_buffer(iostr, iostr->buffer_len + len))
+        return -1;
+      memcpy(iostr->buffer + iostr->buffer_len, ptr, len);
+      iostr->buffer_len += len;
+      iostr->offset += len;
+      return RAPTOR_BAD_CAST(int, nmemb);
+    }
+
+    if(raptor_iostream_flush_write_buffer(iostr))
+      return -1;
+
+    /* fits into the now empty buffer */
+    if(len < iostr->buffer_size) {
+      if(raptor_iostream_grow_write_buffer(iostr, len))
+        return -1;
+      memcpy(iostr->buffer, ptr, len);
+      iostr->buffer_len = len;
+      iostr->offset += len;
+      return RAPTOR_BAD_CAST(int, nmemb);
+    }
+
+    /* else too large to be worth buffering: write it through */
+  }
+
   nobj = iostr->handler->write_bytes(iostr->user_data, ptr, size, nmemb);
   if(nobj > 0)
     iostr->offset += (size * nobj);
@@ -832,14 +1029,38 @@ raptor_iostream_write_end(raptor_iostream *iostr)
   
   if(iostr->flags & RAPTOR_IOSTREAM_FLAGS_EOF)
     return 1;
-  if(iostr->handler->write_end)
-    rc = iostr->handler->write_end(iostr->user_data);
+  if(iostr->buffer)
+    rc = raptor_iostream_flush_write_buffer(iostr);
+  if(iostr->handler->write_end && iostr->handler->write_end(iostr->user_data))
+    rc = 1;
   iostr->flags |= RAPTOR_IOSTREAM_FLAGS_EOF;
 
   return rc;
 }
 
 
+/**
+ * raptor_iostream_flush:
+ * @iostr: raptor iostream
+ *
+ * Write any buffered bytes to the iostream sink.
+ *
+ * Iostreams writing to a file or file handle buffer their output;
+ * this passes it on without ending writing.  It does not call
+ * fflush() on a file handle.
+ *
+ * Return value: non-0 on failure
+ **/
+int
+raptor_iostream_flush(raptor_iostream *iostr)
+{
+  if(!iostr->buffer)
+    return 0;
+
+  return raptor_iostream_flush_write_buffer(iostr);
+}
+
+
 /**
  * raptor_stringbuffer_write:
  * @sb: #raptor_stringbuffer to write
@@ -1133,6 +1354,45 @@ raptor_new_iostream_from_string(raptor_world *world,
 }
 
 
+/*
+ * raptor_iostream_read_string_remaining:
+ * @iostr: raptor read iostream
+ * @max_length: largest length of data to take
+ * @length_p: pointer to store length of the data
+ *
+ * INTERNAL - Take the unread data of an iostream reading from a string
+ *
+ * The data is consumed as if read so the iostream is then at EOF.
+ *
+ * Return value: pointer into the string or NULL if @iostr does not
+ * read from a string, is at EOF or has more than @max_length left
+ */
+const unsigned char*
+raptor_iostream_read_string_remaining(raptor_iostream *iostr,
+                                      size_t max_length, size_t *length_p)
+{
+  struct raptor_read_string_iostream_context* con;
+  const unsigned char* data;
+
+  if(iostr->handler != &raptor_iostream_read_string_handler ||
+     (iostr->flags & RAPTOR_IOSTREAM_FLAGS_EOF))
+    return NULL;
+
+  con = (struct raptor_read_string_iostream_context*)iostr->user_data;
+  if(con->offset >= con->length || con->length - con->offset > max_length)
+    return NULL;
+
+  data = (const unsigned char*)con->string + con->offset;
+  *length_p = con->length - con->offset;
+
+  iostr->offset += *length_p;
+  con->offset = con->length;
+  iostr->flags |= RAPTOR_IOSTREAM_FLAGS_EOF;
+
+  return data;
+}
+
+
 /**
  * raptor_iostream_tell:
  * @iostr: raptor iostream
@@ -1169,6 +1429,7 @@ int main(int argc, char *argv[]);
 static const char *program;
 
 #define READ_BUFFER_SIZE 256
+#define TEST_BLOCK_LEN 1000
 
 
 static int
@@ -1359,6 +1620,198 @@ test_write_to_sink(raptor_world *world,
 }
 
 
+static int
+test_write_flush(raptor_world *world, FILE* handle,
+                 const char* test_string, size_t test_string_len)
+{
+  raptor_iostream *iostr = NULL;
+  long offset;
+  int rc = 0;
+  const char* const label="flush iostream to file handle";
+
+#if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
+  fprintf(stderr, "%s: Testing %s\n", program, label);
+#endif
+
+  iostr = raptor_new_iostream_to_file_handle(world, handle);
+  if(!iostr) {
+    fprintf(stderr, "%s: Failed to create %s\n", program, label);
+    rc = 1;
+    goto tidy;
+  }
+
+  raptor_iostream_write_bytes(test_string, 1, test_string_len, iostr);
+  raptor_iostream_write_byte('\n', iostr);
+
+  if(raptor_iostream_flush(iostr)) {
+    fprintf(stderr, "%s: %s returned failure\n", program, label);
+    rc = 1;
+    goto tidy;
+  }
+
+  /* the bytes must have reached the handle before write_end or free */
+  offset = ftell(handle);
+  if(offset != RAPTOR_BAD_CAST(long, test_string_len + 1)) {
+    fprintf(stderr, "%s: %s passed %ld bytes to the handle, expected %d\n",
+            program, label, offset, (int)test_string_len + 1);
+    rc = 1;
+  }
+
+  tidy:
+  if(iostr)
+    raptor_free_iostream(iostr);
+
+  if(rc)
+    fprintf(stderr, "%s: FAILED Testing %s\n", program, label);
+
+  return rc;
+}
+
+
+/* mix byte and block writes so that both cross buffer boundaries */
+static void
+test_write_mixed(raptor_iostream *iostr, size_t len)
+{
+  size_t i;
+
+  for(i = 0; i < len; ) {
+    unsigned char block[TEST_BLOCK_LEN];
+    size_t j;
+
+    if(i % 3) {
+      raptor_iostream_write_byte('a' + (int)(i % 26), iostr);
+      i++;
+      continue;
+    }
+
+    for(j = 0; j < TEST_BLOCK_LEN && i + j < len; j++)
+      block[j] = RAPTOR_GOOD_CAST(unsigned char, 'a' + ((i + j) % 26));
+    raptor_iostream_write_bytes(block, 1, j, iostr);
+    i += j;
+  }
+}
+
+
+static int
+test_check_mixed(const char* label, const unsigned char *string,
+                 size_t string_len, size_t expected_len)
+{
+  size_t i;
+
+  if(!string || string_len != expected_len) {
+    fprintf(stderr, "%s: %s created a string length %d, expected %d\n",
+            program, label, (int)string_len, (int)expected_len);
+    return 1;
+  }
+
+  for(i = 0; i < expected_len; i++) {
+    if(string[i] != 'a' + (i % 26)) {
+      fprintf(stderr, "%s: %s returned byte '%c' at offset %d, expected '%c'\n",
+              program, label, string[i], (int)i, (char)('a' + (i % 26)));
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+static int
+test_write_to_string_mixed(raptor_world *world, size_t expected_len,
+                           raptor_data_malloc_handler const malloc_handler)
+{
+  raptor_iostream *iostr = NULL;
+  int rc = 0;
+  unsigned char *string = NULL;
+  size_t string_len = 0;
+  const char* const label="write bytes and blocks to a string iostream";
+
+#if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
+  fprintf(stderr, "%s: Testing %s\n", program, label);
+#endif
+
+  iostr = raptor_new_iostream_to_string(world, (void**)&string, &string_len,
+                                        malloc_handler);
+  if(!iostr) {
+    fprintf(stderr, "%s: Failed to create %s\n", program, label);
+    rc = 1;
+    goto tidy;
+  }
+
+  test_write_mixed(iostr, expected_len);
+
+  raptor_free_iostream(iostr); iostr = NULL;
+
+  rc = test_check_mixed(label, string, string_len, expected_len);
+
+  tidy:
+  if(string)
+    raptor_free_memory(string);
+  if(iostr)
+    raptor_free_iostream(iostr);
+
+  if(rc)
+    fprintf(stderr, "%s: FAILED Testing %s\n", program, label);
+
+  return rc;
+}
+
+
+static int
+test_write_to_file_handle_buffered(raptor_world *world, const char* filename,
+                                   size_t expected_len)
+{
+  raptor_iostream *iostr = NULL;
+  FILE *handle = NULL;
+  int rc = 0;
+  unsigned char *string = NULL;
+  size_t string_len = 0;
+  const char* const label="write iostream to a file handle through the buffer";
+
+#if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
+  fprintf(stderr, "%s: Testing %s\n", program, label);
+#endif
+
+  handle = fopen(filename, "wb");
+  if(handle)
+    iostr = raptor_new_iostream_to_file_handle(world, handle);
+  if(!iostr) {
+    fprintf(stderr, "%s: Failed to create %s\n", program, label);
+    rc = 1;
+    goto tidy;
+  }
+
+  test_write_mixed(iostr, expected_len);
+
+  raptor_free_iostream(iostr); iostr = NULL;
+  fclose(handle);
+
+  handle = fopen(filename, "rb");
+  string = (unsigned char*)malloc(expected_len + 1);
+  if(!handle || !string) {
+    fprintf(stderr, "%s: Failed to read back %s\n", program, filename);
+    rc = 1;
+    goto tidy;
+  }
+  string_len = fread(string, 1, expected_len + 1, handle);
+
+  rc = test_check_mixed(label, string, string_len, expected_len);
+
+  tidy:
+  if(iostr)
+    raptor_free_iostream(iostr);
+  if(handle)
+    fclose(handle);
+  if(string)
+    free(string);
+
+  if(rc)
+    fprintf(stderr, "%s: FAILED Testing %s\n", program, label);
+
+  return rc;
+}
+
+
 static int
 test_read_from_filename(raptor_world *world,
                         const char* filename, 
@@ -1588,6 +2041,7 @@ int
 main(int argc, char *argv[]) 
 {
   raptor_world *world;
+  raptor_world *small_world;
   FILE *handle = NULL;
   int failures = 0;
   
@@ -1612,6 +2066,17 @@ main(int argc, char *argv[])
     fclose(handle);
     remove(OUT_FILENAME);
   }
+
+  handle = fopen((const char*)OUT_FILENAME, "wb");
+  if(!handle) {
+    fprintf(stderr, "%s: Failed to create write file handle to file %s\n",
+            program, OUT_FILENAME);
+    failures++;
+  } else {
+    failures+= test_write_flush(world, handle, TEST_STRING, TEST_STRING_LEN);
+    fclose(handle);
+    remove(OUT_FILENAME);
+  }
   
   failures+= test_write_to_string(world,
                                   TEST_STRING,
@@ -1619,6 +2084,25 @@ main(int argc, char *argv[])
   failures+= test_write_to_sink(world,
                                 TEST_STRING,
                                 TEST_STRING_LEN, (int)OUT_BYTES_COUNT);
+  failures+= test_write_to_string_mixed(world, 5000, NULL);
+  failures+= test_write_to_string_mixed(world, 5000, malloc);
+  failures+= test_write_to_file_handle_buffered(world, OUT_FILENAME,
+                                                3 * RAPTOR_IOSTREAM_WRITE_BUFFER_SIZE + 17);
+
+  /* a write buffer smaller than the blocks written */
+  small_world = raptor_new_world();
+  if(!small_world ||
+     raptor_world_set_flag(small_world,
+                           RAPTOR_WORLD_FLAG_IOSTREAM_WRITE_BUFFER_SIZE, 7) ||
+     raptor_world_open(small_world)) {
+    fprintf(stderr, "%s: Failed to create world with a small write buffer\n",
+            program);
+    failures++;
+  } else
+    failures+= test_write_to_file_handle_buffered(small_world, OUT_FILENAME,
+                                                  5000);
+  if(small_world)
+    raptor_free_world(small_world);
 
   remove(OUT_FILENAME);
 
@@ -40,7 +40,13 @@
 #include <stdlib.h>
 #endif
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef HAVE_YAJL
 #include <yajl/yajl_parse.h>
+#endif
 
 /* Raptor includes */
 #include "raptor2.h"
@@ -76,22 +82,54 @@ typedef enum {
 } raptor_json_term_attrib;
 
 
+#ifdef HAVE_YAJL
 /* When YAJL V1 support is dropped, this can be removed */
 #ifdef HAVE_YAJL2
 #define RAPTOR_YAJL_LEN_TYPE size_t
 #else
 #define RAPTOR_YAJL_LEN_TYPE unsigned int
 #endif
+#endif
+
+
+/*
+ * A counted string from the JSON text.  It is either a view into the
+ * document being parsed (@copy is NULL) or an owned copy of it.
+ */
+typedef struct {
+  const unsigned char* string;
+  size_t length;
+  unsigned char* copy;
+} raptor_json_counted_string;
+
+
+/* One bit per byte of a block of JSON text */
+typedef unsigned long raptor_json_bits;
+
+/* Bytes of JSON text classified together */
+#define RAPTOR_JSON_BLOCK_SIZE (sizeof(raptor_json_bits) * 8)
+
+/* Bytes of JSON text indexed at a time */
+#define RAPTOR_JSON_INDEX_WINDOW (64 * RAPTOR_JSON_BLOCK_SIZE)
+
+/* Deepest nesting of maps and arrays the built-in tokenizer allows */
+#define RAPTOR_JSON_MAX_DEPTH 128
+
 
 /*
  * JSON parser object
  */
 struct raptor_json_parser_context_s {
+#ifdef HAVE_YAJL
 #ifdef HAVE_YAJL2
 #else
   yajl_parser_config config;
 #endif
   yajl_handle handle;
+#endif
+
+  /* non-0 if the document is arriving in several chunks */
+  int streaming;
 
   /* Parser state */
   raptor_json_parse_state state;
@@ -100,36 +138,56 @@ struct raptor_json_parser_context_s {
 
   /* Temporary storage, while creating terms */
   raptor_term_type term_type;
-  unsigned char*   term_value;
-  unsigned char*   term_datatype;
-  unsigned char*   term_lang;
+  raptor_json_counted_string term_value;
+  raptor_json_counted_string term_datatype;
+  raptor_json_counted_string term_lang;
 
   /* Temporary storage, while creating statements */
   raptor_statement statement;
+
+  /* Built-in tokenizer: structural positions of the current window */
+  size_t* index;
+
+  /* Built-in tokenizer: strings with escapes decoded */
+  unsigned char* unescaped;
+  size_t unescaped_size;
+
+#ifndef HAVE_YAJL
+  /* Chunks collected until the end of a streamed document */
+  unsigned char* buffer;
+  size_t buffer_len;
+  size_t buffer_size;
+#endif
 };
 
 typedef struct raptor_json_parser_context_s raptor_json_parser_context;
 
 
+static void
+raptor_json_counted_string_clear(raptor_json_counted_string* cs)
+{
+  if(cs->copy)
+    RAPTOR_FREE(char*, cs->copy);
+
+  cs->string = NULL;
+  cs->length = 0;
+  cs->copy = NULL;
+}
+
+
 static void
 raptor_json_reset_term(raptor_json_parser_context *context)
 {
-  if(context->term_value)
-    RAPTOR_FREE(char*, context->term_value);
-  if(context->term_lang)
-    RAPTOR_FREE(char*, context->term_lang);
-  if(context->term_datatype)
-    RAPTOR_FREE(char*, context->term_datatype);
+  raptor_json_counted_string_clear(&context->term_value);
+  raptor_json_counted_string_clear(&context->term_lang);
+  raptor_json_counted_string_clear(&context->term_datatype);
 
-  context->term_value = NULL;
-  context->term_lang = NULL;
-  context->term_datatype = NULL;
   context->term_type = RAPTOR_TERM_TYPE_UNKNOWN;
   context->attrib = RAPTOR_JSON_ATTRIB_UNKNOWN;
 }
 
 static unsigned char*
-raptor_json_cstring_from_counted_string(raptor_parser *rdf_parser, const unsigned char* str, RAPTOR_YAJL_LEN_TYPE len)
+raptor_json_cstring_from_counted_string(raptor_parser *rdf_parser, const unsigned char* str, size_t len)
 {
   unsigned char *cstr = RAPTOR_MALLOC(unsigned char*, len + 1);
   if(!cstr) {
@@ -143,6 +201,38 @@ raptor_json_cstring_from_counted_string(raptor_parser *rdf_parser, const unsigne
   return cstr;
 }
 
+
+/*
+ * raptor_json_counted_string_set:
+ * @rdf_parser: parser
+ * @cs: counted string to set
+ * @str: string
+ * @len: length of @str
+ * @copy: non-0 to copy @str; otherwise it must live until the term is built
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_json_counted_string_set(raptor_parser *rdf_parser,
+                               raptor_json_counted_string* cs,
+                               const unsigned char* str, size_t len,
+                               int copy)
+{
+  raptor_json_counted_string_clear(cs);
+
+  if(copy) {
+    cs->copy = raptor_json_cstring_from_counted_string(rdf_parser, str, len);
+    if(!cs->copy)
+      return 1;
+    str = cs->copy;
+  }
+
+  cs->string = str;
+  cs->length = len;
+
+  return 0;
+}
+
 static raptor_term*
 raptor_json_new_term_from_counted_string(raptor_parser *rdf_parser, const unsigned char* str, size_t len)
 {
@@ -155,9 +245,8 @@ raptor_json_new_term_from_counted_string(raptor_parser *rdf_parser, const unsign
   } else {
     raptor_uri *uri = raptor_new_uri_from_counted_string(rdf_parser->world, str, len);
     if(!uri) {
-      unsigned char* cstr = raptor_json_cstring_from_counted_string(rdf_parser, str, RAPTOR_BAD_CAST(int, len));
-      raptor_parser_error(rdf_parser, "Could not create uri from '%s'", cstr);
-      RAPTOR_FREE(char*, cstr);
+      raptor_parser_error(rdf_parser, "Could not create uri from '%.*s'",
+                          RAPTOR_BAD_CAST(int, len), (const char*)str);
       return NULL;
     }
 
@@ -173,18 +262,23 @@ static raptor_term*
 raptor_json_generate_term(raptor_parser *rdf_parser)
 {
   raptor_json_parser_context *context = (raptor_json_parser_context*)rdf_parser->context;
+  raptor_json_counted_string *value = &context->term_value;
   raptor_term *term = NULL;
 
-  if(!context->term_value) {
+  if(!value->string) {
     raptor_parser_error(rdf_parser, "No value for term defined");
     return NULL;
   }
 
   switch(context->term_type) {
     case RAPTOR_TERM_TYPE_URI: {
-      raptor_uri *uri = raptor_new_uri(rdf_parser->world, context->term_value);
+      raptor_uri *uri = raptor_new_uri_from_counted_string(rdf_parser->world,
+                                                           value->string,
+                                                           value->length);
       if(!uri) {
-        raptor_parser_error(rdf_parser, "Could not create uri from '%s'", context->term_value);
+        raptor_parser_error(rdf_parser, "Could not create uri from '%.*s'",
+                            RAPTOR_BAD_CAST(int, value->length),
+                            (const char*)value->string);
         return NULL;
       }
       term = raptor_new_term_from_uri(rdf_parser->world, uri);
@@ -193,20 +287,31 @@ raptor_json_generate_term(raptor_parser *rdf_parser)
     }
     case RAPTOR_TERM_TYPE_LITERAL: {
       raptor_uri *datatype_uri = NULL;
-      if(context->term_datatype) {
-        datatype_uri = raptor_new_uri(rdf_parser->world, context->term_datatype);
+      if(context->term_datatype.string) {
+        datatype_uri = raptor_new_uri_from_counted_string(rdf_parser->world,
+                                                          context->term_datatype.string,
+                                                          context->term_datatype.length);
       }
-      term = raptor_new_term_from_literal(rdf_parser->world, context->term_value, datatype_uri, context->term_lang);
+      term = raptor_new_term_from_counted_literal(rdf_parser->world,
+                                                  value->string,
+                                                  value->length,
+                                                  datatype_uri,
+                                                  context->term_lang.string,
+                                                  RAPTOR_BAD_CAST(unsigned char, context->term_lang.length));
       if(datatype_uri)
         raptor_free_uri(datatype_uri);
       break;
     }
     case RAPTOR_TERM_TYPE_BLANK: {
-      unsigned char *node_id = context->term_value;
-      if(strlen((const char*)node_id) > 2 && node_id[0] == '_' && node_id[1] == ':') {
-          node_id = &node_id[2];
+      const unsigned char *node_id = value->string;
+      size_t node_id_len = value->length;
+      if(node_id_len > 2 && node_id[0] == '_' && node_id[1] == ':') {
+          node_id += 2;
+          node_id_len -= 2;
       }
-      term = raptor_new_term_from_blank(rdf_parser->world, node_id);
+      term = raptor_new_term_from_counted_blank(rdf_parser->world,
+                                                node_id_len ? node_id : NULL,
+                                                node_id_len);
       break;
     }
     case RAPTOR_TERM_TYPE_UNKNOWN:
@@ -218,44 +323,47 @@ raptor_json_generate_term(raptor_parser *rdf_parser)
 }
 
 
-static int raptor_json_yajl_null(void * ctx)
+static int raptor_json_null(raptor_parser* rdf_parser)
 {
-  raptor_parser* rdf_parser = (raptor_parser*)ctx;
   raptor_parser_error(rdf_parser, "Nulls are not valid in RDF/JSON");
   return 0;
 }
 
-static int raptor_json_yajl_boolean(void * ctx, int b)
+static int raptor_json_boolean(raptor_parser* rdf_parser, int b)
 {
-  raptor_parser* rdf_parser = (raptor_parser*)ctx;
   raptor_parser_error(rdf_parser, "Booleans are not valid in RDF/JSON");
   return 0;
 }
 
-#ifdef HAVE_YAJL2
-#define YAJL_INTEGER_CALLBACK_ARG_TYPE long long
-#else
-#define YAJL_INTEGER_CALLBACK_ARG_TYPE long
-#endif
-static int raptor_json_yajl_integer(void * ctx,
-                                    YAJL_INTEGER_CALLBACK_ARG_TYPE integerVal)
+static int raptor_json_integer(raptor_parser* rdf_parser)
 {
-  raptor_parser* rdf_parser = (raptor_parser*)ctx;
   raptor_parser_error(rdf_parser, "Integers are not valid in RDF/JSON");
   return 0;
 }
 
-static int raptor_json_yajl_double(void * ctx, double d)
+static int raptor_json_double(raptor_parser* rdf_parser)
 {
-  raptor_parser* rdf_parser = (raptor_parser*)ctx;
   raptor_parser_error(rdf_parser, "Floats are not valid in RDF/JSON");
   return 0;
 }
 
-static int raptor_json_yajl_string(void * ctx, const unsigned char * str,
-                                   RAPTOR_YAJL_LEN_TYPE len)
+/* Is the counted string @str of length @len equal to the C string @name */
+#define RAPTOR_JSON_KEY_IS(str, len, name) \
+  ((len) == sizeof(name) - 1 && !memcmp((str), (name), (len)))
+
+/*
+ * raptor_json_string:
+ * @rdf_parser: parser
+ * @str: string value
+ * @len: length of @str
+ * @copy: non-0 if @str does not last until the end of the enclosing map
+ *
+ * Return value: 0 to stop parsing
+ */
+static int raptor_json_string(raptor_parser* rdf_parser,
+                              const unsigned char * str, size_t len,
+                              int copy)
 {
-  raptor_parser* rdf_parser = (raptor_parser*)ctx;
   raptor_json_parser_context *context;
   context = (raptor_json_parser_context*)rdf_parser->context;
 
@@ -263,27 +371,33 @@ static int raptor_json_yajl_string(void * ctx, const unsigned char * str,
       context->state == RAPTOR_JSON_STATE_RESOURCES_OBJECT) {
     switch(context->attrib) {
       case RAPTOR_JSON_ATTRIB_VALUE:
-        context->term_value = raptor_json_cstring_from_counted_string(rdf_parser, str, len);
+        if(raptor_json_counted_string_set(rdf_parser, &context->term_value,
+                                          str, len, copy))
+          return 0;
       break;
       case RAPTOR_JSON_ATTRIB_LANG:
-        context->term_lang = raptor_json_cstring_from_counted_string(rdf_parser, str, len);
+        /* always copied: the literal constructor wants it NUL terminated */
+        if(raptor_json_counted_string_set(rdf_parser, &context->term_lang,
+                                          str, len, 1))
+          return 0;
       break;
       case RAPTOR_JSON_ATTRIB_TYPE:
-        if(!strncmp((const char*)str, "uri", len)) {
+        if(RAPTOR_JSON_KEY_IS(str, len, "uri")) {
           context->term_type = RAPTOR_TERM_TYPE_URI;
-        } else if(!strncmp((const char*)str, "literal", len)) {
+        } else if(RAPTOR_JSON_KEY_IS(str, len, "literal")) {
           context->term_type = RAPTOR_TERM_TYPE_LITERAL;
-        } else if(!strncmp((const char*)str, "bnode", len)) {
+        } else if(RAPTOR_JSON_KEY_IS(str, len, "bnode")) {
           context->term_type = RAPTOR_TERM_TYPE_BLANK;
         } else {
-          unsigned char * cstr = raptor_json_cstring_from_counted_string(rdf_parser, str, len);
           context->term_type = RAPTOR_TERM_TYPE_UNKNOWN;
-          raptor_parser_error(rdf_parser, "Unknown term type: %s", cstr);
-          RAPTOR_FREE(char*, cstr);
+          raptor_parser_error(rdf_parser, "Unknown term type: %.*s",
+                              RAPTOR_BAD_CAST(int, len), (const char*)str);
         }
       break;
       case RAPTOR_JSON_ATTRIB_DATATYPE:
-        context->term_datatype = raptor_json_cstring_from_counted_string(rdf_parser, str, len);
+        if(raptor_json_counted_string_set(rdf_parser, &context->term_datatype,
+                                          str, len, copy))
+          return 0;
       break;
       case RAPTOR_JSON_ATTRIB_UNKNOWN:
       default:
@@ -297,15 +411,14 @@ static int raptor_json_yajl_string(void * ctx, const unsigned char * str,
   return 1;
 }
 
-static int raptor_json_yajl_map_key(void * ctx, const unsigned char * str,
-                                    RAPTOR_YAJL_LEN_TYPE len)
+static int raptor_json_map_key(raptor_parser* rdf_parser,
+                               const unsigned char * str, size_t len)
 {
-  raptor_parser* rdf_parser = (raptor_parser*)ctx;
   raptor_json_parser_context *context;
   context = (raptor_json_parser_context*)rdf_parser->context;
 
   if(context->state == RAPTOR_JSON_STATE_MAP_ROOT) {
-    if(!strncmp((const char*)str, "triples", len)) {
+    if(RAPTOR_JSON_KEY_IS(str, len, "triples")) {
       context->state = RAPTOR_JSON_STATE_TRIPLES_KEY;
       return 1;
     } else {
@@ -325,13 +438,13 @@ static int raptor_json_yajl_map_key(void * ctx, const unsigned char * str,
       return 0;
     return 1;
   } else if(context->state == RAPTOR_JSON_STATE_TRIPLES_TRIPLE) {
-    if(!strncmp((const char*)str, "subject", len)) {
+    if(RAPTOR_JSON_KEY_IS(str, len, "subject")) {
       context->term = RAPTOR_JSON_TERM_SUBJECT;
       return 1;
-    } else if(!strncmp((const char*)str, "predicate", len)) {
+    } else if(RAPTOR_JSON_KEY_IS(str, len, "predicate")) {
       context->term = RAPTOR_JSON_TERM_PREDICATE;
       return 1;
-    } else if(!strncmp((const char*)str, "object", len)) {
+    } else if(RAPTOR_JSON_KEY_IS(str, len, "object")) {
       context->term = RAPTOR_JSON_TERM_OBJECT;
       return 1;
     } else {
@@ -340,16 +453,16 @@ static int raptor_json_yajl_map_key(void * ctx, const unsigned char * str,
     }
   } else if(context->state == RAPTOR_JSON_STATE_TRIPLES_TERM ||
              context->state == RAPTOR_JSON_STATE_RESOURCES_OBJECT) {
-    if(!strncmp((const char*)str, "value", len)) {
+    if(RAPTOR_JSON_KEY_IS(str, len, "value")) {
       context->attrib = RAPTOR_JSON_ATTRIB_VALUE;
       return 1;
-    } else if(!strncmp((const char*)str, "type", len)) {
+    } else if(RAPTOR_JSON_KEY_IS(str, len, "type")) {
       context->attrib = RAPTOR_JSON_ATTRIB_TYPE;
       return 1;
-    } else if(!strncmp((const char*)str, "datatype", len)) {
+    } else if(RAPTOR_JSON_KEY_IS(str, len, "datatype")) {
       context->attrib = RAPTOR_JSON_ATTRIB_DATATYPE;
       return 1;
-    } else if(!strncmp((const char*)str, "lang", len)) {
+    } else if(RAPTOR_JSON_KEY_IS(str, len, "lang")) {
       context->attrib = RAPTOR_JSON_ATTRIB_LANG;
       return 1;
     } else {
@@ -363,9 +476,8 @@ static int raptor_json_yajl_map_key(void * ctx, const unsigned char * str,
   }
 }
 
-static int raptor_json_yajl_start_map(void * ctx)
+static int raptor_json_start_map(raptor_parser* rdf_parser)
 {
-  raptor_parser* rdf_parser = (raptor_parser*)ctx;
   raptor_json_parser_context *context;
   context = (raptor_json_parser_context*)rdf_parser->context;
 
@@ -394,9 +506,8 @@ static int raptor_json_yajl_start_map(void * ctx)
 }
 
 
-static int raptor_json_yajl_end_map(void * ctx)
+static int raptor_json_end_map(raptor_parser* rdf_parser)
 {
-  raptor_parser* rdf_parser = (raptor_parser*)ctx;
   raptor_json_parser_context *context;
   context = (raptor_json_parser_context*)rdf_parser->context;
 
@@ -477,9 +588,8 @@ static int raptor_json_yajl_end_map(void * ctx)
   }
 }
 
-static int raptor_json_yajl_start_array(void * ctx)
+static int raptor_json_start_array(raptor_parser* rdf_parser)
 {
-  raptor_parser* rdf_parser = (raptor_parser*)ctx;
   raptor_json_parser_context *context;
   context = (raptor_json_parser_context*)rdf_parser->context;
 
@@ -495,9 +605,8 @@ static int raptor_json_yajl_start_array(void * ctx)
   }
 }
 
-static int raptor_json_yajl_end_array(void * ctx)
+static int raptor_json_end_array(raptor_parser* rdf_parser)
 {
-  raptor_parser* rdf_parser = (raptor_parser*)ctx;
   raptor_json_parser_context *context;
   context = (raptor_json_parser_context*)rdf_parser->context;
 
@@ -514,6 +623,67 @@ static int raptor_json_yajl_end_array(void * ctx)
 }
 
 
+#ifdef HAVE_YAJL
+static int raptor_json_yajl_null(void * ctx)
+{
+  return raptor_json_null((raptor_parser*)ctx);
+}
+
+static int raptor_json_yajl_boolean(void * ctx, int b)
+{
+  return raptor_json_boolean((raptor_parser*)ctx, b);
+}
+
+#ifdef HAVE_YAJL2
+#define YAJL_INTEGER_CALLBACK_ARG_TYPE long long
+#else
+#define YAJL_INTEGER_CALLBACK_ARG_TYPE long
+#endif
+static int raptor_json_yajl_integer(void * ctx,
+                                    YAJL_INTEGER_CALLBACK_ARG_TYPE integerVal)
+{
+  return raptor_json_integer((raptor_parser*)ctx);
+}
+
+static int raptor_json_yajl_double(void * ctx, double d)
+{
+  return raptor_json_double((raptor_parser*)ctx);
+}
+
+static int raptor_json_yajl_string(void * ctx, const unsigned char * str,
+                                   RAPTOR_YAJL_LEN_TYPE len)
+{
+  /* YAJL may reuse the string's buffer before the term is built */
+  return raptor_json_string((raptor_parser*)ctx, str, len, 1);
+}
+
+static int raptor_json_yajl_map_key(void * ctx, const unsigned char * str,
+                                    RAPTOR_YAJL_LEN_TYPE len)
+{
+  return raptor_json_map_key((raptor_parser*)ctx, str, len);
+}
+
+static int raptor_json_yajl_start_map(void * ctx)
+{
+  return raptor_json_start_map((raptor_parser*)ctx);
+}
+
+static int raptor_json_yajl_end_map(void * ctx)
+{
+  return raptor_json_end_map((raptor_parser*)ctx);
+}
+
+static int raptor_json_yajl_start_array(void * ctx)
+{
+  return raptor_json_start_array((raptor_parser*)ctx);
+}
+
+static int raptor_json_yajl_end_array(void * ctx)
+{
+  return raptor_json_end_array((raptor_parser*)ctx);
+}
+
+
 static void*
 raptor_json_yajl_malloc(void *ctx, RAPTOR_YAJL_LEN_TYPE sz)
 {
@@ -552,6 +722,762 @@ static yajl_callbacks raptor_json_yajl_callbacks = {
   raptor_json_yajl_start_array,
   raptor_json_yajl_end_array
 };
+#endif /* HAVE_YAJL */
+
+
+/*
+ * Built-in tokenizer
+ *
+ * This works on a whole document in memory in two stages, in the
+ * manner of simdjson.  Stage 1 classifies blocks of
+ * RAPTOR_JSON_BLOCK_SIZE bytes into bitmasks, with SSE2 compares
+ * where available, and from them finds the structural positions
+ * outside strings: the operators {}[]:, and the first byte of every
+ * string, literal, number or comment.  Stage 2 walks those positions
+ * checking the JSON syntax and calls the same handlers as YAJL does.
+ * Strings are handed over as views into the document unless they
+ * contain escapes, which are decoded only then.
+ *
+ * Comments are allowed as YAJL is configured to allow them; stage 1
+ * is restarted after each one since it may contain quotes.
+ */
+
+typedef enum {
+  RAPTOR_JSON_EXPECT_VALUE,
+  RAPTOR_JSON_EXPECT_VALUE_OR_CLOSE,
+  RAPTOR_JSON_EXPECT_KEY,
+  RAPTOR_JSON_EXPECT_KEY_OR_CLOSE,
+  RAPTOR_JSON_EXPECT_COLON,
+  RAPTOR_JSON_EXPECT_COMMA_OR_CLOSE,
+  RAPTOR_JSON_EXPECT_END
+} raptor_json_expect;
+
+typedef struct {
+  raptor_parser* rdf_parser;
+
+  /* document */
+  const unsigned char* doc;
+  size_t len;
+
+  /* structural positions of the current window and the next one */
+  size_t* index;
+  size_t index_count;
+  size_t index_next;
+
+  /* offset in document where indexing continues */
+  size_t indexed_to;
+
+  /* carried between blocks: next byte is escaped, inside a string
+   * (all bits) and last byte was inside a literal or number */
+  raptor_json_bits escaped_carry;
+  raptor_json_bits in_string_carry;
+  raptor_json_bits scalar_carry;
+} raptor_json_tokenizer;
+
+
+/* A raptor_json_bits with every byte set to @b */
+#define RAPTOR_JSON_BITS_REPEAT(b) (((raptor_json_bits)-1 / 0xFF) * (raptor_json_bits)(b))
+
+/* Index of lowest bit set in non-0 @x */
+#ifdef __GNUC__
+#define RAPTOR_JSON_CTZ(x) RAPTOR_GOOD_CAST(unsigned int, __builtin_ctzl(x))
+#else
+static unsigned int
+raptor_json_ctz(raptor_json_bits x)
+{
+  unsigned int n = 0;
+
+  while(!(x & 1)) {
+    x >>= 1;
+    n++;
+  }
+  return n;
+}
+#define RAPTOR_JSON_CTZ(x) raptor_json_ctz(x)
+#endif
+
+/* Is byte @c one that ends a literal or number */
+#define RAPTOR_JSON_IS_DELIMITER(c) ((c) && strchr("{}[]:,\" \t\n\r", (c)))
+
+
+/*
+ * raptor_json_classify_block:
+ * @block: RAPTOR_JSON_BLOCK_SIZE bytes of JSON text
+ * @quote: bits set for '"'
+ * @backslash: bits set for '\'
+ * @op: bits set for the operators {}[]:,
+ * @ws: bits set for JSON whitespace
+ */
+static void
+raptor_json_classify_block(const unsigned char* block,
+                           raptor_json_bits* quote,
+                           raptor_json_bits* backslash,
+                           raptor_json_bits* op, raptor_json_bits* ws)
+{
+  unsigned int i;
+#ifdef __SSE2__
+  const __m128i quote_v = _mm_set1_epi8('"');
+  const __m128i backslash_v = _mm_set1_epi8('\\');
+  const __m128i fold_v = _mm_set1_epi8(0x20);
+  const __m128i open_v = _mm_set1_epi8('{');
+  const __m128i close_v = _mm_set1_epi8('}');
+  const __m128i colon_v = _mm_set1_epi8(':');
+  const __m128i comma_v = _mm_set1_epi8(',');
+  const __m128i space_v = _mm_set1_epi8(' ');
+  const __m128i tab_v = _mm_set1_epi8('\t');
+  const __m128i lf_v = _mm_set1_epi8('\n');
+  const __m128i cr_v = _mm_set1_epi8('\r');
+
+  *quote = *backslash = *op = *ws = 0;
+
+  for(i = 0; i < RAPTOR_JSON_BLOCK_SIZE; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(block + i));
+    /* setting 0x20 turns [ and ] into { and } */
+    __m128i folded = _mm_or_si128(v, fold_v);
+    __m128i o = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, open_v),
+                                          _mm_cmpeq_epi8(folded, close_v)),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, colon_v),
+                                          _mm_cmpeq_epi8(v, comma_v)));
+    __m128i w = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space_v),
+                                          _mm_cmpeq_epi8(v, tab_v)),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, lf_v),
+                                          _mm_cmpeq_epi8(v, cr_v)));
+
+    *quote |= (raptor_json_bits)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote_v)) << i;
+    *backslash |= (raptor_json_bits)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash_v)) << i;
+    *op |= (raptor_json_bits)(unsigned int)_mm_movemask_epi8(o) << i;
+    *ws |= (raptor_json_bits)(unsigned int)_mm_movemask_epi8(w) << i;
+  }
+#else
+  *quote = *backslash = *op = *ws = 0;
+
+  for(i = 0; i < RAPTOR_JSON_BLOCK_SIZE; i++) {
+    raptor_json_bits bit = (raptor_json_bits)1 << i;
+
+    switch(block[i]) {
+      case '"':
+        *quote |= bit;
+        break;
+      case '\\':
+        *backslash |= bit;
+        break;
+      case '{': case '}': case '[': case ']': case ':': case ',':
+        *op |= bit;
+        break;
+      case ' ': case '\t': case '\n': case '\r':
+        *ws |= bit;
+        break;
+      default:
+        break;
+    }
+  }
+#endif
+}
+
+
+/*
+ * raptor_json_index_window:
+ * @tok: tokenizer
+ *
+ * Stage 1: fill the index with the structural positions of the next
+ * RAPTOR_JSON_INDEX_WINDOW bytes of the document.
+ */
+static void
+raptor_json_index_window(raptor_json_tokenizer* tok)
+{
+  const raptor_json_bits odd_bits = RAPTOR_JSON_BITS_REPEAT(0xAA);
+  unsigned char padded[RAPTOR_JSON_BLOCK_SIZE];
+  size_t pos = tok->indexed_to;
+  size_t stop = pos + RAPTOR_JSON_INDEX_WINDOW;
+
+  if(stop > tok->len)
+    stop = tok->len;
+
+  tok->index_count = 0;
+  tok->index_next = 0;
+
+  for(; pos < stop; pos += RAPTOR_JSON_BLOCK_SIZE) {
+    const unsigned char* block = tok->doc + pos;
+    raptor_json_bits quote, backslash, op, ws;
+    raptor_json_bits escaped, in_string, scalar, follows_scalar;
+    raptor_json_bits structurals;
+    unsigned int shift;
+
+    if(tok->len - pos < RAPTOR_JSON_BLOCK_SIZE) {
+      /* pad the last block with whitespace */
+      memset(padded, ' ', sizeof(padded));
+      memcpy(padded, block, tok->len - pos);
+      block = padded;
+    }
+
+    raptor_json_classify_block(block, &quote, &backslash, &op, &ws);
+
+    /* bytes after an odd length run of backslashes are escaped */
+    if(backslash) {
+      raptor_json_bits start = backslash & ~tok->escaped_carry;
+      raptor_json_bits code = (((start << 1) | odd_bits) - start) ^ odd_bits;
+
+      escaped = code ^ (backslash | tok->escaped_carry);
+      tok->escaped_carry = (code & backslash) >> (RAPTOR_JSON_BLOCK_SIZE - 1);
+    } else {
+      escaped = tok->escaped_carry;
+      tok->escaped_carry = 0;
+    }
+    quote &= ~escaped;
+
+    /* prefix XOR of the quotes: set from an opening quote up to but
+     * not including the closing one */
+    in_string = quote;
+    for(shift = 1; shift < RAPTOR_JSON_BLOCK_SIZE; shift <<= 1)
+      in_string ^= in_string << shift;
+    in_string ^= tok->in_string_carry;
+    tok->in_string_carry = (raptor_json_bits)0 - (in_string >> (RAPTOR_JSON_BLOCK_SIZE - 1));
+
+    /* operators and the first byte of any other token, except inside
+     * strings or at their closing quote */
+    scalar = ~(op | ws);
+    follows_scalar = ((scalar & ~quote) << 1) | tok->scalar_carry;
+    tok->scalar_carry = (scalar & ~quote) >> (RAPTOR_JSON_BLOCK_SIZE - 1);
+    structurals = (op | (scalar & ~follows_scalar)) & ~(in_string ^ quote);
+
+    while(structurals) {
+      tok->index[tok->index_count++] = pos + RAPTOR_JSON_CTZ(structurals);
+      structurals &= structurals - 1;
+    }
+  }
+
+  tok->indexed_to = stop;
+}
+
+
+/*
+ * raptor_json_next_structural:
+ * @tok: tokenizer
+ * @pos_p: pointer to store offset of next structural position
+ *
+ * Return value: 0 at the end of the document
+ */
+static int
+raptor_json_next_structural(raptor_json_tokenizer* tok, size_t* pos_p)
+{
+  while(tok->index_next == tok->index_count) {
+    if(tok->indexed_to >= tok->len)
+      return 0;
+    raptor_json_index_window(tok);
+  }
+
+  *pos_p = tok->index[tok->index_next++];
+  return 1;
+}
+
+
+/* Restart stage 1 at @pos, which must be outside any token */
+static void
+raptor_json_reindex_from(raptor_json_tokenizer* tok, size_t pos)
+{
+  tok->indexed_to = pos;
+  tok->index_count = 0;
+  tok->index_next = 0;
+  tok->escaped_carry = 0;
+  tok->in_string_carry = 0;
+  tok->scalar_carry = 0;
+}
+
+
+static void
+raptor_json_syntax_error(raptor_json_tokenizer* tok, size_t pos,
+                         const char* message)
+{
+  raptor_parser_error(tok->rdf_parser, "JSON syntax error at byte %lu - %s",
+                      RAPTOR_BAD_CAST(unsigned long, pos), message);
+}
+
+
+/*
+ * raptor_json_string_end:
+ * @tok: tokenizer
+ * @pos: offset of opening quote
+ * @has_escape_p: pointer to flag set if the string contains escapes
+ *
+ * Return value: offset of the closing quote or 0 if there is none
+ */
+static size_t
+raptor_json_string_end(raptor_json_tokenizer* tok, size_t pos,
+                       int* has_escape_p)
+{
+  const unsigned char* start = tok->doc + pos + 1;
+  const unsigned char* end = tok->doc + tok->len;
+  const unsigned char* p = start;
+
+  *has_escape_p = 0;
+
+  while(p < end) {
+    const unsigned char* q;
+    const unsigned char* b;
+
+    q = (const unsigned char*)memchr(p, '"', RAPTOR_GOOD_CAST(size_t, end - p));
+    if(!q)
+      break;
+
+    for(b = q; b > start && b[-1] == '\\'; b--)
+      ;
+    if(!((q - b) & 1)) {
+      if(!*has_escape_p)
+        *has_escape_p = (memchr(start, '\\', RAPTOR_GOOD_CAST(size_t, q - start)) != NULL);
+      return RAPTOR_GOOD_CAST(size_t, q - tok->doc);
+    }
+
+    /* escaped quote */
+    *has_escape_p = 1;
+    p = q + 1;
+  }
+
+  return 0;
+}
+
+
+static int
+raptor_json_hex4(const unsigned char* p, const unsigned char* end,
+                 raptor_unichar* c_p)
+{
+  raptor_unichar c = 0;
+  int i;
+
+  if(end - p < 4)
+    return 1;
+
+  for(i = 0; i < 4; i++) {
+    int d = p[i];
+
+    if(d >= '0' && d <= '9')
+      d -= '0';
+    else if(d >= 'a' && d <= 'f')
+      d = d - 'a' + 10;
+    else if(d >= 'A' && d <= 'F')
+      d = d - 'A' + 10;
+    else
+      return 1;
+
+    c = (c << 4) | RAPTOR_GOOD_CAST(raptor_unichar, d);
+  }
+
+  *c_p = c;
+  return 0;
+}
+
+
+/*
+ * raptor_json_unescape:
+ * @tok: tokenizer
+ * @str: string content between the quotes
+ * @len: length of @str
+ * @len_p: pointer to store length of decoded string
+ *
+ * Decode the escapes in a string into the parser's unescaped buffer.
+ * Lone UTF-16 surrogates become '?' as with YAJL.
+ *
+ * Return value: <0 on memory failure, >0 on a bad escape, 0 on success
+ */
+static int
+raptor_json_unescape(raptor_json_tokenizer* tok,
+                     const unsigned char* str, size_t len, size_t* len_p)
+{
+  raptor_json_parser_context *context;
+  const unsigned char* end = str + len;
+  unsigned char* out;
+
+  context = (raptor_json_parser_context*)tok->rdf_parser->context;
+
+  /* decoding never makes a string longer */
+  if(len + 1 > context->unescaped_size) {
+    unsigned char* buffer = RAPTOR_MALLOC(unsigned char*, len + 1);
+    if(!buffer) {
+      raptor_parser_fatal_error(tok->rdf_parser, "Out of memory");
+      return -1;
+    }
+    if(context->unescaped)
+      RAPTOR_FREE(char*, context->unescaped);
+    context->unescaped = buffer;
+    context->unescaped_size = len + 1;
+  }
+  out = context->unescaped;
+
+  while(str < end) {
+    const unsigned char* backslash;
+    size_t plain_len;
+    raptor_unichar c;
+
+    backslash = (const unsigned char*)memchr(str, '\\', RAPTOR_GOOD_CAST(size_t, end - str));
+    plain_len = RAPTOR_GOOD_CAST(size_t, (backslash ? backslash : end) - str);
+    memcpy(out, str, plain_len);
+    out += plain_len;
+    str += plain_len;
+
+    if(!backslash)
+      break;
+
+    if(++str == end)
+      return 1;
+
+    switch(*str++) {
+      case '"':  *out++ = '"'; break;
+      case '\\': *out++ = '\\'; break;
+      case '/':  *out++ = '/'; break;
+      case 'b':  *out++ = '\b'; break;
+      case 'f':  *out++ = '\f'; break;
+      case 'n':  *out++ = '\n'; break;
+      case 'r':  *out++ = '\r'; break;
+      case 't':  *out++ = '\t'; break;
+
+      case 'u':
+        if(raptor_json_hex4(str, end, &c))
+          return 1;
+        str += 4;
+
+        if((c & 0xFC00) == 0xD800) {
+          raptor_unichar low;
+
+          if(end - str >= 6 && str[0] == '\\' && str[1] == 'u' &&
+             !raptor_json_hex4(str + 2, end, &low) &&
+             (low & 0xFC00) == 0xDC00) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+            str += 6;
+          } else
+            c = '?';
+        } else if((c & 0xFC00) == 0xDC00)
+          c = '?';
+
+        /* at least 6 escape bytes were read for at most 4 written */
+        out += raptor_unicode_utf8_string_put_char(c, out, 4);
+        break;
+
+      default:
+        return 1;
+    }
+  }
+
+  *len_p = RAPTOR_GOOD_CAST(size_t, out - context->unescaped);
+  return 0;
+}
+
+
+/*
+ * raptor_json_comment_end:
+ * @tok: tokenizer
+ * @pos: offset of the '/' starting a comment
+ *
+ * Return value: offset after the comment or 0 if it is not valid
+ */
+static size_t
+raptor_json_comment_end(raptor_json_tokenizer* tok, size_t pos)
+{
+  const unsigned char* p = tok->doc + pos;
+  const unsigned char* end = tok->doc + tok->len;
+
+  if(end - p < 2)
+    return 0;
+
+  if(p[1] == '/') {
+    const unsigned char* nl;
+
+    p += 2;
+    nl = (const unsigned char*)memchr(p, '\n', RAPTOR_GOOD_CAST(size_t, end - p));
+    return nl ? RAPTOR_GOOD_CAST(size_t, nl + 1 - tok->doc) : tok->len;
+  }
+
+  if(p[1] == '*') {
+    p += 2;
+    while(p < end) {
+      const unsigned char* star;
+
+      star = (const unsigned char*)memchr(p, '*', RAPTOR_GOOD_CAST(size_t, end - p));
+      if(!star || star + 1 == end)
+        break;
+      if(star[1] == '/')
+        return RAPTOR_GOOD_CAST(size_t, star + 2 - tok->doc);
+      p = star + 1;
+    }
+  }
+
+  return 0;
+}
+
+
+/*
+ * raptor_json_scalar:
+ * @tok: tokenizer
+ * @pos: offset of first byte of a literal or number
+ *
+ * None of these are valid in RDF/JSON so this always reports an error.
+ *
+ * Return value: 0 to stop parsing
+ */
+static int
+raptor_json_scalar(raptor_json_tokenizer* tok, size_t pos)
+{
+  raptor_parser* rdf_parser = tok->rdf_parser;
+  const unsigned char* s = tok->doc + pos;
+  size_t len = 0;
+
+  while(pos + len < tok->len && !RAPTOR_JSON_IS_DELIMITER(s[len]))
+    len++;
+
+  if(RAPTOR_JSON_KEY_IS(s, len, "true"))
+    return raptor_json_boolean(rdf_parser, 1);
+  if(RAPTOR_JSON_KEY_IS(s, len, "false"))
+    return raptor_json_boolean(rdf_parser, 0);
+  if(RAPTOR_JSON_KEY_IS(s, len, "null"))
+    return raptor_json_null(rdf_parser);
+
+  if(*s == '-' || (*s >= '0' && *s <= '9')) {
+    size_t i;
+
+    for(i = 1; i < len; i++) {
+      if(s[i] == '.' || s[i] == 'e' || s[i] == 'E')
+        return raptor_json_double(rdf_parser);
+    }
+    return raptor_json_integer(rdf_parser);
+  }
+
+  raptor_json_syntax_error(tok, pos, "invalid literal");
+  return 0;
+}
+
+
+/*
+ * raptor_json_tokenize:
+ * @rdf_parser: parser
+ * @doc: whole JSON document
+ * @len: length of @doc
+ *
+ * Stage 2: parse a whole document with the built-in tokenizer.
+ * Unescaped strings given to the handlers point into @doc.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_json_tokenize(raptor_parser* rdf_parser,
+                     const unsigned char* doc, size_t len)
+{
+  raptor_json_parser_context *context;
+  raptor_json_tokenizer tok;
+  unsigned char stack[RAPTOR_JSON_MAX_DEPTH];
+  int depth = 0;
+  raptor_json_expect expect = RAPTOR_JSON_EXPECT_VALUE;
+  size_t pos;
+
+  context = (raptor_json_parser_context*)rdf_parser->context;
+
+  if(!context->index) {
+    context->index = RAPTOR_MALLOC(size_t*,
+                                   RAPTOR_JSON_INDEX_WINDOW * sizeof(size_t));
+    if(!context->index) {
+      raptor_parser_fatal_error(rdf_parser, "Out of memory");
+      return 1;
+    }
+  }
+
+  tok.rdf_parser = rdf_parser;
+  tok.doc = doc;
+  tok.len = len;
+  tok.index = context->index;
+  raptor_json_reindex_from(&tok, 0);
+
+  while(raptor_json_next_structural(&tok, &pos)) {
+    unsigned char c = doc[pos];
+    const char* error = NULL;
+    int rc = 1;
+
+    switch(c) {
+      case '/': {
+        size_t next = raptor_json_comment_end(&tok, pos);
+
+        if(!next) {
+          error = "invalid or unterminated comment";
+          break;
+        }
+        raptor_json_reindex_from(&tok, next);
+        continue;
+      }
+
+      case '{':
+      case '[':
+        if(expect != RAPTOR_JSON_EXPECT_VALUE &&
+           expect != RAPTOR_JSON_EXPECT_VALUE_OR_CLOSE) {
+          error = "unexpected character";
+          break;
+        }
+        if(depth == RAPTOR_JSON_MAX_DEPTH) {
+          error = "maps and arrays nested too deeply";
+          break;
+        }
+        stack[depth++] = c;
+        if(c == '{') {
+          rc = raptor_json_start_map(rdf_parser);
+          expect = RAPTOR_JSON_EXPECT_KEY_OR_CLOSE;
+        } else {
+          rc = raptor_json_start_array(rdf_parser);
+          expect = RAPTOR_JSON_EXPECT_VALUE_OR_CLOSE;
+        }
+        break;
+
+      case '}':
+      case ']':
+        if(!depth || stack[depth - 1] != (c == '}' ? '{' : '[') ||
+           (expect != RAPTOR_JSON_EXPECT_COMMA_OR_CLOSE &&
+            expect != (c == '}' ? RAPTOR_JSON_EXPECT_KEY_OR_CLOSE :
+                                  RAPTOR_JSON_EXPECT_VALUE_OR_CLOSE))) {
+          error = "unexpected character";
+          break;
+        }
+        depth--;
+        if(c == '}')
+          rc = raptor_json_end_map(rdf_parser);
+        else
+          rc = raptor_json_end_array(rdf_parser);
+        expect = depth ? RAPTOR_JSON_EXPECT_COMMA_OR_CLOSE :
+                         RAPTOR_JSON_EXPECT_END;
+        break;
+
+      case ':':
+        if(expect != RAPTOR_JSON_EXPECT_COLON)
+          error = "unexpected character";
+        else
+          expect = RAPTOR_JSON_EXPECT_VALUE;
+        break;
+
+      case ',':
+        if(expect != RAPTOR_JSON_EXPECT_COMMA_OR_CLOSE)
+          error = "unexpected character";
+        else if(stack[depth - 1] == '{')
+          expect = RAPTOR_JSON_EXPECT_KEY;
+        else
+          expect = RAPTOR_JSON_EXPECT_VALUE;
+        break;
+
+      case '"': {
+        const unsigned char* str = doc + pos + 1;
+        size_t str_len;
+        size_t end;
+        size_t i;
+        int has_escape;
+        int is_key = (expect == RAPTOR_JSON_EXPECT_KEY ||
+                      expect == RAPTOR_JSON_EXPECT_KEY_OR_CLOSE);
+
+        if(!is_key && expect != RAPTOR_JSON_EXPECT_VALUE &&
+           expect != RAPTOR_JSON_EXPECT_VALUE_OR_CLOSE) {
+          error = "unexpected character";
+          break;
+        }
+
+        end = raptor_json_string_end(&tok, pos, &has_escape);
+        if(!end) {
+          error = "unterminated string";
+          break;
+        }
+        str_len = end - pos - 1;
+
+        /* control characters must be escaped in strings */
+        for(i = 0; i < str_len; i++) {
+          if(str[i] < 0x20) {
+            raptor_json_syntax_error(&tok, pos + 1 + i,
+                                     "invalid character in string");
+            return 1;
+          }
+        }
+
+        if(has_escape) {
+          int urc = raptor_json_unescape(&tok, str, str_len, &str_len);
+          if(urc < 0)
+            return 1;
+          if(urc) {
+            error = "invalid escape in string";
+            break;
+          }
+          str = context->unescaped;
+        }
+
+        if(is_key) {
+          rc = raptor_json_map_key(rdf_parser, str, str_len);
+          expect = RAPTOR_JSON_EXPECT_COLON;
+        } else {
+          /* the decoded buffer is reused by the next string */
+          rc = raptor_json_string(rdf_parser, str, str_len, has_escape);
+          expect = depth ? RAPTOR_JSON_EXPECT_COMMA_OR_CLOSE :
+                           RAPTOR_JSON_EXPECT_END;
+        }
+        break;
+      }
+
+      default:
+        if(expect != RAPTOR_JSON_EXPECT_VALUE &&
+           expect != RAPTOR_JSON_EXPECT_VALUE_OR_CLOSE) {
+          error = "unexpected character";
+          break;
+        }
+        rc = raptor_json_scalar(&tok, pos);
+        expect = depth ? RAPTOR_JSON_EXPECT_COMMA_OR_CLOSE :
+                         RAPTOR_JSON_EXPECT_END;
+        break;
+    }
+
+    if(error) {
+      raptor_json_syntax_error(&tok, pos, error);
+      return 1;
+    }
+    if(!rc)
+      return 1;
+  }
+
+  if(expect != RAPTOR_JSON_EXPECT_END) {
+    raptor_json_syntax_error(&tok, len, "premature end of input");
+    return 1;
+  }
+
+  return 0;
+}
+
+
+#ifndef HAVE_YAJL
+/*
+ * raptor_json_buffer_chunk:
+ * @rdf_parser: parser
+ * @s: chunk
+ * @len: length of chunk
+ *
+ * Collect a chunk of a streamed document for the built-in tokenizer.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_json_buffer_chunk(raptor_parser* rdf_parser,
+                         const unsigned char *s, size_t len)
+{
+  raptor_json_parser_context *context;
+  context = (raptor_json_parser_context*)rdf_parser->context;
+
+  if(context->buffer_len + len > context->buffer_size) {
+    size_t size = context->buffer_size ? context->buffer_size : 4096;
+    unsigned char* buffer;
+
+    while(size < context->buffer_len + len)
+      size <<= 1;
+
+    buffer = RAPTOR_REALLOC(unsigned char*, context->buffer, size);
+    if(!buffer) {
+      raptor_parser_fatal_error(rdf_parser, "Out of memory");
+      return 1;
+    }
+    context->buffer = buffer;
+    context->buffer_size = size;
+  }
+
+  memcpy(context->buffer + context->buffer_len, s, len);
+  context->buffer_len += len;
+
+  return 0;
+}
+#endif
 
 
 
@@ -572,11 +1498,13 @@ raptor_json_parse_init(raptor_parser* rdf_parser, const char *name)
   /* Initialse the static statement */
   raptor_statement_init(&context->statement, rdf_parser->world);
 
+#ifdef HAVE_YAJL
   /* Configure the parser */
 #ifdef HAVE_YAJL2
 #else
   context->config.allowComments = 1;
   context->config.checkUTF8 = 0;
+#endif
 #endif
 
   return 0;
@@ -594,8 +1522,18 @@ raptor_json_parse_terminate(raptor_parser* rdf_parser)
   raptor_json_parser_context *context;
   context = (raptor_json_parser_context*)rdf_parser->context;
 
+#ifdef HAVE_YAJL
   if(context->handle)
     yajl_free(context->handle);
+#else
+  if(context->buffer)
+    RAPTOR_FREE(char*, context->buffer);
+#endif
+
+  if(context->index)
+    RAPTOR_FREE(size_t*, context->index);
+  if(context->unescaped)
+    RAPTOR_FREE(char*, context->unescaped);
 
   raptor_json_reset_term(context);
   raptor_statement_clear(&context->statement);
@@ -609,43 +1547,65 @@ raptor_json_parse_chunk(raptor_parser* rdf_parser,
                         int is_end)
 {
   raptor_json_parser_context *context = (raptor_json_parser_context*)rdf_parser->context;
-  yajl_status status;
   int result = 0;
 
-  if(len) {
-    /* Parse the chunk passed to us */
-    status = yajl_parse(context->handle, s, RAPTOR_BAD_CAST(int, len));
+  if(!context->streaming && is_end) {
+    /* The whole document at once: tokenize it where it is */
+    result = raptor_json_tokenize(rdf_parser, s, len);
+  } else {
+#ifdef HAVE_YAJL
+    yajl_status status;
+
+    context->streaming = 1;
 
-    if(status != yajl_status_ok 
+    if(len) {
+      /* Parse the chunk passed to us */
+      status = yajl_parse(context->handle, s, RAPTOR_BAD_CAST(int, len));
+
+      if(status != yajl_status_ok 
 #ifdef HAVE_YAJL2
 #else
-       && status != yajl_status_insufficient_data
+         && status != yajl_status_insufficient_data
 #endif
-    )
-    {
-      unsigned char * str = yajl_get_error(context->handle, 1, s, RAPTOR_BAD_CAST(int, len));
-      raptor_parser_error(rdf_parser, "YAJL error: %s", (const char *) str);
-      result = 1;
-      yajl_free_error(context->handle, str);
+      )
+      {
+        unsigned char * str = yajl_get_error(context->handle, 1, s, RAPTOR_BAD_CAST(int, len));
+        raptor_parser_error(rdf_parser, "YAJL error: %s", (const char *) str);
+        result = 1;
+        yajl_free_error(context->handle, str);
+      }
     }
-  }
 
-  if(is_end) {
-    /* parse any remaining buffered data */
+    if(is_end) {
+      /* parse any remaining buffered data */
 #ifdef HAVE_YAJL2
 #else
 #define yajl_complete_parse(h) yajl_parse_complete(h)
 #endif
-    status = yajl_complete_parse(context->handle);
-
-    if(status != yajl_status_ok)
-    {
-      unsigned char * str = yajl_get_error(context->handle, 0, NULL, 0);
-      raptor_parser_error(rdf_parser, "YAJL error: %s", (const char *) str);
-      result = 1;
-      yajl_free_error(context->handle, str);
+      status = yajl_complete_parse(context->handle);
+
+      if(status != yajl_status_ok)
+      {
+        unsigned char * str = yajl_get_error(context->handle, 0, NULL, 0);
+        raptor_parser_error(rdf_parser, "YAJL error: %s", (const char *) str);
+        result = 1;
+        yajl_free_error(context->handle, str);
+      }
     }
+#else
+    context->streaming = 1;
+
+    /* Collect the document to tokenize at the end */
+    if(len)
+      result = raptor_json_buffer_chunk(rdf_parser, s, len);
 
+    if(!result && is_end)
+      result = raptor_json_tokenize(rdf_parser, context->buffer,
+                                    context->buffer_len);
+#endif
+  }
+
+  if(is_end) {
     raptor_json_reset_term(context);
     raptor_statement_clear(&context->statement);
   }
@@ -659,6 +1619,7 @@ raptor_json_parse_start(raptor_parser* rdf_parser)
 {
   raptor_json_parser_context *context = (raptor_json_parser_context*)rdf_parser->context;
 
+#ifdef HAVE_YAJL
   /* Destroy the old parser */
   if(context->handle)
     yajl_free(context->handle);
@@ -684,8 +1645,12 @@ raptor_json_parse_start(raptor_parser* rdf_parser)
   yajl_config(context->handle, yajl_allow_comments, 1);
   yajl_config(context->handle, yajl_dont_validate_strings, 1);
 #else
+#endif
+#else
+  context->buffer_len = 0;
 #endif
 
+  context->streaming = 0;
   context->state = RAPTOR_JSON_STATE_ROOT;
   raptor_json_reset_term(context);
   raptor_statement_clear(&context->statement);
@@ -761,6 +1726,7 @@ raptor_json_parser_register_factory(raptor_parser_factory *factory)
   factory->desc.flags = 0;
 
   factory->context_length     = sizeof(raptor_json_parser_context);
+  factory->whole_document_chunk = 1;
 
   factory->init      = raptor_json_parse_init;
   factory->terminate = raptor_json_parse_terminate;
@@ -47,6 +47,9 @@
 
 #define RAPTOR_DEFAULT_RDFA_VERSION 0
 
+/* Size of the direct mapped cache of IRI terms; a power of 2 */
+#define RAPTOR_LIBRDFA_URI_TERM_CACHE_SIZE 256
+
 /*
  * RDFA parser object
  */
@@ -59,6 +62,9 @@ struct raptor_librdfa_parser_context_s {
 
   /* 10 for 1.0  11 for 1.1 or otherwise is default (== 1.1) */
   int rdfa_version;
+
+  /* recently made IRI terms indexed by a hash of the IRI string */
+  raptor_term* uri_terms[RAPTOR_LIBRDFA_URI_TERM_CACHE_SIZE];
 };
 
 
@@ -90,6 +96,7 @@ static void
 raptor_librdfa_parse_terminate(raptor_parser* rdf_parser)
 {
   raptor_librdfa_parser_context *librdfa_parser;
+  int i;
 
   librdfa_parser = (raptor_librdfa_parser_context*)rdf_parser->context;
 
@@ -98,6 +105,77 @@ raptor_librdfa_parse_terminate(raptor_parser* rdf_parser)
     rdfa_free_context(librdfa_parser->context);
     librdfa_parser->context = NULL;
   }
+
+  for(i = 0; i < RAPTOR_LIBRDFA_URI_TERM_CACHE_SIZE; i++) {
+    if(librdfa_parser->uri_terms[i]) {
+      raptor_free_term(librdfa_parser->uri_terms[i]);
+      librdfa_parser->uri_terms[i] = NULL;
+    }
+  }
+}
+
+
+/*
+ * raptor_librdfa_new_uri_term:
+ * @rdf_parser: parser
+ * @uri_string: IRI string from librdfa
+ *
+ * INTERNAL - Get an IRI term for an IRI string
+ *
+ * Subjects, predicates, types and datatypes repeat a lot in RDFa so
+ * recently made terms are kept and shared by reference count instead
+ * of making the URI and term again.
+ *
+ * Return value: new term reference or NULL on failure
+ */
+static raptor_term*
+raptor_librdfa_new_uri_term(raptor_parser* rdf_parser,
+                            const char* uri_string)
+{
+  raptor_librdfa_parser_context *librdfa_parser;
+  raptor_term **entry;
+  raptor_term *term;
+  raptor_uri *uri;
+  unsigned int hash = 2166136261U;
+  const char *p;
+  size_t len;
+
+  librdfa_parser = (raptor_librdfa_parser_context*)rdf_parser->context;
+
+  for(p = uri_string; *p; p++) {
+    hash ^= (unsigned char)*p;
+    hash *= 16777619U;
+  }
+  len = RAPTOR_GOOD_CAST(size_t, p - uri_string);
+
+  entry = &librdfa_parser->uri_terms[hash &
+                                     (RAPTOR_LIBRDFA_URI_TERM_CACHE_SIZE - 1)];
+  if(*entry) {
+    size_t entry_len;
+    const unsigned char *entry_string;
+
+    entry_string = raptor_uri_as_counted_string((*entry)->value.uri,
+                                                &entry_len);
+    if(entry_len == len && !memcmp(entry_string, uri_string, len))
+      return raptor_term_copy(*entry);
+  }
+
+  uri = raptor_new_uri_from_counted_string(rdf_parser->world,
+                                           (const unsigned char*)uri_string,
+                                           len);
+  if(!uri)
+    return NULL;
+
+  term = raptor_new_term_from_uri(rdf_parser->world, uri);
+  raptor_free_uri(uri);
+  if(!term)
+    return NULL;
+
+  if(*entry)
+    raptor_free_term(*entry);
+  *entry = raptor_term_copy(term);
+
+  return term;
 }
 
 
@@ -108,7 +186,6 @@ raptor_librdfa_generate_statement(rdftriple* triple, void* callback_data)
   raptor_statement *s = &parser->statement;
   raptor_term *subject_term = NULL;
   raptor_term *predicate_term = NULL;
-  raptor_uri *predicate_uri = NULL;
   raptor_term *object_term = NULL;
 
   if(!parser->emitted_default_graph) {
@@ -147,25 +224,14 @@ raptor_librdfa_generate_statement(rdftriple* triple, void* callback_data)
     subject_term = raptor_new_term_from_blank(parser->world,
                                               (const unsigned char*)triple->subject + 2);
   } else {
-    raptor_uri* subject_uri;
-    
-    subject_uri = raptor_new_uri(parser->world,
-                                 (const unsigned char*)triple->subject);
-    subject_term = raptor_new_term_from_uri(parser->world, subject_uri);
-    raptor_free_uri(subject_uri);
-    subject_uri = NULL;
+    subject_term = raptor_librdfa_new_uri_term(parser, triple->subject);
   }
   s->subject = subject_term;
   
 
-  predicate_uri = raptor_new_uri(parser->world,
-                                 (const unsigned char*)triple->predicate);
-  if(!predicate_uri)
+  predicate_term = raptor_librdfa_new_uri_term(parser, triple->predicate);
+  if(!predicate_term)
     goto cleanup;
-
-  predicate_term = raptor_new_term_from_uri(parser->world, predicate_uri);
-  raptor_free_uri(predicate_uri);
-  predicate_uri = NULL;
   s->predicate = predicate_term;
  
 
@@ -174,14 +240,9 @@ raptor_librdfa_generate_statement(rdftriple* triple, void* callback_data)
       object_term = raptor_new_term_from_blank(parser->world,
                                                (const unsigned char*)triple->object + 2);
     } else {
-      raptor_uri* object_uri;
-      object_uri = raptor_new_uri(parser->world,
-                                  (const unsigned char*)triple->object);
-      if(!object_uri)
+      object_term = raptor_librdfa_new_uri_term(parser, triple->object);
+      if(!object_term)
         goto cleanup;
-
-      object_term = raptor_new_term_from_uri(parser->world, object_uri);
-      raptor_free_uri(object_uri);
     }
   } else if(triple->object_type == RDF_TYPE_PLAIN_LITERAL) {
     object_term = raptor_new_term_from_literal(parser->world,
@@ -200,23 +261,23 @@ raptor_librdfa_generate_statement(rdftriple* triple, void* callback_data)
                                                NULL);
     raptor_free_uri(datatype_uri);
   } else if(triple->object_type == RDF_TYPE_TYPED_LITERAL) {
-    raptor_uri *datatype_uri = NULL;
+    raptor_term *datatype_term = NULL;
     const unsigned char* language = (const unsigned char*)triple->language;
     
     if(triple->datatype) {
       /* If datatype, no language allowed */
       language = NULL;
-      datatype_uri = raptor_new_uri(parser->world,
-                                    (const unsigned char*)triple->datatype);
-      if(!datatype_uri)
+      datatype_term = raptor_librdfa_new_uri_term(parser, triple->datatype);
+      if(!datatype_term)
         goto cleanup;
     }
     
     object_term = raptor_new_term_from_literal(parser->world,
                                                (const unsigned char*)triple->object,
-                                               datatype_uri,
+                                               datatype_term ? datatype_term->value.uri : NULL,
                                                language);
-    raptor_free_uri(datatype_uri);
+    if(datatype_term)
+      raptor_free_term(datatype_term);
   } else {
     raptor_log_error_formatted(parser->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
                                "Triple has unknown object term type %u",
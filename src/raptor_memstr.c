@@ -1,6 +1,7 @@
 /* -*- Mode: c; c-basic-offset: 2 -*-
  *
  * raptor_memstr.c - search for a string in a block of memory
+ *                    and scan for bytes needing escaping
  *
  * Copyright (C) 2008, David Beckett http://www.dajobe.org/
  * 
@@ -28,6 +29,10 @@
 
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /* Raptor includes */
 #include "raptor2.h"
 #include "raptor_internal.h"
@@ -74,3 +79,118 @@ raptor_memstr(const char *haystack, size_t haystack_len, const char *needle)
 }
 
     
+
+
+
+/* Most special bytes raptor_memspn_ascii() checks with vector compares */
+#define RAPTOR_MEMSPN_MAX_SPECIALS 4
+
+/* A size_t with every byte set to @b */
+#define RAPTOR_MEMSPN_REPEAT(b) (((size_t)-1 / 0xFF) * (size_t)(b))
+
+/* Is byte @c outside printable ASCII or one of @specials */
+#define RAPTOR_MEMSPN_STOP(c, specials) \
+  ((c) < 0x20 || (c) >= 0x7f || ((specials) && strchr(specials, (c))))
+
+
+/*
+ * raptor_memspn_ascii:
+ * @string: memory block to scan
+ * @len: size of memory block
+ * @specials: NUL terminated string of bytes that end the span (or NULL)
+ *
+ * INTERNAL: Find the length of a run of bytes that need no escaping
+ *
+ * Returns the length of the initial segment of @string made of
+ * printable ASCII bytes (0x20 to 0x7E) that are not in @specials.
+ * The scan thus stops at NUL, control characters, DEL and the first
+ * byte of any UTF-8 multibyte sequence.
+ *
+ * Whole words (or SSE2 vectors where available) are checked at a time
+ * so that escaping writers can copy the plain text between escapes
+ * with a single write.
+ *
+ * Return value: length of span
+ */
+size_t
+raptor_memspn_ascii(const unsigned char *string, size_t len,
+                    const char *specials)
+{
+  const unsigned char *p = string;
+  const unsigned char *end = string + len;
+  size_t specials_count = specials ? strlen(specials) : 0;
+  size_t i;
+
+  if(specials && !specials_count)
+    specials = NULL;
+
+  if(specials_count <= RAPTOR_MEMSPN_MAX_SPECIALS) {
+#ifdef __SSE2__
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    __m128i special_v[RAPTOR_MEMSPN_MAX_SPECIALS];
+
+    for(i = 0; i < specials_count; i++)
+      special_v[i] = _mm_set1_epi8(specials[i]);
+
+    while(end - p >= 16) {
+      __m128i v = _mm_loadu_si128((const __m128i*)p);
+      /* signed compare: bytes >= 0x80 are negative so also below space */
+      __m128i stop = _mm_or_si128(_mm_cmplt_epi8(v, space),
+                                  _mm_cmpeq_epi8(v, del));
+      int mask;
+
+      for(i = 0; i < specials_count; i++)
+        stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, special_v[i]));
+
+      mask = _mm_movemask_epi8(stop);
+      if(mask) {
+        while(!(mask & 1)) {
+          mask >>= 1;
+          p++;
+        }
+        return RAPTOR_GOOD_CAST(size_t, p - string);
+      }
+      p += 16;
+    }
+#else
+    const size_t ones = RAPTOR_MEMSPN_REPEAT(0x01);
+    const size_t highs = RAPTOR_MEMSPN_REPEAT(0x80);
+    size_t special_w[RAPTOR_MEMSPN_MAX_SPECIALS];
+
+    for(i = 0; i < specials_count; i++)
+      special_w[i] = RAPTOR_MEMSPN_REPEAT((unsigned char)specials[i]);
+
+    while(RAPTOR_GOOD_CAST(size_t, end - p) >= sizeof(size_t)) {
+      size_t w;
+      size_t x;
+      size_t stop;
+
+      memcpy(&w, p, sizeof(w));
+
+      /* high bit set, or some byte below 0x20 */
+      stop = (w & highs) |
+             ((w - RAPTOR_MEMSPN_REPEAT(0x20)) & ~w & highs);
+      /* some byte equal to 0x7F */
+      x = w ^ RAPTOR_MEMSPN_REPEAT(0x7f);
+      stop |= (x - ones) & ~x & highs;
+      for(i = 0; i < specials_count; i++) {
+        x = w ^ special_w[i];
+        stop |= (x - ones) & ~x & highs;
+      }
+
+      /* the word tests may flag bytes after a real stop byte; find the
+       * exact position below */
+      if(stop)
+        break;
+
+      p += sizeof(size_t);
+    }
+#endif
+  }
+
+  while(p < end && !RAPTOR_MEMSPN_STOP(*p, specials))
+    p++;
+
+  return RAPTOR_GOOD_CAST(size_t, p - string);
+}
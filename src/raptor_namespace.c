@@ -111,7 +111,226 @@ raptor_hash_ns_string(const unsigned char *str, int length)
 }
 
 
-#define RAPTOR_NAMESPACES_HASHTABLE_SIZE 1024
+static unsigned int
+raptor_hash_ns_uri(raptor_uri *uri)
+{
+  size_t len;
+  const unsigned char *str = raptor_uri_as_counted_string(uri, &len);
+
+  return raptor_hash_ns_string(str, (int)len);
+}
+
+
+/*
+ * Byte trie of the namespace URIs in a stack
+ *
+ * Nodes are kept in one array with node 0 the root (the empty URI);
+ * the children of a node are a linked list of siblings.  count is
+ * the number of started namespaces with the URI ending at that node.
+ * Nodes are never removed when namespaces end, only their counts.
+ */
+typedef struct {
+  int parent;
+  int first_child;
+  int next_sibling;
+  int count;
+  unsigned char byte;
+} raptor_namespace_trie_node;
+
+typedef struct raptor_namespace_trie_s {
+  raptor_namespace_trie_node* nodes;
+  int nodes_count;
+  int nodes_size;
+} raptor_namespace_trie;
+
+
+static void
+raptor_free_namespace_trie(raptor_namespace_trie* trie)
+{
+  if(trie->nodes)
+    RAPTOR_FREE(raptor_namespace_trie_node, trie->nodes);
+  RAPTOR_FREE(raptor_namespace_trie, trie);
+}
+
+
+static raptor_namespace_trie*
+raptor_new_namespace_trie(void)
+{
+  raptor_namespace_trie* trie;
+
+  trie = RAPTOR_CALLOC(raptor_namespace_trie*, 1, sizeof(*trie));
+  if(!trie)
+    return NULL;
+
+  trie->nodes_size = 64;
+  trie->nodes = RAPTOR_CALLOC(raptor_namespace_trie_node*, trie->nodes_size,
+                              sizeof(*trie->nodes));
+  if(!trie->nodes) {
+    raptor_free_namespace_trie(trie);
+    return NULL;
+  }
+
+  /* root */
+  trie->nodes[0].parent = -1;
+  trie->nodes_count = 1;
+
+  return trie;
+}
+
+
+/*
+ * raptor_namespace_trie_add:
+ * @trie: trie
+ * @uri: namespace URI
+ * @delta: +1 when starting a namespace, -1 when ending it
+ *
+ * INTERNAL - Update the count for a namespace URI, adding nodes if needed
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_namespace_trie_add(raptor_namespace_trie* trie, raptor_uri* uri,
+                          int delta)
+{
+  const unsigned char* str;
+  size_t len;
+  size_t i;
+  int node = 0;
+
+  str = raptor_uri_as_counted_string(uri, &len);
+
+  for(i = 0; i < len; i++) {
+    int child;
+
+    for(child = trie->nodes[node].first_child; child;
+        child = trie->nodes[child].next_sibling) {
+      if(trie->nodes[child].byte == str[i])
+        break;
+    }
+
+    if(!child) {
+      raptor_namespace_trie_node* n;
+
+      if(delta < 0)
+        return 1;
+
+      if(trie->nodes_count == trie->nodes_size) {
+        int new_size = trie->nodes_size << 1;
+        raptor_namespace_trie_node* new_nodes;
+
+        new_nodes = RAPTOR_REALLOC(raptor_namespace_trie_node*, trie->nodes,
+                                   new_size * sizeof(*new_nodes));
+        if(!new_nodes)
+          return 1;
+        trie->nodes = new_nodes;
+        trie->nodes_size = new_size;
+      }
+
+      child = trie->nodes_count++;
+      n = &trie->nodes[child];
+      n->parent = node;
+      n->first_child = 0;
+      n->next_sibling = trie->nodes[node].first_child;
+      n->count = 0;
+      n->byte = str[i];
+      trie->nodes[node].first_child = child;
+    }
+
+    node = child;
+  }
+
+  trie->nodes[node].count += delta;
+  return 0;
+}
+
+
+/* keep the trie, if any, in step with a namespace starting or ending */
+static void
+raptor_namespaces_trie_update(raptor_namespace_stack *nstack,
+                              raptor_namespace *nspace, int delta)
+{
+  if(!nstack->trie || !nspace->uri)
+    return;
+
+  if(raptor_namespace_trie_add(nstack->trie, nspace->uri, delta)) {
+    /* rebuilt from the URI table when next needed */
+    raptor_free_namespace_trie(nstack->trie);
+    nstack->trie = NULL;
+  }
+}
+
+
+/* initial size of the prefix and URI hash tables; must be a power of 2 */
+#define RAPTOR_NAMESPACES_HASHTABLE_SIZE 16
+
+
+/*
+ * raptor_namespaces_grow:
+ * @nstack: namespace stack
+ *
+ * INTERNAL - Double the size of the prefix and URI hash tables
+ *
+ * Each old bucket splits into two new buckets keeping the order of
+ * its chain so that the most recently started namespace stays first.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_namespaces_grow(raptor_namespace_stack *nstack)
+{
+  int old_size = nstack->table_size;
+  int new_size = old_size << 1;
+  raptor_namespace** table;
+  raptor_namespace** uri_table;
+  int bucket;
+
+  table = RAPTOR_CALLOC(raptor_namespace**, new_size,
+                        sizeof(raptor_namespace*));
+  if(!table)
+    return 1;
+  uri_table = RAPTOR_CALLOC(raptor_namespace**, new_size,
+                            sizeof(raptor_namespace*));
+  if(!uri_table) {
+    RAPTOR_FREE(raptor_namespaces, table);
+    return 1;
+  }
+
+  for(bucket = 0; bucket < old_size; bucket++) {
+    raptor_namespace** tails[2];
+    raptor_namespace* ns;
+
+    tails[0] = &table[bucket];
+    tails[1] = &table[bucket + old_size];
+    for(ns = nstack->table[bucket]; ns; ns = ns->next) {
+      int hi = (raptor_hash_ns_string(ns->prefix, ns->prefix_length) %
+                new_size) != (unsigned int)bucket;
+      *tails[hi] = ns;
+      tails[hi] = &ns->next;
+    }
+    *tails[0] = NULL;
+    *tails[1] = NULL;
+
+    tails[0] = &uri_table[bucket];
+    tails[1] = &uri_table[bucket + old_size];
+    for(ns = nstack->uri_table[bucket]; ns; ns = ns->uri_next) {
+      int hi = (raptor_hash_ns_uri(ns->uri) % new_size) != (unsigned int)bucket;
+      *tails[hi] = ns;
+      tails[hi] = &ns->uri_next;
+    }
+    *tails[0] = NULL;
+    *tails[1] = NULL;
+  }
+
+  RAPTOR_FREE(raptor_namespaces, nstack->table);
+  RAPTOR_FREE(raptor_namespaces, nstack->uri_table);
+  nstack->table = table;
+  nstack->uri_table = uri_table;
+  nstack->table_size = new_size;
+
+  return 0;
+}
+
+
 /**
  * raptor_namespaces_init:
  * @world: raptor_world object
@@ -142,8 +361,22 @@ raptor_namespaces_init(raptor_world* world,
   nstack->table = RAPTOR_CALLOC(raptor_namespace**,
                                 RAPTOR_NAMESPACES_HASHTABLE_SIZE,
                                 sizeof(raptor_namespace*));
-  if(!nstack->table)
+  nstack->uri_table = RAPTOR_CALLOC(raptor_namespace**,
+                                    RAPTOR_NAMESPACES_HASHTABLE_SIZE,
+                                    sizeof(raptor_namespace*));
+  nstack->trie = NULL;
+  if(!nstack->table || !nstack->uri_table) {
+    if(nstack->table) {
+      RAPTOR_FREE(raptor_namespaces, nstack->table);
+      nstack->table = NULL;
+    }
+    if(nstack->uri_table) {
+      RAPTOR_FREE(raptor_namespaces, nstack->uri_table);
+      nstack->uri_table = NULL;
+    }
+    nstack->table_size = 0;
     return -1;
+  }
 
   nstack->def_namespace = NULL;
 
@@ -231,14 +464,27 @@ raptor_namespaces_start_namespace(raptor_namespace_stack *nstack,
 {
   unsigned int hash = raptor_hash_ns_string(nspace->prefix,
                                             nspace->prefix_length);
-  const int bucket = hash % nstack->table_size;
+  int bucket;
+
+  /* keep chains short; on failure carry on with the current tables */
+  if(nstack->size >= nstack->table_size)
+    (void)raptor_namespaces_grow(nstack);
 
   nstack->size++;
   
+  bucket = hash % nstack->table_size;
   if(nstack->table[bucket])
     nspace->next = nstack->table[bucket];
   nstack->table[bucket] = nspace;
 
+  if(nspace->uri) {
+    bucket = raptor_hash_ns_uri(nspace->uri) % nstack->table_size;
+    nspace->uri_next = nstack->uri_table[bucket];
+    nstack->uri_table[bucket] = nspace;
+  }
+
+  raptor_namespaces_trie_update(nstack, nspace, 1);
+
   if(!nstack->def_namespace)
     nstack->def_namespace = nspace;
 
@@ -311,6 +557,16 @@ raptor_namespaces_clear(raptor_namespace_stack *nstack)
     nstack->table_size = 0;
   }
 
+  if(nstack->uri_table) {
+    RAPTOR_FREE(raptor_namespaces, nstack->uri_table);
+    nstack->uri_table = NULL;
+  }
+
+  if(nstack->trie) {
+    raptor_free_namespace_trie(nstack->trie);
+    nstack->trie = NULL;
+  }
+
   if(nstack->world) {
     if(nstack->rdf_ms_uri) {
       raptor_free_uri(nstack->rdf_ms_uri);
@@ -369,6 +625,18 @@ raptor_namespaces_end_for_depth(raptor_namespace_stack *nstack, int depth)
                     ns->prefix ? (char*)ns->prefix : "(default)", depth);
 #endif
 #endif
+      if(ns->uri) {
+        raptor_namespace** prev;
+
+        prev = &nstack->uri_table[raptor_hash_ns_uri(ns->uri) %
+                                  nstack->table_size];
+        while(*prev != ns)
+          prev = &(*prev)->uri_next;
+        *prev = ns->uri_next;
+      }
+
+      raptor_namespaces_trie_update(nstack, ns, -1);
+
       raptor_free_namespace(ns);
       nstack->size--;
 
@@ -440,6 +708,32 @@ raptor_namespaces_find_namespace(raptor_namespace_stack *nstack,
 }
 
 
+/* find the most recently started namespace with a URI given as a string */
+static raptor_namespace*
+raptor_namespaces_find_namespace_by_uri_string(raptor_namespace_stack *nstack,
+                                               const unsigned char *uri_string,
+                                               size_t uri_len)
+{
+  raptor_namespace* ns;
+  int bucket;
+
+  if(!nstack->table_size)
+    return NULL;
+  
+  bucket = raptor_hash_ns_string(uri_string, (int)uri_len) % nstack->table_size;
+  for(ns = nstack->uri_table[bucket]; ns ; ns = ns->uri_next) {
+    const unsigned char *ns_uri_string;
+    size_t ns_uri_len;
+
+    ns_uri_string = raptor_uri_as_counted_string(ns->uri, &ns_uri_len);
+    if(ns_uri_len == uri_len && !memcmp(ns_uri_string, uri_string, uri_len))
+      return ns;
+  }
+  
+  return NULL;
+}
+
+
 /**
  * raptor_namespaces_find_namespace_by_uri:
  * @nstack: namespace stack
@@ -453,19 +747,15 @@ raptor_namespace*
 raptor_namespaces_find_namespace_by_uri(raptor_namespace_stack *nstack, 
                                         raptor_uri *ns_uri)
 {
-  int bucket;
+  const unsigned char *uri_string;
+  size_t uri_len;
 
   if(!ns_uri)
     return NULL;
   
-  for(bucket = 0; bucket < nstack->table_size; bucket++) {
-    raptor_namespace* ns;
-    for(ns = nstack->table[bucket]; ns ; ns = ns->next)
-      if(raptor_uri_equals(ns->uri, ns_uri))
-        return ns;
-   }
-  
-  return NULL;
+  uri_string = raptor_uri_as_counted_string(ns_uri, &uri_len);
+  return raptor_namespaces_find_namespace_by_uri_string(nstack, uri_string,
+                                                        uri_len);
 }
 
 
@@ -485,9 +775,13 @@ raptor_namespaces_namespace_in_scope(raptor_namespace_stack *nstack,
   raptor_namespace* ns;
   int bucket;
   
+  if(nspace->uri)
+    return raptor_namespaces_find_namespace_by_uri(nstack, nspace->uri) != NULL;
+
+  /* no URI: look for any other namespace without one */
   for(bucket = 0; bucket < nstack->table_size; bucket++) {
     for(ns = nstack->table[bucket]; ns ; ns = ns->next)
-      if(raptor_uri_equals(ns->uri, nspace->uri))
+      if(!ns->uri)
         return 1;
   }
   return 0;
@@ -963,7 +1257,8 @@ raptor_xml_namespace_string_parse(const unsigned char *string,
  * Make an appropriate XML Qname from the namespaces on a namespace stack
  * 
  * Makes a qname from the in-scope namespaces in a stack if the URI matches
- * the prefix and the rest is a legal XML name.
+ * the prefix and the rest is a legal XML name.  The namespace with the
+ * longest matching URI is used.
  *
  * Return value: #raptor_qname for the URI or NULL on failure
  **/
@@ -971,50 +1266,72 @@ raptor_qname*
 raptor_new_qname_from_namespace_uri(raptor_namespace_stack *nstack, 
                                     raptor_uri *uri, int xml_version)
 {
-  unsigned char *uri_string;
+  raptor_namespace_trie* trie;
+  const unsigned char *uri_string;
   size_t uri_len;
-  raptor_namespace* ns = NULL;
-  unsigned char *ns_uri_string;
-  size_t ns_uri_len;
-  unsigned char *name = NULL;
-  int bucket;
+  size_t depth;
+  int node;
 
-  if(!uri)
+  if(!uri || !nstack->table_size)
     return NULL;
   
+  if(!nstack->trie) {
+    int bucket;
+
+    trie = raptor_new_namespace_trie();
+    if(!trie)
+      return NULL;
+    for(bucket = 0; bucket < nstack->table_size; bucket++) {
+      raptor_namespace* ns;
+
+      for(ns = nstack->uri_table[bucket]; ns; ns = ns->uri_next) {
+        if(raptor_namespace_trie_add(trie, ns->uri, 1)) {
+          raptor_free_namespace_trie(trie);
+          return NULL;
+        }
+      }
+    }
+    nstack->trie = trie;
+  }
+  trie = nstack->trie;
+
   uri_string = raptor_uri_as_counted_string(uri, &uri_len);
 
-  for(bucket = 0; bucket < nstack->table_size; bucket++) {
-    for(ns = nstack->table[bucket]; ns ; ns = ns->next) {
-      if(!ns->uri)
-        continue;
-      
-      ns_uri_string = raptor_uri_as_counted_string(ns->uri,
-                                                      &ns_uri_len);
-      if(ns_uri_len >= uri_len)
-        continue;
-      if(strncmp((const char*)uri_string, (const char*)ns_uri_string,
-                 ns_uri_len))
-        continue;
-      
-      /* uri_string is a prefix of ns_uri_string */
-      name = uri_string + ns_uri_len;
-      if(!raptor_xml_name_check(name, uri_len-ns_uri_len, xml_version))
-        name = NULL;
-      
-      /* If name is set, we've found a prefix with a legal XML name value */
-      if(name)
+  /* follow the URI down the trie as far as it goes */
+  for(node = 0, depth = 0; depth < uri_len; depth++) {
+    int child;
+
+    for(child = trie->nodes[node].first_child; child;
+        child = trie->nodes[child].next_sibling) {
+      if(trie->nodes[child].byte == uri_string[depth])
         break;
     }
-    if(name)
+    if(!child)
       break;
+    node = child;
   }
-  
-  if(!ns)
-    return NULL;
 
-  return raptor_new_qname_from_namespace_local_name(nstack->world, ns,
-                                                    name,  NULL);
+  /* then back up to the longest namespace URI that is a proper prefix
+   * of the URI and leaves a legal XML name */
+  for(; node >= 0; node = trie->nodes[node].parent, depth--) {
+    raptor_namespace* ns;
+
+    if(!trie->nodes[node].count || depth == uri_len)
+      continue;
+
+    if(!raptor_xml_name_check(uri_string + depth, uri_len - depth,
+                              xml_version))
+      continue;
+
+    ns = raptor_namespaces_find_namespace_by_uri_string(nstack, uri_string,
+                                                        depth);
+    if(ns)
+      return raptor_new_qname_from_namespace_local_name(nstack->world, ns,
+                                                        uri_string + depth,
+                                                        NULL);
+  }
+
+  return NULL;
 }
 
 
@@ -1091,6 +1408,8 @@ main(int argc, char *argv[])
   const char *program = raptor_basename(argv[0]);
   raptor_namespace_stack namespaces; /* static */
   raptor_namespace* ns;
+  raptor_uri* ns_uri;
+  int i;
 
   world = raptor_new_world();
   if(!world || raptor_world_open(world))
@@ -1133,6 +1452,64 @@ main(int argc, char *argv[])
     return(1);
   }
 
+  /* enough namespaces to grow the hash tables several times */
+  for(i = 0; i < 100; i++) {
+    unsigned char prefix[16];
+    unsigned char uri_string[40];
+
+    sprintf((char*)prefix, "p%d", i);
+    sprintf((char*)uri_string, "http://example.org/many/%d#", i);
+    if(raptor_namespaces_start_namespace_full(&namespaces, prefix,
+                                              uri_string, 3)) {
+      fprintf(stderr, "%s: Failed to start namespace %s, returning error\n",
+              program, prefix);
+      return(1);
+    }
+  }
+
+  for(i = 0; i < 100; i++) {
+    unsigned char prefix[16];
+    unsigned char uri_string[40];
+    raptor_uri* uri;
+
+    sprintf((char*)prefix, "p%d", i);
+    sprintf((char*)uri_string, "http://example.org/many/%d#", i);
+    uri = raptor_new_uri(world, uri_string);
+    ns = raptor_namespaces_find_namespace_by_uri(&namespaces, uri);
+    raptor_free_uri(uri);
+    if(!ns || strcmp((const char*)ns->prefix, (const char*)prefix)) {
+      fprintf(stderr, "%s: namespace for URI %s not found by URI, returning error\n", 
+              program, uri_string);
+      return(1);
+    }
+    if(raptor_namespaces_find_namespace(&namespaces, prefix,
+                                        (int)strlen((const char*)prefix)) != ns) {
+      fprintf(stderr, "%s: namespace %s not found by prefix, returning error\n", 
+              program, prefix);
+      return(1);
+    }
+  }
+
+  raptor_namespaces_end_for_depth(&namespaces, 3);
+
+  ns_uri = raptor_new_uri(world, (const unsigned char*)"http://example.org/many/7#");
+  ns = raptor_namespaces_find_namespace_by_uri(&namespaces, ns_uri);
+  raptor_free_uri(ns_uri);
+  if(ns) {
+    fprintf(stderr, "%s: namespace p7 found by URI after it was ended, returning error\n", 
+            program);
+    return(1);
+  }
+
+  ns_uri = raptor_new_uri(world, (const unsigned char*)"http://example.org/ns2");
+  ns = raptor_namespaces_find_namespace_by_uri(&namespaces, ns_uri);
+  raptor_free_uri(ns_uri);
+  if(!ns || strcmp((const char*)ns->prefix, "ex2")) {
+    fprintf(stderr, "%s: namespace ex2 not found by URI, returning error\n", 
+            program);
+    return(1);
+  }
+
   raptor_namespaces_end_for_depth(&namespaces, 2);
 
   raptor_namespaces_end_for_depth(&namespaces, 1);
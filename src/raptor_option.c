@@ -296,6 +296,48 @@ static const struct
     RAPTOR_OPTION_VALUE_TYPE_BOOL,
     "loadExternalEntities",
     "Parsers and SAX2 should load external entities."
+  },
+  { RAPTOR_OPTION_MEMORY_BUDGET,
+    RAPTOR_OPTION_AREA_SERIALIZER,
+    RAPTOR_OPTION_VALUE_TYPE_INT,
+    "memoryBudget",
+    "Turtle serializer memory budget in kilobytes before using temporary files (0 = no limit)"
+  },
+  { RAPTOR_OPTION_JSON_STREAM,
+    RAPTOR_OPTION_AREA_SERIALIZER,
+    RAPTOR_OPTION_VALUE_TYPE_BOOL,
+    "jsonStream",
+    "JSON serializer writes subjects as they end from input grouped by subject"
+  },
+  { RAPTOR_OPTION_NTRIPLES_THREADS,
+    RAPTOR_OPTION_AREA_SERIALIZER,
+    RAPTOR_OPTION_VALUE_TYPE_INT,
+    "ntriplesThreads",
+    "N-Triples and N-Quads serializers worker threads (0 = none)"
+  },
+  { RAPTOR_OPTION_CHECK_RDF_ID_EXACT,
+    RAPTOR_OPTION_AREA_PARSER,
+    RAPTOR_OPTION_VALUE_TYPE_BOOL,
+    "checkRdfIDExact",
+    "RDF/XML parser keeps rdf:ID values to check for duplicates exactly"
+  },
+  { RAPTOR_OPTION_CHECK_RDF_ID_MEMORY,
+    RAPTOR_OPTION_AREA_PARSER,
+    RAPTOR_OPTION_VALUE_TYPE_INT,
+    "checkRdfIDMemory",
+    "RDF/XML parser rdf:ID checking memory limit in kilobytes (0 = no limit)"
+  },
+  { RAPTOR_OPTION_GRDDL_THREADS,
+    RAPTOR_OPTION_AREA_PARSER,
+    RAPTOR_OPTION_VALUE_TYPE_INT,
+    "grddlThreads",
+    "GRDDL parser worker threads for XSLT transformations (0 = none)"
+  },
+  { RAPTOR_OPTION_JSON_STREAM_CHECK,
+    RAPTOR_OPTION_AREA_SERIALIZER,
+    RAPTOR_OPTION_VALUE_TYPE_BOOL,
+    "jsonStreamCheck",
+    "JSON serializer jsonStream fails on subjects repeated after being written"
   }
 };
 
@@ -593,6 +635,9 @@ raptor_object_options_init(raptor_object_options* options,
   /* Indent 2 spaces */
   options->options[RAPTOR_OPTION_WRITER_INDENT_WIDTH].integer = 2;
 
+  /* Check JSON stream input for repeated subjects */
+  options->options[RAPTOR_OPTION_JSON_STREAM_CHECK].integer = 1;
+
   /* lax (no strict) parsing */
   options->options[RAPTOR_OPTION_STRICT].integer = 0;
 
@@ -43,6 +43,12 @@
 #ifdef HAVE_FCNTL_H
 #include <fcntl.h>
 #endif
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#endif
 
 /* Raptor includes */
 #include "raptor2.h"
@@ -613,6 +619,30 @@ raptor_parser_parse_file(raptor_parser* rdf_parser, raptor_uri *uri,
     fh = stdin;
   }
 
+#if defined(HAVE_UNISTD_H) && defined(HAVE_SYS_STAT_H) && \
+    defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+  /* Give a parser that wants it the whole file at once */
+  if(uri && rdf_parser->factory->whole_document_chunk &&
+     !fstat(fileno(fh), &buf) && S_ISREG(buf.st_mode) &&
+     buf.st_size > 0 && buf.st_size <= INT_MAX) {
+    size_t len = RAPTOR_GOOD_CAST(size_t, buf.st_size);
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fileno(fh), 0);
+
+    if(map != MAP_FAILED) {
+      rdf_parser->locator.line = rdf_parser->locator.column = -1;
+      rdf_parser->locator.file = filename;
+
+      rc = raptor_parser_parse_start(rdf_parser, base_uri);
+      if(!rc)
+        rc = (raptor_parser_parse_chunk(rdf_parser,
+                                        (const unsigned char*)map, len,
+                                        1) != 0);
+      munmap(map, len);
+      goto cleanup;
+    }
+  }
+#endif
+
   rc = raptor_parser_parse_file_stream(rdf_parser, fh, filename, base_uri);
 
   cleanup:
@@ -1737,6 +1767,16 @@ raptor_parser_parse_iostream(raptor_parser* rdf_parser, raptor_iostream *iostr,
   rc = raptor_parser_parse_start(rdf_parser, base_uri);
   if(rc)
     return rc;
+
+  /* Give a parser that wants it a whole string at once */
+  if(rdf_parser->factory->whole_document_chunk) {
+    const unsigned char* string;
+    size_t len;
+
+    string = raptor_iostream_read_string_remaining(iostr, INT_MAX, &len);
+    if(string)
+      return raptor_parser_parse_chunk(rdf_parser, string, len, 1);
+  }
   
   while(!raptor_iostream_read_eof(iostr)) {
     int ilen;
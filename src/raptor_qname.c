@@ -111,6 +111,7 @@ raptor_new_qname(raptor_namespace_stack *nstack,
   if(!qname)
     return NULL;
   qname->world = nstack->world;
+  qname->usage = 1;
 
   if(value) {
     size_t value_length = strlen((char*)value);
@@ -251,6 +252,7 @@ raptor_new_qname_from_namespace_local_name(raptor_world* world,
   if(!qname)
     return NULL;
   qname->world = world;
+  qname->usage = 1;
 
   if(value) {
     unsigned int value_length = (unsigned int)strlen((char*)value);
@@ -310,6 +312,7 @@ raptor_qname_copy(raptor_qname *qname)
   if(!new_qname)
     return NULL;
   new_qname->world = qname->world;
+  new_qname->usage = 1;
 
   if(qname->value) {
     size_t value_length = qname->value_length;
@@ -346,6 +349,57 @@ raptor_qname_copy(raptor_qname *qname)
 }
 
 
+/*
+ * raptor_qname_copy_with_value:
+ * @qname: existing qname
+ * @value: attribute value
+ *
+ * INTERNAL - Copy an existing XML qname with a new attribute value
+ *
+ * The namespace URI is shared with @qname rather than made again.
+ *
+ * Return value: a new #raptor_qname object or NULL on failure
+ */
+raptor_qname*
+raptor_qname_copy_with_value(raptor_qname *qname, const unsigned char *value)
+{
+  raptor_qname* new_qname;
+  unsigned char* new_name;
+  size_t value_length = strlen((const char*)value);
+  unsigned char* new_value;
+
+  new_qname = RAPTOR_CALLOC(raptor_qname*, 1, sizeof(*qname));
+  if(!new_qname)
+    return NULL;
+  new_qname->world = qname->world;
+  new_qname->usage = 1;
+
+  new_value = RAPTOR_MALLOC(unsigned char*, value_length + 1);
+  if(!new_value) {
+    RAPTOR_FREE(raptor_qname, new_qname);
+    return NULL;
+  }
+  memcpy(new_value, value, value_length + 1); /* Copy NUL */
+  new_qname->value = new_value;
+  new_qname->value_length = value_length;
+
+  new_name = RAPTOR_MALLOC(unsigned char*, qname->local_name_length + 1);
+  if(!new_name) {
+    raptor_free_qname(new_qname);
+    return NULL;
+  }
+  memcpy(new_name, qname->local_name, qname->local_name_length + 1); /* Copy NUL */
+  new_qname->local_name = new_name;
+  new_qname->local_name_length = qname->local_name_length;
+
+  new_qname->nspace = qname->nspace;
+  if(qname->uri && qname->nspace)
+    new_qname->uri = raptor_uri_copy(qname->uri);
+
+  return new_qname;
+}
+
+
 #ifdef RAPTOR_DEBUG
 void
 raptor_qname_print(FILE *stream, raptor_qname* name) 
@@ -374,6 +428,9 @@ raptor_free_qname(raptor_qname* name)
   if(!name)
     return;
 
+  if(--name->usage)
+    return;
+
   if(name->local_name)
     RAPTOR_FREE(char*, name->local_name);
 
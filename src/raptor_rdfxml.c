@@ -397,11 +397,17 @@ struct raptor_rdfxml_parser_s {
   raptor_rdfxml_element *root_element;
   raptor_rdfxml_element *current_element;
 
+  /* free list of ended elements linked by parent for reuse */
+  raptor_rdfxml_element *element_pool;
+
   raptor_uri* concepts[RAPTOR_RDFXML_N_CONCEPTS];
 
   /* set of seen rdf:ID / rdf:bagID values (with in-scope base URI) */
   raptor_id_set* id_set;
 
+  /* non-0 if the warning that id_set reached its memory limit was given */
+  int id_set_limit_warned;
+
   void *xml_content;
   size_t xml_content_length;
   raptor_iostream* iostream;
@@ -478,8 +484,9 @@ raptor_rdfxml_element_push(raptor_rdfxml_parser *rdf_xml_parser, raptor_rdfxml_e
 }
 
 
+/* free the content of an element */
 static void
-raptor_free_rdfxml_element(raptor_rdfxml_element *element)
+raptor_rdfxml_element_clear(raptor_rdfxml_element *element)
 {
   int i;
   
@@ -506,11 +513,46 @@ raptor_free_rdfxml_element(raptor_rdfxml_element *element)
 
   if(element->reified_id)
     RAPTOR_FREE(char*, (char*)element->reified_id);
+}
+
+
+static void
+raptor_free_rdfxml_element(raptor_rdfxml_element *element)
+{
+  raptor_rdfxml_element_clear(element);
 
   RAPTOR_FREE(raptor_rdfxml_element, element);
 }
 
 
+/* get a zeroed element from the pool or a new one */
+static raptor_rdfxml_element*
+raptor_rdfxml_new_element(raptor_rdfxml_parser *rdf_xml_parser)
+{
+  raptor_rdfxml_element *element = rdf_xml_parser->element_pool;
+
+  if(!element)
+    return RAPTOR_CALLOC(raptor_rdfxml_element*, 1, sizeof(*element));
+
+  rdf_xml_parser->element_pool = element->parent;
+  memset(element, 0, sizeof(*element));
+
+  return element;
+}
+
+
+/* free the content of an ended element and keep it in the pool */
+static void
+raptor_rdfxml_release_element(raptor_rdfxml_parser *rdf_xml_parser,
+                              raptor_rdfxml_element *element)
+{
+  raptor_rdfxml_element_clear(element);
+
+  element->parent = rdf_xml_parser->element_pool;
+  rdf_xml_parser->element_pool = element;
+}
+
+
 static void
 raptor_rdfxml_sax2_new_namespace_handler(void *user_data,
                                          raptor_namespace* nspace)
@@ -571,7 +613,7 @@ raptor_rdfxml_start_element_handler(void *user_data,
   raptor_rdfxml_update_document_locator(rdf_parser);
 
   /* Create new element structure */
-  element = RAPTOR_CALLOC(raptor_rdfxml_element*, 1, sizeof(*element));
+  element = raptor_rdfxml_new_element(rdf_xml_parser);
   if(!element) {
     raptor_parser_fatal_error(rdf_parser, "Out of memory");
     rdf_parser->failed = 1;
@@ -587,23 +629,14 @@ raptor_rdfxml_start_element_handler(void *user_data,
 
   /* RDF-specific processing of attributes */
   if(ns_attributes_count) {
-    raptor_qname** new_named_attrs;
     int offset = 0;
     raptor_rdfxml_element* parent_element;
 
     parent_element = element->parent;
 
-    /* Allocate new array to move namespaced-attributes to if
-     * rdf processing is performed
+    /* Namespaced-attributes not used by RDF processing are moved down
+     * in place over the deleted ones
      */
-    new_named_attrs = RAPTOR_CALLOC(raptor_qname**, ns_attributes_count, 
-                                    sizeof(raptor_qname*));
-    if(!new_named_attrs) {
-      raptor_parser_fatal_error(rdf_parser, "Out of memory");
-      rdf_parser->failed = 1;
-      return;
-    }
-
     for(i = 0; i < ns_attributes_count; i++) {
       raptor_qname* attr = named_attrs[i];
 
@@ -679,21 +712,12 @@ raptor_rdfxml_start_element_handler(void *user_data,
       } /* end if leave literal XML alone */
 
       if(attr)
-        new_named_attrs[offset++] = attr;
+        named_attrs[offset++] = attr;
     }
 
     /* new attribute count is set from attributes that haven't been skipped */
     ns_attributes_count = offset;
-    if(!ns_attributes_count) {
-      /* all attributes were deleted so delete the new array */
-      RAPTOR_FREE(raptor_qname_array, new_named_attrs);
-      new_named_attrs = NULL;
-    }
-
-    RAPTOR_FREE(raptor_qname_array, named_attrs);
-    named_attrs = new_named_attrs;
-    raptor_xml_element_set_attributes(xml_element, 
-                                      named_attrs, ns_attributes_count);
+    xml_element->attribute_count = ns_attributes_count;
   } /* end if ns_attributes_count */
 
 
@@ -865,7 +889,7 @@ raptor_rdfxml_end_element_handler(void *user_data,
         element->parent->child_state = element->state;
     }
   
-    raptor_free_rdfxml_element(element);
+    raptor_rdfxml_release_element(rdf_xml_parser, element);
   }
 }
 
@@ -1015,9 +1039,20 @@ raptor_rdfxml_parse_start(raptor_parser* rdf_parser)
     rdf_xml_parser->id_set = NULL;
   }
   
+  rdf_xml_parser->id_set_limit_warned = 0;
+
   /* Create a new id_set if needed */
   if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_CHECK_RDF_ID)) {
-    rdf_xml_parser->id_set = raptor_new_id_set(rdf_parser->world);
+    int exact;
+    int memory;
+
+    exact = RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser,
+                                       RAPTOR_OPTION_CHECK_RDF_ID_EXACT);
+    memory = RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser,
+                                        RAPTOR_OPTION_CHECK_RDF_ID_MEMORY);
+
+    rdf_xml_parser->id_set = raptor_new_id_set(rdf_parser->world, exact,
+                                               memory > 0 ? (size_t)memory * 1024 : 0);
     if(!rdf_xml_parser->id_set)
       return 1;
   }
@@ -1042,6 +1077,10 @@ raptor_rdfxml_parse_terminate(raptor_parser *rdf_parser)
   
   while( (element = raptor_rdfxml_element_pop(rdf_xml_parser)) )
     raptor_free_rdfxml_element(element);
+  while( (element = rdf_xml_parser->element_pool) ) {
+    rdf_xml_parser->element_pool = element->parent;
+    RAPTOR_FREE(raptor_rdfxml_element, element);
+  }
 
 
   for(i = 0; i < RAPTOR_RDFXML_N_CONCEPTS; i++) {
@@ -3138,6 +3177,23 @@ raptor_rdfxml_record_ID(raptor_parser *rdf_parser,
 
   rc = raptor_id_set_add(rdf_xml_parser->id_set, base_uri, id, id_len);
 
+  if(!rdf_xml_parser->id_set_limit_warned) {
+    size_t count;
+
+    if(raptor_id_set_reached_limit(rdf_xml_parser->id_set, &count)) {
+      raptor_parser_warning(rdf_parser, "rdf:ID checking reached its memory limit of %d kilobytes after %lu IDs; duplicated rdf:ID values are now only reported as possible",
+                            RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_CHECK_RDF_ID_MEMORY),
+                            (unsigned long)count);
+      rdf_xml_parser->id_set_limit_warned = 1;
+    }
+  }
+
+  /* set over its memory limit cannot be sure */
+  if(rc == 2) {
+    raptor_parser_warning(rdf_parser, "Possibly duplicated rdf:ID value '%s'", id);
+    return 0;
+  }
+
   return (rc != 0);
 }
 
@@ -3197,6 +3253,7 @@ raptor_rdfxml_parser_register_factory(raptor_parser_factory *factory)
   factory->terminate = raptor_rdfxml_parse_terminate;
   factory->start     = raptor_rdfxml_parse_start;
   factory->chunk     = raptor_rdfxml_parse_chunk;
+  factory->whole_document_chunk = 1;
   factory->finish_factory = raptor_rdfxml_parse_finish_factory;
   factory->recognise_syntax = raptor_rdfxml_parse_recognise_syntax;
 
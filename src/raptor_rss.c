@@ -45,6 +45,7 @@
 
 static void raptor_rss_uplift_items(raptor_parser* rdf_parser);
 static int raptor_rss_emit(raptor_parser* rdf_parser);
+static int raptor_rss_end_item(raptor_parser* rdf_parser);
 
 static void raptor_rss_start_element_handler(void *user_data, raptor_xml_element* xml_element);
 static void raptor_rss_end_element_handler(void *user_data, raptor_xml_element* xml_element);
@@ -95,6 +96,15 @@ struct raptor_rss_parser_s {
 
   /* current BLOCK pointer (inside CONTAINER of type current_type) */
   raptor_rss_block *current_block;
+
+  /* namespaces already started with raptor_parser_start_namespace() */
+  char nspaces_started[RAPTOR_RSS_NAMESPACES_SIZE];
+
+  /* rdf:Seq node of the channel items, made when the first item is emitted */
+  raptor_term* items_seq;
+
+  /* number of items emitted into items_seq so far */
+  int items_emitted;
 };
 
 typedef struct raptor_rss_parser_s raptor_rss_parser;
@@ -215,6 +225,9 @@ raptor_rss_parse_terminate(raptor_parser *rdf_parser)
 
   raptor_rss_model_clear(&rss_parser->model);
 
+  if(rss_parser->items_seq)
+    raptor_free_term(rss_parser->items_seq);
+
   for(n = 0; n < RAPTOR_RSS_NAMESPACES_SIZE; n++) {
     if(rss_parser->nspaces[n])
       raptor_free_namespace(rss_parser->nspaces[n]);
@@ -238,8 +251,16 @@ raptor_rss_parse_start(raptor_parser *rdf_parser)
   if(!uri)
     return 1;
 
-  for(n = 0; n < RAPTOR_RSS_NAMESPACES_SIZE; n++)
+  for(n = 0; n < RAPTOR_RSS_NAMESPACES_SIZE; n++) {
     rss_parser->nspaces_seen[n] = 'N';
+    rss_parser->nspaces_started[n] = 'N';
+  }
+
+  if(rss_parser->items_seq) {
+    raptor_free_term(rss_parser->items_seq);
+    rss_parser->items_seq = NULL;
+  }
+  rss_parser->items_emitted = 0;
 
   /* Optionally forbid internal network and file requests in the XML parser */
   raptor_sax2_set_option(rss_parser->sax2, 
@@ -855,6 +876,10 @@ raptor_rss_end_element_handler(void *user_data,
       rss_parser->current_field =  RAPTOR_RSS_FIELD_NONE;
     } else {
       RAPTOR_DEBUG3("Ending element %s type %s\n", name, raptor_rss_items_info[rss_parser->current_type].name);
+      if(rss_parser->current_type == RAPTOR_RSS_ITEM &&
+         raptor_rss_end_item(rdf_parser))
+        rdf_parser->failed = 1;
+
       if(rss_parser->prev_type != RAPTOR_RSS_NONE) {
         rss_parser->current_type = rss_parser->prev_type;
         rss_parser->prev_type = RAPTOR_RSS_NONE;
@@ -1001,6 +1026,62 @@ raptor_rss_insert_rss_link(raptor_parser* rdf_parser,
 }
 
 
+/* Add the identifier of one rss:item; items without one are left
+ * without a term */
+static int
+raptor_rss_insert_item_identifiers(raptor_parser* rdf_parser,
+                                   raptor_rss_item* item)
+{
+  raptor_rss_block *block;
+  raptor_uri* uri = NULL;
+
+  if(!item->fields[RAPTOR_RSS_FIELD_LINK])  {
+    if(raptor_rss_insert_rss_link(rdf_parser, item))
+      return 1;
+  }
+
+  if(item->uri) {
+    uri = raptor_uri_copy(item->uri);
+  } else {
+    if(item->fields[RAPTOR_RSS_FIELD_LINK]) {
+      if(item->fields[RAPTOR_RSS_FIELD_LINK]->value)
+        uri = raptor_new_uri(rdf_parser->world,
+                             (const unsigned char*)item->fields[RAPTOR_RSS_FIELD_LINK]->value);
+      else if(item->fields[RAPTOR_RSS_FIELD_LINK]->uri)
+        uri = raptor_uri_copy(item->fields[RAPTOR_RSS_FIELD_LINK]->uri);
+    } else if(item->fields[RAPTOR_RSS_FIELD_ATOM_ID]) {
+      if(item->fields[RAPTOR_RSS_FIELD_ATOM_ID]->value)
+        uri = raptor_new_uri(rdf_parser->world,
+                             (const unsigned char*)item->fields[RAPTOR_RSS_FIELD_ATOM_ID]->value);
+      else if(item->fields[RAPTOR_RSS_FIELD_ATOM_ID]->uri)
+        uri = raptor_uri_copy(item->fields[RAPTOR_RSS_FIELD_ATOM_ID]->uri);
+    }
+  }
+
+  if(!uri)
+    return 0;
+
+  item->term = raptor_new_term_from_uri(rdf_parser->world, uri);
+  raptor_free_uri(uri);
+  uri = NULL;
+
+  for(block = item->blocks; block; block = block->next) {
+    if(!block->identifier) {
+      const unsigned char *id;
+      /* need to make bnode */
+      id = raptor_world_generate_bnodeid(rdf_parser->world);
+      item->term = raptor_new_term_from_blank(rdf_parser->world, id);
+      RAPTOR_FREE(char*, id);
+    }
+  }
+
+  item->node_type = &raptor_rss_items_info[RAPTOR_RSS_ITEM];
+  item->node_typei = RAPTOR_RSS_ITEM;
+
+  return 0;
+}
+
+
 static int
 raptor_rss_insert_identifiers(raptor_parser* rdf_parser) 
 {
@@ -1072,52 +1153,8 @@ raptor_rss_insert_identifiers(raptor_parser* rdf_parser)
   }
   /* sequence of rss:item */
   for(item = rss_parser->model.items; item; item = item->next) {
-    raptor_rss_block *block;
-    raptor_uri* uri = NULL;
-    
-    if(!item->fields[RAPTOR_RSS_FIELD_LINK])  {
-      if(raptor_rss_insert_rss_link(rdf_parser, item))
-        return 1;
-    }
-    
-
-    if(item->uri) {
-      uri = raptor_uri_copy(item->uri);
-    } else {
-      if(item->fields[RAPTOR_RSS_FIELD_LINK]) {
-        if(item->fields[RAPTOR_RSS_FIELD_LINK]->value)
-          uri = raptor_new_uri(rdf_parser->world,
-                               (const unsigned char*)item->fields[RAPTOR_RSS_FIELD_LINK]->value);
-        else if(item->fields[RAPTOR_RSS_FIELD_LINK]->uri)
-          uri = raptor_uri_copy(item->fields[RAPTOR_RSS_FIELD_LINK]->uri);
-      } else if(item->fields[RAPTOR_RSS_FIELD_ATOM_ID]) {
-        if(item->fields[RAPTOR_RSS_FIELD_ATOM_ID]->value)
-          uri = raptor_new_uri(rdf_parser->world,
-                               (const unsigned char*)item->fields[RAPTOR_RSS_FIELD_ATOM_ID]->value);
-        else if(item->fields[RAPTOR_RSS_FIELD_ATOM_ID]->uri)
-          uri = raptor_uri_copy(item->fields[RAPTOR_RSS_FIELD_ATOM_ID]->uri);
-      }
-    }
-
-    if(!uri)
-      continue;
-
-    item->term = raptor_new_term_from_uri(rdf_parser->world, uri);
-    raptor_free_uri(uri);
-    uri = NULL;
-    
-    for(block = item->blocks; block; block = block->next) {
-      if(!block->identifier) {
-        const unsigned char *id;
-        /* need to make bnode */
-        id = raptor_world_generate_bnodeid(rdf_parser->world);
-        item->term = raptor_new_term_from_blank(rdf_parser->world, id);
-        RAPTOR_FREE(char*, id);
-      }
-    }
-    
-    item->node_type = &raptor_rss_items_info[RAPTOR_RSS_ITEM];
-    item->node_typei = RAPTOR_RSS_ITEM;
+    if(raptor_rss_insert_item_identifiers(rdf_parser, item))
+      return 1;
   }
 
   return 0;
@@ -1359,6 +1396,72 @@ raptor_rss_emit_connection(raptor_parser* rdf_parser,
 }
 
 
+static void
+raptor_rss_start_default_graph(raptor_parser* rdf_parser)
+{
+  if(rdf_parser->emitted_default_graph)
+    return;
+
+  /* Emit start default graph mark */
+  raptor_parser_start_graph(rdf_parser, NULL, 0);
+  rdf_parser->emitted_default_graph++;
+}
+
+
+static void
+raptor_rss_end_default_graph(raptor_parser* rdf_parser)
+{
+  if(rdf_parser->emitted_default_graph) {
+    raptor_parser_end_graph(rdf_parser, NULL, 0);
+    rdf_parser->emitted_default_graph--;
+  }
+}
+
+
+/* Emit one rss:item and add it as the next member of the items rdf:Seq,
+ * making the sequence node when the first item is emitted.  An item
+ * without an identifier is skipped with a warning. */
+static int
+raptor_rss_emit_seq_item(raptor_parser* rdf_parser, raptor_rss_item *item)
+{
+  raptor_rss_parser* rss_parser = (raptor_rss_parser*)rdf_parser->context;
+
+  if(!rss_parser->items_seq) {
+    const unsigned char* id;
+
+    id = raptor_world_generate_bnodeid(rdf_parser->world);
+
+    /* make a new genid for the <rdf:Seq> node */
+    rss_parser->items_seq = raptor_new_term_from_blank(rdf_parser->world, id);
+    RAPTOR_FREE(char*, id);
+    if(!rss_parser->items_seq)
+      return 1;
+
+    /* _:genid1 rdf:type rdf:Seq . */
+    if(raptor_rss_emit_type_triple(rdf_parser, rss_parser->items_seq,
+                                   RAPTOR_RDF_Seq_URI(rdf_parser->world)))
+      return 1;
+  }
+
+  if(!item)
+    return 0;
+
+  if(!item->term) {
+    raptor_parser_warning(rdf_parser, "Skipping RSS item with no identifier");
+    return 0;
+  }
+
+  if(raptor_rss_emit_item(rdf_parser, item) ||
+     raptor_rss_emit_connection(rdf_parser, rss_parser->items_seq, NULL,
+                                rss_parser->items_emitted + 1, item->term))
+    return 1;
+
+  rss_parser->items_emitted++;
+
+  return 0;
+}
+
+
 static int
 raptor_rss_emit(raptor_parser* rdf_parser)
 {
@@ -1369,17 +1472,17 @@ raptor_rss_emit(raptor_parser* rdf_parser)
 
   if(!rss_parser->model.common[RAPTOR_RSS_CHANNEL]) {
     raptor_parser_error(rdf_parser, "No RSS channel item present");
-    return 1;
+    rc = 1;
+    goto tidy;
   }
   
   if(!rss_parser->model.common[RAPTOR_RSS_CHANNEL]->term) {
     raptor_parser_error(rdf_parser, "RSS channel has no identifier");
-    return 1;
+    rc = 1;
+    goto tidy;
   }
 
-  /* Emit start default graph mark */
-  raptor_parser_start_graph(rdf_parser, NULL, 0);
-  rdf_parser->emitted_default_graph++;
+  raptor_rss_start_default_graph(rdf_parser);
 
 
   /* Emit all the common type blocks (channel, author, ...) */
@@ -1416,21 +1519,10 @@ raptor_rss_emit(raptor_parser* rdf_parser)
   }
 
 
-  /* Emit the feed item blocks */
-  if(rss_parser->model.items_count) {
-    const unsigned char* id;
-    raptor_term *items;
-
-    id = raptor_world_generate_bnodeid(rdf_parser->world);
-    
-    /* make a new genid for the <rdf:Seq> node */
-    items = raptor_new_term_from_blank(rdf_parser->world, id);
-    RAPTOR_FREE(char*, id);
-
-    /* _:genid1 rdf:type rdf:Seq . */
-    if(raptor_rss_emit_type_triple(rdf_parser, items,
-                                   RAPTOR_RDF_Seq_URI(rdf_parser->world))) {
-      raptor_free_term(items);
+  /* Emit the feed item blocks that were not already emitted at their
+   * end tag */
+  if(rss_parser->model.items || rss_parser->items_seq) {
+    if(raptor_rss_emit_seq_item(rdf_parser, NULL)) {
       rc = 1;
       goto tidy;
     }
@@ -1439,31 +1531,22 @@ raptor_rss_emit(raptor_parser* rdf_parser)
     if(raptor_rss_emit_connection(rdf_parser,
                                   rss_parser->model.common[RAPTOR_RSS_CHANNEL]->term,
                                   rdf_parser->world->rss_fields_info_uris[RAPTOR_RSS_FIELD_ITEMS], 0,
-                                  items)) {
-      raptor_free_term(items);
+                                  rss_parser->items_seq)) {
       rc= 1;
       goto tidy;
     }
     
     /* sequence of rss:item */
-    for(i = 1, item = rss_parser->model.items; item; item = item->next, i++) {
-      
-      if(raptor_rss_emit_item(rdf_parser, item) ||
-         raptor_rss_emit_connection(rdf_parser, items, NULL, i,item->term)) {
-        raptor_free_term(items);
+    for(item = rss_parser->model.items; item; item = item->next) {
+      if(raptor_rss_emit_seq_item(rdf_parser, item)) {
         rc = 1;
         goto tidy;
       }
     }
-
-    raptor_free_term(items);
   }
 
   tidy:
-  if(rdf_parser->emitted_default_graph) {
-    raptor_parser_end_graph(rdf_parser, NULL, 0);
-    rdf_parser->emitted_default_graph--;
-  }
+  raptor_rss_end_default_graph(rdf_parser);
 
   return rc;
 }
@@ -1586,14 +1669,62 @@ raptor_rss_start_namespaces(raptor_parser* rdf_parser)
     }
   }
 
-  /* start the namespaces */
+  /* start the namespaces not already started */
   for(n = 0; n < RAPTOR_RSS_NAMESPACES_SIZE; n++) {
-    if(rss_parser->nspaces[n] && rss_parser->nspaces_seen[n] == 'Y')
+    if(rss_parser->nspaces[n] && rss_parser->nspaces_seen[n] == 'Y' &&
+       rss_parser->nspaces_started[n] != 'Y') {
       raptor_parser_start_namespace(rdf_parser, rss_parser->nspaces[n]);
+      rss_parser->nspaces_started[n] = 'Y';
+    }
   }
 }
 
 
+/*
+ * raptor_rss_end_item:
+ * @rdf_parser: parser
+ *
+ * INTERNAL - Handle the end tag of an rss:item or atom:entry
+ *
+ * Once the channel has content, the item just ended is given its
+ * identifier, uplifted and emitted immediately and then freed, so that
+ * only the channel and other common blocks are held until the end of
+ * the document.  Items seen before that are buffered and emitted in
+ * order by raptor_rss_emit().
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_rss_end_item(raptor_parser* rdf_parser)
+{
+  raptor_rss_parser* rss_parser = (raptor_rss_parser*)rdf_parser->context;
+  raptor_rss_item* channel = rss_parser->model.common[RAPTOR_RSS_CHANNEL];
+  raptor_rss_item* item = rss_parser->model.last;
+  int rc;
+
+  if(!item || rss_parser->model.items != item ||
+     !channel || !channel->fields_count)
+    return 0;
+
+  rc = raptor_rss_insert_item_identifiers(rdf_parser, item);
+  if(!rc) {
+    raptor_rss_uplift_fields(rss_parser, item);
+
+    /* start the namespaces seen so far before the first triple */
+    raptor_rss_start_namespaces(rdf_parser);
+
+    raptor_rss_start_default_graph(rdf_parser);
+
+    rc = raptor_rss_emit_seq_item(rdf_parser, item);
+  }
+
+  rss_parser->model.items = rss_parser->model.last = NULL;
+  raptor_free_rss_item(item);
+
+  return rc;
+}
+
+
 static int
 raptor_rss_parse_chunk(raptor_parser* rdf_parser, 
                        const unsigned char *s, size_t len,
@@ -1609,12 +1740,15 @@ raptor_rss_parse_chunk(raptor_parser* rdf_parser,
   if(!is_end)
     return 0;
 
-  if(rdf_parser->failed)
+  if(rdf_parser->failed) {
+    raptor_rss_end_default_graph(rdf_parser);
     return 1;
+  }
 
   /* turn strings into URIs, move things around if needed */
   if(raptor_rss_insert_identifiers(rdf_parser)) {
     rdf_parser->failed = 1;
+    raptor_rss_end_default_graph(rdf_parser);
     return 1;
   }
   
@@ -1715,6 +1849,7 @@ raptor_rss_parser_register_factory(raptor_parser_factory *factory)
   factory->terminate = raptor_rss_parse_terminate;
   factory->start     = raptor_rss_parse_start;
   factory->chunk     = raptor_rss_parse_chunk;
+  factory->whole_document_chunk = 1;
   factory->recognise_syntax = raptor_rss_parse_recognise_syntax;
 
   return rc;
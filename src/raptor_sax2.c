@@ -37,16 +37,41 @@
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
 
 /* Raptor includes */
 #include "raptor2.h"
 #include "raptor_internal.h"
 
+#ifdef RAPTOR_XML_LIBXML
+/* for xmlCreateMemoryParserCtxt() */
+#include <libxml/parserInternals.h>
+#endif
+
 
 /* Define this for far too much output */
 #undef RAPTOR_DEBUG_CDATA
 
 
+/* Size of the direct mapped cache of resolved names; a power of 2 */
+#define RAPTOR_SAX2_QNAME_CACHE_SIZE 256
+
+typedef struct raptor_sax2_qname_cache_entry_s {
+  /* name as given by the XML parser or NULL if the entry is empty */
+  unsigned char *name;
+  size_t name_len;
+  /* non-0 for an attribute name, which has no default namespace */
+  int is_attribute;
+  /* shared qname; attribute qnames have an empty value */
+  raptor_qname *qname;
+} raptor_sax2_qname_cache_entry;
+
+
+static void raptor_sax2_qname_cache_flush(raptor_sax2 *sax2);
+
+
 int
 raptor_sax2_init(raptor_world* world)
 {
@@ -127,6 +152,19 @@ raptor_free_sax2(raptor_sax2 *sax2)
   while( (xml_element = raptor_xml_element_pop(sax2)) )
     raptor_free_xml_element(xml_element);
 
+  while( (xml_element = sax2->element_pool) ) {
+    sax2->element_pool = xml_element->parent;
+    raptor_free_xml_element(xml_element);
+  }
+
+  if(sax2->atts_copy)
+    RAPTOR_FREE(cstringpointer, sax2->atts_copy);
+
+  if(sax2->qname_cache) {
+    raptor_sax2_qname_cache_flush(sax2);
+    RAPTOR_FREE(raptor_sax2_qname_cache_entry, sax2->qname_cache);
+  }
+
   raptor_namespaces_clear(&sax2->namespaces);
 
   if(sax2->base_uri)
@@ -293,6 +331,215 @@ raptor_xml_element_push(raptor_sax2 *sax2, raptor_xml_element* element)
 }
 
 
+/* empty the cache of resolved names */
+static void
+raptor_sax2_qname_cache_flush(raptor_sax2 *sax2)
+{
+  int i;
+
+  if(!sax2->qname_cache_count)
+    return;
+
+  for(i = 0; i < RAPTOR_SAX2_QNAME_CACHE_SIZE; i++) {
+    raptor_sax2_qname_cache_entry *entry = &sax2->qname_cache[i];
+
+    if(entry->name) {
+      RAPTOR_FREE(char*, entry->name);
+      entry->name = NULL;
+      raptor_free_qname(entry->qname);
+      entry->qname = NULL;
+    }
+  }
+
+  sax2->qname_cache_count = 0;
+  sax2->qname_cache_depth = 0;
+}
+
+
+/*
+ * raptor_sax2_new_qname:
+ * @sax2: SAX2 object
+ * @name: element or attribute name
+ * @value: attribute value or NULL for an element name
+ *
+ * INTERNAL - Resolve a name into a qname using a cache
+ *
+ * Element names return a qname shared with the cache.  Attribute
+ * names return a new qname with the namespace URI of the cached one.
+ * The cache is flushed whenever the namespaces in scope change, so
+ * a cached name always resolves as raptor_new_qname() would.
+ *
+ * Return value: qname or NULL on failure
+ */
+static raptor_qname*
+raptor_sax2_new_qname(raptor_sax2 *sax2, const unsigned char *name,
+                      const unsigned char *value)
+{
+  raptor_sax2_qname_cache_entry *entry;
+  raptor_qname *qname;
+  int is_attribute = (value != NULL);
+  unsigned int hash = 2166136261U;
+  const unsigned char *p;
+  size_t name_len;
+
+  if(!sax2->qname_cache) {
+    sax2->qname_cache = RAPTOR_CALLOC(raptor_sax2_qname_cache_entry*,
+                                      RAPTOR_SAX2_QNAME_CACHE_SIZE,
+                                      sizeof(*entry));
+    if(!sax2->qname_cache)
+      return raptor_new_qname(&sax2->namespaces, name, value);
+  }
+
+  for(p = name; *p; p++) {
+    hash ^= *p;
+    hash *= 16777619U;
+  }
+  name_len = (size_t)(p - name);
+
+  entry = &sax2->qname_cache[(hash + (unsigned int)is_attribute) &
+                             (RAPTOR_SAX2_QNAME_CACHE_SIZE - 1)];
+  if(entry->name && entry->is_attribute == is_attribute &&
+     entry->name_len == name_len && !memcmp(entry->name, name, name_len)) {
+    if(is_attribute)
+      return raptor_qname_copy_with_value(entry->qname, value);
+
+    entry->qname->usage++;
+    return entry->qname;
+  }
+
+  qname = raptor_new_qname(&sax2->namespaces, name,
+                           is_attribute ? (const unsigned char*)"" : NULL);
+  if(!qname)
+    return NULL;
+
+  /* an undeclared prefix is not cached so it is reported every time */
+  if(qname->nspace || !memchr(name, ':', name_len)) {
+    unsigned char *name_copy = RAPTOR_MALLOC(unsigned char*, name_len + 1);
+
+    if(name_copy) {
+      memcpy(name_copy, name, name_len + 1); /* copy NUL */
+
+      if(entry->name) {
+        RAPTOR_FREE(char*, entry->name);
+        raptor_free_qname(entry->qname);
+      } else
+        sax2->qname_cache_count++;
+
+      entry->name = name_copy;
+      entry->name_len = name_len;
+      entry->is_attribute = is_attribute;
+      entry->qname = qname;
+      qname->usage++;
+
+      if(qname->nspace && qname->nspace->depth > sax2->qname_cache_depth)
+        sax2->qname_cache_depth = qname->nspace->depth;
+    }
+  }
+
+  if(is_attribute) {
+    raptor_qname *attr = raptor_qname_copy_with_value(qname, value);
+
+    raptor_free_qname(qname);
+    return attr;
+  }
+
+  return qname;
+}
+
+
+/*
+ * raptor_sax2_new_xml_element:
+ * @sax2: SAX2 object
+ * @name: element name
+ * @xml_language: in-scope XML language or NULL
+ * @xml_base: XML base URI or NULL
+ *
+ * INTERNAL - Get an XML element for a start tag, reusing a pooled one
+ *
+ * @name, @xml_language and @xml_base become owned by the element
+ * on success.
+ *
+ * Return value: XML element or NULL on failure
+ */
+static raptor_xml_element*
+raptor_sax2_new_xml_element(raptor_sax2 *sax2, raptor_qname *name,
+                            const unsigned char *xml_language,
+                            raptor_uri *xml_base)
+{
+  raptor_xml_element *xml_element = sax2->element_pool;
+
+  if(!xml_element)
+    return raptor_new_xml_element(name, xml_language, xml_base);
+
+  if(!xml_element->content_cdata_sb) {
+    xml_element->content_cdata_sb = raptor_new_stringbuffer();
+    if(!xml_element->content_cdata_sb)
+      return NULL;
+  }
+
+  sax2->element_pool = xml_element->parent;
+  xml_element->parent = NULL;
+
+  xml_element->name = name;
+  xml_element->xml_language = xml_language;
+  xml_element->base_uri = xml_base;
+
+  return xml_element;
+}
+
+
+/*
+ * raptor_sax2_release_xml_element:
+ * @sax2: SAX2 object
+ * @xml_element: XML element
+ *
+ * INTERNAL - Free the content of an ended XML element and pool it
+ *
+ * The element structure, attributes array and CDATA stringbuffer are
+ * kept for the next start tag so the pool grows to the nesting depth.
+ */
+static void
+raptor_sax2_release_xml_element(raptor_sax2 *sax2,
+                                raptor_xml_element *xml_element)
+{
+  unsigned int i;
+
+  for(i = 0; i < xml_element->attribute_count; i++)
+    if(xml_element->attributes[i])
+      raptor_free_qname(xml_element->attributes[i]);
+  xml_element->attribute_count = 0;
+
+  if(xml_element->content_cdata_sb)
+    raptor_stringbuffer_clear(xml_element->content_cdata_sb);
+  xml_element->content_cdata_length = 0;
+  xml_element->content_cdata_seen = 0;
+  xml_element->content_element_seen = 0;
+
+  if(xml_element->base_uri) {
+    raptor_free_uri(xml_element->base_uri);
+    xml_element->base_uri = NULL;
+  }
+
+  if(xml_element->xml_language) {
+    RAPTOR_FREE(char*, xml_element->xml_language);
+    xml_element->xml_language = NULL;
+  }
+
+  raptor_free_qname(xml_element->name);
+  xml_element->name = NULL;
+
+  if(xml_element->declared_nspaces) {
+    raptor_free_sequence(xml_element->declared_nspaces);
+    xml_element->declared_nspaces = NULL;
+  }
+
+  xml_element->user_data = NULL;
+
+  xml_element->parent = sax2->element_pool;
+  sax2->element_pool = xml_element;
+}
+
+
 /**
  * raptor_xml_element_is_empty:
  * @xml_element: XML Element
@@ -459,6 +706,8 @@ raptor_sax2_parse_start(raptor_sax2* sax2, raptor_uri *base_uri)
   }
 #endif
 
+  raptor_sax2_qname_cache_flush(sax2);
+
   raptor_namespaces_clear(&sax2->namespaces);
 
   if(raptor_namespaces_init(sax2->world, &sax2->namespaces, 1)) {
@@ -493,6 +742,8 @@ raptor_sax2_parse_chunk(raptor_sax2* sax2, const unsigned char *buffer,
   
   if(!xc) {
     int libxml_options = 0;
+    /* whole document in one call so parse it from memory in one pass */
+    int whole = (is_end && len <= INT_MAX);
 
     if(!len) {
       /* no data given at all */
@@ -502,9 +753,25 @@ raptor_sax2_parse_chunk(raptor_sax2* sax2, const unsigned char *buffer,
       return 1;
     }
 
-    xc = xmlCreatePushParserCtxt(&sax2->sax, sax2, /* user data */
-                                 (char*)buffer, RAPTOR_BAD_CAST(int, len),
-                                 NULL);
+    if(whole) {
+      xc = xmlCreateMemoryParserCtxt((const char*)buffer,
+                                     RAPTOR_BAD_CAST(int, len));
+      if(!xc)
+        goto handle_error;
+
+      /* replace the default handlers; freed with the context */
+      if(xc->sax)
+        xmlFree(xc->sax);
+      xc->sax = (xmlSAXHandlerPtr)xmlMalloc(sizeof(xmlSAXHandler));
+      if(!xc->sax) {
+        xmlFreeParserCtxt(xc);
+        goto handle_error;
+      }
+      memcpy(xc->sax, &sax2->sax, sizeof(xmlSAXHandler));
+    } else
+      xc = xmlCreatePushParserCtxt(&sax2->sax, sax2, /* user data */
+                                   (char*)buffer, RAPTOR_BAD_CAST(int, len),
+                                   NULL);
     if(!xc)
       goto handle_error;
 
@@ -524,6 +791,14 @@ raptor_sax2_parse_chunk(raptor_sax2* sax2, const unsigned char *buffer,
     
     sax2->xc = xc;
 
+    if(whole) {
+      xmlParseDocument(xc);
+      rc = xc->errNo;
+      if(rc && rc != XML_WAR_UNDECLARED_ENTITY) /* libxml: non 0 is failure */
+        goto handle_error;
+      return 0;
+    }
+
     if(is_end)
       len = 0;
     else
@@ -629,11 +904,9 @@ raptor_sax2_start_element(void* user_data, const unsigned char *name,
 {
   raptor_sax2* sax2 = (raptor_sax2*)user_data;
   raptor_qname* el_name;
-  unsigned char **xml_atts_copy = NULL;
   size_t xml_atts_size = 0;
   int all_atts_count = 0;
   int ns_attributes_count = 0;
-  raptor_qname** named_attrs = NULL;
   raptor_xml_element* xml_element = NULL;
   unsigned char *xml_language = NULL;
   raptor_uri *xml_base = NULL;
@@ -645,19 +918,11 @@ raptor_sax2_start_element(void* user_data, const unsigned char *name,
   if(atts) {
     int i;
     
-    /* Do XML attribute value normalization */
+    /* Do XML attribute value normalization in place; it only
+     * shortens the value and libxml frees it after this call */
     for(i = 0; atts[i]; i += 2) {
-      unsigned char *value = (unsigned char*)atts[i+1];
-      unsigned char *src = value;
-      unsigned char *dst = xmlStrdup(value);
-
-      if(!dst) {
-        raptor_log_error(sax2->world, RAPTOR_LOG_LEVEL_FATAL,
-                         sax2->locator, "Out of memory");
-        return;
-      }
-
-      atts[i+1] = dst;
+      unsigned char *src = (unsigned char*)atts[i+1];
+      unsigned char *dst = src;
 
       while(*src == 0x20 || *src == 0x0d || *src == 0x0a || *src == 0x09) 
         src++;
@@ -672,7 +937,6 @@ raptor_sax2_start_element(void* user_data, const unsigned char *name,
         }
       }
       *dst = '\0';
-      xmlFree(value);
     }
   }
 #endif
@@ -687,12 +951,19 @@ raptor_sax2_start_element(void* user_data, const unsigned char *name,
      */
     for(i = 0; atts[i]; i++) ;
     xml_atts_size = sizeof(unsigned char*) * i;
-    if(xml_atts_size) {
-      xml_atts_copy = RAPTOR_MALLOC(unsigned char**, xml_atts_size);
-      if(!xml_atts_copy)
+    if(xml_atts_size > sax2->atts_copy_size) {
+      const unsigned char **atts_copy;
+
+      atts_copy = RAPTOR_MALLOC(const unsigned char**, xml_atts_size);
+      if(!atts_copy)
         goto fail;
-      memcpy(xml_atts_copy, atts, xml_atts_size);
+      if(sax2->atts_copy)
+        RAPTOR_FREE(cstringpointer, sax2->atts_copy);
+      sax2->atts_copy = atts_copy;
+      sax2->atts_copy_size = xml_atts_size;
     }
+    if(xml_atts_size)
+      memcpy(sax2->atts_copy, atts, xml_atts_size);
 
     /* XML attributes processing:
      *   xmlns*   - XML namespaces (Namespaces in XML REC)
@@ -723,6 +994,8 @@ raptor_sax2_start_element(void* user_data, const unsigned char *name,
 
         if(nspace) {
           raptor_namespaces_start_namespace(&sax2->namespaces, nspace);
+          /* cached names may now resolve differently */
+          raptor_sax2_qname_cache_flush(sax2);
 
           if(sax2->namespace_handler)
             (*sax2->namespace_handler)(sax2->user_data, nspace);
@@ -766,11 +1039,12 @@ raptor_sax2_start_element(void* user_data, const unsigned char *name,
 
 
   /* Create new element structure */
-  el_name = raptor_new_qname(&sax2->namespaces, name, NULL);
+  el_name = raptor_sax2_new_qname(sax2, name, NULL);
   if(!el_name)
     goto fail;
 
-  xml_element = raptor_new_xml_element(el_name, xml_language, xml_base);
+  xml_element = raptor_sax2_new_xml_element(sax2, el_name,
+                                            xml_language, xml_base);
   if(!xml_element) {
     raptor_free_qname(el_name);
     goto fail;
@@ -782,15 +1056,22 @@ raptor_sax2_start_element(void* user_data, const unsigned char *name,
   /* Turn string attributes into namespaced-attributes */
   if(ns_attributes_count) {
     int i;
-    int offset = 0;
-
-    /* Allocate new array to hold namespaced-attributes */
-    named_attrs = RAPTOR_CALLOC(raptor_qname**, ns_attributes_count, 
-                                sizeof(raptor_qname*));
-    if(!named_attrs) {
-      raptor_log_error(sax2->world, RAPTOR_LOG_LEVEL_FATAL,
-                       sax2->locator, "Out of memory");
-      goto fail;
+
+    /* Grow the array to hold namespaced-attributes if needed */
+    if(xml_element->attributes_size < (unsigned int)ns_attributes_count) {
+      raptor_qname** named_attrs;
+
+      named_attrs = RAPTOR_CALLOC(raptor_qname**, ns_attributes_count, 
+                                  sizeof(raptor_qname*));
+      if(!named_attrs) {
+        raptor_log_error(sax2->world, RAPTOR_LOG_LEVEL_FATAL,
+                         sax2->locator, "Out of memory");
+        goto fail;
+      }
+      if(xml_element->attributes)
+        RAPTOR_FREE(raptor_qname_array, xml_element->attributes);
+      xml_element->attributes = named_attrs;
+      xml_element->attributes_size = ns_attributes_count;
     }
 
     for(i = 0; i < all_atts_count; i++) {
@@ -800,48 +1081,33 @@ raptor_sax2_start_element(void* user_data, const unsigned char *name,
       if(!atts[i<<1])
         continue;
 
-      /* namespace-name[i] stored in named_attrs[i] */
-      attr = raptor_new_qname(&sax2->namespaces, atts[i<<1], atts[(i<<1)+1]);
-      if(!attr) { /* failed - tidy up and return */
-        int j;
-
-        for(j = 0; j < i; j++)
-          RAPTOR_FREE(raptor_qname, named_attrs[j]);
-        RAPTOR_FREE(raptor_qname_array, named_attrs);
+      attr = raptor_sax2_new_qname(sax2, atts[i<<1], atts[(i<<1)+1]);
+      if(!attr) /* failed - element frees the ones added so far */
         goto fail;
-      }
 
-      named_attrs[offset++] = attr;
+      xml_element->attributes[xml_element->attribute_count++] = attr;
     }
   } /* end if ns_attributes_count */
 
 
-  if(named_attrs)
-    raptor_xml_element_set_attributes(xml_element,
-                                      named_attrs, ns_attributes_count);
-
   raptor_xml_element_push(sax2, xml_element);
 
   if(sax2->start_element_handler)
     sax2->start_element_handler(sax2->user_data, xml_element);
 
-  if(xml_atts_copy) {
-    /* Restore passed in XML attributes, free the copy */
-    memcpy((void*)atts, xml_atts_copy, xml_atts_size);
-    RAPTOR_FREE(cstringpointer, xml_atts_copy);
-  }
+  /* Restore passed in XML attributes */
+  if(xml_atts_size)
+    memcpy((void*)atts, sax2->atts_copy, xml_atts_size);
 
   return;
 
   fail:
-  if(xml_atts_copy)
-    RAPTOR_FREE(cstringpointer, xml_atts_copy);
   if(xml_base)
     raptor_free_uri(xml_base);
   if(xml_language)
     RAPTOR_FREE(char*, xml_language);
   if(xml_element)
-    raptor_free_xml_element(xml_element);
+    raptor_sax2_release_xml_element(sax2, xml_element);
 }
 
 
@@ -867,11 +1133,16 @@ raptor_sax2_end_element(void* user_data, const unsigned char *name)
       sax2->end_element_handler(sax2->user_data, xml_element);
   }
   
+  /* cached names must not outlive the namespaces they use */
+  if(sax2->qname_cache_count &&
+     raptor_sax2_get_depth(sax2) <= sax2->qname_cache_depth)
+    raptor_sax2_qname_cache_flush(sax2);
+
   raptor_namespaces_end_for_depth(&sax2->namespaces, 
                                   raptor_sax2_get_depth(sax2));
   xml_element = raptor_xml_element_pop(sax2);
   if(xml_element)
-    raptor_free_xml_element(xml_element);
+    raptor_sax2_release_xml_element(sax2, xml_element);
 
   raptor_sax2_dec_depth(sax2);
 }
@@ -42,6 +42,8 @@
 #include "raptor_internal.h"
 
 
+#ifndef STANDALONE
+
 /* prototypes for helper functions */
 static raptor_serializer_factory* raptor_get_serializer_factory(raptor_world* world, const char *name);
 
@@ -584,6 +586,51 @@ raptor_serializer_serialize_statement(raptor_serializer* rdf_serializer,
 }
 
 
+/**
+ * raptor_serializer_serialize_statements:
+ * @rdf_serializer: the #raptor_serializer
+ * @statements: array of #raptor_statement to serialize to a syntax
+ * @count: number of statements in @statements
+ *
+ * Serialize an array of statements.
+ *
+ * This is equivalent to calling raptor_serializer_serialize_statement()
+ * on each statement in order but lets serializers that support it
+ * handle the whole array at once.  Serializing stops at the first
+ * statement that fails.
+ * 
+ * Return value: non-0 on failure.
+ **/
+int
+raptor_serializer_serialize_statements(raptor_serializer* rdf_serializer,
+                                       raptor_statement *statements,
+                                       int count)
+{
+  int i;
+  
+  if(!rdf_serializer->iostream)
+    return 1;
+
+  if(count <= 0)
+    return 0;
+
+  if(rdf_serializer->factory->serialize_statements)
+    return rdf_serializer->factory->serialize_statements(rdf_serializer,
+                                                         statements, count);
+
+  for(i = 0; i < count; i++) {
+    int rc;
+
+    rc = rdf_serializer->factory->serialize_statement(rdf_serializer,
+                                                      &statements[i]);
+    if(rc)
+      return rc;
+  }
+
+  return 0;
+}
+
+
 /**
  * raptor_serializer_serialize_end:
  * @rdf_serializer:  the #raptor_serializer
@@ -773,7 +820,8 @@ raptor_serializer_get_description(raptor_serializer *rdf_serializer)
  *
  * In serializers that can generate blocks of content, this causes
  * the writing of any current pending block.  For example in Turtle
- * this may write all pending triples.
+ * this may write all pending triples.  Any output buffered by the
+ * iostream is then passed to its sink with raptor_iostream_flush().
  * 
  * Return value: non-0 on failure
  **/
@@ -787,5 +835,250 @@ raptor_serializer_flush(raptor_serializer *rdf_serializer)
   else
     rc = 0;
 
+  if(rdf_serializer->iostream &&
+     raptor_iostream_flush(rdf_serializer->iostream))
+    rc = 1;
+
+  return rc;
+}
+
+
+/* end not STANDALONE */
+#endif
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+static const char *program;
+
+/* more than one N-Triples batch */
+#define TEST_STATEMENTS_COUNT 2500
+
+
+static raptor_statement*
+test_make_statements(raptor_world* world, int count)
+{
+  raptor_statement* statements;
+  int i;
+
+  statements = RAPTOR_CALLOC(raptor_statement*, count, sizeof(*statements));
+  if(!statements)
+    return NULL;
+
+  for(i = 0; i < count; i++) {
+    raptor_statement* s = &statements[i];
+    char buffer[64];
+
+    raptor_statement_init(s, world);
+
+    if(i % 5) {
+      sprintf(buffer, "http://example.org/s%d", i / 3);
+      s->subject = raptor_new_term_from_uri_string(world,
+                                                   (const unsigned char*)buffer);
+    } else {
+      sprintf(buffer, "b%d", i);
+      s->subject = raptor_new_term_from_blank(world,
+                                              (const unsigned char*)buffer);
+    }
+
+    sprintf(buffer, "http://example.org/p%d", i % 7);
+    s->predicate = raptor_new_term_from_uri_string(world,
+                                                   (const unsigned char*)buffer);
+
+    sprintf(buffer, "value \"%d\"\n\t\xc3\xa9", i);
+    s->object = raptor_new_term_from_literal(world,
+                                             (const unsigned char*)buffer,
+                                             NULL,
+                                             (i % 2) ? (const unsigned char*)"en" : NULL);
+
+    if(i % 3) {
+      sprintf(buffer, "http://example.org/g%d", i % 4);
+      s->graph = raptor_new_term_from_uri_string(world,
+                                                 (const unsigned char*)buffer);
+    }
+  }
+
+  return statements;
+}
+
+
+static void
+test_free_statements(raptor_statement* statements, int count)
+{
+  int i;
+
+  for(i = 0; i < count; i++)
+    raptor_statement_clear(&statements[i]);
+  RAPTOR_FREE(raptor_statement*, statements);
+}
+
+
+/*
+ * Serialize @statements with @name one at a time when @bulk is 0,
+ * otherwise through raptor_serializer_serialize_statements() in
+ * slices of @bulk statements, with empty and negative counts between
+ */
+static int
+test_serialize(raptor_world* world, const char* name, int threads,
+               raptor_statement* statements, int count, int bulk,
+               void** string_p, size_t* length_p)
+{
+  raptor_serializer* serializer;
+  raptor_uri* base_uri;
+  int rc = 0;
+  int i;
+
+  *string_p = NULL;
+
+  serializer = raptor_new_serializer(world, name);
+  if(!serializer)
+    return 1;
+
+  if(threads)
+    raptor_serializer_set_option(serializer, RAPTOR_OPTION_NTRIPLES_THREADS,
+                                 NULL, threads);
+
+  /* no iostream yet */
+  if(!raptor_serializer_serialize_statements(serializer, statements, count)) {
+    fprintf(stderr,
+            "%s: %s serialize statements before start did not fail\n",
+            program, name);
+    rc = 1;
+  }
+
+  base_uri = raptor_new_uri(world, (const unsigned char*)"http://example.org/");
+  if(raptor_serializer_start_to_string(serializer, base_uri,
+                                       string_p, length_p)) {
+    rc = 1;
+    goto tidy;
+  }
+
+  for(i = 0; i < count; ) {
+    int n;
+
+    if(!bulk) {
+      if(raptor_serializer_serialize_statement(serializer, &statements[i]))
+        rc = 1;
+      i++;
+      continue;
+    }
+
+    n = count - i;
+    if(n > bulk)
+      n = bulk;
+
+    if(raptor_serializer_serialize_statements(serializer, &statements[i], n) ||
+       raptor_serializer_serialize_statements(serializer, &statements[i], 0) ||
+       raptor_serializer_serialize_statements(serializer, NULL, -1))
+      rc = 1;
+    i += n;
+  }
+
+  if(raptor_serializer_serialize_end(serializer))
+    rc = 1;
+
+  tidy:
+  raptor_free_serializer(serializer);
+  raptor_free_uri(base_uri);
+
   return rc;
 }
+
+
+static int
+test_serialize_statements(raptor_world* world, const char* name, int threads,
+                          raptor_statement* statements, int count, int bulk)
+{
+  void* expected = NULL;
+  size_t expected_len = 0;
+  void* string = NULL;
+  size_t string_len = 0;
+  int rc = 0;
+
+#if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
+  fprintf(stderr, "%s: Testing %s serialize statements in slices of %d\n",
+          program, name, bulk);
+#endif
+
+  if(test_serialize(world, name, 0, statements, count, 0,
+                    &expected, &expected_len) ||
+     test_serialize(world, name, threads, statements, count, bulk,
+                    &string, &string_len)) {
+    fprintf(stderr, "%s: %s serializing failed\n", program, name);
+    rc = 1;
+    goto tidy;
+  }
+
+  if(!expected || !string || expected_len != string_len ||
+     memcmp(expected, string, expected_len)) {
+    fprintf(stderr,
+            "%s: %s serialize statements in slices of %d wrote %d bytes, expected the %d bytes written one statement at a time\n",
+            program, name, bulk, (int)string_len, (int)expected_len);
+    rc = 1;
+  }
+
+  tidy:
+  if(expected)
+    raptor_free_memory(expected);
+  if(string)
+    raptor_free_memory(string);
+
+  if(rc)
+    fprintf(stderr, "%s: FAILED Testing %s serialize statements\n",
+            program, name);
+
+  return rc;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  raptor_world *world;
+  raptor_statement* statements;
+  int failures = 0;
+
+  program = raptor_basename(argv[0]);
+
+  world = raptor_new_world();
+  if(!world || raptor_world_open(world))
+    exit(1);
+
+  statements = test_make_statements(world, TEST_STATEMENTS_COUNT);
+  if(!statements) {
+    fprintf(stderr, "%s: Failed to create statements\n", program);
+    exit(1);
+  }
+
+  /* serializer with its own serialize_statements */
+  failures += test_serialize_statements(world, "ntriples", 0, statements,
+                                        TEST_STATEMENTS_COUNT, 1);
+  failures += test_serialize_statements(world, "ntriples", 0, statements,
+                                        TEST_STATEMENTS_COUNT, 1000);
+  failures += test_serialize_statements(world, "nquads", 0, statements,
+                                        TEST_STATEMENTS_COUNT,
+                                        TEST_STATEMENTS_COUNT);
+  failures += test_serialize_statements(world, "nquads", 3, statements,
+                                        TEST_STATEMENTS_COUNT, 700);
+
+  /* serializers using the serialize_statement loop */
+  if(raptor_world_is_serializer_name(world, "rdfxml"))
+    failures += test_serialize_statements(world, "rdfxml", 0, statements,
+                                          TEST_STATEMENTS_COUNT, 700);
+  if(raptor_world_is_serializer_name(world, "turtle"))
+    failures += test_serialize_statements(world, "turtle", 0, statements,
+                                          TEST_STATEMENTS_COUNT,
+                                          TEST_STATEMENTS_COUNT);
+
+  test_free_statements(statements, TEST_STATEMENTS_COUNT);
+
+  raptor_free_world(world);
+
+  return failures;
+}
+
+#endif
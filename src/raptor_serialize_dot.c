@@ -50,9 +50,18 @@ typedef struct {
   raptor_sequence *resources;
   raptor_sequence *literals;
   raptor_sequence *bnodes;
+
+  /* Open addressing hash table of the terms in the sequences above
+   * (shared pointers) with a power of 2 size; NULL marks an empty slot */
+  raptor_term **nodes_table;
+  int nodes_table_size;
+  int nodes_count;
 } raptor_dot_context;
 
 
+#define RAPTOR_DOT_NODES_TABLE_INITIAL_SIZE 64
+
+
 /* add a namespace */
 static int
 raptor_dot_serializer_declare_namespace_from_namespace(raptor_serializer* serializer,
@@ -125,6 +134,13 @@ raptor_dot_serializer_init(raptor_serializer *serializer, const char *name)
   context->bnodes =
     raptor_new_sequence((raptor_data_free_handler)raptor_free_term, NULL);
 
+  context->nodes_table_size = RAPTOR_DOT_NODES_TABLE_INITIAL_SIZE;
+  context->nodes_table = RAPTOR_CALLOC(raptor_term**,
+                                       context->nodes_table_size,
+                                       sizeof(raptor_term*));
+  if(!context->nodes_table)
+    return 1;
+
   return 0;
 }
 
@@ -259,16 +275,66 @@ raptor_dot_serializer_write_term(raptor_serializer * serializer,
 }
 
 
-/* Check the list to see if the node is a duplicate. If not, add it
- * to the list.
+/* Return the slot holding a term equal to @term or the empty slot
+ * where it belongs.
  */
-static void
+static raptor_term**
+raptor_dot_serializer_find_node(raptor_term** table, int table_size,
+                                raptor_term* term, unsigned int hash)
+{
+  unsigned int mask = (unsigned int)table_size - 1;
+  unsigned int i;
+
+  for(i = hash & mask; table[i]; i = (i + 1) & mask) {
+    if(raptor_term_equals(table[i], term))
+      break;
+  }
+
+  return &table[i];
+}
+
+
+static int
+raptor_dot_serializer_grow_nodes(raptor_dot_context* context)
+{
+  int new_size = context->nodes_table_size << 1;
+  raptor_term** new_table;
+  int i;
+
+  new_table = RAPTOR_CALLOC(raptor_term**, new_size, sizeof(raptor_term*));
+  if(!new_table)
+    return 1;
+
+  for(i = 0; i < context->nodes_table_size; i++) {
+    raptor_term* term = context->nodes_table[i];
+
+    if(term)
+      *raptor_dot_serializer_find_node(new_table, new_size, term,
+                                       raptor_term_hash(term)) = term;
+  }
+
+  RAPTOR_FREE(raptor_term**, context->nodes_table);
+  context->nodes_table = new_table;
+  context->nodes_table_size = new_size;
+
+  return 0;
+}
+
+
+/* Check the hash of nodes to see if the node is a duplicate. If not,
+ * add it to the list for its type, keeping first-seen order.
+ *
+ * Return value: non-0 on failure
+ */
+static int
 raptor_dot_serializer_assert_node(raptor_serializer* serializer,
                                   raptor_term* assert_node)
 {
   raptor_dot_context* context = (raptor_dot_context*)serializer->context;
   raptor_sequence* seq = NULL;
-  int i;
+  raptor_term** slot;
+  raptor_term* node;
+  unsigned int hash;
 
   /* Which list are we searching? */
   switch(assert_node->type) {
@@ -288,14 +354,34 @@ raptor_dot_serializer_assert_node(raptor_serializer* serializer,
       break;
   }
 
-  for(i = 0 ; i < raptor_sequence_size(seq) ; i++ ) {
-    raptor_term* node = (raptor_term*)raptor_sequence_get_at(seq, i);
+  if(!seq)
+    return 0;
 
-    if(raptor_term_equals(node, assert_node))
-      return;
+  hash = raptor_term_hash(assert_node);
+  slot = raptor_dot_serializer_find_node(context->nodes_table,
+                                         context->nodes_table_size,
+                                         assert_node, hash);
+  if(*slot)
+    return 0;
+
+  /* keep the table at most half full so that it always has an empty
+   * slot to end a search */
+  if(context->nodes_count + 1 > (context->nodes_table_size >> 1)) {
+    if(raptor_dot_serializer_grow_nodes(context))
+      return 1;
+    slot = raptor_dot_serializer_find_node(context->nodes_table,
+                                           context->nodes_table_size,
+                                           assert_node, hash);
   }
 
-  raptor_sequence_push(seq, raptor_term_copy(assert_node));
+  node = raptor_term_copy(assert_node);
+  if(!node || raptor_sequence_push(seq, node))
+    return 1;
+
+  *slot = node;
+  context->nodes_count++;
+
+  return 0;
 }
 
 
@@ -458,6 +544,9 @@ raptor_dot_serializer_end(raptor_serializer* serializer)
   }
   raptor_free_sequence(context->literals);
 
+  RAPTOR_FREE(raptor_term**, context->nodes_table);
+  context->nodes_table = NULL;
+
   raptor_iostream_string_write((const unsigned char*)"\n\tlabel=\"\\n\\nModel:\\n",
                                serializer->iostream);
   if(serializer->base_uri)
@@ -506,9 +595,13 @@ raptor_dot_serializer_end(raptor_serializer* serializer)
 static void
 raptor_dot_serializer_terminate(raptor_serializer* serializer)
 {
-  /* raptor_dot_context* context = (raptor_dot_context*)serializer->context; */
+  raptor_dot_context* context = (raptor_dot_context*)serializer->context;
 
-  /* Everything should have been freed in raptor_dot_serializer_end */
+  /* Everything else should have been freed in raptor_dot_serializer_end */
+  if(context->nodes_table) {
+    RAPTOR_FREE(raptor_term**, context->nodes_table);
+    context->nodes_table = NULL;
+  }
 }
 
 /* serialize a statement */
@@ -517,8 +610,9 @@ raptor_dot_serializer_statement(raptor_serializer* serializer,
                                 raptor_statement *statement)
 {
   /* Cache the nodes for later. */
-  raptor_dot_serializer_assert_node(serializer, statement->subject);
-  raptor_dot_serializer_assert_node(serializer, statement->object);
+  if(raptor_dot_serializer_assert_node(serializer, statement->subject) ||
+     raptor_dot_serializer_assert_node(serializer, statement->object))
+    return 1;
 
   raptor_iostream_string_write((const unsigned char*)"\t\"",
                                serializer->iostream);
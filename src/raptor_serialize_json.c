@@ -57,6 +57,23 @@ typedef struct {
 
   int need_object_comma;
 
+  /* non-0 if is_resource and writing each subject as soon as the
+   * next one starts (RAPTOR_OPTION_JSON_STREAM) */
+  int stream;
+
+  /* non-0 if a subject came back after its triples were written */
+  int stream_failed;
+
+  /* Subject of the triples held in avltree if stream (owned) */
+  raptor_term* stream_subject;
+
+  /* Copy of last statement written if stream (owned) */
+  raptor_statement* stream_last_statement;
+
+  /* Subjects already written if stream and repeated subjects are
+   * checked (RAPTOR_OPTION_JSON_STREAM_CHECK); owned terms */
+  raptor_avltree* stream_done;
+
 } raptor_json_context;
 
 
@@ -67,6 +84,7 @@ static int raptor_json_serialize_start(raptor_serializer* serializer);
 static int raptor_json_serialize_statement(raptor_serializer* serializer, 
                                            raptor_statement *statement);
 static int raptor_json_serialize_end(raptor_serializer* serializer);
+static int raptor_json_serialize_avltree_visit(int depth, void* data, void *user_data);
 static void raptor_json_serialize_finish_factory(raptor_serializer_factory* factory);
 
 
@@ -105,6 +123,21 @@ raptor_json_serialize_terminate(raptor_serializer* serializer)
     raptor_free_avltree(context->avltree);
     context->avltree = NULL;
   }
+
+  if(context->stream_subject) {
+    raptor_free_term(context->stream_subject);
+    context->stream_subject = NULL;
+  }
+
+  if(context->stream_last_statement) {
+    raptor_free_statement(context->stream_last_statement);
+    context->stream_last_statement = NULL;
+  }
+
+  if(context->stream_done) {
+    raptor_free_avltree(context->stream_done);
+    context->stream_done = NULL;
+  }
 }
 
 
@@ -125,6 +158,8 @@ raptor_json_serialize_start(raptor_serializer* serializer)
     return 1;
 
   if(context->is_resource) {
+    context->stream = RAPTOR_OPTIONS_GET_NUMERIC(serializer,
+                                                 RAPTOR_OPTION_JSON_STREAM);
     context->avltree = raptor_new_avltree((raptor_data_compare_handler)raptor_statement_compare,
                                           (raptor_data_free_handler)raptor_free_statement,
                                           0);
@@ -133,6 +168,20 @@ raptor_json_serialize_start(raptor_serializer* serializer)
       context->json_writer = NULL;
       return 1;
     }
+
+    if(context->stream &&
+       RAPTOR_OPTIONS_GET_NUMERIC(serializer, RAPTOR_OPTION_JSON_STREAM_CHECK)) {
+      context->stream_done = raptor_new_avltree((raptor_data_compare_handler)raptor_term_compare,
+                                                (raptor_data_free_handler)raptor_free_term,
+                                                0);
+      if(!context->stream_done) {
+        raptor_free_avltree(context->avltree);
+        context->avltree = NULL;
+        raptor_free_json_writer(context->json_writer);
+        context->json_writer = NULL;
+        return 1;
+      }
+    }
   }
 
   /* start callback */
@@ -152,12 +201,55 @@ raptor_json_serialize_start(raptor_serializer* serializer)
                                          serializer->iostream);
     raptor_json_writer_start_block(context->json_writer, '[');
     raptor_json_writer_newline(context->json_writer);
+  } else if(context->stream) {
+    /* start outer object now since subjects are written as they end */
+    raptor_json_writer_newline(context->json_writer);
+    raptor_json_writer_start_block(context->json_writer, '{');
+    raptor_json_writer_newline(context->json_writer);
   }
   
   return 0;
 }
 
 
+/*
+ * raptor_json_serialize_stream_flush:
+ * @serializer: serializer
+ *
+ * INTERNAL - Write the triples of the current subject held in the
+ * avltree and empty it, keeping a copy of the last statement written.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_json_serialize_stream_flush(raptor_serializer* serializer)
+{
+  raptor_json_context* context = (raptor_json_context*)serializer->context;
+  raptor_statement* last;
+
+  if(!raptor_avltree_size(context->avltree))
+    return 0;
+
+  raptor_avltree_visit(context->avltree,
+                       raptor_json_serialize_avltree_visit,
+                       serializer);
+
+  /* last_statement now points into the tree about to be emptied */
+  last = raptor_statement_copy(context->last_statement);
+  if(context->stream_last_statement)
+    raptor_free_statement(context->stream_last_statement);
+  context->stream_last_statement = last;
+  context->last_statement = last;
+
+  raptor_free_avltree(context->avltree);
+  context->avltree = raptor_new_avltree((raptor_data_compare_handler)raptor_statement_compare,
+                                        (raptor_data_free_handler)raptor_free_statement,
+                                        0);
+
+  return (!last || !context->avltree);
+}
+
+
 static int
 raptor_json_serialize_statement(raptor_serializer* serializer, 
                                 raptor_statement *statement)
@@ -165,7 +257,45 @@ raptor_json_serialize_statement(raptor_serializer* serializer,
   raptor_json_context* context = (raptor_json_context*)serializer->context;
 
   if(context->is_resource) {
-    raptor_statement* s = raptor_statement_copy(statement);
+    raptor_statement* s;
+
+    if(context->stream) {
+      if(context->stream_failed)
+        return 1;
+
+      if(!context->stream_subject ||
+         !raptor_term_equals(statement->subject, context->stream_subject)) {
+        if(raptor_json_serialize_stream_flush(serializer))
+          return 1;
+
+        if(context->stream_subject) {
+          if(context->stream_done) {
+            /* the tree takes ownership of the subject */
+            if(raptor_avltree_add(context->stream_done,
+                                  context->stream_subject) < 0) {
+              context->stream_subject = NULL;
+              return 1;
+            }
+          } else
+            raptor_free_term(context->stream_subject);
+          context->stream_subject = NULL;
+        }
+
+        /* The subject's earlier triples are already written and
+         * cannot be merged with these */
+        if(context->stream_done &&
+           raptor_avltree_search(context->stream_done, statement->subject)) {
+          raptor_log_error(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                           "JSON serializer stream input is not grouped by subject");
+          context->stream_failed = 1;
+          return 1;
+        }
+
+        context->stream_subject = raptor_term_copy(statement->subject);
+      }
+    }
+
+    s = raptor_statement_copy(statement);
     if(!s)
       return 1;
     return raptor_avltree_add(context->avltree, s);
@@ -338,16 +468,22 @@ raptor_json_serialize_end(raptor_serializer* serializer)
   raptor_json_context* context = (raptor_json_context*)serializer->context;
   char* value;
   
-  raptor_json_writer_newline(context->json_writer);
+  if(!context->stream)
+    raptor_json_writer_newline(context->json_writer);
 
   if(context->is_resource) {
-    /* start outer object */
-    raptor_json_writer_start_block(context->json_writer, '{');
-    raptor_json_writer_newline(context->json_writer);
+    if(context->stream) {
+      /* outer object was started by raptor_json_serialize_start() */
+      raptor_json_serialize_stream_flush(serializer);
+    } else {
+      /* start outer object */
+      raptor_json_writer_start_block(context->json_writer, '{');
+      raptor_json_writer_newline(context->json_writer);
     
-    raptor_avltree_visit(context->avltree,
-                         raptor_json_serialize_avltree_visit,
-                         serializer);
+      raptor_avltree_visit(context->avltree,
+                           raptor_json_serialize_avltree_visit,
+                           serializer);
+    }
 
     /* end last triples block */
     if(context->last_statement) {
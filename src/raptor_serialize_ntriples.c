@@ -40,12 +40,82 @@
 #include "raptor2.h"
 #include "raptor_internal.h"
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+
+#ifdef HAVE_PTHREAD
+/*
+ * Worker pool formatting batches of statements in parallel
+ *
+ * Statements are copied into batches of RAPTOR_NTRIPLES_BATCH_SIZE.
+ * There are two rounds of one batch per worker: while the workers
+ * format one round into strings, the next round is filled.  When it
+ * is full, the formatted round is written to the iostream in order
+ * and the full round is handed to the workers.
+ */
+
+#define RAPTOR_NTRIPLES_BATCH_SIZE 1024
+
+typedef struct {
+  raptor_statement* statements;
+  int count;
+
+  /* formatted output of the statements or NULL on failure */
+  void* string;
+  size_t length;
+} raptor_ntriples_batch;
+
+typedef struct raptor_ntriples_pool_s raptor_ntriples_pool;
+
+typedef struct {
+  raptor_ntriples_pool* pool;
+  int index;
+  pthread_t thread;
+} raptor_ntriples_worker;
+
+struct raptor_ntriples_pool_s {
+  raptor_world* world;
+  int write_graph_term;
+
+  int workers_count;
+  raptor_ntriples_worker* workers;
+
+  /* 2 rounds of workers_count batches */
+  raptor_ntriples_batch* batches;
+
+  /* round and batch in it being filled */
+  int fill_round;
+  int fill_index;
+
+  /* non-0 if the other round was handed to the workers */
+  int in_flight;
+
+  /* fields below are protected by lock */
+  pthread_mutex_t lock;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+  /* incremented each time a round is handed to the workers */
+  unsigned int generation;
+  int work_round;
+  /* number of workers still formatting work_round */
+  int busy;
+  int quit;
+};
+#endif
+
 
 /*
  * Raptor N-Triples serializer object
  */
 typedef struct {
   int is_nquads;
+
+#ifdef HAVE_PTHREAD
+  /* worker pool if RAPTOR_OPTION_NTRIPLES_THREADS > 1 */
+  raptor_ntriples_pool* pool;
+#endif
 } raptor_ntriples_serializer_context;
 
 
@@ -63,11 +133,26 @@ raptor_ntriples_serialize_init(raptor_serializer* serializer, const char *name)
 }
   
 
+#ifdef HAVE_PTHREAD
+static void raptor_free_ntriples_pool(raptor_ntriples_pool* pool);
+#endif
+
+
 /* destroy a serializer */
 static void
 raptor_ntriples_serialize_terminate(raptor_serializer* serializer)
 {
+#ifdef HAVE_PTHREAD
+  raptor_ntriples_serializer_context* ntriples_serializer;
+
+  ntriples_serializer = (raptor_ntriples_serializer_context*)serializer->context;
 
+  /* serializing was not ended so any pending statements are dropped */
+  if(ntriples_serializer->pool) {
+    raptor_free_ntriples_pool(ntriples_serializer->pool);
+    ntriples_serializer->pool = NULL;
+  }
+#endif
 }
   
 
@@ -82,14 +167,37 @@ raptor_ntriples_serialize_declare_namespace(raptor_serializer* serializer,
 }
 
 
-#if 0
+#ifdef HAVE_PTHREAD
+static raptor_ntriples_pool* raptor_new_ntriples_pool(raptor_world* world, int workers_count, int write_graph_term);
+#endif
+
+
 /* start a serialize */
 static int
 raptor_ntriples_serialize_start(raptor_serializer* serializer)
 {
+#ifdef HAVE_PTHREAD
+  raptor_ntriples_serializer_context* ntriples_serializer;
+  int threads;
+
+  ntriples_serializer = (raptor_ntriples_serializer_context*)serializer->context;
+
+  if(ntriples_serializer->pool) {
+    raptor_free_ntriples_pool(ntriples_serializer->pool);
+    ntriples_serializer->pool = NULL;
+  }
+
+  threads = RAPTOR_OPTIONS_GET_NUMERIC(serializer,
+                                       RAPTOR_OPTION_NTRIPLES_THREADS);
+  /* if the pool cannot be made, statements are written as they arrive */
+  if(threads > 1)
+    ntriples_serializer->pool = raptor_new_ntriples_pool(serializer->world,
+                                                         threads,
+                                                         ntriples_serializer->is_nquads);
+#endif
+
   return 0;
 }
-#endif
 
 
 
@@ -213,6 +321,350 @@ raptor_statement_ntriples_write(const raptor_statement *statement,
 }
 
 
+#ifdef HAVE_PTHREAD
+/*
+ * raptor_ntriples_format_statements:
+ * @world: world
+ * @statements: array of statements
+ * @count: number of statements
+ * @write_graph_term: flag to write graph term if present
+ * @string_p: pointer to store the new string
+ * @length_p: pointer to store the string length
+ *
+ * INTERNAL - Format statements in N-Triples or N-Quads into one string
+ *
+ * The workers format into strings since the batches must be written
+ * to the serializer iostream in order, after the ones before them.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_ntriples_format_statements(raptor_world* world,
+                                  raptor_statement* statements, int count,
+                                  int write_graph_term,
+                                  void** string_p, size_t* length_p)
+{
+  raptor_iostream* iostr;
+  int rc = 0;
+  int i;
+
+  *string_p = NULL;
+  *length_p = 0;
+
+  iostr = raptor_new_iostream_to_string(world, string_p, length_p, NULL);
+  if(!iostr)
+    return 1;
+
+  for(i = 0; i < count; i++) {
+    if(raptor_statement_ntriples_write(&statements[i], iostr,
+                                       write_graph_term)) {
+      rc = 1;
+      break;
+    }
+  }
+
+  raptor_free_iostream(iostr);
+
+  if(!*string_p)
+    rc = 1;
+  if(rc && *string_p) {
+    raptor_free_memory(*string_p);
+    *string_p = NULL;
+  }
+
+  return rc;
+}
+
+
+static void
+raptor_ntriples_batch_format(raptor_ntriples_pool* pool,
+                             raptor_ntriples_batch* batch)
+{
+  batch->string = NULL;
+  batch->length = 0;
+
+  if(!batch->count)
+    return;
+
+  raptor_ntriples_format_statements(pool->world,
+                                    batch->statements, batch->count,
+                                    pool->write_graph_term,
+                                    &batch->string, &batch->length);
+}
+
+
+static void*
+raptor_ntriples_worker_run(void* arg)
+{
+  raptor_ntriples_worker* worker = (raptor_ntriples_worker*)arg;
+  raptor_ntriples_pool* pool = worker->pool;
+  unsigned int generation = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  while(1) {
+    raptor_ntriples_batch* batch;
+
+    while(!pool->quit && pool->generation == generation)
+      pthread_cond_wait(&pool->work_cond, &pool->lock);
+
+    if(pool->quit)
+      break;
+
+    generation = pool->generation;
+    batch = &pool->batches[pool->work_round * pool->workers_count +
+                           worker->index];
+    pthread_mutex_unlock(&pool->lock);
+
+    raptor_ntriples_batch_format(pool, batch);
+
+    pthread_mutex_lock(&pool->lock);
+    if(!--pool->busy)
+      pthread_cond_signal(&pool->done_cond);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+
+static void
+raptor_ntriples_pool_clear_round(raptor_ntriples_pool* pool, int round)
+{
+  int i;
+
+  for(i = 0; i < pool->workers_count; i++) {
+    raptor_ntriples_batch* batch;
+    int j;
+
+    batch = &pool->batches[round * pool->workers_count + i];
+    for(j = 0; j < batch->count; j++)
+      raptor_statement_clear(&batch->statements[j]);
+    batch->count = 0;
+
+    if(batch->string) {
+      raptor_free_memory(batch->string);
+      batch->string = NULL;
+    }
+  }
+}
+
+
+static void
+raptor_ntriples_pool_stop(raptor_ntriples_pool* pool, int count)
+{
+  int i;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = 1;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->lock);
+
+  for(i = 0; i < count; i++)
+    pthread_join(pool->workers[i].thread, NULL);
+}
+
+
+static raptor_ntriples_pool*
+raptor_new_ntriples_pool(raptor_world* world, int workers_count,
+                         int write_graph_term)
+{
+  raptor_ntriples_pool* pool;
+  int batches_count = workers_count << 1;
+  int i;
+
+  pool = RAPTOR_CALLOC(raptor_ntriples_pool*, 1, sizeof(*pool));
+  if(!pool)
+    return NULL;
+
+  pool->world = world;
+  pool->write_graph_term = write_graph_term;
+
+  pool->workers = RAPTOR_CALLOC(raptor_ntriples_worker*, workers_count,
+                                sizeof(*pool->workers));
+  pool->batches = RAPTOR_CALLOC(raptor_ntriples_batch*, batches_count,
+                                sizeof(*pool->batches));
+  if(!pool->workers || !pool->batches)
+    goto failed;
+
+  for(i = 0; i < batches_count; i++) {
+    pool->batches[i].statements =
+      RAPTOR_CALLOC(raptor_statement*, RAPTOR_NTRIPLES_BATCH_SIZE,
+                    sizeof(raptor_statement));
+    if(!pool->batches[i].statements)
+      goto failed;
+  }
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+
+  for(i = 0; i < workers_count; i++) {
+    pool->workers[i].pool = pool;
+    pool->workers[i].index = i;
+    if(pthread_create(&pool->workers[i].thread, NULL,
+                      raptor_ntriples_worker_run, &pool->workers[i])) {
+      raptor_ntriples_pool_stop(pool, i);
+      pthread_cond_destroy(&pool->done_cond);
+      pthread_cond_destroy(&pool->work_cond);
+      pthread_mutex_destroy(&pool->lock);
+      goto failed;
+    }
+  }
+
+  pool->workers_count = workers_count;
+
+  return pool;
+
+  failed:
+  if(pool->batches) {
+    for(i = 0; i < batches_count; i++) {
+      if(pool->batches[i].statements)
+        RAPTOR_FREE(raptor_statement*, pool->batches[i].statements);
+    }
+    RAPTOR_FREE(raptor_ntriples_batch*, pool->batches);
+  }
+  if(pool->workers)
+    RAPTOR_FREE(raptor_ntriples_worker*, pool->workers);
+  RAPTOR_FREE(raptor_ntriples_pool, pool);
+
+  return NULL;
+}
+
+
+static void
+raptor_free_ntriples_pool(raptor_ntriples_pool* pool)
+{
+  int i;
+
+  /* a round in flight is finished before the workers see quit */
+  pthread_mutex_lock(&pool->lock);
+  while(pool->busy)
+    pthread_cond_wait(&pool->done_cond, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+
+  raptor_ntriples_pool_stop(pool, pool->workers_count);
+
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_mutex_destroy(&pool->lock);
+
+  raptor_ntriples_pool_clear_round(pool, 0);
+  raptor_ntriples_pool_clear_round(pool, 1);
+
+  for(i = 0; i < (pool->workers_count << 1); i++)
+    RAPTOR_FREE(raptor_statement*, pool->batches[i].statements);
+  RAPTOR_FREE(raptor_ntriples_batch*, pool->batches);
+  RAPTOR_FREE(raptor_ntriples_worker*, pool->workers);
+  RAPTOR_FREE(raptor_ntriples_pool, pool);
+}
+
+
+/* wait for the round in flight and write it out in batch order */
+static int
+raptor_ntriples_pool_wait(raptor_ntriples_pool* pool, raptor_iostream* iostr)
+{
+  int rc = 0;
+  int i;
+
+  if(!pool->in_flight)
+    return 0;
+
+  pthread_mutex_lock(&pool->lock);
+  while(pool->busy)
+    pthread_cond_wait(&pool->done_cond, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+
+  pool->in_flight = 0;
+
+  for(i = 0; i < pool->workers_count; i++) {
+    raptor_ntriples_batch* batch;
+
+    batch = &pool->batches[pool->work_round * pool->workers_count + i];
+    if(!batch->count)
+      continue;
+
+    if(!batch->string)
+      rc = 1;
+    else if(raptor_iostream_counted_string_write(batch->string,
+                                                 batch->length, iostr))
+      rc = 1;
+  }
+
+  raptor_ntriples_pool_clear_round(pool, pool->work_round);
+
+  return rc;
+}
+
+
+/* hand the round being filled to the workers and start the other */
+static int
+raptor_ntriples_pool_dispatch(raptor_ntriples_pool* pool,
+                              raptor_iostream* iostr)
+{
+  int rc;
+
+  rc = raptor_ntriples_pool_wait(pool, iostr);
+
+  pthread_mutex_lock(&pool->lock);
+  pool->work_round = pool->fill_round;
+  pool->busy = pool->workers_count;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->lock);
+
+  pool->in_flight = 1;
+  pool->fill_round ^= 1;
+  pool->fill_index = 0;
+
+  return rc;
+}
+
+
+/* write out all statements added so far */
+static int
+raptor_ntriples_pool_drain(raptor_ntriples_pool* pool, raptor_iostream* iostr)
+{
+  int rc = 0;
+
+  if(pool->fill_index ||
+     pool->batches[pool->fill_round * pool->workers_count].count)
+    rc = raptor_ntriples_pool_dispatch(pool, iostr);
+
+  if(raptor_ntriples_pool_wait(pool, iostr))
+    rc = 1;
+
+  return rc;
+}
+
+
+static int
+raptor_ntriples_pool_add(raptor_ntriples_pool* pool,
+                         raptor_statement* statement,
+                         raptor_iostream* iostr)
+{
+  raptor_ntriples_batch* batch;
+  raptor_statement* s;
+
+  batch = &pool->batches[pool->fill_round * pool->workers_count +
+                         pool->fill_index];
+  s = &batch->statements[batch->count++];
+
+  raptor_statement_init(s, pool->world);
+  s->subject = raptor_term_copy(statement->subject);
+  s->predicate = raptor_term_copy(statement->predicate);
+  s->object = raptor_term_copy(statement->object);
+  if(statement->graph && pool->write_graph_term)
+    s->graph = raptor_term_copy(statement->graph);
+
+  if(batch->count == RAPTOR_NTRIPLES_BATCH_SIZE &&
+     ++pool->fill_index == pool->workers_count)
+    return raptor_ntriples_pool_dispatch(pool, iostr);
+
+  return 0;
+}
+#endif
+
+
 /* serialize a statement */
 static int
 raptor_ntriples_serialize_statement(raptor_serializer* serializer, 
@@ -222,6 +674,12 @@ raptor_ntriples_serialize_statement(raptor_serializer* serializer,
 
   ntriples_serializer = (raptor_ntriples_serializer_context*)serializer->context;
 
+#ifdef HAVE_PTHREAD
+  if(ntriples_serializer->pool)
+    return raptor_ntriples_pool_add(ntriples_serializer->pool, statement,
+                                    serializer->iostream);
+#endif
+
   raptor_statement_ntriples_write(statement,
                                   serializer->iostream,
                                   ntriples_serializer->is_nquads);
@@ -229,14 +687,82 @@ raptor_ntriples_serialize_statement(raptor_serializer* serializer,
 }
 
 
-#if 0
-/* end a serialize */
+/* serialize an array of statements */
 static int
-raptor_ntriples_serialize_end(raptor_serializer* serializer)
+raptor_ntriples_serialize_statements(raptor_serializer* serializer, 
+                                     raptor_statement *statements,
+                                     int count)
+{
+  raptor_ntriples_serializer_context* ntriples_serializer;
+  raptor_iostream* iostr = serializer->iostream;
+  int write_graph_term;
+  int i;
+
+  ntriples_serializer = (raptor_ntriples_serializer_context*)serializer->context;
+  write_graph_term = ntriples_serializer->is_nquads;
+
+#ifdef HAVE_PTHREAD
+  if(ntriples_serializer->pool) {
+    for(i = 0; i < count; i++) {
+      if(raptor_ntriples_pool_add(ntriples_serializer->pool, &statements[i],
+                                  iostr))
+        return 1;
+    }
+    return 0;
+  }
+#endif
+
+  /* the serializer iostream buffers the writes */
+  for(i = 0; i < count; i++) {
+    if(raptor_statement_ntriples_write(&statements[i], iostr,
+                                       write_graph_term))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/* flush pending statements */
+static int
+raptor_ntriples_serialize_flush(raptor_serializer* serializer)
 {
+#ifdef HAVE_PTHREAD
+  raptor_ntriples_serializer_context* ntriples_serializer;
+
+  ntriples_serializer = (raptor_ntriples_serializer_context*)serializer->context;
+
+  if(ntriples_serializer->pool)
+    return raptor_ntriples_pool_drain(ntriples_serializer->pool,
+                                      serializer->iostream);
+#endif
+
   return 0;
 }
+
+
+/* end a serialize */
+static int
+raptor_ntriples_serialize_end(raptor_serializer* serializer)
+{
+  int rc;
+#ifdef HAVE_PTHREAD
+  raptor_ntriples_serializer_context* ntriples_serializer;
+
+  ntriples_serializer = (raptor_ntriples_serializer_context*)serializer->context;
 #endif
+
+  rc = raptor_ntriples_serialize_flush(serializer);
+
+#ifdef HAVE_PTHREAD
+  if(ntriples_serializer->pool) {
+    raptor_free_ntriples_pool(ntriples_serializer->pool);
+    ntriples_serializer->pool = NULL;
+  }
+#endif
+
+  return rc;
+}
   
 /* finish the serializer factory */
 static void
@@ -276,9 +802,11 @@ raptor_ntriples_serializer_register_factory(raptor_serializer_factory *factory)
   factory->init                = raptor_ntriples_serialize_init;
   factory->terminate           = raptor_ntriples_serialize_terminate;
   factory->declare_namespace   = raptor_ntriples_serialize_declare_namespace;
-  factory->serialize_start     = NULL;
+  factory->serialize_start     = raptor_ntriples_serialize_start;
   factory->serialize_statement = raptor_ntriples_serialize_statement;
-  factory->serialize_end       = NULL;
+  factory->serialize_statements = raptor_ntriples_serialize_statements;
+  factory->serialize_end       = raptor_ntriples_serialize_end;
+  factory->serialize_flush     = raptor_ntriples_serialize_flush;
   factory->finish_factory      = raptor_ntriples_serialize_finish_factory;
 
   return 0;
@@ -314,9 +842,11 @@ raptor_nquads_serializer_register_factory(raptor_serializer_factory *factory)
   factory->init                = raptor_ntriples_serialize_init;
   factory->terminate           = raptor_ntriples_serialize_terminate;
   factory->declare_namespace   = raptor_ntriples_serialize_declare_namespace;
-  factory->serialize_start     = NULL;
+  factory->serialize_start     = raptor_ntriples_serialize_start;
   factory->serialize_statement = raptor_ntriples_serialize_statement;
-  factory->serialize_end       = NULL;
+  factory->serialize_statements = raptor_ntriples_serialize_statements;
+  factory->serialize_end       = raptor_ntriples_serialize_end;
+  factory->serialize_flush     = raptor_ntriples_serialize_flush;
   factory->finish_factory      = raptor_ntriples_serialize_finish_factory;
 
   return 0;
@@ -41,6 +41,29 @@
 #include "raptor_internal.h"
 
 
+/*
+ * Predicate element template
+ *
+ * The namespace and element for a predicate URI, built once and
+ * reused with fresh attributes for every statement with that predicate.
+ */
+typedef struct {
+  unsigned int hash;
+
+  /* predicate term or NULL for an empty slot */
+  raptor_term* predicate;
+
+  /* namespace of the element: from nstack or owned if free_nspace */
+  raptor_namespace* nspace;
+  int free_nspace;
+
+  /* element or NULL if the URI cannot be split into an XML qname */
+  raptor_xml_element* element;
+} raptor_rdfxml_predicate;
+
+#define RAPTOR_RDFXML_PREDICATES_INITIAL_SIZE 64
+
+
 /*
  * Raptor RDF/XML serializer object
  */
@@ -67,6 +90,15 @@ typedef struct {
    * can be declared).
    */
   int written_header;
+
+  /* Open addressing hash table of predicate element templates with a
+   * power of 2 size */
+  raptor_rdfxml_predicate* predicates;
+  int predicates_size;
+  int predicates_count;
+
+  /* rdf:Description element reused for every statement */
+  raptor_xml_element* rdf_Description_element;
 } raptor_rdfxml_serializer_context;
 
 
@@ -74,6 +106,8 @@ typedef struct {
 
 static void
 raptor_rdfxml_serialize_terminate(raptor_serializer* serializer);
+static void
+raptor_rdfxml_free_predicates(raptor_rdfxml_serializer_context* context);
 
 /* create a new serializer */
 static int
@@ -127,6 +161,8 @@ raptor_rdfxml_serialize_terminate(raptor_serializer* serializer)
     context->rdf_RDF_element = NULL;
   }
 
+  raptor_rdfxml_free_predicates(context);
+
   if(context->rdf_nspace) {
     raptor_free_namespace(context->rdf_nspace);
     context->rdf_nspace = NULL;
@@ -323,6 +359,189 @@ raptor_rdfxml_ensure_writen_header(raptor_serializer* serializer,
 }
 
 
+/* forget the predicate templates and rdf:Description element */
+static void
+raptor_rdfxml_free_predicates(raptor_rdfxml_serializer_context* context)
+{
+  int i;
+
+  if(context->predicates) {
+    for(i = 0; i < context->predicates_size; i++) {
+      raptor_rdfxml_predicate* p = &context->predicates[i];
+
+      if(!p->predicate)
+        continue;
+
+      if(p->element)
+        raptor_free_xml_element(p->element);
+      if(p->free_nspace)
+        raptor_free_namespace(p->nspace);
+      raptor_free_term(p->predicate);
+    }
+    RAPTOR_FREE(raptor_rdfxml_predicate*, context->predicates);
+    context->predicates = NULL;
+  }
+  context->predicates_size = 0;
+  context->predicates_count = 0;
+
+  if(context->rdf_Description_element) {
+    raptor_free_xml_element(context->rdf_Description_element);
+    context->rdf_Description_element = NULL;
+  }
+}
+
+
+/* remove the attributes and writing state of a reused element */
+static void
+raptor_rdfxml_reset_element(raptor_xml_element* element)
+{
+  unsigned int i;
+
+  for(i = 0; i < element->attribute_count; i++)
+    if(element->attributes[i])
+      raptor_free_qname(element->attributes[i]);
+
+  if(element->attributes)
+    RAPTOR_FREE(raptor_qname_array, element->attributes);
+
+  element->attributes = NULL;
+  element->attribute_count = 0;
+  element->parent = NULL;
+  element->content_cdata_length = 0;
+  element->content_cdata_seen = 0;
+  element->content_element_seen = 0;
+}
+
+
+static raptor_rdfxml_predicate*
+raptor_rdfxml_find_predicate_slot(raptor_rdfxml_predicate* table, int size,
+                                  raptor_term* predicate, unsigned int hash)
+{
+  unsigned int mask = (unsigned int)size - 1;
+  unsigned int i;
+
+  for(i = hash & mask; table[i].predicate; i = (i + 1) & mask) {
+    if(table[i].hash == hash && raptor_term_equals(table[i].predicate, predicate))
+      break;
+  }
+
+  return &table[i];
+}
+
+
+static int
+raptor_rdfxml_grow_predicates(raptor_rdfxml_serializer_context* context)
+{
+  raptor_rdfxml_predicate* table;
+  int size;
+  int i;
+
+  size = context->predicates_size ? (context->predicates_size << 1)
+                                  : RAPTOR_RDFXML_PREDICATES_INITIAL_SIZE;
+  table = RAPTOR_CALLOC(raptor_rdfxml_predicate*, size, sizeof(*table));
+  if(!table)
+    return 1;
+
+  for(i = 0; i < context->predicates_size; i++) {
+    raptor_rdfxml_predicate* p = &context->predicates[i];
+
+    if(p->predicate)
+      *raptor_rdfxml_find_predicate_slot(table, size, p->predicate,
+                                         p->hash) = *p;
+  }
+
+  if(context->predicates)
+    RAPTOR_FREE(raptor_rdfxml_predicate*, context->predicates);
+  context->predicates = table;
+  context->predicates_size = size;
+
+  return 0;
+}
+
+
+/*
+ * raptor_rdfxml_get_predicate:
+ * @serializer: serializer
+ * @context: RDF/XML serializer context
+ * @predicate: predicate URI term
+ *
+ * INTERNAL - Find or build the element template for a predicate
+ *
+ * The returned template element is NULL if the predicate URI cannot
+ * be split into an XML qname.
+ *
+ * Return value: template or NULL on failure
+ */
+static raptor_rdfxml_predicate*
+raptor_rdfxml_get_predicate(raptor_serializer* serializer,
+                            raptor_rdfxml_serializer_context* context,
+                            raptor_term* predicate)
+{
+  const unsigned char* nsprefix = (const unsigned char*)"ns0";
+  raptor_rdfxml_predicate* p;
+  unsigned int hash;
+  unsigned char* uri_string;
+  size_t uri_len;
+  size_t ns_uri_len;
+  raptor_uri* predicate_ns_uri;
+
+  if(context->predicates_count >= (context->predicates_size >> 1) &&
+     raptor_rdfxml_grow_predicates(context))
+    return NULL;
+
+  hash = raptor_term_hash(predicate);
+  p = raptor_rdfxml_find_predicate_slot(context->predicates,
+                                        context->predicates_size,
+                                        predicate, hash);
+  if(p->predicate)
+    return p;
+
+  uri_string = raptor_uri_as_counted_string(predicate->value.uri, &uri_len);
+
+  /* split before the longest legal XML name at the end of the URI */
+  ns_uri_len = raptor_xml_name_suffix_start(uri_string, uri_len, 10);
+  if(ns_uri_len && ns_uri_len < uri_len) {
+    predicate_ns_uri = raptor_new_uri_from_counted_string(serializer->world,
+                                                          uri_string,
+                                                          ns_uri_len);
+    if(!predicate_ns_uri)
+      return NULL;
+
+    p->nspace = raptor_namespaces_find_namespace_by_uri(context->nstack,
+                                                        predicate_ns_uri);
+    if(!p->nspace) {
+      p->nspace = raptor_new_namespace_from_uri(context->nstack,
+                                                nsprefix,
+                                                predicate_ns_uri, 0);
+      if(!p->nspace) {
+        raptor_free_uri(predicate_ns_uri);
+        return NULL;
+      }
+      p->free_nspace = 1;
+    }
+    raptor_free_uri(predicate_ns_uri);
+
+    p->element = raptor_new_xml_element_from_namespace_local_name(p->nspace,
+                                                                  uri_string + ns_uri_len,
+                                                                  NULL,
+                                                                  serializer->base_uri);
+    if(!p->element) {
+      if(p->free_nspace)
+        raptor_free_namespace(p->nspace);
+      p->nspace = NULL;
+      p->free_nspace = 0;
+      return NULL;
+    }
+  }
+
+  p->hash = hash;
+  p->predicate = raptor_term_copy(predicate);
+  context->predicates_count++;
+
+  return p;
+}
+
+
 /* serialize a statement */
 static int
 raptor_rdfxml_serialize_statement(raptor_serializer* serializer,
@@ -330,21 +549,15 @@ raptor_rdfxml_serialize_statement(raptor_serializer* serializer,
 {
   raptor_rdfxml_serializer_context* context = (raptor_rdfxml_serializer_context*)serializer->context;
   raptor_xml_writer* xml_writer = context->xml_writer;
-  unsigned char* uri_string = NULL; /* predicate URI */
-  unsigned char* name = NULL;  /* where to split predicate name */
   unsigned char* subject_uri_string = NULL;
   unsigned char* object_uri_string = NULL;
-  const unsigned char* nsprefix = (const unsigned char*)"ns0";
   int rc = 1;
   size_t len;
   raptor_xml_element* rdf_Description_element = NULL;
-  raptor_uri* predicate_ns_uri = NULL;
-  raptor_namespace* predicate_ns = NULL;
-  int free_predicate_ns = 0;
+  raptor_rdfxml_predicate* predicate;
   raptor_xml_element* predicate_element = NULL;
   raptor_qname **attrs = NULL;
   int attrs_count = 0;
-  raptor_uri* base_uri = NULL;
   raptor_term_type object_type;
   int allocated = 1;
   int object_is_parseTypeLiteral = 0;
@@ -353,54 +566,17 @@ raptor_rdfxml_serialize_statement(raptor_serializer* serializer,
     return 1;
 
   if(statement->predicate->type == RAPTOR_TERM_TYPE_URI) {
-    unsigned char *p;
-    size_t uri_len;
-    size_t name_len = 1;
-    unsigned char c;
-
-    /* Do not use raptor_uri_as_counted_string() - we want a modifiable copy */
-    uri_string = raptor_uri_to_counted_string(statement->predicate->value.uri,
-                                              &uri_len);
-    if(!uri_string)
+    predicate = raptor_rdfxml_get_predicate(serializer, context,
+                                            statement->predicate);
+    if(!predicate)
       goto oom;
 
-    p= uri_string;
-    name_len = uri_len;
-    /* FIXME: this loop could be made smarter */
-    while(name_len >0) {
-      if(raptor_xml_name_check(p, name_len, 10)) {
-        name = p;
-        break;
-      }
-      p++; name_len--;
-    }
-
-    if(!name || (name == uri_string)) {
+    if(!predicate->element) {
       raptor_log_error_formatted(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
-                                 "Cannot split predicate URI %s into an XML qname - skipping statement", uri_string);
+                                 "Cannot split predicate URI %s into an XML qname - skipping statement", raptor_uri_as_string(statement->predicate->value.uri));
       rc = 0; /* skip but do not return an error */
       goto tidy;
     }
-
-    c = *name; *name = '\0';
-    predicate_ns_uri = raptor_new_uri(serializer->world, uri_string);
-    *name = c;
-    if(!predicate_ns_uri)
-      goto oom;
-
-    predicate_ns = raptor_namespaces_find_namespace_by_uri(context->nstack,
-                                                           predicate_ns_uri);
-    if(!predicate_ns) {
-      predicate_ns = raptor_new_namespace_from_uri(context->nstack,
-                                                   nsprefix,
-                                                   predicate_ns_uri, 0);
-      if(!predicate_ns) {
-        raptor_free_uri(predicate_ns_uri);
-        goto oom;
-      }
-      free_predicate_ns = 1;
-    }
-    raptor_free_uri(predicate_ns_uri);
   } else {
     raptor_log_error_formatted(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
                                "Cannot serialize a triple with subject node type %u\n",
@@ -408,16 +584,14 @@ raptor_rdfxml_serialize_statement(raptor_serializer* serializer,
     goto tidy;
   }
 
-  /* base uri */
-  if(serializer->base_uri)
-    base_uri = raptor_uri_copy(serializer->base_uri);
-
-
-  rdf_Description_element = raptor_new_xml_element_from_namespace_local_name(context->rdf_nspace,
-                                                                             (unsigned const char*)"Description",
-                                                                             NULL, base_uri);
-  if(!rdf_Description_element)
-    goto oom;
+  if(!context->rdf_Description_element) {
+    context->rdf_Description_element = raptor_new_xml_element_from_namespace_local_name(context->rdf_nspace,
+                                                                                       (unsigned const char*)"Description",
+                                                                                       NULL, serializer->base_uri);
+    if(!context->rdf_Description_element)
+      goto oom;
+  }
+  rdf_Description_element = context->rdf_Description_element;
 
   attrs = RAPTOR_CALLOC(raptor_qname**, 3, sizeof(raptor_qname*));
   if(!attrs)
@@ -481,9 +655,7 @@ raptor_rdfxml_serialize_statement(raptor_serializer* serializer,
 
 
   /* predicate */
-  predicate_element = raptor_new_xml_element_from_namespace_local_name(predicate_ns, name, NULL, base_uri);
-  if(!predicate_element)
-    goto oom;
+  predicate_element = predicate->element;
 
   /* object */
   attrs = RAPTOR_CALLOC(raptor_qname**, 3, sizeof(raptor_qname*));
@@ -548,8 +720,6 @@ raptor_rdfxml_serialize_statement(raptor_serializer* serializer,
       }
 
       raptor_xml_writer_end_element(xml_writer, predicate_element);
-      raptor_free_xml_element(predicate_element);
-      predicate_element = NULL;
       raptor_xml_writer_cdata_counted(xml_writer, (const unsigned char*)"\n", 1);
 
       break;
@@ -619,23 +789,14 @@ raptor_rdfxml_serialize_statement(raptor_serializer* serializer,
     RAPTOR_FREE(qnamearray, attrs);
 
   if(predicate_element)
-    raptor_free_xml_element(predicate_element);
+    raptor_rdfxml_reset_element(predicate_element);
 
   if(rdf_Description_element) {
     raptor_xml_writer_end_element(xml_writer, rdf_Description_element);
     raptor_xml_writer_cdata_counted(xml_writer, (const unsigned char*)"\n", 1);
-    raptor_free_xml_element(rdf_Description_element);
+    raptor_rdfxml_reset_element(rdf_Description_element);
   }
 
-  if(base_uri)
-    raptor_free_uri(base_uri);
-
-  if(free_predicate_ns)
-    raptor_free_namespace(predicate_ns);
-
-  if(uri_string)
-    RAPTOR_FREE(char*, uri_string);
-
   return rc;
 }
 
@@ -668,6 +829,9 @@ raptor_rdfxml_serialize_end(raptor_serializer* serializer)
     context->rdf_RDF_element = NULL;
   }
 
+  /* the next serializing may have a different base URI */
+  raptor_rdfxml_free_predicates(context);
+
   return 0;
 }
 
@@ -54,7 +54,7 @@ typedef struct {
   raptor_sequence *namespaces;          /* User declared namespaces */
   raptor_avltree *subjects;             /* subject items */
   raptor_avltree *blanks;               /* blank subject items */
-  raptor_avltree *nodes;                /* nodes */
+  raptor_abbrev_nodes *nodes;           /* nodes */
   raptor_abbrev_node *rdf_type;         /* rdf:type uri */
 
   /* non-zero if is Adobe XMP abbreviated form */
@@ -482,8 +482,8 @@ raptor_rdfxmla_emit_subject_properties(raptor_serializer* serializer,
 {
   raptor_rdfxmla_context* context = (raptor_rdfxmla_context*)serializer->context;
   int rv = 0;
+  int count;
   int i;
-  raptor_avltree_iterator* iter = NULL;
   raptor_term* subject_term = subject->node->term;
 
   RAPTOR_DEBUG_ABBREV_NODE("Emitting subject properties", subject->node);
@@ -529,21 +529,16 @@ raptor_rdfxmla_emit_subject_properties(raptor_serializer* serializer,
   }
 
 
-  for(i = 0, iter = raptor_new_avltree_iterator(subject->properties, NULL, NULL, 1);
-      iter && !rv;
-      i++, (rv = raptor_avltree_iterator_next(iter))) {
+  count = raptor_abbrev_subject_sort_properties(subject);
+  for(i = 0; i < count && !rv; i++) {
     raptor_uri *base_uri = NULL;
     raptor_qname *qname;
     raptor_xml_element *element;
-    raptor_abbrev_node** nodes;
     raptor_abbrev_node* predicate;
     raptor_abbrev_node* object;
 
-    nodes = (raptor_abbrev_node**)raptor_avltree_iterator_get(iter);
-    if(!nodes)
-      break;
-    predicate= nodes[0];
-    object= nodes[1];
+    predicate = subject->properties[i].predicate;
+    object = subject->properties[i].object;
     
     qname = raptor_new_qname_from_resource(context->namespaces,
                                            context->nstack,
@@ -598,14 +593,10 @@ raptor_rdfxmla_emit_subject_properties(raptor_serializer* serializer,
     raptor_free_xml_element(element);
     
   }
-  if(iter)
-    raptor_free_avltree_iterator(iter);
   
   return rv;
 
   oom:
-  if(iter)
-    raptor_free_avltree_iterator(iter);
   raptor_log_error(serializer->world, RAPTOR_LOG_LEVEL_FATAL, NULL,
                    "Out of memory");
   return 1;
@@ -861,9 +852,7 @@ raptor_rdfxmla_serialize_init(raptor_serializer* serializer, const char *name)
     raptor_new_avltree((raptor_data_compare_handler)raptor_abbrev_subject_compare,
                        (raptor_data_free_handler)raptor_free_abbrev_subject, 0);
   
-  context->nodes =
-    raptor_new_avltree((raptor_data_compare_handler)raptor_abbrev_node_compare,
-                       (raptor_data_free_handler)raptor_free_abbrev_node, 0);
+  context->nodes = raptor_new_abbrev_nodes(serializer->world);
 
   type_term = RAPTOR_RDF_type_term(serializer->world);
   context->rdf_type = raptor_new_abbrev_node(serializer->world, type_term);
@@ -948,7 +937,7 @@ raptor_rdfxmla_serialize_terminate(raptor_serializer* serializer)
   }
   
   if(context->nodes) {
-    raptor_free_avltree(context->nodes);
+    raptor_free_abbrev_nodes(context->nodes);
     context->nodes = NULL;
   }
   
@@ -1352,18 +1341,11 @@ raptor_rdfxmla_serialize_statement(raptor_serializer* serializer,
       int add_property = 1;
 
       if(context->is_xmp && predicate->ref_count > 1) {
-        raptor_avltree_iterator* iter = NULL;
         int i;
-        for(i = 0, (iter = raptor_new_avltree_iterator(subject->properties, NULL, NULL, 1));
-            iter && !rv;
-            i++, (rv = raptor_avltree_iterator_next(iter))) {
-          raptor_abbrev_node** nodes;
+        for(i = 0; i < subject->properties_count; i++) {
           raptor_abbrev_node* node;
 
-          nodes = (raptor_abbrev_node**)raptor_avltree_iterator_get(iter);
-          if(!nodes)
-            break;
-          node= nodes[0];
+          node = subject->properties[i].predicate;
           
           if(node == predicate) {
             add_property = 0;
@@ -1379,8 +1361,6 @@ raptor_rdfxmla_serialize_statement(raptor_serializer* serializer,
             break;
           }
         }
-        if(iter)
-          raptor_free_avltree_iterator(iter);
       }
 
       if(add_property) {
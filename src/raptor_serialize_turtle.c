@@ -56,7 +56,7 @@ typedef struct {
   raptor_sequence *namespaces;          /* User declared namespaces */
   raptor_avltree *subjects;             /* subject items */
   raptor_avltree *blanks;               /* blank subject items */
-  raptor_avltree *nodes;                /* nodes */
+  raptor_abbrev_nodes *nodes;           /* nodes */
   raptor_abbrev_node *rdf_type;         /* rdf:type uri */
 
   /* URI of rdf:XMLLiteral */
@@ -102,6 +102,18 @@ typedef struct {
   int mkr_rs_ntuple;
   int mkr_rs_nvalue;
   int mkr_rs_processing_value;
+
+  /* state for turtle-stream: subject and predicate of the last
+   * statement written, or NULL at the start of the output */
+  raptor_term* stream_subject;
+  raptor_term* stream_predicate;
+
+  /* statements sorted by subject when RAPTOR_OPTION_MEMORY_BUDGET
+   * is set, or NULL */
+  raptor_spool* spool;
+  /* buffer for encoding a spool record */
+  unsigned char* spool_record;
+  size_t spool_record_size;
 } raptor_turtle_context;
 
 
@@ -403,41 +415,30 @@ raptor_turtle_emit_subject_collection_items(raptor_serializer* serializer,
   raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
   int emit_mkr = context->emit_mkr;
   int rv = 0;
-  raptor_avltree_iterator* iter = NULL;
   int i;
-  int is_new_subject = 0;
 
   RAPTOR_DEBUG_ABBREV_NODE("Emitting subject collection items", subject->node);
 
-  /* if just saw a new subject (is_new_subject is true) then there is no need
-   * to advance the iterator - it was just reset
+  /* each list node has properties rdf:first then rdf:rest; follow
+   * rdf:rest to the next list node until rdf:nil
    */
-  for(i = 0, (iter = raptor_new_avltree_iterator(subject->properties, NULL, NULL, 1));
-      iter && !rv;
-      i++, (rv = is_new_subject ? 0 : raptor_avltree_iterator_next(iter))) {
-    raptor_abbrev_node** nodes;
+  for(i = 0; !rv; i++) {
     raptor_abbrev_node* predicate;
     raptor_abbrev_node* object;
 
-    is_new_subject = 0;
-
-    nodes = (raptor_abbrev_node**)raptor_avltree_iterator_get(iter);
-    if(!nodes)
+    if(raptor_abbrev_subject_sort_properties(subject) < 1)
       break;
-    predicate = nodes[0];
-    object = nodes[1];
+
+    predicate = subject->properties[0].predicate;
+    object = subject->properties[0].object;
 
     if(!raptor_uri_equals(predicate->term->value.uri,
                           context->rdf_first_uri)) {
       raptor_log_error(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
                        "Malformed collection - first predicate is not rdf:first");
-      raptor_free_avltree_iterator(iter);
       return 1;
     }
 
-    if(!object)
-      continue;
-
     if(i > 0) {
       if(emit_mkr)
         raptor_turtle_writer_raw_counted(context->turtle_writer,
@@ -468,58 +469,46 @@ raptor_turtle_emit_subject_collection_items(raptor_serializer* serializer,
     }
 
     /* Return error if emitting something failed above */
-    if(rv) {
-      raptor_free_avltree_iterator(iter);
+    if(rv)
       return rv;
-    }
 
     /* last item */
-    rv = raptor_avltree_iterator_next(iter);
-    if(rv)
+    if(subject->properties_count < 2) {
+      rv = 1;
       break;
+    }
 
-    nodes = (raptor_abbrev_node**)raptor_avltree_iterator_get(iter);
-    predicate = nodes[0];
-    object = nodes[1];
+    predicate = subject->properties[1].predicate;
+    object = subject->properties[1].object;
 
     if(!raptor_uri_equals(predicate->term->value.uri, context->rdf_rest_uri)) {
       raptor_log_error(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
                        "Malformed collection - second predicate is not rdf:rest");
-      raptor_free_avltree_iterator(iter);
       return 1;
     }
 
     if(object->term->type == RAPTOR_TERM_TYPE_BLANK) {
+      /* got a <(old)subject> rdf:rest <(new)subject> triple so
+       * continue with the new subject's properties
+       */
       subject = raptor_abbrev_subject_find(context->blanks, object->term);
 
       if(!subject) {
         raptor_log_error(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
                          "Malformed collection - could not find subject for rdf:rest");
-        raptor_free_avltree_iterator(iter);
         return 1;
       }
 
-      /* got a <(old)subject> rdf:rest <(new)subject> triple so know
-       * subject has changed and should reset the properties iterator
-       */
-      if(iter)
-        raptor_free_avltree_iterator(iter);
-      iter = raptor_new_avltree_iterator(subject->properties, NULL, NULL, 1);
-      is_new_subject = 1;
-
     } else {
       if(object->term->type != RAPTOR_TERM_TYPE_URI ||
          !raptor_uri_equals(object->term->value.uri, context->rdf_nil_uri)) {
         raptor_log_error(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
                          "Malformed collection - last rdf:rest resource is not rdf:nil");
-        raptor_free_avltree_iterator(iter);
         return 1;
       }
       break;
     }
   }
-  if(iter)
-    raptor_free_avltree_iterator(iter);
 
   return rv;
 }
@@ -547,7 +536,7 @@ raptor_turtle_emit_subject_properties(raptor_serializer* serializer,
   int numobj = 2; /* "[" "]" around all object lists (any size) */
   raptor_abbrev_node* last_predicate = NULL;
   int rv = 0;
-  raptor_avltree_iterator* iter = NULL;
+  int count;
   int i;
 
   RAPTOR_DEBUG_ABBREV_NODE("Emitting subject properties", subject->node);
@@ -556,19 +545,14 @@ raptor_turtle_emit_subject_properties(raptor_serializer* serializer,
   if(raptor_sequence_size(subject->list_items) > 0)
     rv = raptor_turtle_emit_subject_list_items(serializer, subject, depth+1);
 
-  for(i = 0, (iter = raptor_new_avltree_iterator(subject->properties, NULL, NULL, 1));
-      iter && !rv;
-      i++, (rv = raptor_avltree_iterator_next(iter))) {
-    raptor_abbrev_node** nodes;
+  count = raptor_abbrev_subject_sort_properties(subject);
+  for(i = 0; i < count && !rv; i++) {
     raptor_abbrev_node* predicate;
     raptor_abbrev_node* object;
     raptor_qname *qname;
 
-    nodes = (raptor_abbrev_node**)raptor_avltree_iterator_get(iter);
-    if(!nodes)
-      break;
-    predicate = nodes[0];
-    object = nodes[1];
+    predicate = subject->properties[i].predicate;
+    object = subject->properties[i].object;
     numobj = 2;  /* = raptor_sequence_size(xxx) if available */
 
     if(!last_predicate ||
@@ -643,9 +627,6 @@ raptor_turtle_emit_subject_properties(raptor_serializer* serializer,
     last_predicate = predicate;
   }
 
-  if(iter)
-    raptor_free_avltree_iterator(iter);
-
   return rv;
 }
 
@@ -670,7 +651,7 @@ raptor_mkr_emit_subject_resultset(raptor_serializer* serializer,
   raptor_turtle_writer *turtle_writer = context->turtle_writer;
   raptor_abbrev_node* last_predicate = NULL;
   int rv = 0;
-  raptor_avltree_iterator* iter = NULL;
+  int count;
   int i;
   int skip_object;
 
@@ -682,20 +663,14 @@ raptor_mkr_emit_subject_resultset(raptor_serializer* serializer,
     rv = raptor_turtle_emit_subject_list_items(serializer, subject, depth+1);
 
 
-  for(i = 0, (iter = raptor_new_avltree_iterator(subject->properties, NULL, NULL, 1));
-      iter && !rv;
-      i++, (rv = raptor_avltree_iterator_next(iter))) {
-    raptor_abbrev_node** nodes;
+  count = raptor_abbrev_subject_sort_properties(subject);
+  for(i = 0; i < count && !rv; i++) {
     raptor_abbrev_node* predicate;
     raptor_abbrev_node* object;
     raptor_qname *qname;
 
-    nodes = (raptor_abbrev_node**)raptor_avltree_iterator_get(iter);
-    if(!nodes)
-      break;
-
-    predicate = nodes[0];
-    object = nodes[1];
+    predicate = subject->properties[i].predicate;
+    object = subject->properties[i].object;
 
     if(!last_predicate ||
        !raptor_abbrev_node_equals(predicate, last_predicate)) {
@@ -819,9 +794,6 @@ raptor_mkr_emit_subject_resultset(raptor_serializer* serializer,
     last_predicate = predicate;
   } /* end iteration i */
 
-  if(iter)
-    raptor_free_avltree_iterator(iter);
-
   return rv;
 }
 
@@ -860,27 +832,15 @@ raptor_turtle_emit_subject(raptor_serializer *serializer,
     return 0;
   }
 
-  if(raptor_avltree_size(subject->properties) == 0) {
+  if(raptor_abbrev_subject_sort_properties(subject) == 0) {
     RAPTOR_DEBUG_ABBREV_NODE("Skipping subject node - no props", subject->node);
     return 0;
   }
 
   /* check if we can do collection abbreviation */
-  if(raptor_avltree_size(subject->properties) >= 2) {
-    raptor_avltree_iterator* iter = NULL;
-    raptor_abbrev_node* pred1;
-    raptor_abbrev_node* pred2;
-
-    iter = raptor_new_avltree_iterator(subject->properties, NULL, NULL, 1);
-    if(!iter)
-      return 1;
-    pred1 = ((raptor_abbrev_node**)raptor_avltree_iterator_get(iter))[0];
-    if(raptor_avltree_iterator_next(iter)) {
-      raptor_free_avltree_iterator(iter);
-      return 1;
-    }
-    pred2 = ((raptor_abbrev_node**)raptor_avltree_iterator_get(iter))[0];
-    raptor_free_avltree_iterator(iter);
+  if(subject->properties_count >= 2) {
+    raptor_abbrev_node* pred1 = subject->properties[0].predicate;
+    raptor_abbrev_node* pred2 = subject->properties[1].predicate;
 
     if(pred1->term->type == RAPTOR_TERM_TYPE_URI &&
        pred2->term->type == RAPTOR_TERM_TYPE_URI &&
@@ -1097,6 +1057,443 @@ raptor_turtle_emit(raptor_serializer *serializer)
 }
 
 
+/*
+ * Spooling statements (RAPTOR_OPTION_MEMORY_BUDGET)
+ *
+ * Instead of building the subjects trees, each statement is encoded
+ * as a record keyed by its subject and added to a #raptor_spool that
+ * sorts them in temporary files when they use more memory than the
+ * budget.  Each statement with a blank node object adds a second
+ * reference record keyed by the object so that the records with a
+ * blank node key start with one reference record per use as an
+ * object, giving the count_as_object of the node.
+ *
+ * The sorted records are read twice.  The first pass loads the blank
+ * nodes used once as an object into the subjects trees, since they
+ * are nested inside another subject's description.  The second pass
+ * builds, emits and frees every other subject in turn, in the same
+ * order raptor_turtle_emit() uses.  Memory use is therefore the
+ * budget plus the nested blank nodes plus the largest subject.
+ *
+ * Term encoding: one byte of #raptor_term_type then
+ *   URI and blank node: the string and a NUL
+ *   literal: a size_t length, the string, the language and a NUL,
+ *     the datatype URI and a NUL
+ * so that URI and blank keys sort in raptor_term_compare() order.
+ *
+ * Records: key term, record kind, then for a statement the
+ * predicate and object terms.
+ */
+
+#define RAPTOR_TURTLE_SPOOL_REFERENCE 0
+#define RAPTOR_TURTLE_SPOOL_STATEMENT 1
+
+
+static int
+raptor_turtle_spool_ensure(raptor_turtle_context* context, size_t length)
+{
+  unsigned char* record;
+  size_t size;
+
+  if(length <= context->spool_record_size)
+    return 0;
+
+  size = context->spool_record_size ? context->spool_record_size : 256;
+  while(size < length)
+    size <<= 1;
+
+  record = RAPTOR_REALLOC(unsigned char*, context->spool_record, size);
+  if(!record)
+    return 1;
+
+  context->spool_record = record;
+  context->spool_record_size = size;
+
+  return 0;
+}
+
+
+/*
+ * raptor_turtle_spool_encode_term:
+ * @context: turtle serializer context
+ * @term: term to encode
+ * @offset_p: pointer to offset in the record buffer to write at;
+ *   updated to the offset after the term
+ *
+ * INTERNAL - Append the encoding of a term to the record buffer
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_turtle_spool_encode_term(raptor_turtle_context* context,
+                                raptor_term* term, size_t* offset_p)
+{
+  const unsigned char* string;
+  size_t string_len;
+  const unsigned char* language = NULL;
+  size_t language_len = 0;
+  const unsigned char* datatype = NULL;
+  size_t datatype_len = 0;
+  unsigned char* p;
+
+  if(term->type == RAPTOR_TERM_TYPE_URI) {
+    string = raptor_uri_as_counted_string(term->value.uri, &string_len);
+  } else if(term->type == RAPTOR_TERM_TYPE_BLANK) {
+    string = term->value.blank.string;
+    string_len = term->value.blank.string_len;
+  } else {
+    string = term->value.literal.string;
+    string_len = term->value.literal.string_len;
+    if(term->value.literal.language) {
+      language = term->value.literal.language;
+      language_len = term->value.literal.language_len;
+    }
+    if(term->value.literal.datatype)
+      datatype = raptor_uri_as_counted_string(term->value.literal.datatype,
+                                              &datatype_len);
+  }
+
+  if(raptor_turtle_spool_ensure(context, *offset_p + 1 + sizeof(size_t) +
+                                string_len + 1 + language_len + 1 +
+                                datatype_len + 1))
+    return 1;
+
+  p = context->spool_record + *offset_p;
+  *p++ = (unsigned char)term->type;
+
+  if(term->type == RAPTOR_TERM_TYPE_LITERAL) {
+    memcpy(p, &string_len, sizeof(string_len));
+    p += sizeof(string_len);
+    memcpy(p, string, string_len);
+    p += string_len;
+    if(language_len)
+      memcpy(p, language, language_len);
+    p += language_len;
+    *p++ = '\0';
+    if(datatype_len)
+      memcpy(p, datatype, datatype_len);
+    p += datatype_len;
+    *p++ = '\0';
+  } else {
+    memcpy(p, string, string_len);
+    p += string_len;
+    *p++ = '\0';
+  }
+
+  *offset_p = p - context->spool_record;
+
+  return 0;
+}
+
+
+/*
+ * raptor_turtle_spool_decode_term:
+ * @world: world
+ * @p_p: pointer to the encoded term; updated to point after it
+ *
+ * INTERNAL - Create a term from an encoding
+ *
+ * Return value: new term or NULL on failure
+ */
+static raptor_term*
+raptor_turtle_spool_decode_term(raptor_world* world, const unsigned char** p_p)
+{
+  const unsigned char* p = *p_p;
+  raptor_term_type type = (raptor_term_type)*p++;
+  raptor_term* term = NULL;
+  size_t len;
+
+  if(type == RAPTOR_TERM_TYPE_LITERAL) {
+    const unsigned char* string;
+    const unsigned char* language;
+    size_t language_len;
+    raptor_uri* datatype = NULL;
+
+    memcpy(&len, p, sizeof(len));
+    p += sizeof(len);
+    string = p;
+    p += len;
+    language = p;
+    language_len = strlen((const char*)language);
+    p += language_len + 1;
+    if(*p) {
+      datatype = raptor_new_uri(world, p);
+      if(!datatype)
+        return NULL;
+    }
+    p += strlen((const char*)p) + 1;
+
+    term = raptor_new_term_from_counted_literal(world, string, len, datatype,
+                                                language_len ? language : NULL,
+                                                (unsigned char)language_len);
+    if(datatype)
+      raptor_free_uri(datatype);
+  } else {
+    len = strlen((const char*)p);
+    if(type == RAPTOR_TERM_TYPE_URI)
+      term = raptor_new_term_from_counted_uri_string(world, p, len);
+    else
+      term = raptor_new_term_from_counted_blank(world, p, len);
+    p += len + 1;
+  }
+
+  *p_p = p;
+
+  return term;
+}
+
+
+/*
+ * raptor_turtle_spool_statement:
+ * @serializer: #raptor_serializer object
+ * @statement: statement
+ *
+ * INTERNAL - Add the records for a statement to the spool
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_turtle_spool_statement(raptor_serializer* serializer,
+                              raptor_statement *statement)
+{
+  raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
+  size_t offset = 0;
+
+  if(raptor_turtle_spool_encode_term(context, statement->subject, &offset) ||
+     raptor_turtle_spool_ensure(context, offset + 1))
+    return 1;
+  context->spool_record[offset++] = RAPTOR_TURTLE_SPOOL_STATEMENT;
+  if(raptor_turtle_spool_encode_term(context, statement->predicate, &offset) ||
+     raptor_turtle_spool_encode_term(context, statement->object, &offset))
+    return 1;
+
+  if(raptor_spool_add(context->spool, context->spool_record, offset))
+    return 1;
+
+  if(statement->object->type == RAPTOR_TERM_TYPE_BLANK) {
+    offset = 0;
+    if(raptor_turtle_spool_encode_term(context, statement->object, &offset) ||
+       raptor_turtle_spool_ensure(context, offset + 1))
+      return 1;
+    context->spool_record[offset++] = RAPTOR_TURTLE_SPOOL_REFERENCE;
+
+    if(raptor_spool_add(context->spool, context->spool_record, offset))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * raptor_turtle_spool_add_statement:
+ * @serializer: #raptor_serializer object
+ * @record: statement record
+ * @nodes: table of nodes to use for the subject, predicate and object
+ *
+ * INTERNAL - Add a spooled statement to the subjects trees
+ *
+ * Blank node objects are first looked for in the context nodes
+ * table which holds the nested blank nodes.
+ *
+ * Return value: subject or NULL on failure
+ */
+static raptor_abbrev_subject*
+raptor_turtle_spool_add_statement(raptor_serializer* serializer,
+                                  const unsigned char* record,
+                                  raptor_abbrev_nodes* nodes)
+{
+  raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
+  raptor_world* world = serializer->world;
+  raptor_term* terms[3] = { NULL, NULL, NULL };
+  raptor_abbrev_subject* subject = NULL;
+  raptor_abbrev_node* predicate;
+  raptor_abbrev_node* object = NULL;
+  const unsigned char* p = record;
+  int i;
+
+  terms[0] = raptor_turtle_spool_decode_term(world, &p);
+  p++; /* record kind */
+  terms[1] = raptor_turtle_spool_decode_term(world, &p);
+  terms[2] = raptor_turtle_spool_decode_term(world, &p);
+  if(!terms[0] || !terms[1] || !terms[2])
+    goto tidy;
+
+  subject = raptor_abbrev_subject_lookup(nodes, context->subjects,
+                                         context->blanks, terms[0]);
+  if(!subject)
+    goto tidy;
+
+  predicate = raptor_abbrev_node_lookup(nodes, terms[1]);
+  if(!predicate) {
+    subject = NULL;
+    goto tidy;
+  }
+
+  if(terms[2]->type == RAPTOR_TERM_TYPE_BLANK && nodes != context->nodes)
+    object = raptor_abbrev_node_find(context->nodes, terms[2]);
+  if(!object)
+    object = raptor_abbrev_node_lookup(nodes, terms[2]);
+  if(!object) {
+    subject = NULL;
+    goto tidy;
+  }
+
+  if(raptor_abbrev_subject_add_property(subject, predicate, object) < 0) {
+    raptor_log_error_formatted(world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                               "Unable to add properties to subject %p",
+                               subject);
+    subject = NULL;
+  }
+
+  tidy:
+  for(i = 0; i < 3; i++) {
+    if(terms[i])
+      raptor_free_term(terms[i]);
+  }
+
+  return subject;
+}
+
+
+/*
+ * raptor_turtle_spool_pass:
+ * @serializer: #raptor_serializer object
+ * @emit: 0 to load the nested blank nodes, non-0 to emit all the
+ *   other subjects
+ *
+ * INTERNAL - Read the spooled statements in subject order
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_turtle_spool_pass(raptor_serializer* serializer, int emit)
+{
+  raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
+  raptor_abbrev_nodes* nodes = NULL;
+  raptor_abbrev_subject* subject = NULL;
+  unsigned char* key = NULL;
+  size_t key_length = 0;
+  int refs = 0;
+  int rc = 0;
+
+  if(raptor_spool_rewind(context->spool))
+    return 1;
+
+  if(emit) {
+    nodes = raptor_new_abbrev_nodes(serializer->world);
+    if(!nodes)
+      return 1;
+  }
+
+  while(1) {
+    const unsigned char* record;
+    size_t length;
+    size_t record_key_length = 0;
+    int nested;
+
+    record = raptor_spool_next(context->spool, &length);
+    if(record)
+      record_key_length = strlen((const char*)record + 1) + 2;
+
+    if(!record || record_key_length != key_length ||
+       memcmp(record, key, key_length)) {
+      /* finished all statements of the last subject */
+      if(subject) {
+        subject->node->count_as_object = refs;
+        rc = raptor_turtle_emit_subject(serializer, subject, 0);
+        if(subject->node->term->type == RAPTOR_TERM_TYPE_BLANK)
+          raptor_avltree_delete(context->blanks, subject);
+        else
+          raptor_avltree_delete(context->subjects, subject);
+        subject = NULL;
+
+        /* drop the nodes used by that subject */
+        raptor_free_abbrev_nodes(nodes);
+        nodes = raptor_new_abbrev_nodes(serializer->world);
+        if(!nodes)
+          rc = 1;
+        if(rc)
+          break;
+      }
+
+      if(!record)
+        break;
+
+      if(key)
+        RAPTOR_FREE(char*, key);
+      key = RAPTOR_MALLOC(unsigned char*, record_key_length);
+      if(!key) {
+        rc = 1;
+        break;
+      }
+      memcpy(key, record, record_key_length);
+      key_length = record_key_length;
+      refs = 0;
+    }
+
+    if(record[key_length] == RAPTOR_TURTLE_SPOOL_REFERENCE) {
+      refs++;
+      continue;
+    }
+
+    /* A blank node used once as an object is emitted nested inside
+     * that statement's subject; see raptor_turtle_emit_blank() */
+    nested = (*record == RAPTOR_TERM_TYPE_BLANK && refs == 1);
+
+    if(!emit) {
+      if(nested) {
+        raptor_abbrev_subject* blank;
+
+        blank = raptor_turtle_spool_add_statement(serializer, record,
+                                                  context->nodes);
+        if(!blank) {
+          rc = 1;
+          break;
+        }
+        blank->node->count_as_object = refs;
+      }
+    } else if(!nested) {
+      subject = raptor_turtle_spool_add_statement(serializer, record, nodes);
+      if(!subject) {
+        rc = 1;
+        break;
+      }
+    }
+  }
+
+  if(key)
+    RAPTOR_FREE(char*, key);
+  if(nodes)
+    raptor_free_abbrev_nodes(nodes);
+
+  return rc;
+}
+
+
+/*
+ * raptor_turtle_spool_emit:
+ * @serializer: #raptor_serializer object
+ *
+ * INTERNAL - Emit Turtle for all spooled statements
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_turtle_spool_emit(raptor_serializer* serializer)
+{
+  raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
+
+  if(raptor_spool_finish(context->spool))
+    return 1;
+
+  if(raptor_turtle_spool_pass(serializer, 0))
+    return 1;
+
+  return raptor_turtle_spool_pass(serializer, 1);
+}
+
+
 /*
  * raptor serializer Turtle implementation
  */
@@ -1136,9 +1533,7 @@ raptor_turtle_serialize_init(raptor_serializer* serializer, const char *name)
     raptor_new_avltree((raptor_data_compare_handler)raptor_abbrev_subject_compare,
                        (raptor_data_free_handler)raptor_free_abbrev_subject, 0);
 
-  context->nodes =
-    raptor_new_avltree((raptor_data_compare_handler)raptor_abbrev_node_compare,
-                       (raptor_data_free_handler)raptor_free_abbrev_node, 0);
+  context->nodes = raptor_new_abbrev_nodes(serializer->world);
 
   rdf_type_uri = raptor_new_uri_for_rdf_concept(serializer->world,
                                                 (const unsigned char*)"type");
@@ -1221,7 +1616,7 @@ raptor_turtle_serialize_terminate(raptor_serializer* serializer)
   }
 
   if(context->nodes) {
-    raptor_free_avltree(context->nodes);
+    raptor_free_abbrev_nodes(context->nodes);
     context->nodes = NULL;
   }
 
@@ -1264,6 +1659,27 @@ raptor_turtle_serialize_terminate(raptor_serializer* serializer)
     raptor_free_uri(context->rs_resultVariable_uri);
     context->rs_resultVariable_uri = NULL;
   }
+
+  if(context->stream_subject) {
+    raptor_free_term(context->stream_subject);
+    context->stream_subject = NULL;
+  }
+
+  if(context->stream_predicate) {
+    raptor_free_term(context->stream_predicate);
+    context->stream_predicate = NULL;
+  }
+
+  if(context->spool) {
+    raptor_free_spool(context->spool);
+    context->spool = NULL;
+  }
+
+  if(context->spool_record) {
+    RAPTOR_FREE(char*, context->spool_record);
+    context->spool_record = NULL;
+    context->spool_record_size = 0;
+  }
 }
 
 
@@ -1404,13 +1820,6 @@ raptor_turtle_serialize_statement(raptor_serializer* serializer,
     return 1;
   }
 
-  subject = raptor_abbrev_subject_lookup(context->nodes, context->subjects,
-                                         context->blanks,
-                                         statement->subject);
-  if(!subject) {
-    return 1;
-  }
-
   object_type = statement->object->type;
 
   if(!(object_type == RAPTOR_TERM_TYPE_URI ||
@@ -1422,6 +1831,35 @@ raptor_turtle_serialize_statement(raptor_serializer* serializer,
     return 1;
   }
 
+  if(!context->spool) {
+    int budget = RAPTOR_OPTIONS_GET_NUMERIC(serializer,
+                                            RAPTOR_OPTION_MEMORY_BUDGET);
+    if(budget > 0) {
+      context->spool = raptor_new_spool(serializer->world,
+                                        (size_t)budget * 1024);
+      if(!context->spool)
+        return 1;
+    }
+  }
+
+  if(context->spool) {
+    if(statement->predicate->type != RAPTOR_TERM_TYPE_URI) {
+      raptor_log_error_formatted(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                                 "Do not know how to serialize node type %u",
+                                 statement->predicate->type);
+      return 1;
+    }
+
+    return raptor_turtle_spool_statement(serializer, statement);
+  }
+
+  subject = raptor_abbrev_subject_lookup(context->nodes, context->subjects,
+                                         context->blanks,
+                                         statement->subject);
+  if(!subject) {
+    return 1;
+  }
+
   object = raptor_abbrev_node_lookup(context->nodes, statement->object);
   if(!object)
     return 1;
@@ -1461,9 +1899,160 @@ raptor_turtle_serialize_end(raptor_serializer* serializer)
 {
   raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
 
+  int rc = 0;
+
   raptor_turtle_ensure_writen_header(serializer, context);
 
-  raptor_turtle_emit(serializer);
+  if(context->spool) {
+    rc = raptor_turtle_spool_emit(serializer);
+
+    raptor_free_spool(context->spool);
+    context->spool = NULL;
+  } else
+    raptor_turtle_emit(serializer);
+
+  /* reset serializer for reuse */
+  context->written_header = 0;
+
+  return rc;
+}
+
+
+/*
+ * raptor_turtle_stream_close_subject:
+ * @serializer: #raptor_serializer object
+ *
+ * INTERNAL - Terminate the predicate-object list of the last subject
+ * written by the turtle-stream serializer, if any.
+ */
+static void
+raptor_turtle_stream_close_subject(raptor_serializer* serializer)
+{
+  raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
+  raptor_turtle_writer* turtle_writer = context->turtle_writer;
+
+  if(!context->stream_subject)
+    return;
+
+  raptor_turtle_writer_decrease_indent(turtle_writer);
+  /* NOTE: the space before the . MUST be there - see
+   * raptor_turtle_emit_subject() */
+  raptor_turtle_writer_raw_counted(turtle_writer, (const unsigned char*)" .", 2);
+  raptor_turtle_writer_newline(turtle_writer);
+  raptor_turtle_writer_newline(turtle_writer);
+
+  raptor_free_term(context->stream_subject);
+  context->stream_subject = NULL;
+  if(context->stream_predicate) {
+    raptor_free_term(context->stream_predicate);
+    context->stream_predicate = NULL;
+  }
+}
+
+
+/*
+ * raptor_turtle_stream_serialize_statement:
+ * @serializer: #raptor_serializer object
+ * @statement: statement
+ *
+ * INTERNAL - Write a statement as it arrives (turtle-stream)
+ *
+ * Only the subject and predicate of the previous statement are kept
+ * so a run of statements with the same subject is written as one
+ * predicate-object list with ';' and a run with the same subject
+ * and predicate as one object list with ','.  Nothing else is
+ * abbreviated: blank nodes are always written with their IDs and
+ * collections as rdf:first / rdf:rest triples.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_turtle_stream_serialize_statement(raptor_serializer* serializer,
+                                         raptor_statement *statement)
+{
+  raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
+  raptor_turtle_writer* turtle_writer = context->turtle_writer;
+  raptor_term_type object_type;
+
+  if(!turtle_writer)
+    return 1;
+
+  if(!(statement->subject->type == RAPTOR_TERM_TYPE_URI ||
+       statement->subject->type == RAPTOR_TERM_TYPE_BLANK)) {
+    raptor_log_error_formatted(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                               "Do not know how to serialize node type %u",
+                               statement->subject->type);
+    return 1;
+  }
+
+  if(statement->predicate->type != RAPTOR_TERM_TYPE_URI) {
+    raptor_log_error_formatted(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                               "Do not know how to serialize node type %u",
+                               statement->predicate->type);
+    return 1;
+  }
+
+  object_type = statement->object->type;
+  if(!(object_type == RAPTOR_TERM_TYPE_URI ||
+       object_type == RAPTOR_TERM_TYPE_BLANK ||
+       object_type == RAPTOR_TERM_TYPE_LITERAL)) {
+    raptor_log_error_formatted(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                               "Cannot serialize a triple with object node type %u",
+                               object_type);
+    return 1;
+  }
+
+  raptor_turtle_ensure_writen_header(serializer, context);
+
+  if(context->stream_subject &&
+     raptor_term_equals(context->stream_subject, statement->subject)) {
+    if(raptor_term_equals(context->stream_predicate, statement->predicate)) {
+      /* same subject and predicate: continue the object list */
+      raptor_turtle_writer_raw_counted(turtle_writer,
+                                       (const unsigned char*)", ", 2);
+      return raptor_turtle_writer_term(turtle_writer, statement->object);
+    }
+
+    /* same subject: continue the predicate-object list */
+    raptor_turtle_writer_raw_counted(turtle_writer,
+                                     (const unsigned char*)" ;", 2);
+    raptor_turtle_writer_newline(turtle_writer);
+  } else {
+    raptor_turtle_stream_close_subject(serializer);
+
+    if(raptor_turtle_writer_term(turtle_writer, statement->subject))
+      return 1;
+    context->stream_subject = raptor_term_copy(statement->subject);
+
+    raptor_turtle_writer_increase_indent(turtle_writer);
+    raptor_turtle_writer_newline(turtle_writer);
+  }
+
+  if(context->stream_predicate)
+    raptor_free_term(context->stream_predicate);
+  context->stream_predicate = raptor_term_copy(statement->predicate);
+
+  if(raptor_uri_equals(statement->predicate->value.uri,
+                       context->rdf_type->term->value.uri))
+    raptor_turtle_writer_raw_counted(turtle_writer,
+                                     (const unsigned char*)"a", 1);
+  else
+    raptor_turtle_writer_uri(turtle_writer, statement->predicate->value.uri);
+  raptor_turtle_writer_raw_counted(turtle_writer, (const unsigned char*)" ", 1);
+
+  return raptor_turtle_writer_term(turtle_writer, statement->object);
+}
+
+
+/* end a turtle-stream serialize */
+static int
+raptor_turtle_stream_serialize_end(raptor_serializer* serializer)
+{
+  raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
+
+  raptor_turtle_ensure_writen_header(serializer, context);
+
+  raptor_turtle_stream_close_subject(serializer);
 
   /* reset serializer for reuse */
   context->written_header = 0;
@@ -1482,6 +2071,7 @@ raptor_turtle_serialize_finish_factory(raptor_serializer_factory* factory)
 
 static const char* const turtle_names[2] = { "turtle", NULL};
 static const char* const    mkr_names[2] = { "mkr", NULL};
+static const char* const turtle_stream_names[2] = { "turtle-stream", NULL};
 
 static const char* const turtle_uri_strings[3] = {
   "http://www.w3.org/ns/formats/Turtle",
@@ -1533,6 +2123,36 @@ raptor_turtle_serializer_register_factory(raptor_serializer_factory *factory)
   return 0;
 }
 
+#define TURTLE_STREAM_TYPES_COUNT 2
+static const raptor_type_q turtle_stream_types[TURTLE_STREAM_TYPES_COUNT + 1] = {
+  { "text/turtle", 11, 0},
+  { "application/x-turtle", 20, 0},
+  { NULL, 0, 0}
+};
+
+static int
+raptor_turtle_stream_serializer_register_factory(raptor_serializer_factory *factory)
+{
+  factory->desc.names = turtle_stream_names;
+  factory->desc.mime_types = turtle_stream_types;
+
+  factory->desc.label = "Turtle Terse RDF Triple Language (streaming)";
+  factory->desc.uri_strings = NULL;
+
+  factory->context_length     = sizeof(raptor_turtle_context);
+
+  factory->init                = raptor_turtle_serialize_init;
+  factory->terminate           = raptor_turtle_serialize_terminate;
+  factory->declare_namespace   = raptor_turtle_serialize_declare_namespace;
+  factory->declare_namespace_from_namespace   = raptor_turtle_serialize_declare_namespace_from_namespace;
+  factory->serialize_start     = raptor_turtle_serialize_start;
+  factory->serialize_statement = raptor_turtle_stream_serialize_statement;
+  factory->serialize_end       = raptor_turtle_stream_serialize_end;
+  factory->finish_factory      = raptor_turtle_serialize_finish_factory;
+
+  return 0;
+}
+
 static int
 raptor_mkr_serializer_register_factory(raptor_serializer_factory *factory)
 {
@@ -1559,8 +2179,17 @@ raptor_mkr_serializer_register_factory(raptor_serializer_factory *factory)
 int
 raptor_init_serializer_turtle(raptor_world* world)
 {
-  return !raptor_serializer_register_factory(world,
-                                             &raptor_turtle_serializer_register_factory);
+  int rc;
+
+  rc = !raptor_serializer_register_factory(world,
+                                           &raptor_turtle_serializer_register_factory);
+  if(rc)
+    return rc;
+
+  rc = !raptor_serializer_register_factory(world,
+                                           &raptor_turtle_stream_serializer_register_factory);
+
+  return rc;
 }
 
 int
@@ -50,31 +50,63 @@
  *  Destroy Set
  *  Check a (base, ID) pair present add it if not, return if added/not
  *
+ * The set is an open addressing hash table of 64 bit fingerprints of
+ * the (base URI, ID) pairs, made of two independent 32 bit hashes.
+ * In exact mode each slot also keeps the base URI and a copy of the
+ * ID so that fingerprint collisions are told apart.
+ *
+ * The table is kept at most half full while it can double within the
+ * memory limit; after that it is filled up to 7/8.  When that is full
+ * too, it is replaced by a Bloom filter of the limit size holding the
+ * same fingerprints.  After that an ID can only be reported as
+ * possibly present.
  */
 
-struct raptor_base_id_set_s
-{
-  raptor_world* world;
+#define RAPTOR_ID_SET_INITIAL_SIZE 64
 
-  /* The base URI of this set of IDs */
-  raptor_uri *uri;
-  
-  /* neighbour ID sets */
-  struct raptor_base_id_set_s* prev;
-  struct raptor_base_id_set_s* next;
+/* number of bits set per fingerprint in the Bloom filter */
+#define RAPTOR_ID_SET_BLOOM_PROBES 4
 
-  /* binary tree */
-  raptor_avltree* tree;
-};
-typedef struct raptor_base_id_set_s raptor_base_id_set;
+typedef struct {
+  raptor_uri* base_uri;
+  unsigned char* id;
+  size_t id_len;
+} raptor_id_set_key;
 
 
 struct raptor_id_set_s
 {
   raptor_world* world;
 
-  /* start of trees, 1 per base URI */
-  struct raptor_base_id_set_s* first;
+  /* non-0 to store the IDs and never give false positives */
+  int exact;
+
+  /* memory limit in bytes for the hash table or 0 for no limit */
+  size_t max_size;
+
+  /* hash table with a power of 2 size; 2 hash values per slot and
+   * both 0 mark an empty slot */
+  unsigned int* fingerprints;
+  size_t size;
+  size_t count;
+  /* count at which the table must grow */
+  size_t grow_count;
+
+  /* keys parallel to fingerprints in exact mode */
+  raptor_id_set_key* keys;
+  /* bytes used by ID copies in exact mode */
+  size_t keys_size;
+
+  /* Bloom filter used instead of the table once max_size was reached */
+  unsigned char* bloom;
+  size_t bloom_bits;
+  /* number of IDs in the table when it was replaced by the Bloom filter */
+  size_t bloom_count;
+
+  /* last base URI seen and the hash state after it */
+  raptor_uri* base_uri;
+  unsigned int base_h1;
+  unsigned int base_h2;
 
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
   int hits;
@@ -88,39 +120,53 @@ struct raptor_id_set_s
 /**
  * raptor_new_id_set:
  * @world: raptor_world object
+ * @exact: non-0 to store IDs so that there are no false positives
+ * @max_size: memory limit in bytes before using a Bloom filter or 0 for no limit
  *
  * INTERNAL - Constructor - create a new ID set.
  * 
- * Return value: non 0 on failure
+ * Return value: new ID set or NULL on failure
  **/
 raptor_id_set*
-raptor_new_id_set(raptor_world* world)
+raptor_new_id_set(raptor_world* world, int exact, size_t max_size)
 {
   raptor_id_set* set = RAPTOR_CALLOC(raptor_id_set*, 1, sizeof(*set));
   if(!set)
     return NULL;
 
   set->world = world;
+  set->exact = exact;
+  set->max_size = max_size;
 
   return set;
 }
 
 
-/**
- * raptor_free_base_id_set:
- * @set: #raptor_base_id_set
- *
- * INTERNAL - Destructor - Free a Base ID Set.
- *
- **/
 static void
-raptor_free_base_id_set(raptor_base_id_set *base) 
+raptor_id_set_free_table(raptor_id_set *set)
 {
-  if(base->tree)
-    raptor_free_avltree(base->tree);
-  if(base->uri)
-    raptor_free_uri(base->uri);
-  RAPTOR_FREE(raptor_base_id_set, base);
+  if(set->keys) {
+    size_t i;
+
+    for(i = 0; i < set->size; i++) {
+      if(set->keys[i].id) {
+        RAPTOR_FREE(char*, set->keys[i].id);
+        raptor_free_uri(set->keys[i].base_uri);
+      }
+    }
+    RAPTOR_FREE(raptor_id_set_key*, set->keys);
+    set->keys = NULL;
+  }
+
+  if(set->fingerprints) {
+    RAPTOR_FREE(unsigned int*, set->fingerprints);
+    set->fingerprints = NULL;
+  }
+
+  set->size = 0;
+  set->count = 0;
+  set->grow_count = 0;
+  set->keys_size = 0;
 }
 
 
@@ -134,20 +180,190 @@ raptor_free_base_id_set(raptor_base_id_set *base)
 void
 raptor_free_id_set(raptor_id_set *set) 
 {
-  raptor_base_id_set *base;
-
   RAPTOR_ASSERT_OBJECT_POINTER_RETURN(set, raptor_id_set);
 
-  base = set->first;
-  while(base) {
-    raptor_base_id_set *next = base->next;
-    raptor_free_base_id_set(base);
-    base = next;
-  }
+  raptor_id_set_free_table(set);
+
+  if(set->bloom)
+    RAPTOR_FREE(char*, set->bloom);
+
+  if(set->base_uri)
+    raptor_free_uri(set->base_uri);
+
   RAPTOR_FREE(raptor_id_set, set);
 }
 
 
+static void
+raptor_id_set_bloom_add(raptor_id_set* set, unsigned int h1, unsigned int h2,
+                        int* present_p)
+{
+  int present = 1;
+  int i;
+
+  for(i = 0; i < RAPTOR_ID_SET_BLOOM_PROBES; i++) {
+    size_t bit = (size_t)(h1 + (unsigned int)i * h2) % set->bloom_bits;
+    unsigned char mask = (unsigned char)(1 << (bit & 7));
+
+    if(!(set->bloom[bit >> 3] & mask)) {
+      present = 0;
+      set->bloom[bit >> 3] |= mask;
+    }
+  }
+
+  if(present_p)
+    *present_p = present;
+}
+
+
+/* replace the hash table by a Bloom filter of max_size bytes */
+static int
+raptor_id_set_make_bloom(raptor_id_set* set)
+{
+  size_t bloom_size = set->max_size;
+  size_t i;
+
+  set->bloom = RAPTOR_CALLOC(unsigned char*, bloom_size, 1);
+  if(!set->bloom)
+    return 1;
+  set->bloom_bits = bloom_size << 3;
+
+  for(i = 0; i < set->size; i++) {
+    unsigned int h1 = set->fingerprints[i << 1];
+    unsigned int h2 = set->fingerprints[(i << 1) + 1];
+
+    if(h1 || h2)
+      raptor_id_set_bloom_add(set, h1, h2, NULL);
+  }
+
+  set->bloom_count = set->count;
+
+  raptor_id_set_free_table(set);
+
+  return 0;
+}
+
+
+/* return slot of a fingerprint and key or the empty slot for them */
+static size_t
+raptor_id_set_find_slot(raptor_id_set* set, unsigned int h1, unsigned int h2,
+                        raptor_uri* base_uri,
+                        const unsigned char* id, size_t id_len)
+{
+  size_t mask = set->size - 1;
+  size_t i;
+
+  for(i = h1 & mask; ; i = (i + 1) & mask) {
+    unsigned int* fp = &set->fingerprints[i << 1];
+
+    if(!fp[0] && !fp[1])
+      break;
+
+    if(fp[0] == h1 && fp[1] == h2) {
+      raptor_id_set_key* key;
+
+      if(!set->keys)
+        break;
+
+      key = &set->keys[i];
+      if(key->id_len == id_len && !memcmp(key->id, id, id_len) &&
+         raptor_uri_equals(key->base_uri, base_uri))
+        break;
+    }
+  }
+
+  return i;
+}
+
+
+/* bytes used by a table of @size slots holding the current IDs */
+static size_t
+raptor_id_set_table_bytes(raptor_id_set* set, size_t size)
+{
+  size_t bytes = size * 2 * sizeof(unsigned int);
+
+  if(set->exact)
+    bytes += size * sizeof(raptor_id_set_key) + set->keys_size;
+
+  return bytes;
+}
+
+
+static int
+raptor_id_set_grow(raptor_id_set* set)
+{
+  unsigned int* old_fingerprints = set->fingerprints;
+  raptor_id_set_key* old_keys = set->keys;
+  size_t old_size = set->size;
+  size_t new_size;
+  size_t i;
+
+  new_size = old_size ? (old_size << 1) : RAPTOR_ID_SET_INITIAL_SIZE;
+
+  if(set->max_size &&
+     raptor_id_set_table_bytes(set, new_size) > set->max_size) {
+    size_t full_count = old_size - (old_size >> 3);
+
+    /* cannot double so use the rest of the current table */
+    if(set->count < full_count &&
+       raptor_id_set_table_bytes(set, old_size) <= set->max_size) {
+      set->grow_count = full_count;
+      return 0;
+    }
+
+    return raptor_id_set_make_bloom(set);
+  }
+
+  set->fingerprints = RAPTOR_CALLOC(unsigned int*, new_size << 1,
+                                    sizeof(unsigned int));
+  if(!set->fingerprints) {
+    set->fingerprints = old_fingerprints;
+    return 1;
+  }
+
+  if(set->exact) {
+    set->keys = RAPTOR_CALLOC(raptor_id_set_key*, new_size,
+                              sizeof(raptor_id_set_key));
+    if(!set->keys) {
+      RAPTOR_FREE(unsigned int*, set->fingerprints);
+      set->fingerprints = old_fingerprints;
+      set->keys = old_keys;
+      return 1;
+    }
+  }
+
+  set->size = new_size;
+  set->grow_count = new_size >> 1;
+
+  for(i = 0; i < old_size; i++) {
+    unsigned int h1 = old_fingerprints[i << 1];
+    unsigned int h2 = old_fingerprints[(i << 1) + 1];
+    size_t mask = new_size - 1;
+    size_t j;
+
+    if(!h1 && !h2)
+      continue;
+
+    /* all entries are distinct so only an empty slot is needed */
+    for(j = h1 & mask;
+        set->fingerprints[j << 1] || set->fingerprints[(j << 1) + 1];
+        j = (j + 1) & mask)
+      ;
+
+    set->fingerprints[j << 1] = h1;
+    set->fingerprints[(j << 1) + 1] = h2;
+    if(old_keys)
+      set->keys[j] = old_keys[i];
+  }
+
+  if(old_fingerprints)
+    RAPTOR_FREE(unsigned int*, old_fingerprints);
+  if(old_keys)
+    RAPTOR_FREE(raptor_id_set_key*, old_keys);
+
+  return 0;
+}
+
 
 /**
  * raptor_id_set_add:
@@ -157,64 +373,68 @@ raptor_free_id_set(raptor_id_set *set)
  * @id_len: length of identifier
  *
  * INTERNAL - Add an item to the set.
+ *
+ * Once the set has reached its memory limit it cannot tell for
+ * certain whether an item was seen before and returns 2 when the
+ * item may have been.
  * 
- * Return value: <0 on failure, 0 on success, 1 if already present
+ * Return value: <0 on failure, 0 on success, 1 if already present,
+ * 2 if possibly present
  **/
 int
 raptor_id_set_add(raptor_id_set* set, raptor_uri *base_uri,
                   const unsigned char *id, size_t id_len)
 {
-  raptor_base_id_set *base;
-  char* item;
+  unsigned int h1;
+  unsigned int h2;
+  size_t i;
   
   if(!base_uri || !id || !id_len)
     return -1;
 
-  base = set->first;
-  while(base) {
-    if(raptor_uri_equals(base->uri, base_uri))
-      break;
-    base = base->next;
+  if(base_uri != set->base_uri) {
+    unsigned char* uri_string;
+    size_t uri_len;
+
+    if(set->base_uri)
+      raptor_free_uri(set->base_uri);
+    set->base_uri = raptor_uri_copy(base_uri);
+
+    set->base_h1 = 2166136261U;
+    set->base_h2 = 0;
+    uri_string = raptor_uri_as_counted_string(base_uri, &uri_len);
+    /* include the NUL as a separator from the ID */
+    raptor_hash_bytes(&set->base_h1, &set->base_h2,
+                      uri_string, uri_len + 1);
   }
 
-  if(!base) {
-    /* a set for this base_uri not found */
-    base = RAPTOR_CALLOC(raptor_base_id_set*, 1, sizeof(*base));
-    if(!base)
+  h1 = set->base_h1;
+  h2 = set->base_h2;
+  raptor_hash_bytes(&h1, &h2, id, id_len);
+  h2 = raptor_hash_bytes_finish(h2);
+  if(!h1 && !h2)
+    h2 = 1;
+
+  /* exact mode also checks the ID copies against the limit */
+  if(!set->bloom &&
+     (set->count >= set->grow_count ||
+      (set->exact && set->max_size &&
+       raptor_id_set_table_bytes(set, set->size) > set->max_size))) {
+    if(raptor_id_set_grow(set))
       return -1;
+  }
 
-    base->world = set->world;
-
-    base->uri = raptor_uri_copy(base_uri);
+  if(set->bloom) {
+    int present;
 
-    base->tree = raptor_new_avltree((raptor_data_compare_handler)strcmp,
-                                    free, 0);
-  
-    /* Add to the start of the list */
-    if(set->first)
-      set->first->prev = base;
-    /* base->prev = NULL; */
-    base->next = set->first;
-
-    set->first = base;
-  } else {
-    /* If not at the start of the list, move there */
-    if(base != set->first) {
-      /* remove from the list */
-      base->prev->next = base->next;
-      if(base->next)
-        base->next->prev = base->prev;
-      /* add at the start of the list */
-      set->first->prev = base;
-      base->prev = NULL;
-      base->next = set->first;
-    }
+    raptor_id_set_bloom_add(set, h1, h2, &present);
+    return present ? 2 : 0;
   }
-  
-  item = (char*)raptor_avltree_search(base->tree, id);
+
+  i = raptor_id_set_find_slot(set, h1, h2, base_uri, id, id_len);
 
   /* if already there, error */
-  if(item) {
+  if(set->fingerprints[i << 1] || set->fingerprints[(i << 1) + 1]) {
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
     set->misses++;
 #endif
@@ -224,14 +444,48 @@ raptor_id_set_add(raptor_id_set* set, raptor_uri *base_uri,
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
   set->hits++;
 #endif
-  
-  item = RAPTOR_MALLOC(char*, id_len + 1);
-  if(!item)
-    return 1;
 
-  memcpy(item, id, id_len + 1);
+  if(set->exact) {
+    raptor_id_set_key* key = &set->keys[i];
+
+    key->id = RAPTOR_MALLOC(unsigned char*, id_len + 1);
+    if(!key->id)
+      return -1;
+    memcpy(key->id, id, id_len);
+    key->id[id_len] = '\0';
+    key->id_len = id_len;
+    key->base_uri = raptor_uri_copy(base_uri);
+    set->keys_size += id_len + 1;
+  }
+
+  set->fingerprints[i << 1] = h1;
+  set->fingerprints[(i << 1) + 1] = h2;
+  set->count++;
 
-  return raptor_avltree_add(base->tree, item);
+  return 0;
+}
+
+
+/**
+ * raptor_id_set_reached_limit:
+ * @set: #raptor_id_set
+ * @count_p: pointer to store the number of IDs held when the limit was reached (or NULL)
+ *
+ * INTERNAL - Check if the set reached its memory limit
+ *
+ * Return value: non-0 if the set reached its memory limit and only
+ * reports items as possibly present
+ **/
+int
+raptor_id_set_reached_limit(raptor_id_set* set, size_t* count_p)
+{
+  if(!set->bloom)
+    return 0;
+
+  if(count_p)
+    *count_p = set->bloom_count;
+
+  return 1;
 }
 
 
@@ -251,51 +505,50 @@ raptor_id_set_stats_print(raptor_id_set* set, FILE *stream) {
 int main(int argc, char *argv[]);
 
 
-int
-main(int argc, char *argv[]) 
+static const char *items[8] = { "ron", "amy", "jen", "bij", "jib", "daj", "jim", NULL };
+
+static int
+test_id_set(raptor_world *world, const char *program,
+            int exact, size_t max_size)
 {
-  raptor_world *world;
-  const char *program = raptor_basename(argv[0]);
-  const char *items[8] = { "ron", "amy", "jen", "bij", "jib", "daj", "jim", NULL };
   raptor_id_set *set;
   raptor_uri *base_uri;
+  raptor_uri *other_base_uri;
   int i = 0;
-  
-  world = raptor_new_world();
-  if(!world || raptor_world_open(world))
-    exit(1);
-    
+  int rc;
+
   base_uri = raptor_new_uri(world, (const unsigned char*)"http://example.org/base#");
+  other_base_uri = raptor_new_uri(world, (const unsigned char*)"http://example.org/other#");
 
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
-  fprintf(stderr, "%s: Creating set\n", program);
+  fprintf(stderr, "%s: Creating set exact %d max size %d\n", program,
+          exact, (int)max_size);
 #endif
 
-  set = raptor_new_id_set(world);
+  set = raptor_new_id_set(world, exact, max_size);
   if(!set) {
     fprintf(stderr, "%s: Failed to create set\n", program);
-    exit(1);
+    return 1;
   }
 
   for(i = 0; items[i]; i++) {
     size_t len = strlen(items[i]);
-    int rc;
 
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
     fprintf(stderr, "%s: Adding set item '%s'\n", program, items[i]);
 #endif
   
     rc = raptor_id_set_add(set, base_uri, (const unsigned char*)items[i], len);
-if(rc) {
+    /* a full set may report a new item as possibly present */
+    if(rc < 0 || (rc && !max_size)) {
       fprintf(stderr, "%s: Adding set item %d '%s' failed, returning error %d\n",
               program, i, items[i], rc);
-      exit(1);
+      return 1;
     }
   }
 
   for(i = 0; items[i]; i++) {
     size_t len = strlen(items[i]);
-    int rc;
 
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
     fprintf(stderr, "%s: Adding duplicate set item '%s'\n", program, items[i]);
@@ -305,10 +558,19 @@ if(rc) {
     if(rc <= 0) {
       fprintf(stderr, "%s: Adding duplicate set item %d '%s' succeeded, should have failed, returning error %d\n",
               program, i, items[i], rc);
-      exit(1);
+      return 1;
     }
   }
 
+  /* the same ID with another base is not a duplicate */
+  rc = raptor_id_set_add(set, other_base_uri,
+                         (const unsigned char*)items[0], strlen(items[0]));
+  if(rc < 0 || (rc && !max_size)) {
+    fprintf(stderr, "%s: Adding set item '%s' with other base failed, returning error %d\n",
+            program, items[0], rc);
+    return 1;
+  }
+
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
   raptor_id_set_stats_print(set, stderr);
 #endif
@@ -318,12 +580,95 @@ if(rc) {
 #endif
   raptor_free_id_set(set);
 
+  raptor_free_uri(other_base_uri);
   raptor_free_uri(base_uri);
+
+  return 0;
+}
+
+
+/* a 4096 byte table of 512 slots cannot double within 4096 bytes
+ * so it is filled to 7/8 before becoming a Bloom filter */
+#define TEST_LIMIT_SIZE 4096
+#define TEST_LIMIT_COUNT 448
+
+static int
+test_id_set_limit(raptor_world *world, const char *program)
+{
+  raptor_id_set *set;
+  raptor_uri *base_uri;
+  size_t count = 0;
+  int rc = 0;
+  int i;
+
+  base_uri = raptor_new_uri(world, (const unsigned char*)"http://example.org/base#");
+
+  set = raptor_new_id_set(world, 0, TEST_LIMIT_SIZE);
+  if(!set) {
+    fprintf(stderr, "%s: Failed to create set\n", program);
+    raptor_free_uri(base_uri);
+    return 1;
+  }
+
+  for(i = 0; i <= TEST_LIMIT_COUNT; i++) {
+    char id[16];
+    int add_rc;
+
+    if(i == TEST_LIMIT_COUNT && raptor_id_set_reached_limit(set, NULL)) {
+      fprintf(stderr, "%s: Set reached its limit before holding %d IDs\n",
+              program, TEST_LIMIT_COUNT);
+      rc = 1;
+      break;
+    }
+
+    sprintf(id, "id%d", i);
+    add_rc = raptor_id_set_add(set, base_uri, (const unsigned char*)id,
+                               strlen(id));
+    if(add_rc < 0 || (add_rc && i < TEST_LIMIT_COUNT)) {
+      fprintf(stderr, "%s: Adding set item '%s' returned %d\n",
+              program, id, add_rc);
+      rc = 1;
+      break;
+    }
+  }
+
+  if(!rc && (!raptor_id_set_reached_limit(set, &count) ||
+             count != TEST_LIMIT_COUNT)) {
+    fprintf(stderr, "%s: Set reached its limit after %d IDs, expected %d\n",
+            program, (int)count, TEST_LIMIT_COUNT);
+    rc = 1;
+  }
+
+  raptor_free_id_set(set);
+  raptor_free_uri(base_uri);
+
+  return rc;
+}
+
+
+int
+main(int argc, char *argv[]) 
+{
+  raptor_world *world;
+  const char *program = raptor_basename(argv[0]);
+  int failures = 0;
   
+  world = raptor_new_world();
+  if(!world || raptor_world_open(world))
+    exit(1);
+
+  /* fingerprints */
+  failures += test_id_set(world, program, 0, 0);
+  /* exact */
+  failures += test_id_set(world, program, 1, 0);
+  /* Bloom filter of 64 bytes */
+  failures += test_id_set(world, program, 0, 64);
+  /* table filled past half before the Bloom filter */
+  failures += test_id_set_limit(world, program);
+
   raptor_free_world(world);
   
-  /* keep gcc -Wall happy */
-  return(0);
+  return failures;
 }
 
 #endif
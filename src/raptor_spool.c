@@ -0,0 +1,745 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * raptor_spool.c - Raptor external merge sort of byte records
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <raptor_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+/* Raptor includes */
+#include "raptor2.h"
+#include "raptor_internal.h"
+
+
+#ifndef STANDALONE
+
+/*
+ * A spool collects variable length byte records, sorts them with
+ * memcmp() order (a record that is a prefix of another sorts first)
+ * and returns them in order.
+ *
+ * Records are kept in memory until they use more than the memory
+ * limit, then the sorted records are written to a temporary file as
+ * a run.  Runs are merged RAPTOR_SPOOL_MERGE_WIDTH at a time as they
+ * accumulate so at most a few dozen files are open at once, and
+ * merged into a single run when the spool is finished.
+ */
+
+/* POLICY - number of runs merged in one go */
+#define RAPTOR_SPOOL_MERGE_WIDTH 16
+
+/* POLICY - minimum size of the record buffer */
+#define RAPTOR_SPOOL_MIN_BUFFER_SIZE 1024
+
+
+typedef struct {
+  size_t offset;
+  size_t length;
+} raptor_spool_entry;
+
+
+typedef struct {
+  FILE* fh;
+  /* runs made from merging N runs of level L have level L+1 */
+  int level;
+} raptor_spool_run;
+
+
+typedef struct {
+  FILE* fh;
+  unsigned char* record;
+  size_t length;
+  size_t size;
+} raptor_spool_cursor;
+
+
+struct raptor_spool_s {
+  raptor_world* world;
+
+  size_t memory_limit;
+
+  /* in-memory records stored back to back */
+  unsigned char* buffer;
+  size_t buffer_length;
+  size_t buffer_size;
+
+  raptor_spool_entry* entries;
+  int entries_count;
+  int entries_size;
+
+  /* sequence of raptor_spool_run* */
+  raptor_sequence* runs;
+
+  /* non-0 after raptor_spool_finish() */
+  int finished;
+
+  /* reading: index into entries or the cursor over the single run */
+  int next_entry;
+  raptor_spool_cursor cursor;
+};
+
+
+static void
+raptor_free_spool_run(raptor_spool_run* run)
+{
+  if(run->fh)
+    fclose(run->fh);
+  RAPTOR_FREE(raptor_spool_run, run);
+}
+
+
+/**
+ * raptor_new_spool:
+ * @world: raptor world
+ * @memory_limit: bytes of records to hold in memory before writing
+ *   a sorted run to a temporary file
+ *
+ * INTERNAL - Constructor for a record spool
+ *
+ * Return value: new spool or NULL on failure
+ */
+raptor_spool*
+raptor_new_spool(raptor_world* world, size_t memory_limit)
+{
+  raptor_spool* spool;
+
+  spool = RAPTOR_CALLOC(raptor_spool*, 1, sizeof(*spool));
+  if(!spool)
+    return NULL;
+
+  spool->world = world;
+  spool->memory_limit = memory_limit;
+  spool->runs = raptor_new_sequence((raptor_data_free_handler)raptor_free_spool_run, NULL);
+  if(!spool->runs) {
+    RAPTOR_FREE(raptor_spool, spool);
+    return NULL;
+  }
+
+  return spool;
+}
+
+
+/**
+ * raptor_free_spool:
+ * @spool: spool
+ *
+ * INTERNAL - Destructor - closes and deletes any temporary files
+ */
+void
+raptor_free_spool(raptor_spool* spool)
+{
+  if(!spool)
+    return;
+
+  if(spool->buffer)
+    RAPTOR_FREE(char*, spool->buffer);
+  if(spool->entries)
+    RAPTOR_FREE(raptor_spool_entry*, spool->entries);
+  if(spool->cursor.record)
+    RAPTOR_FREE(char*, spool->cursor.record);
+  if(spool->runs)
+    raptor_free_sequence(spool->runs);
+
+  RAPTOR_FREE(raptor_spool, spool);
+}
+
+
+static int
+raptor_spool_compare_records(const unsigned char* record1, size_t length1,
+                             const unsigned char* record2, size_t length2)
+{
+  int d;
+
+  d = memcmp(record1, record2, (length1 < length2) ? length1 : length2);
+  if(!d && length1 != length2)
+    d = (length1 < length2) ? -1 : 1;
+
+  return d;
+}
+
+
+static int
+raptor_spool_compare_entries(const void* data1, const void* data2,
+                             void* user_data)
+{
+  raptor_spool* spool = (raptor_spool*)user_data;
+  const raptor_spool_entry* entry1 = (const raptor_spool_entry*)data1;
+  const raptor_spool_entry* entry2 = (const raptor_spool_entry*)data2;
+
+  return raptor_spool_compare_records(spool->buffer + entry1->offset,
+                                      entry1->length,
+                                      spool->buffer + entry2->offset,
+                                      entry2->length);
+}
+
+
+static int
+raptor_spool_write_record(raptor_spool* spool, FILE* fh,
+                          const unsigned char* record, size_t length)
+{
+  if(fwrite(&length, sizeof(length), 1, fh) != 1 ||
+     (length && fwrite(record, 1, length, fh) != length)) {
+    raptor_log_error_formatted(spool->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                               "Writing to temporary file failed - %s",
+                               strerror(errno));
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * raptor_spool_cursor_next:
+ * @spool: spool
+ * @cursor: cursor
+ *
+ * INTERNAL - Read the next record of a run into the cursor
+ *
+ * Return value: <0 on failure, >0 at end of run, 0 otherwise
+ */
+static int
+raptor_spool_cursor_next(raptor_spool* spool, raptor_spool_cursor* cursor)
+{
+  size_t length;
+
+  if(fread(&length, sizeof(length), 1, cursor->fh) != 1) {
+    if(feof(cursor->fh))
+      return 1;
+    goto failed;
+  }
+
+  if(length > cursor->size) {
+    unsigned char* record;
+    size_t size = cursor->size ? cursor->size : RAPTOR_SPOOL_MIN_BUFFER_SIZE;
+
+    while(size < length)
+      size <<= 1;
+
+    record = RAPTOR_REALLOC(unsigned char*, cursor->record, size);
+    if(!record)
+      return -1;
+    cursor->record = record;
+    cursor->size = size;
+  }
+
+  if(length && fread(cursor->record, 1, length, cursor->fh) != length)
+    goto failed;
+
+  cursor->length = length;
+  return 0;
+
+  failed:
+  raptor_log_error_formatted(spool->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                             "Reading from temporary file failed - %s",
+                             ferror(cursor->fh) ? strerror(errno) : "truncated");
+  return -1;
+}
+
+
+static FILE*
+raptor_spool_new_file(raptor_spool* spool)
+{
+  FILE* fh;
+
+  fh = tmpfile();
+  if(!fh)
+    raptor_log_error_formatted(spool->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                               "Cannot create temporary file - %s",
+                               strerror(errno));
+  return fh;
+}
+
+
+static int
+raptor_spool_push_run(raptor_spool* spool, FILE* fh, int level)
+{
+  raptor_spool_run* run;
+
+  run = RAPTOR_CALLOC(raptor_spool_run*, 1, sizeof(*run));
+  if(!run) {
+    fclose(fh);
+    return 1;
+  }
+  run->fh = fh;
+  run->level = level;
+
+  return raptor_sequence_push(spool->runs, run);
+}
+
+
+/*
+ * raptor_spool_merge_runs:
+ * @spool: spool
+ * @count: number of runs to merge from the end of the runs sequence
+ *
+ * INTERNAL - Replace the last @count runs with one run of all their records
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_spool_merge_runs(raptor_spool* spool, int count)
+{
+  raptor_spool_cursor* cursors;
+  int first = raptor_sequence_size(spool->runs) - count;
+  int level = 0;
+  FILE* fh;
+  int rc = 0;
+  int i;
+
+  fh = raptor_spool_new_file(spool);
+  if(!fh)
+    return 1;
+
+  cursors = RAPTOR_CALLOC(raptor_spool_cursor*, count, sizeof(*cursors));
+  if(!cursors) {
+    fclose(fh);
+    return 1;
+  }
+
+  for(i = 0; i < count; i++) {
+    raptor_spool_run* run;
+
+    run = (raptor_spool_run*)raptor_sequence_get_at(spool->runs, first + i);
+    if(run->level > level)
+      level = run->level;
+    cursors[i].fh = run->fh;
+    rewind(cursors[i].fh);
+    rc = raptor_spool_cursor_next(spool, &cursors[i]);
+    if(rc < 0)
+      goto tidy;
+    if(rc > 0)
+      cursors[i].fh = NULL;
+  }
+  rc = 0;
+
+  while(1) {
+    raptor_spool_cursor* min = NULL;
+
+    /* few runs are merged at once so a linear scan is fine */
+    for(i = 0; i < count; i++) {
+      if(!cursors[i].fh)
+        continue;
+      if(!min ||
+         raptor_spool_compare_records(cursors[i].record, cursors[i].length,
+                                      min->record, min->length) < 0)
+        min = &cursors[i];
+    }
+    if(!min)
+      break;
+
+    rc = raptor_spool_write_record(spool, fh, min->record, min->length);
+    if(rc)
+      goto tidy;
+
+    rc = raptor_spool_cursor_next(spool, min);
+    if(rc < 0)
+      goto tidy;
+    if(rc > 0)
+      min->fh = NULL;
+    rc = 0;
+  }
+
+  tidy:
+  for(i = 0; i < count; i++) {
+    if(cursors[i].record)
+      RAPTOR_FREE(char*, cursors[i].record);
+  }
+  RAPTOR_FREE(raptor_spool_cursor*, cursors);
+
+  if(rc) {
+    fclose(fh);
+    return 1;
+  }
+
+  for(i = 0; i < count; i++)
+    raptor_free_spool_run((raptor_spool_run*)raptor_sequence_pop(spool->runs));
+
+  return raptor_spool_push_run(spool, fh, level + 1);
+}
+
+
+/*
+ * raptor_spool_flush:
+ * @spool: spool
+ *
+ * INTERNAL - Sort the in-memory records and write them as a new run
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_spool_flush(raptor_spool* spool)
+{
+  FILE* fh;
+  int i;
+
+  if(!spool->entries_count)
+    return 0;
+
+  raptor_sort_r(spool->entries, spool->entries_count,
+                sizeof(raptor_spool_entry),
+                raptor_spool_compare_entries, spool);
+
+  fh = raptor_spool_new_file(spool);
+  if(!fh)
+    return 1;
+
+  for(i = 0; i < spool->entries_count; i++) {
+    raptor_spool_entry* entry = &spool->entries[i];
+
+    if(raptor_spool_write_record(spool, fh, spool->buffer + entry->offset,
+                                 entry->length)) {
+      fclose(fh);
+      return 1;
+    }
+  }
+
+  spool->buffer_length = 0;
+  spool->entries_count = 0;
+
+  if(raptor_spool_push_run(spool, fh, 0))
+    return 1;
+
+  /* merge while the last RAPTOR_SPOOL_MERGE_WIDTH runs have one level */
+  while(1) {
+    int size = raptor_sequence_size(spool->runs);
+    raptor_spool_run* last;
+    raptor_spool_run* run;
+
+    if(size < RAPTOR_SPOOL_MERGE_WIDTH)
+      break;
+
+    last = (raptor_spool_run*)raptor_sequence_get_at(spool->runs, size - 1);
+    run = (raptor_spool_run*)raptor_sequence_get_at(spool->runs,
+                                                    size - RAPTOR_SPOOL_MERGE_WIDTH);
+    if(run->level != last->level)
+      break;
+
+    if(raptor_spool_merge_runs(spool, RAPTOR_SPOOL_MERGE_WIDTH))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/**
+ * raptor_spool_add:
+ * @spool: spool
+ * @record: record bytes
+ * @length: length of @record
+ *
+ * INTERNAL - Add a copy of a record to the spool
+ *
+ * Return value: non-0 on failure
+ */
+int
+raptor_spool_add(raptor_spool* spool, const unsigned char* record,
+                 size_t length)
+{
+  raptor_spool_entry* entry;
+
+  if(spool->finished)
+    return 1;
+
+  if(spool->entries_count &&
+     spool->buffer_length + length +
+     (spool->entries_count + 1) * sizeof(raptor_spool_entry) > spool->memory_limit) {
+    if(raptor_spool_flush(spool))
+      return 1;
+  }
+
+  if(spool->buffer_length + length > spool->buffer_size) {
+    unsigned char* buffer;
+    size_t size = spool->buffer_size ? spool->buffer_size : RAPTOR_SPOOL_MIN_BUFFER_SIZE;
+
+    while(size < spool->buffer_length + length)
+      size <<= 1;
+
+    buffer = RAPTOR_REALLOC(unsigned char*, spool->buffer, size);
+    if(!buffer)
+      return 1;
+    spool->buffer = buffer;
+    spool->buffer_size = size;
+  }
+
+  if(spool->entries_count == spool->entries_size) {
+    raptor_spool_entry* entries;
+    int size = spool->entries_size ? (spool->entries_size << 1) : 64;
+
+    entries = RAPTOR_REALLOC(raptor_spool_entry*, spool->entries,
+                             size * sizeof(*entries));
+    if(!entries)
+      return 1;
+    spool->entries = entries;
+    spool->entries_size = size;
+  }
+
+  entry = &spool->entries[spool->entries_count++];
+  entry->offset = spool->buffer_length;
+  entry->length = length;
+
+  if(length)
+    memcpy(spool->buffer + spool->buffer_length, record, length);
+  spool->buffer_length += length;
+
+  return 0;
+}
+
+
+/**
+ * raptor_spool_finish:
+ * @spool: spool
+ *
+ * INTERNAL - Finish adding records and prepare to read them in order
+ *
+ * If nothing was written to disk the records are sorted in memory,
+ * otherwise the remaining records are written and all runs merged
+ * into one.
+ *
+ * Return value: non-0 on failure
+ */
+int
+raptor_spool_finish(raptor_spool* spool)
+{
+  int size;
+
+  if(spool->finished)
+    return 0;
+
+  if(!raptor_sequence_size(spool->runs)) {
+    if(spool->entries_count > 1)
+      raptor_sort_r(spool->entries, spool->entries_count,
+                    sizeof(raptor_spool_entry),
+                    raptor_spool_compare_entries, spool);
+  } else {
+    if(raptor_spool_flush(spool))
+      return 1;
+
+    size = raptor_sequence_size(spool->runs);
+    if(size > 1 && raptor_spool_merge_runs(spool, size))
+      return 1;
+
+    /* the records now live on disk */
+    if(spool->buffer) {
+      RAPTOR_FREE(char*, spool->buffer);
+      spool->buffer = NULL;
+      spool->buffer_size = 0;
+    }
+    if(spool->entries) {
+      RAPTOR_FREE(raptor_spool_entry*, spool->entries);
+      spool->entries = NULL;
+      spool->entries_size = 0;
+    }
+  }
+
+  spool->finished = 1;
+
+  return raptor_spool_rewind(spool);
+}
+
+
+/**
+ * raptor_spool_rewind:
+ * @spool: spool
+ *
+ * INTERNAL - Restart reading a finished spool from the first record
+ *
+ * Return value: non-0 on failure
+ */
+int
+raptor_spool_rewind(raptor_spool* spool)
+{
+  raptor_spool_run* run;
+
+  if(!spool->finished)
+    return 1;
+
+  spool->next_entry = 0;
+
+  run = (raptor_spool_run*)raptor_sequence_get_at(spool->runs, 0);
+  if(run) {
+    spool->cursor.fh = run->fh;
+    rewind(spool->cursor.fh);
+  }
+
+  return 0;
+}
+
+
+/**
+ * raptor_spool_next:
+ * @spool: spool
+ * @length_p: pointer to store record length
+ *
+ * INTERNAL - Get the next record of a finished spool in sorted order
+ *
+ * The record is shared and valid until the next call.
+ *
+ * Return value: record or NULL at the end or on failure
+ */
+const unsigned char*
+raptor_spool_next(raptor_spool* spool, size_t* length_p)
+{
+  if(!spool->finished)
+    return NULL;
+
+  if(spool->cursor.fh) {
+    if(raptor_spool_cursor_next(spool, &spool->cursor))
+      return NULL;
+    *length_p = spool->cursor.length;
+    /* a zero length record has no allocated buffer yet */
+    return spool->cursor.record ? spool->cursor.record
+                                : (const unsigned char*)"";
+  }
+
+  if(spool->next_entry < spool->entries_count) {
+    raptor_spool_entry* entry = &spool->entries[spool->next_entry++];
+
+    *length_p = entry->length;
+    return entry->length ? spool->buffer + entry->offset
+                         : (const unsigned char*)"";
+  }
+
+  return NULL;
+}
+
+#endif
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+#define TEST_RECORDS_COUNT 5000
+
+static int
+test_spool(raptor_world* world, const char* program, size_t memory_limit)
+{
+  raptor_spool* spool;
+  unsigned char record[32];
+  const unsigned char* r;
+  size_t length;
+  int pass;
+  int i;
+  int rc = 0;
+
+  spool = raptor_new_spool(world, memory_limit);
+  if(!spool) {
+    fprintf(stderr, "%s: raptor_new_spool() failed\n", program);
+    return 1;
+  }
+
+  /* distinct records in a scrambled order; some are prefixes of others */
+  for(i = 0; i < TEST_RECORDS_COUNT; i++) {
+    int n = (i * 7919) % TEST_RECORDS_COUNT;
+
+    length = sprintf((char*)record, "r%04d", n / 2);
+    if(n % 2)
+      record[length++] = 'x';
+    if(raptor_spool_add(spool, record, length)) {
+      fprintf(stderr, "%s: raptor_spool_add() failed\n", program);
+      rc = 1;
+      goto tidy;
+    }
+  }
+
+  if(raptor_spool_finish(spool)) {
+    fprintf(stderr, "%s: raptor_spool_finish() failed\n", program);
+    rc = 1;
+    goto tidy;
+  }
+
+  for(pass = 0; pass < 2; pass++) {
+    if(pass && raptor_spool_rewind(spool)) {
+      fprintf(stderr, "%s: raptor_spool_rewind() failed\n", program);
+      rc = 1;
+      goto tidy;
+    }
+
+    for(i = 0; (r = raptor_spool_next(spool, &length)); i++) {
+      size_t expected_length;
+
+      /* record i of the sorted output is "r%04d" of i/2, then with 'x' */
+      expected_length = sprintf((char*)record, "r%04d", i / 2);
+      if(i % 2)
+        record[expected_length++] = 'x';
+
+      if(length != expected_length || memcmp(r, record, length)) {
+        fprintf(stderr,
+                "%s: limit %d pass %d: record %d is '%.*s' expected '%.*s'\n",
+                program, (int)memory_limit, pass, i, (int)length, r,
+                (int)expected_length, record);
+        rc = 1;
+        goto tidy;
+      }
+    }
+
+    if(i != TEST_RECORDS_COUNT) {
+      fprintf(stderr, "%s: limit %d pass %d: got %d records expected %d\n",
+              program, (int)memory_limit, pass, i, TEST_RECORDS_COUNT);
+      rc = 1;
+      goto tidy;
+    }
+  }
+
+  tidy:
+  raptor_free_spool(spool);
+
+  return rc;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  raptor_world *world;
+  const char *program = raptor_basename(argv[0]);
+  int failures = 0;
+
+  world = raptor_new_world();
+  if(!world || raptor_world_open(world))
+    exit(1);
+
+  /* all in memory */
+  failures += test_spool(world, program, 1 << 20);
+  /* a few runs merged at the end */
+  failures += test_spool(world, program, 16384);
+  /* many runs so they are merged as they accumulate */
+  failures += test_spool(world, program, 512);
+
+  raptor_free_world(world);
+
+  return failures;
+}
+
+#endif
@@ -44,27 +44,24 @@
 
 #ifndef STANDALONE
 
-struct raptor_stringbuffer_node_s
-{
-  struct raptor_stringbuffer_node_s* next;
-  unsigned char *string;
-  size_t length;
-};
-typedef struct raptor_stringbuffer_node_s raptor_stringbuffer_node;
-
+/* Size of the buffer inside the stringbuffer object used for short strings */
+#define RAPTOR_STRINGBUFFER_SMALL_SIZE 64
 
 struct raptor_stringbuffer_s
 {
-  /* Pointing to the first item in the list of nodes */
-  raptor_stringbuffer_node* head;
-  /* and the last */
-  raptor_stringbuffer_node* tail;
-  
+  /* String content, always '\0' terminated.  Points at small or to a
+   * heap block when the content outgrows it.
+   */
+  unsigned char *string;
+
   /* total length of the string */
   size_t length;
 
-  /* frozen string if already calculated, or NULL if not present */
-  unsigned char *string;
+  /* allocated size of string including space for the '\0' */
+  size_t size;
+
+  /* initial storage so that short strings need no extra allocation */
+  unsigned char small[RAPTOR_STRINGBUFFER_SMALL_SIZE];
 };
 
 
@@ -72,6 +69,70 @@ struct raptor_stringbuffer_s
 static int raptor_stringbuffer_append_string_common(raptor_stringbuffer* stringbuffer, const unsigned char *string, size_t length, int do_copy);
 
 
+/* Reset stringbuffer to empty, using the small buffer */
+static void
+raptor_stringbuffer_reset(raptor_stringbuffer* stringbuffer)
+{
+  stringbuffer->string = stringbuffer->small;
+  stringbuffer->size = RAPTOR_STRINGBUFFER_SMALL_SIZE;
+  stringbuffer->length = 0;
+  stringbuffer->small[0] = '\0';
+}
+
+
+/*
+ * raptor_stringbuffer_ensure:
+ * @stringbuffer: raptor stringbuffer
+ * @length: number of bytes to make room for
+ *
+ * INTERNAL - Grow the stringbuffer so @length more bytes and a '\0' fit
+ *
+ * The storage is grown geometrically so that appends are amortized
+ * constant time and done in place.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_stringbuffer_ensure(raptor_stringbuffer* stringbuffer, size_t length)
+{
+  size_t needed = stringbuffer->length + length + 1;
+  size_t new_size;
+  unsigned char *new_string;
+
+  if(needed <= stringbuffer->size)
+    return 0;
+
+  if(needed < length)
+    return 1; /* overflow */
+
+  new_size = stringbuffer->size;
+  while(new_size < needed) {
+    if(new_size > ((size_t)-1) / 2) {
+      new_size = needed;
+      break;
+    }
+    new_size <<= 1;
+  }
+
+  if(stringbuffer->string == stringbuffer->small) {
+    new_string = RAPTOR_MALLOC(unsigned char*, new_size);
+    if(!new_string)
+      return 1;
+    memcpy(new_string, stringbuffer->small, stringbuffer->length + 1);
+  } else {
+    new_string = RAPTOR_REALLOC(unsigned char*, stringbuffer->string,
+                                new_size);
+    if(!new_string)
+      return 1;
+  }
+
+  stringbuffer->string = new_string;
+  stringbuffer->size = new_size;
+
+  return 0;
+}
+
+
 /* functions implementing the stringbuffer api */
 
 /**
@@ -86,11 +147,31 @@ raptor_new_stringbuffer(void)
 {
   raptor_stringbuffer* sb;
   
-  sb = RAPTOR_CALLOC(raptor_stringbuffer*, 1, sizeof(*sb));
+  sb = RAPTOR_MALLOC(raptor_stringbuffer*, sizeof(*sb));
+  if(sb)
+    raptor_stringbuffer_reset(sb);
   return sb;
 }
 
 
+/*
+ * raptor_stringbuffer_clear:
+ * @stringbuffer: raptor stringbuffer
+ *
+ * INTERNAL - Empty a stringbuffer so it can be used again
+ *
+ * Any storage beyond the initial small buffer is freed.
+ */
+void
+raptor_stringbuffer_clear(raptor_stringbuffer* stringbuffer)
+{
+  if(stringbuffer->string != stringbuffer->small)
+    RAPTOR_FREE(char*, stringbuffer->string);
+
+  raptor_stringbuffer_reset(stringbuffer);
+}
+
+
 /**
  * raptor_free_stringbuffer:
  * @stringbuffer: stringbuffer object to destroy.
@@ -104,20 +185,7 @@ raptor_free_stringbuffer(raptor_stringbuffer *stringbuffer)
   if(!stringbuffer)
     return;
 
-  if(stringbuffer->head) {
-    raptor_stringbuffer_node *node = stringbuffer->head;
-  
-    while(node) {
-      raptor_stringbuffer_node *next = node->next;
-      
-      if(node->string)
-        RAPTOR_FREE(char*, node->string);
-      RAPTOR_FREE(raptor_stringbuffer_node, node);
-      node = next;
-    }
-  }
-
-  if(stringbuffer->string)
+  if(stringbuffer->string != stringbuffer->small)
     RAPTOR_FREE(char*, stringbuffer->string);
 
   RAPTOR_FREE(raptor_stringbuffer, stringbuffer);
@@ -150,45 +218,24 @@ raptor_stringbuffer_append_string_common(raptor_stringbuffer* stringbuffer,
                                          size_t length,
                                          int do_copy)
 {
-  raptor_stringbuffer_node *node;
+  int rc = 0;
 
   if(!string || !length)
     return 0;
-  
-  node = RAPTOR_MALLOC(raptor_stringbuffer_node*, sizeof(*node));
-  if(!node) {
-    if(!do_copy)
-      RAPTOR_FREE(char*, string);
-    return 1;
-  }
-
-  if(do_copy) {
-    /* Note this copy does not include the \0 character - not needed  */
-    node->string = RAPTOR_MALLOC(unsigned char*, length);
-    if(!node->string) {
-      RAPTOR_FREE(raptor_stringbuffer_node, node);
-      return 1;
-    }
-    memcpy(node->string, string, length);
-  } else
-    node->string = (unsigned char*)string;
-  node->length = length;
-
-
-  if(stringbuffer->tail) {
-    stringbuffer->tail->next = node;
-    stringbuffer->tail = node;
-  } else
-    stringbuffer->head = stringbuffer->tail = node;
-  node->next = NULL;
 
-  if(stringbuffer->string) {
-    RAPTOR_FREE(char*, stringbuffer->string);
-    stringbuffer->string = NULL;
+  if(raptor_stringbuffer_ensure(stringbuffer, length))
+    rc = 1;
+  else {
+    memcpy(stringbuffer->string + stringbuffer->length, string, length);
+    stringbuffer->length += length;
+    stringbuffer->string[stringbuffer->length] = '\0';
   }
-  stringbuffer->length += length;
 
-  return 0;
+  /* content is always copied in place so an owned string is done with */
+  if(!do_copy)
+    RAPTOR_FREE(char*, string);
+
+  return rc;
 }
 
 
@@ -308,33 +355,29 @@ int
 raptor_stringbuffer_append_stringbuffer(raptor_stringbuffer* stringbuffer, 
                                         raptor_stringbuffer* append)
 {
-  raptor_stringbuffer_node *node = append->head;
-
-  if(!node)
+  if(!append->length)
     return 0;
 
-  /* move all append nodes to stringbuffer */
-  if(stringbuffer->tail) {
-    stringbuffer->tail->next = node;
-  } else
-    stringbuffer->head = node;
-
-  stringbuffer->tail = append->tail;
+  if(!stringbuffer->length && append->string != append->small) {
+    /* take over the heap block without copying */
+    if(stringbuffer->string != stringbuffer->small)
+      RAPTOR_FREE(char*, stringbuffer->string);
+    stringbuffer->string = append->string;
+    stringbuffer->length = append->length;
+    stringbuffer->size = append->size;
+  } else {
+    if(raptor_stringbuffer_ensure(stringbuffer, append->length))
+      return 1;
+    memcpy(stringbuffer->string + stringbuffer->length, append->string,
+           append->length + 1);
+    stringbuffer->length += append->length;
 
-  /* adjust our length */
-  stringbuffer->length += append->length;
-  if(stringbuffer->string) {
-    RAPTOR_FREE(char*, stringbuffer->string);
-    stringbuffer->string = NULL;
+    if(append->string != append->small)
+      RAPTOR_FREE(char*, append->string);
   }
 
   /* zap append content */
-  append->head = append->tail = NULL;
-  append->length = 0;
-  if(append->string) {
-    RAPTOR_FREE(char*, append->string);
-    append->string = NULL;
-  }
+  raptor_stringbuffer_reset(append);
   
   return 0;
 }
@@ -364,38 +407,23 @@ raptor_stringbuffer_prepend_string_common(raptor_stringbuffer* stringbuffer,
                                           const unsigned char *string, size_t length,
                                           int do_copy)
 {
-  raptor_stringbuffer_node *node;
-
-  node = RAPTOR_MALLOC(raptor_stringbuffer_node*, sizeof(*node));
-  if(!node)
-    return 1;
-
-  if(do_copy) {
-    /* Note this copy does not include the \0 character - not needed  */
-    node->string = RAPTOR_MALLOC(unsigned char*, length);
-    if(!node->string) {
-      RAPTOR_FREE(raptor_stringbuffer_node, node);
-      return 1;
-    }
-    memcpy(node->string, string, length);
-  } else
-    node->string = (unsigned char*)string;
-  node->length = length;
-
-
-  node->next = stringbuffer->head;
-  if(stringbuffer->head)
-    stringbuffer->head = node;
-  else
-    stringbuffer->head = stringbuffer->tail = node;
-
-  if(stringbuffer->string) {
-    RAPTOR_FREE(char*, stringbuffer->string);
-    stringbuffer->string = NULL;
+  int rc = 0;
+
+  if(!length)
+    rc = 0;
+  else if(raptor_stringbuffer_ensure(stringbuffer, length))
+    rc = 1;
+  else {
+    memmove(stringbuffer->string + length, stringbuffer->string,
+            stringbuffer->length + 1);
+    memcpy(stringbuffer->string, string, length);
+    stringbuffer->length += length;
   }
-  stringbuffer->length += length;
 
-  return 0;
+  if(!do_copy && string)
+    RAPTOR_FREE(char*, string);
+
+  return rc;
 }
 
 
@@ -470,7 +498,8 @@ raptor_stringbuffer_length(raptor_stringbuffer* stringbuffer)
  * Return the stringbuffer as a C string.
  * 
  * Note: the return value is a to a shared string that the stringbuffer
- * allocates and manages.
+ * allocates and manages.  It is only valid until the stringbuffer
+ * is next changed.
  *
  * Return value: NULL on failure or stringbuffer is empty, otherwise
  *   a pointer to a shared copy of the string.
@@ -478,27 +507,58 @@ raptor_stringbuffer_length(raptor_stringbuffer* stringbuffer)
 unsigned char *
 raptor_stringbuffer_as_string(raptor_stringbuffer* stringbuffer)
 {
-  raptor_stringbuffer_node *node;
-  unsigned char *p;
-  
   if(!stringbuffer->length)
     return NULL;
-  if(stringbuffer->string)
-    return stringbuffer->string;
 
-  stringbuffer->string = RAPTOR_MALLOC(unsigned char*, stringbuffer->length + 1);
-  if(!stringbuffer->string)
-    return NULL;
+  return stringbuffer->string;
+}
 
-  node = stringbuffer->head;
-  p = stringbuffer->string;
-  while(node) {
-    memcpy(p, node->string, node->length);
-    p+= node->length;
-    node = node->next;
+
+/**
+ * raptor_stringbuffer_as_string_steal:
+ * @stringbuffer: raptor stringbuffer
+ * @length_p: pointer to location to store length of string (or NULL)
+ *
+ * Take the stringbuffer content as a new C string.
+ *
+ * The stringbuffer becomes empty and the caller owns the returned
+ * string which must be freed with raptor_free_memory().  If the
+ * content is already in a heap block it is returned without
+ * copying.
+ *
+ * An empty stringbuffer returns a new empty string.
+ *
+ * Return value: new string or NULL on failure
+ **/
+unsigned char *
+raptor_stringbuffer_as_string_steal(raptor_stringbuffer* stringbuffer,
+                                    size_t* length_p)
+{
+  unsigned char *string;
+  size_t length = stringbuffer->length;
+
+  if(stringbuffer->string == stringbuffer->small) {
+    string = RAPTOR_MALLOC(unsigned char*, length + 1);
+    if(!string)
+      return NULL;
+    memcpy(string, stringbuffer->small, length + 1);
+  } else {
+    string = stringbuffer->string;
+    /* give back any slack from geometric growth */
+    if(stringbuffer->size > length + 1) {
+      unsigned char *shrunk = RAPTOR_REALLOC(unsigned char*, string,
+                                             length + 1);
+      if(shrunk)
+        string = shrunk;
+    }
   }
-  *p='\0';
-  return stringbuffer->string;
+
+  raptor_stringbuffer_reset(stringbuffer);
+
+  if(length_p)
+    *length_p = length;
+
+  return string;
 }
 
 
@@ -519,26 +579,23 @@ int
 raptor_stringbuffer_copy_to_string(raptor_stringbuffer* stringbuffer,
                                    unsigned char *string, size_t length)
 {
-  raptor_stringbuffer_node *node;
-  unsigned char *p;
-  
   if(!string || length < 1)
     return 1;
 
   if(!stringbuffer->length)
     return 0;
 
-  p = string;
-  for(node = stringbuffer->head; node; node = node->next) {
-    if(node->length > length) {
-      p[-1]='\0';
-      return 1;
-    }
-    memcpy(p, node->string, node->length);
-    p+= node->length;
-    length-= node->length;
+  if(stringbuffer->length > length) {
+    memcpy(string, stringbuffer->string, length - 1);
+    string[length - 1] = '\0';
+    return 1;
   }
-  *p='\0';
+
+  /* callers may pass the string length for a buffer with one more
+   * byte for the '\0'
+   */
+  memcpy(string, stringbuffer->string, stringbuffer->length);
+  string[stringbuffer->length] = '\0';
   return 0;
 }
 
@@ -666,6 +723,7 @@ main(int argc, char *argv[])
   const char *test_append_results[TEST_APPEND_COUNT]={ "thebrownjumpsthedog", "quickfoxoverlazy" };
   const char *test_append_results_total="thebrownjumpsthedogquickfoxoverlazy";
 #define COPY_STRING_BUFFER_SIZE 100
+#define TEST_STEAL_COUNT (TEST_ITEMS_COUNT * 100)
   unsigned char *copy_string;
   
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
@@ -886,6 +944,55 @@ main(int argc, char *argv[])
     exit(1);
   }
   free(copy_string);
+
+
+#if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
+  fprintf(stderr, "%s: Stealing string buffer strings\n", program);
+#endif
+
+  str = raptor_stringbuffer_as_string_steal(sb1, &len);
+  if(!str || len != strlen(test_append_results_total) ||
+     strcmp((const char*)str, test_append_results_total)) {
+    fprintf(stderr, "%s: stolen string buffer contains '%s', expected '%s'\n",
+            program, str, test_append_results_total);
+    exit(1);
+  }
+  raptor_free_memory(str);
+
+  len = raptor_stringbuffer_length(sb1);
+  if(len) {
+    fprintf(stderr, "%s: stolen string buffer is length %d, not empty'\n",
+            program, (int)len);
+    exit(1);
+  }
+
+  /* grow past the small buffer */
+  for(i = 0; i < TEST_STEAL_COUNT; i++) {
+    if(raptor_stringbuffer_append_counted_string(sb1, (unsigned char*)items[i % TEST_ITEMS_COUNT],
+                                                 strlen(items[i % TEST_ITEMS_COUNT]), 1)) {
+      fprintf(stderr, "%s: Adding string buffer item %d failed\n",
+              program, i);
+      exit(1);
+    }
+  }
+  
+  str = raptor_stringbuffer_as_string_steal(sb1, &len);
+  if(!str || len != items_len * (TEST_STEAL_COUNT / TEST_ITEMS_COUNT) ||
+     strncmp((const char*)str, items_string, items_len) ||
+     strcmp((const char*)str + len - items_len, items_string)) {
+    fprintf(stderr, "%s: stolen string buffer has length %d, expected %d\n",
+            program, (int)len, (int)(items_len * (TEST_STEAL_COUNT / TEST_ITEMS_COUNT)));
+    exit(1);
+  }
+  raptor_free_memory(str);
+
+  str = raptor_stringbuffer_as_string_steal(sb1, &len);
+  if(!str || len || *str) {
+    fprintf(stderr, "%s: stolen empty string buffer is length %d\n",
+            program, (int)len);
+    exit(1);
+  }
+  raptor_free_memory(str);
   
   
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
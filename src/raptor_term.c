@@ -757,6 +757,88 @@ raptor_term_compare(const raptor_term *t1,  const raptor_term *t2)
 
   return d;
 }
+
+
+/**
+ * raptor_term_fingerprint:
+ * @term: term
+ * @h1_p: pointer to store the raptor_term_hash() value
+ * @h2_p: pointer to store a second, independent hash value (or NULL)
+ *
+ * INTERNAL - Hash a #raptor_term consistently with raptor_term_equals()
+ *
+ * URIs are hashed by their string, not their pointer, so the hashes
+ * do not depend on URI interning.  The two values together make a
+ * 64 bit fingerprint for sets that do not keep the terms.
+ */
+void
+raptor_term_fingerprint(const raptor_term* term,
+                        unsigned int* h1_p, unsigned int* h2_p)
+{
+  unsigned int h1 = 2166136261U;
+  unsigned int h2 = 0;
+  unsigned int* h2p = h2_p ? &h2 : NULL;
+  unsigned char* str;
+  size_t len;
+
+  raptor_hash_bytes(&h1, h2p, (const unsigned char*)&term->type,
+                    sizeof(term->type));
+
+  switch(term->type) {
+    case RAPTOR_TERM_TYPE_URI:
+      str = raptor_uri_as_counted_string(term->value.uri, &len);
+      raptor_hash_bytes(&h1, h2p, str, len);
+      break;
+
+    case RAPTOR_TERM_TYPE_BLANK:
+      raptor_hash_bytes(&h1, h2p, term->value.blank.string,
+                        term->value.blank.string_len);
+      break;
+
+    case RAPTOR_TERM_TYPE_LITERAL:
+      raptor_hash_bytes(&h1, h2p, term->value.literal.string,
+                        term->value.literal.string_len);
+      if(term->value.literal.language)
+        raptor_hash_bytes(&h1, h2p, term->value.literal.language,
+                          term->value.literal.language_len);
+      if(term->value.literal.datatype) {
+        str = raptor_uri_as_counted_string(term->value.literal.datatype,
+                                           &len);
+        raptor_hash_bytes(&h1, h2p, str, len);
+      }
+      break;
+
+    case RAPTOR_TERM_TYPE_UNKNOWN:
+    default:
+      break;
+  }
+
+  *h1_p = h1;
+  if(h2_p)
+    *h2_p = raptor_hash_bytes_finish(h2);
+}
+
+
+/**
+ * raptor_term_hash:
+ * @term: term
+ *
+ * INTERNAL - Hash a #raptor_term consistently with raptor_term_equals()
+ *
+ * URIs are hashed by their string, not their pointer, so the hash
+ * does not depend on URI interning.
+ *
+ * Return value: hash value
+ */
+unsigned int
+raptor_term_hash(const raptor_term* term)
+{
+  unsigned int hash;
+
+  raptor_term_fingerprint(term, &hash, NULL);
+
+  return hash;
+}
 #endif
 
 
@@ -603,6 +603,9 @@ raptor_turtle_writer_set_option(raptor_turtle_writer *turtle_writer,
     case RAPTOR_OPTION_NON_NFC_FATAL:
     case RAPTOR_OPTION_WARN_OTHER_PARSETYPES:
     case RAPTOR_OPTION_CHECK_RDF_ID:
+    case RAPTOR_OPTION_CHECK_RDF_ID_EXACT:
+    case RAPTOR_OPTION_CHECK_RDF_ID_MEMORY:
+    case RAPTOR_OPTION_GRDDL_THREADS:
     case RAPTOR_OPTION_HTML_TAG_SOUP:
     case RAPTOR_OPTION_MICROFORMATS:
     case RAPTOR_OPTION_HTML_LINK:
@@ -628,12 +631,16 @@ raptor_turtle_writer_set_option(raptor_turtle_writer *turtle_writer,
     /* JSON serializer options */
     case RAPTOR_OPTION_JSON_CALLBACK:
     case RAPTOR_OPTION_JSON_EXTRA_DATA:
+    case RAPTOR_OPTION_JSON_STREAM:
+    case RAPTOR_OPTION_JSON_STREAM_CHECK:
     case RAPTOR_OPTION_RSS_TRIPLES:
     case RAPTOR_OPTION_ATOM_ENTRY_URI:
     case RAPTOR_OPTION_PREFIX_ELEMENTS:
     
     /* Turtle serializer option */
     case RAPTOR_OPTION_WRITE_BASE_URI:
+    case RAPTOR_OPTION_MEMORY_BUDGET:
+    case RAPTOR_OPTION_NTRIPLES_THREADS:
 
     /* WWW option */
     case RAPTOR_OPTION_WWW_HTTP_CACHE_CONTROL:
@@ -727,6 +734,9 @@ raptor_turtle_writer_get_option(raptor_turtle_writer *turtle_writer,
     case RAPTOR_OPTION_NON_NFC_FATAL:
     case RAPTOR_OPTION_WARN_OTHER_PARSETYPES:
     case RAPTOR_OPTION_CHECK_RDF_ID:
+    case RAPTOR_OPTION_CHECK_RDF_ID_EXACT:
+    case RAPTOR_OPTION_CHECK_RDF_ID_MEMORY:
+    case RAPTOR_OPTION_GRDDL_THREADS:
     case RAPTOR_OPTION_HTML_TAG_SOUP:
     case RAPTOR_OPTION_MICROFORMATS:
     case RAPTOR_OPTION_HTML_LINK:
@@ -752,12 +762,16 @@ raptor_turtle_writer_get_option(raptor_turtle_writer *turtle_writer,
     /* JSON serializer options */
     case RAPTOR_OPTION_JSON_CALLBACK:
     case RAPTOR_OPTION_JSON_EXTRA_DATA:
+    case RAPTOR_OPTION_JSON_STREAM:
+    case RAPTOR_OPTION_JSON_STREAM_CHECK:
     case RAPTOR_OPTION_RSS_TRIPLES:
     case RAPTOR_OPTION_ATOM_ENTRY_URI:
     case RAPTOR_OPTION_PREFIX_ELEMENTS:
     
     /* Turtle serializer option */
     case RAPTOR_OPTION_WRITE_BASE_URI:
+    case RAPTOR_OPTION_MEMORY_BUDGET:
+    case RAPTOR_OPTION_NTRIPLES_THREADS:
 
     /* WWW option */
     case RAPTOR_OPTION_WWW_HTTP_CACHE_CONTROL:
@@ -191,6 +191,7 @@ raptor_xml_element_set_attributes(raptor_xml_element* xml_element,
 {
   xml_element->attributes = attributes;
   xml_element->attribute_count = count;
+  xml_element->attributes_size = count;
 }
 
 
@@ -793,6 +794,7 @@ raptor_xml_escape_string_any_write(const unsigned char *string,
 {
   size_t l;
   const unsigned char *p;
+  char specials[5] = "&<>";
 
   if(xml_version != 10)
     xml_version = 11;
@@ -800,9 +802,26 @@ raptor_xml_escape_string_any_write(const unsigned char *string,
   if(quote != '\"' && quote != '\'')
     quote='\0';
 
+  /* Printable ASCII other than these is never escaped */
+  specials[3] = quote;
+
   for(l = len, p = string; l; p++, l--) {
     int unichar_len = 1;
-    raptor_unichar unichar=*p;
+    raptor_unichar unichar;
+    size_t plain_len;
+
+    /* Write any run of plain characters in one go; the rest of the
+     * loop handles escapes, validation and UTF-8 */
+    plain_len = raptor_memspn_ascii(p, l, specials);
+    if(plain_len) {
+      raptor_iostream_counted_string_write(p, plain_len, iostr);
+      p += plain_len;
+      l -= plain_len;
+      if(!l)
+        break;
+    }
+
+    unichar = *p;
 
     if(*p > 0x7f) {
       unichar_len = raptor_unicode_utf8_string_get_char(p, l, &unichar);
@@ -945,6 +964,65 @@ raptor_xml_name_check(const unsigned char *string, size_t length,
 }
 
 
+/**
+ * raptor_xml_name_suffix_start:
+ * @string: UTF-8 string
+ * @length: length of string
+ * @xml_version: XML version
+ *
+ * INTERNAL - Find the longest suffix of a string that is a legal XML name
+ *
+ * This gives the same answer as calling raptor_xml_name_check() on
+ * every suffix from the longest down but in one pass from the end of
+ * the string.  Each byte offset records whether the characters from
+ * there to the end are all legal name characters; a character is at
+ * most 6 bytes so only the last 8 offsets need to be remembered.
+ *
+ * Return value: offset of the suffix or @length if there is none
+ **/
+size_t
+raptor_xml_name_suffix_start(const unsigned char *string, size_t length,
+                             int xml_version)
+{
+  /* rest_ok[i & 7] is non-0 if the string from offset i is all name chars */
+  unsigned char rest_ok[8];
+  size_t start = length;
+  size_t i;
+
+  if(xml_version != 10 && xml_version != 11)
+    return length;
+
+  rest_ok[length & 7] = 1;
+  for(i = length; i-- > 0; ) {
+    raptor_unichar unichar = 0;
+    int unichar_len;
+    int is_name_char = 0;
+    int is_start_char = 0;
+
+    unichar_len = raptor_unicode_utf8_string_get_char(string + i, length - i,
+                                                      &unichar);
+    if(unichar_len > 0 &&
+       RAPTOR_GOOD_CAST(size_t, unichar_len) <= length - i &&
+       unichar <= raptor_unicode_max_codepoint &&
+       rest_ok[(i + unichar_len) & 7]) {
+      if(xml_version == 10) {
+        is_name_char = raptor_unicode_is_xml10_namechar(unichar);
+        is_start_char = raptor_unicode_is_xml10_namestartchar(unichar);
+      } else {
+        is_name_char = raptor_unicode_is_xml11_namechar(unichar);
+        is_start_char = raptor_unicode_is_xml11_namestartchar(unichar);
+      }
+    }
+
+    rest_ok[i & 7] = (unsigned char)is_name_char;
+    if(is_start_char)
+      start = i;
+  }
+
+  return start;
+}
+
+
 #endif
 
 
@@ -1007,6 +1085,13 @@ main(int argc, char *argv[])
 
     {"&amp;", 0, "&amp;amp;"},
     {"<foo>", 0, "&lt;foo&gt;"},
+
+    {"plain text that is longer than one vector", 0,
+     "plain text that is longer than one vector"},
+    {"a <long> string with \"quotes\" & caf\xc3\xa9 \xe2\x82\xac and\x0dmore", 0,
+     "a &lt;long&gt; string with \"quotes\" &amp; caf\xc3\xa9 \xe2\x82\xac and&#xD;more"},
+    {"a <long> string with \"quotes\" & caf\xc3\xa9 \xe2\x82\xac and\x0amore", '\"',
+     "a &lt;long> string with &quot;quotes&quot; &amp; caf\xc3\xa9 \xe2\x82\xac and&#xA;more"},
 #if 0
     {"\x1f", 0, "&#x1F;"},
     {"\xc2\x80", 0, "&#x80;"},
@@ -1023,6 +1108,21 @@ main(int argc, char *argv[])
 #endif
     {NULL, 0, 0}
   };
+  const char *name_test_values[]={
+    "",
+    "name",
+    "http://example.org/ns#name",
+    "http://example.org/ns/name-1.2",
+    "http://example.org/ns/123",
+    "http://example.org/ns/1abc",
+    "http://example.org/ns#",
+    "http://example.org/caf\xc3\xa9",
+    "http://example.org/\xc3\xa9t\xc3\xa9",
+    "http://example.org/bad\xc3",
+    "http://example.org/\x80" "abc",
+    "-._",
+    NULL
+  };
   int i;
   int failures = 0;
 
@@ -1036,6 +1136,7 @@ main(int argc, char *argv[])
     size_t utf8_string_len = strlen((const char*)utf8_string);
     unsigned char *xml_string;
     int xml_string_len = 0;
+    raptor_iostream *iostr;
 
     xml_string_len = raptor_xml_escape_string(world, 
                                               utf8_string, utf8_string_len,
@@ -1077,6 +1178,37 @@ main(int argc, char *argv[])
             program, xml_string);
 #endif
     RAPTOR_FREE(char*, xml_string);
+
+    /* and again with the iostream writer */
+    xml_string = NULL;
+    iostr = raptor_new_iostream_to_string(world, (void**)&xml_string, NULL,
+                                          NULL);
+    if(!iostr ||
+       raptor_xml_escape_string_write(utf8_string, utf8_string_len, quote,
+                                      iostr)) {
+      fprintf(stderr, "%s: raptor_xml_escape_string_write FAILED to escape string '",
+              program);
+      raptor_bad_string_print(utf8_string, stderr);
+      fputs("'\n", stderr);
+      failures++;
+      if(iostr)
+        raptor_free_iostream(iostr);
+      if(xml_string)
+        raptor_free_memory(xml_string);
+      continue;
+    }
+    raptor_free_iostream(iostr);
+
+    if(!xml_string || strcmp((const char*)xml_string, t->result)) {
+      fprintf(stderr, "%s: raptor_xml_escape_string_write FAILED to escape string '",
+              program);
+      raptor_bad_string_print(utf8_string, stderr);
+      fprintf(stderr, "', expected '%s', result was '%s'\n",
+              t->result, xml_string);
+      failures++;
+    }
+    if(xml_string)
+      raptor_free_memory(xml_string);
   }
 
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1    
@@ -1084,6 +1216,29 @@ main(int argc, char *argv[])
     fprintf(stderr, "%s: raptor_xml_escape_string all tests OK\n", program);
 #endif
 
+  for(i = 0; name_test_values[i]; i++) {
+    const unsigned char *string = (const unsigned char*)name_test_values[i];
+    size_t length = strlen(name_test_values[i]);
+    size_t expected;
+    size_t result;
+
+    /* the longest suffix found by checking every suffix */
+    for(expected = 0; expected < length; expected++) {
+      if(raptor_xml_name_check(string + expected, length - expected, 10))
+        break;
+    }
+
+    result = raptor_xml_name_suffix_start(string, length, 10);
+    if(result != expected) {
+      fprintf(stderr, "%s: raptor_xml_name_suffix_start FAILED for string '",
+              program);
+      raptor_bad_string_print(string, stderr);
+      fprintf(stderr, "', expected %d, result was %d\n",
+              (int)expected, (int)result);
+      failures++;
+    }
+  }
+
   raptor_free_world(world);
 
   return failures;
@@ -802,6 +802,9 @@ raptor_xml_writer_comment_counted(raptor_xml_writer* xml_writer,
  *
  * Finish the XML writer.
  *
+ * Any output buffered by the iostream is passed to its sink with
+ * raptor_iostream_flush().
+ *
  **/
 void
 raptor_xml_writer_flush(raptor_xml_writer* xml_writer)
@@ -810,6 +813,8 @@ raptor_xml_writer_flush(raptor_xml_writer* xml_writer)
     raptor_iostream_write_byte('\n', xml_writer->iostr);
     xml_writer->pending_newline = 0;
   }
+
+  raptor_iostream_flush(xml_writer->iostr);
 }
 
 
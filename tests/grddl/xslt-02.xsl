@@ -0,0 +1,21 @@
+<?xml version="1.0" encoding="utf-8"?>
+<!-- Turn each person @mbox into a triple -->
+<xsl:stylesheet version="1.0"
+    xmlns:xsl="http://www.w3.org/1999/XSL/Transform"
+    xmlns:p="http://example.org/people#"
+    xmlns:rdf="http://www.w3.org/1999/02/22-rdf-syntax-ns#"
+    exclude-result-prefixes="p">
+
+  <xsl:output method="xml" indent="yes"/>
+
+  <xsl:template match="/p:people">
+    <rdf:RDF>
+      <xsl:for-each select="p:person">
+        <rdf:Description rdf:about="http://example.org/people/{@id}">
+          <p:mbox><xsl:value-of select="@mbox"/></p:mbox>
+        </rdf:Description>
+      </xsl:for-each>
+    </rdf:RDF>
+  </xsl:template>
+
+</xsl:stylesheet>
@@ -467,7 +467,10 @@ main(int argc, char *argv[])
               }
 
               name_len = od->name_len;
-              if(!strncmp(optarg, od->name, name_len)) {
+              /* match the whole name so a name that is a prefix of
+               * another one does not take its place */
+              if(!strncmp(optarg, od->name, name_len) &&
+                 (name_len == arg_len || optarg[name_len] == '=')) {
                 fv = (option_value*)raptor_calloc_memory(sizeof(option_value),
                                                          1);
 